@@ -1,3 +1,6 @@
+// In-VM MOV encoder. ipf_encoder/encoder_mov writes the same file on the host
+// straight from a video, far faster.
+//
 // some manual configurations
 //
 let IPFMODE = 1 // 1 or 2
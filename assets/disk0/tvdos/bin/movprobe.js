@@ -38,7 +38,8 @@ seqread.readShort() // skip unused field
 const audioQueueInfo = seqread.readShort()
 const AUDIO_QUEUE_LENGTH = (audioQueueInfo >> 12) + 1
 const AUDIO_QUEUE_BYTES = (audioQueueInfo & 0xFFF) << 2
-seqread.skip(10)
+const INDEX_OFFSET = seqread.readInt() >>> 0
+seqread.skip(6)
 
 let stats = {
     "sync":0,
@@ -49,8 +50,10 @@ let stats = {
     "ipf2a":0,
     "ipf1_delta":0,
     "ipf2_delta":0,
+    "streamed":0,
     "audio_mp2":0,
-    "audio_pcm":0
+    "audio_pcm":0,
+    "index_entries":-1
 }
 
 
@@ -88,11 +91,21 @@ while (seqread.getReadCount() < FILE_LENGTH) {
         else if (packetType == 261) {
             stats["ipf2a"] += 1
         }
+        else if (packetType == 516 || packetType == 517) {
+            stats["ipf1_delta"] += 1
+        }
+        else if (packetType == 772 || packetType == 773) {
+            stats["ipf2_delta"] += 1
+        }
+        else if ((packetType & 254) == 6 && (packetType >>> 8) < 4) {
+            stats["streamed"] += 1
+        }
         else {
             throw Error(`Unknown Video Packet with type ${packetType} at offset ${seqread.getReadCount() - 2}`)
         }
 
         let payloadLen = seqread.readInt()
+        if ((packetType & 254) == 6) seqread.skip(4) // uncompressed size of a streamed packet
         seqread.skip(payloadLen)
     }
     // audio packets
@@ -116,6 +129,13 @@ while (seqread.getReadCount() < FILE_LENGTH) {
             throw Error(`Audio Packet with type ${packetType} at offset ${seqread.getReadCount() - 2}`)
         }
     }
+    // seek index, the last packet
+    else if (65533 == packetType) {
+        if (seqread.getReadCount() - 2 != INDEX_OFFSET) println(`Seek index at offset ${seqread.getReadCount() - 2} is not the one the header points to`)
+        let size = seqread.readInt()
+        stats["index_entries"] = seqread.readInt()
+        seqread.skip(size - 4)
+    }
     else {
         println(`Unknown Packet with type ${packetType} at offset ${seqread.getReadCount() - 2}`)
     }
@@ -134,6 +154,10 @@ finally {
     println(`iPF2: ${stats["ipf2"]}`)
     println(`iPF1a: ${stats["ipf1a"]}`)
     println(`iPF2a: ${stats["ipf2a"]}`)
+    println(`iPF1-delta: ${stats["ipf1_delta"]}`)
+    println(`iPF2-delta: ${stats["ipf2_delta"]}`)
+    println(`Streamed: ${stats["streamed"]}`)
+    println(`Seek index: ${(stats["index_entries"] < 0) ? "none" : stats["index_entries"] + " keyframes"}`)
     println("** Audio Stats **")
     println(`MP2: ${stats["audio_mp2"]}`)
     println(`PCM: ${stats["audio_pcm"]}`)
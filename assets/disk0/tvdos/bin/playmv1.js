@@ -176,6 +176,10 @@ while (!stopPlay && seqread.getReadCount() < FILE_LENGTH) {
                 if (65535 == packetType) {
                     frameUnit -= 1
                 }
+                // seek index, written after the last frame
+                else if (65533 == packetType) {
+                    break renderLoop
+                }
                 // background colour packets
                 else if (65279 == packetType) {
                     AUTO_BGCOLOUR_CHANGE = false
@@ -246,8 +250,8 @@ while (!stopPlay && seqread.getReadCount() < FILE_LENGTH) {
 
                         sys.free(gzippedPtr)
                     }
-                    // iPF1d
-                    else if (packetType == 516) {
+                    // iPF1d/iPF2d
+                    else if (packetType == 516 || packetType == 517 || packetType == 772 || packetType == 773) {
                         doFrameskip = false // disable frameskip for delta-coding
 
                         let payloadLen = seqread.readInt()
@@ -263,7 +267,10 @@ while (!stopPlay && seqread.getReadCount() < FILE_LENGTH) {
 
                         if (frameUnit == 1) {
                             gzip.decompFromTo(gzippedPtr, payloadLen, ipfbuf) // should return FBUF_SIZE
-                            graphics.applyIpf1d(ipfbuf, -1048577, -1310721, width, height)
+                            if (packetType == 516)
+                                graphics.applyIpf1d(ipfbuf, -1048577, -1310721, width, height)
+                            else
+                                graphics.applyIpfDelta(ipfbuf, -1048577, -1310721, width, height, (packetType >>> 8) - 2, (packetType & 255) == 5)
 
                             // defer audio playback until a first frame is sent
                             if (!audioFired) {
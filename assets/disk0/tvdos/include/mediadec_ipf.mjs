@@ -6,12 +6,15 @@
  * (the proven, fast path), plus MP2 and raw-PCM audio and the background-colour
  * packet.  Presents at decode time (so blit() is a no-op); bias lighting is a
  * separate player-driven stage via the bias() method; the ASCII path reads the
- * planes back via common.sampleGrayScreen.
+ * planes back via common.sampleGrayScreen.  Seeking uses the keyframe index
+ * that encoder_mov appends; files without one don't seek.  Streamed packets
+ * (6,t / 7,t) continue one zstd stream per GOP, kept open in `zstream`.
  */
 
 const WIDTH = 560
 const HEIGHT = 448
 const FBUF_SIZE = WIDTH * HEIGHT
+const INDEX_PACKET = 0xFFFD   // 253,255: seek index, after the last frame
 
 function create(magic, sr, fileLength, opts, common) {
     const audioR = common.makeAudioRouter(sr)
@@ -23,7 +26,8 @@ function create(magic, sr, fileLength, opts, common) {
     const FRAME_COUNT = sr.readInt() % 16777216
     sr.readShort()                 // skip unused
     sr.readShort()                 // audioQueueInfo (unused for playback)
-    sr.skip(10)
+    const INDEX_OFFSET = sr.readInt() >>> 0   // 0 = no seek index
+    sr.skip(6)
 
     graphics.setGraphicsMode(4)
     graphics.clearPixels(255)
@@ -50,6 +54,8 @@ function create(magic, sr, fileLength, opts, common) {
     let framesRead = 0
     let frameCount = 0
     let paused = false
+    let seekIndex = null           // [{frame, offset}], read on the first seek
+    let zstream = 0                // gzip decompression stream for streamed packets
 
     function setBackgroundPacket() {
         autoBg = false
@@ -57,6 +63,45 @@ function create(magic, sr, fileLength, opts, common) {
         graphics.setBackground((rgbx & 0xFF000000) >>> 24, (rgbx & 0x00FF0000) >>> 16, (rgbx & 0x0000FF00) >>> 8)
     }
 
+    // The index sits at the end of the file; fetch it once and come back.
+    function loadSeekIndex() {
+        if (seekIndex !== null) return seekIndex
+        seekIndex = []
+        if (INDEX_OFFSET < 32 || INDEX_OFFSET + 10 > fileLength) return seekIndex
+        let savedPos = sr.getReadCount()
+        try {
+            sr.seek(INDEX_OFFSET)
+            if (sr.readShort() != INDEX_PACKET) return seekIndex
+            let size = sr.readInt()
+            let count = sr.readInt()
+            if (size != 4 + 8 * count || INDEX_OFFSET + 6 + size > fileLength) return seekIndex
+            let entries = sr.readBytes(8 * count)
+            for (let i = 0; i < count; i++) {
+                let e = entries + 8 * i
+                seekIndex.push({
+                    frame: sys.peek(e) | (sys.peek(e + 1) << 8) | (sys.peek(e + 2) << 16) | (sys.peek(e + 3) << 24),
+                    offset: (sys.peek(e + 4) | (sys.peek(e + 5) << 8) | (sys.peek(e + 6) << 16) | (sys.peek(e + 7) << 24)) >>> 0
+                })
+            }
+            sys.free(entries)
+        }
+        catch (e) { serial.printerr(`Seek index error: ${e}`); seekIndex = [] }
+        finally { sr.seek(savedPos) }
+        return seekIndex
+    }
+
+    // Last indexed keyframe at or before targetFrame.
+    function findKeyframe(targetFrame) {
+        let index = loadSeekIndex()
+        let lo = 0, hi = index.length - 1, found = null
+        while (lo <= hi) {
+            let mid = (lo + hi) >>> 1
+            if (index[mid].frame <= targetFrame) { found = index[mid]; lo = mid + 1 }
+            else hi = mid - 1
+        }
+        return found
+    }
+
     function step() {
         const now = sys.nanoTime()
         if (paused) { lastT = now; return { type: 'idle' } }
@@ -81,6 +126,9 @@ function create(magic, sr, fileLength, opts, common) {
             else if (0xFEFF === packetType) {       // explicit background colour
                 setBackgroundPacket()
             }
+            else if (INDEX_PACKET === packetType) { // seek index: nothing follows
+                return { type: 'eof' }
+            }
             else if (packetType < 2047) {           // video
                 if (packetType == 4 || packetType == 5 || packetType == 260 || packetType == 261) {
                     let decodefun = (packetType > 255) ? graphics.decodeIpf2 : graphics.decodeIpf1
@@ -97,7 +145,7 @@ function create(magic, sr, fileLength, opts, common) {
                     }
                     sys.free(gz)
                 }
-                else if (packetType == 516) {       // iPF1-delta
+                else if (packetType == 516 || packetType == 517 || packetType == 772 || packetType == 773) {   // iPF1/iPF2-delta
                     doFrameskip = false
                     let payloadLen = sr.readInt()
                     if (framesRead >= FRAME_COUNT) return { type: 'eof' }
@@ -105,13 +153,40 @@ function create(magic, sr, fileLength, opts, common) {
                     let gz = sr.readBytes(payloadLen)
                     if (frameUnit == 1) {
                         gzip.decompFromTo(gz, payloadLen, ipfbuf)
-                        graphics.applyIpf1d(ipfbuf, common.DISP_RG, common.DISP_BA, width, height)
+                        if (packetType == 516)
+                            graphics.applyIpf1d(ipfbuf, common.DISP_RG, common.DISP_BA, width, height)
+                        else
+                            graphics.applyIpfDelta(ipfbuf, common.DISP_RG, common.DISP_BA, width, height, (packetType >>> 8) - 2, (packetType & 255) == 5)
                         audioR.fire()
                         displayed = true
                         frameCount += 1
                     }
                     sys.free(gz)
                 }
+                else if ((packetType & 254) == 6 && (packetType >>> 8) < 4) {   // streamed iPF, any type
+                    doFrameskip = false
+                    let t = packetType >>> 8
+                    let payloadLen = sr.readInt()
+                    let rawLen = sr.readInt()
+                    if (framesRead >= FRAME_COUNT) return { type: 'eof' }
+                    if (rawLen > FBUF_SIZE) throw Error(`Streamed iPF packet of ${rawLen} bytes at ${sr.getReadCount() - 10}`)
+                    framesRead += 1
+                    let gz = sr.readBytes(payloadLen)
+                    if (zstream == 0) zstream = gzip.openDecompStream()
+                    if (t < 2) gzip.resetDecompStream(zstream)
+                    gzip.decompStreamFromTo(zstream, gz, payloadLen, ipfbuf, rawLen)
+                    sys.free(gz)
+                    if (frameUnit == 1) {
+                        let hasAlpha = (packetType & 1) == 1
+                        if (t < 2)
+                            (t == 1 ? graphics.decodeIpf2 : graphics.decodeIpf1)(ipfbuf, common.DISP_RG, common.DISP_BA, width, height, hasAlpha)
+                        else
+                            graphics.applyIpfDelta(ipfbuf, common.DISP_RG, common.DISP_BA, width, height, t - 2, hasAlpha)
+                        audioR.fire()
+                        displayed = true
+                        frameCount += 1
+                    }
+                }
                 else {
                     throw Error(`Unknown iPF video packet type ${packetType} at ${sr.getReadCount() - 2}`)
                 }
@@ -179,10 +254,20 @@ function create(magic, sr, fileLength, opts, common) {
         isPaused() { return paused },
         setVolume(v) { audioR.setVolume(v) },
         getVolume() { return audioR.getVolume() },
-        seekSeconds(_n) { /* iPF has no index; seeking unsupported */ },
+        seekSeconds(n) {
+            let target = (n < 0)
+                ? Math.max(0, frameCount - Math.floor(fps * (-n)))
+                : Math.min(FRAME_COUNT - 1, frameCount + Math.floor(fps * n))
+            let key = findKeyframe(target)
+            if (!key || (n > 0 && key.frame <= frameCount)) return
+            sr.seek(key.offset)
+            frameCount = key.frame; framesRead = key.frame; akku = FRAME_TIME
+            audioR.purge()
+        },
         cue(_d) { /* no cues */ },
 
         close() {
+            if (zstream != 0) gzip.closeDecompStream(zstream)
             sys.free(ipfbuf)
             audioR.close()
         }
@@ -42,6 +42,17 @@ export function makeCompress(vm) {
         return bytes.length
     }
 
+    // Streams for packets that continue one zstd frame (openDecompStream & co.).
+    // Node has no synchronous streaming Zstd, so every packet decompresses the
+    // stream so far again and keeps the new tail; quadratic, but GOPs are short.
+    const streams = new Map()
+    let nextStream = 1
+    const getStream = (handle, fn) => {
+        const stream = streams.get(handle)
+        if (!stream) throw new Error(`gzip.${fn}: no such decompression stream: ${handle}`)
+        return stream
+    }
+
     const gzip = {
         comp: (input) => bytesToArr(compBytes(typeof input === "string" ? strToBytes(input) : input)),
         decomp: (input) => bytesToArr(decompBytes(typeof input === "string" ? strToBytes(input) : input)),
@@ -65,6 +76,27 @@ export function makeCompress(vm) {
             return writeOut(out, output, true)
         },
 
+        openDecompStream: () => {
+            streams.set(nextStream, { packets: [], produced: 0 })
+            return nextStream++
+        },
+        resetDecompStream: (handle) => {
+            getStream(handle, "resetDecompStream")
+            streams.set(handle, { packets: [], produced: 0 })
+        },
+        closeDecompStream: (handle) => { streams.delete(handle) },
+        decompStreamFromTo: (handle, input, len, output, outLen) => {
+            const stream = getStream(handle, "decompStreamFromTo")
+            stream.packets.push(Buffer.from(mem.readBytes(input, len)))
+            const all = zlib.zstdDecompressSync(Buffer.concat(stream.packets))
+            if (all.length < stream.produced + outLen) {
+                throw new Error(`gzip.decompStreamFromTo: stream ended after ${all.length - stream.produced} of ${outLen} bytes`)
+            }
+            const out = all.subarray(stream.produced, stream.produced + outLen)
+            stream.produced += outLen
+            return writeOut(out, output, false)
+        },
+
         // internal helper used by sys.toObjectCode
         decompBytes: (bytes) => decompBytes(bytes),
         compBytes: (bytes) => compBytes(bytes),
@@ -3,10 +3,12 @@
 // The `graphics` global -- headless port of GraphicsJSR223Delegate.kt. Text /
 // cursor operations go through the shared TTY (so con.* and direct-VRAM reads
 // agree); the framebuffer is a flat 560x448 byte plane inside the GPU block.
-// Image decoders and the iPF/TEV/TAV codecs are NOT ported -- they call into
-// native Kotlin and will throw a clear "not available in harness" error.
+// Image decoders and the TEV/TAV codecs are NOT ported -- they call into
+// native Kotlin and will throw a clear "not available in harness" error. The
+// iPF codecs run natively when the libipf addon is built (see ipf.mjs).
 
 import { GPU_SLOT, GPU_TEXT_AREA_OFFSET } from "./memory.mjs"
+import { loadIpfCodec, makeIpfFunctions } from "./ipf.mjs"
 
 const FB_WIDTH = 560
 const FB_HEIGHT = 448
@@ -98,6 +100,8 @@ export function makeGraphics(vm) {
         decodeIpf1: notImpl("decodeIpf1"),
         decodeIpf2: notImpl("decodeIpf2"),
         applyIpf1d: notImpl("applyIpf1d"),
+        encodeIpfDelta: notImpl("encodeIpfDelta"),
+        applyIpfDelta: notImpl("applyIpfDelta"),
         decodeIpf1Progressive: notImpl("decodeIpf1Progressive"),
         decodeIpf2Progressive: notImpl("decodeIpf2Progressive"),
         tevDecode: notImpl("tevDecode"),
@@ -105,5 +109,8 @@ export function makeGraphics(vm) {
         tevMotionCopy8x8: notImpl("tevMotionCopy8x8"),
     }
 
+    const ipfCodec = loadIpfCodec()
+    if (ipfCodec) Object.assign(g, makeIpfFunctions(vm.mem, ipfCodec))
+
     return g
 }
@@ -0,0 +1,101 @@
+// harness/lib/ipf.mjs
+//
+// iPF codec for the headless `graphics` delegate, backed by the libipf Node
+// addon (ipf_encoder/ipf_napi.node, built with `make napi`). libipf matches
+// GraphicsJSR223Delegate's Kotlin codec byte for byte, so encode/decode
+// output here is what the real machine produces.
+//
+// The addon is optional: without it loadIpfCodec() returns null and the
+// graphics delegate keeps the "not available in harness" stubs. Set
+// TSVM_IPF_ADDON to load it from elsewhere.
+
+import path from "node:path"
+import { createRequire } from "node:module"
+import { fileURLToPath } from "node:url"
+
+const HARNESS_DIR = path.dirname(path.dirname(fileURLToPath(import.meta.url)))
+const ADDON_PATH = process.env.TSVM_IPF_ADDON ||
+    path.join(path.dirname(HARNESS_DIR), "ipf_encoder/ipf_napi.node")
+
+const FB_WIDTH = 560
+
+let addon // undefined = not tried yet, null = unavailable
+
+export function loadIpfCodec() {
+    if (addon === undefined) {
+        try { addon = createRequire(import.meta.url)(ADDON_PATH) }
+        catch (e) { addon = null }
+    }
+    return addon
+}
+
+const blockSize = (type, hasAlpha) => (type === 0 ? 12 : 16) + (hasAlpha ? 8 : 0)
+
+// View of `span` bytes at a VM address, the way VM.getDev resolves it. Negative
+// sources are read backwards by the Kotlin codec, which has no flat view.
+function view(mem, ptr, span, what) {
+    const dev = mem._getDev(ptr | 0, span)
+    if (!dev) throw new Error(`graphics: ${what} range at ${ptr} (${span} bytes) is not flat memory`)
+    return dev.array.subarray(dev.base, dev.base + span)
+}
+
+// Everything from `ptr` to the end of its memory; delta streams carry no length.
+function tail(mem, ptr, what) {
+    const dev = mem._getDev(ptr | 0, 1)
+    if (!dev) throw new Error(`graphics: ${what} at ${ptr} is not flat memory`)
+    return dev.array.subarray(dev.base)
+}
+
+// Returns the graphics-delegate functions, bound to `mem`.
+export function makeIpfFunctions(mem, codec) {
+    const encode = (type) => (srcPtr, destPtr, width, height, channels, hasAlpha, pattern) => {
+        if (srcPtr < 0 || destPtr < 0) throw new Error("graphics.encodeIpf: only user-space buffers are supported")
+        const blocksX = (width + 3) >> 2, blocksY = (height + 3) >> 2
+        const srcSpan = channels * ((blocksY * 4 - 1) * width + blocksX * 4)
+        const src = view(mem, srcPtr, srcSpan, "source")
+        const dest = view(mem, destPtr, blocksX * blocksY * blockSize(type, hasAlpha), "destination")
+        codec.encode(src, width * channels, channels, dest, width, height, type, hasAlpha ? 1 : 0, pattern | 0)
+    }
+
+    const decode = (type, progressive) => (srcPtr, destRG, destBA, width, height, hasAlpha) => {
+        if (destRG * destBA < 0) throw new Error("Both destination memories must be on the same domain (both being Usermem or HWmem)")
+        if (srcPtr < 0) throw new Error("graphics.decodeIpf: only user-space sources are supported")
+        const blocksX = (width + 3) >> 2, blocksY = (height + 3) >> 2
+        const planeSpan = (blocksY * 4 - 1) * FB_WIDTH + blocksX * 4
+        const src = view(mem, srcPtr, blocksX * blocksY * blockSize(type, hasAlpha), "source")
+        const rg = view(mem, destRG, planeSpan, "RG plane")
+        const ba = view(mem, destBA, planeSpan, "BA plane")
+        const flags = (hasAlpha ? 0x01 : 0) | (progressive ? 0x80 : 0)
+        codec.decodePlanes(src, rg, ba, FB_WIDTH, width, height, type, flags)
+    }
+
+    const encodeDelta = (previousPtr, currentPtr, outPtr, width, height, type, hasAlpha) => {
+        const blocksX = (width + 3) >> 2, blocksY = (height + 3) >> 2
+        const blocks = blocksX * blocksY, span = blocks * blockSize(type, hasAlpha)
+        const previous = view(mem, previousPtr, span, "previous frame")
+        const current = view(mem, currentPtr, span, "current frame")
+        const out = view(mem, outPtr, blocks * (blockSize(type, hasAlpha) + 2) + 16, "delta destination")
+        return codec.deltaEncode(previous, current, out, width, height, type, hasAlpha ? 1 : 0)
+    }
+
+    const applyDelta = (deltaPtr, destRG, destBA, width, height, type, hasAlpha) => {
+        if (destRG * destBA < 0) throw new Error("Both destination memories must be on the same domain")
+        const planeSpan = (height - 1) * FB_WIDTH + width
+        const rg = view(mem, destRG, planeSpan, "RG plane")
+        const ba = view(mem, destBA, planeSpan, "BA plane")
+        codec.deltaApplyPlanes(tail(mem, deltaPtr, "delta stream"), rg, ba, FB_WIDTH, width, height, type, hasAlpha ? 1 : 0)
+    }
+
+    return {
+        encodeIpf1: encode(0),
+        encodeIpf2: encode(1),
+        decodeIpf1: decode(0, false),
+        decodeIpf2: decode(1, false),
+        decodeIpf1Progressive: decode(0, true),
+        decodeIpf2Progressive: decode(1, true),
+        encodeIpf1d: (previousPtr, currentPtr, outPtr, width, height) => encodeDelta(previousPtr, currentPtr, outPtr, width, height, 0, false),
+        applyIpf1d: (deltaPtr, destRG, destBA, width, height) => applyDelta(deltaPtr, destRG, destBA, width, height, 0, false),
+        encodeIpfDelta: encodeDelta,
+        applyIpfDelta: applyDelta,
+    }
+}
@@ -1,9 +1,26 @@
 // harness/test/t_compress.mjs -- gzip (Zstd) + base64 round-trips, including
-// the in-memory compFromTo/decompFromTo variants.
+// the in-memory compFromTo/decompFromTo variants and packet streams.
 
+import zlib from "node:zlib"
 import { createVM, makeT } from "../index.mjs"
 
-export function run() {
+// Compress `chunks` as one zstd stream flushed after each chunk, the way
+// encoder_mov --stream writes a GOP: one packet per chunk, none closing the frame.
+async function flushedPackets(chunks) {
+    const z = zlib.createZstdCompress()
+    const out = []
+    z.on("data", (c) => out.push(c))
+    const packets = []
+    for (const chunk of chunks) {
+        z.write(Buffer.from(chunk, "latin1"))
+        await new Promise((resolve) => z.flush(zlib.constants.ZSTD_e_flush, resolve))
+        packets.push(Buffer.concat(out.splice(0)))
+    }
+    z.destroy()
+    return packets
+}
+
+export async function run() {
     const t = makeT("compress")
     const vm = createVM({ tvdos: false })
     const { gzip, base64, sys } = vm.sandbox
@@ -26,6 +43,30 @@ export function run() {
     for (let i = 0; i < src.length; i++) if (sys.peek(30000 + i) !== src.charCodeAt(i)) ok = false
     t.ok(ok, "decompFromTo restores the bytes")
 
+    // ---- packet streams: openDecompStream / decompStreamFromTo ----
+    const chunks = ["keyframe ".repeat(40), "delta one ".repeat(12), "delta two ".repeat(9)]
+    const packets = await flushedPackets(chunks)
+    const readStr = (ptr, len) => { let s = ""; for (let i = 0; i < len; i++) s += String.fromCharCode(sys.peek(ptr + i)); return s }
+    const feed = (handle, packet, outLen) => {
+        for (let i = 0; i < packet.length; i++) sys.poke(40000 + i, packet[i])
+        return gzip.decompStreamFromTo(handle, 40000, packet.length, 50000, outLen)
+    }
+    const zs = gzip.openDecompStream()
+    let streamOk = true
+    packets.forEach((packet, i) => {
+        if (feed(zs, packet, chunks[i].length) !== chunks[i].length || readStr(50000, chunks[i].length) !== chunks[i]) streamOk = false
+    })
+    t.ok(streamOk, "decompStreamFromTo decodes each flushed packet of an unfinished frame")
+    t.ok(packets[1].length < 20, `later packets reuse the stream's window (${packets[1].length} bytes)`)
+
+    gzip.resetDecompStream(zs)
+    t.throws(() => feed(zs, packets[1], chunks[1].length), undefined, "after resetDecompStream a mid-stream packet has no frame to continue")
+    gzip.resetDecompStream(zs)
+    t.eq(feed(zs, packets[0], chunks[0].length), chunks[0].length, "resetDecompStream starts a new frame")
+    t.throws(() => feed(zs, packets[2], chunks[1].length + chunks[2].length), undefined, "asking for more than a packet holds fails")
+    gzip.closeDecompStream(zs)
+    t.throws(() => feed(zs, packets[0], chunks[0].length), /no such decompression stream/, "closed streams are gone")
+
     // ---- base64 ----
     t.eq(base64.btoa("Man"), "TWFu", "base64.btoa")
     t.eq(base64.atostr("TWFu"), "Man", "base64.atostr")
@@ -0,0 +1,168 @@
+// harness/test/t_ipf.mjs -- graphics.encodeIpf*/decodeIpf* through the libipf
+// addon (ipf_encoder/ipf_napi.node, `make napi`). Without the addon only the
+// stubs are checked. decoder_ipf's scaling of empty images is checked when
+// ipf_encoder/decoder_ipf is built.
+
+import fs from "node:fs"
+import os from "node:os"
+import path from "node:path"
+import { spawnSync } from "node:child_process"
+import zlib from "node:zlib"
+import { fileURLToPath } from "node:url"
+import { createVM, makeT } from "../index.mjs"
+import { loadIpfCodec } from "../lib/ipf.mjs"
+
+const ASSETS = path.join(path.dirname(fileURLToPath(import.meta.url)), "../../assets/disk0")
+const FB_RG = -1048577
+const FB_BA = -1310721
+const FB_WIDTH = 560
+const DECODER_IPF = path.join(path.dirname(fileURLToPath(import.meta.url)), "../../ipf_encoder/decoder_ipf")
+
+function fnv1a(bytes) {
+    let h = 0x811c9dc5
+    for (const b of bytes) h = Math.imul(h ^ b, 0x01000193) >>> 0
+    return h
+}
+
+// A header-only iPF1 file: the parser accepts a zero side, with no blocks after it
+function emptyIpf(width, height) {
+    const header = Buffer.alloc(28)
+    header.write("\x1FTSVMiPF", 0, "latin1")
+    header.writeUInt16LE(width, 8)
+    header.writeUInt16LE(height, 10)
+    return header
+}
+
+function checkDecoderScaling(t) {
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), "tsvm-ipf-"))
+    const cases = [[0, 256, "--fit", "100x77"], [0, 0, "--fit", "10x10"], [256, 0, "--upscale", "2"]]
+    for (const [w, h, option, value] of cases) {
+        const input = path.join(dir, `${w}x${h}.ipf`), output = path.join(dir, `${w}x${h}.png`)
+        fs.writeFileSync(input, emptyIpf(w, h))
+        const r = spawnSync(DECODER_IPF, ["-i", input, "-o", output, option, value], { encoding: "utf8" })
+        t.ok(r.signal === null && r.status === 1 && /Cannot scale/.test(r.stderr),
+            `decoder_ipf ${option} ${value} rejects a ${w}x${h} image`)
+        t.ok(!fs.existsSync(output), `no output is written for a ${w}x${h} image`)
+    }
+    const batch = spawnSync(DECODER_IPF, ["-b", dir, "-O", path.join(dir, "out"), "--fit", "100x77"], { encoding: "utf8" })
+    t.ok(batch.signal === null && batch.status === 1 && (batch.stderr.match(/Cannot scale/g) || []).length === cases.length,
+        "batch --fit rejects every empty image")
+    fs.rmSync(dir, { recursive: true, force: true })
+}
+
+export function run() {
+    const t = makeT("ipf")
+    if (fs.existsSync(DECODER_IPF)) checkDecoderScaling(t)
+    const vm = createVM({ tvdos: false })
+    const { graphics, sys } = vm.sandbox
+
+    if (!loadIpfCodec()) {
+        t.throws(() => graphics.decodeIpf1(0, FB_RG, FB_BA, 4, 4, false), /not available/, "decodeIpf1 is stubbed without the addon")
+        vm.dispose()
+        return t.report()
+    }
+
+    const plane = (base, len) => { const out = []; for (let i = 0; i < len; i++) out.push(sys.peek(base - i)); return out }
+
+    // ---- solid colours land on the planes as nibble pairs ----
+    const solid = (r, g, b, type) => {
+        for (let i = 0; i < 16 * 3; i += 3) { sys.poke(1000 + i, r); sys.poke(1001 + i, g); sys.poke(1002 + i, b) }
+        const encode = type === 0 ? graphics.encodeIpf1 : graphics.encodeIpf2
+        const decode = type === 0 ? graphics.decodeIpf1 : graphics.decodeIpf2
+        encode(1000, 2000, 4, 4, 3, false, -1)
+        decode(2000, FB_RG, FB_BA, 4, 4, false)
+        return [sys.peek(FB_RG), sys.peek(FB_BA), sys.peek(FB_RG - 3 * FB_WIDTH - 3), sys.peek(FB_BA - 3 * FB_WIDTH - 3)]
+    }
+    t.eq(solid(255, 255, 255, 0).join(), "255,255,255,255", "iPF1 white decodes to RG 0xFF, BA 0xFF")
+    t.eq(solid(0, 0, 0, 0).join(), "0,15,0,15", "iPF1 black decodes to RG 0x00, BA 0x0F")
+    t.eq(solid(255, 0, 0, 1).join(), "240,15,240,15", "iPF2 red decodes to RG 0xF0, BA 0x0F")
+
+    // ---- shipped assets match the reference decode of the Kotlin codec ----
+    for (const [name, type, rgHash, baHash] of [["ycocg.ipf1", 0, 0x62634e1b, 0xa422f2e5], ["ycocg.ipf2", 1, 0xad2a7da7, 0xa6dd5575]]) {
+        const file = fs.readFileSync(path.join(ASSETS, name))
+        const width = file.readUInt16LE(8), height = file.readUInt16LE(10)
+        const blocks = zlib.gunzipSync(file.subarray(28))
+        for (let i = 0; i < blocks.length; i++) sys.poke(4096 + i, blocks[i])
+        const decode = type === 0 ? graphics.decodeIpf1 : graphics.decodeIpf2
+        decode(4096, FB_RG, FB_BA, width, height, false)
+        const span = ((height + 3) & ~3) * FB_WIDTH
+        t.eq(fnv1a(plane(FB_RG, span)), rgHash, `${name} RG plane`)
+        t.eq(fnv1a(plane(FB_BA, span)), baHash, `${name} BA plane`)
+    }
+
+    // ---- progressive decode places Adam7-ordered blocks like a raster decode ----
+    const W = 32, H = 16
+    for (let y = 0; y < H; y++) for (let x = 0; x < W; x++) {
+        const p = 1000 + 3 * (y * W + x)
+        sys.poke(p, x * 8); sys.poke(p + 1, y * 16); sys.poke(p + 2, (x ^ y) * 8)
+    }
+    graphics.encodeIpf1(1000, 8000, W, H, 3, false, 0)
+    graphics.decodeIpf1(8000, FB_RG, FB_BA, W, H, false)
+    const raster = plane(FB_RG, H * FB_WIDTH).concat(plane(FB_BA, H * FB_WIDTH))
+
+    const ADAM7 = [[1,6,4,6,2,6,4,6],[7,7,7,7,7,7,7,7],[5,6,5,6,5,6,5,6],[7,7,7,7,7,7,7,7],
+                   [3,6,4,6,3,6,4,6],[7,7,7,7,7,7,7,7],[5,6,5,6,5,6,5,6],[7,7,7,7,7,7,7,7]]
+    const bx = W / 4, by = H / 4
+    let out = 12000
+    for (let pass = 1; pass <= 7; pass++)
+        for (let y = 0; y < by; y++) for (let x = 0; x < bx; x++)
+            if (ADAM7[(y * 4) % 8][(x * 4) % 8] === pass) {
+                for (let i = 0; i < 12; i++) sys.poke(out++, sys.peek(8000 + 12 * (y * bx + x) + i))
+            }
+    graphics.decodeIpf1Progressive(12000, FB_RG, FB_BA, W, H, false)
+    const progressive = plane(FB_RG, H * FB_WIDTH).concat(plane(FB_BA, H * FB_WIDTH))
+    t.eq(progressive.join(), raster.join(), "progressive decode matches raster decode")
+
+    // ---- delta frames: applying the delta to frame A's picture gives frame B's ----
+    for (const [type, hasAlpha] of [[0, false], [0, true], [1, false], [1, true]]) {
+        const encode = type === 0 ? graphics.encodeIpf1 : graphics.encodeIpf2
+        const decode = type === 0 ? graphics.decodeIpf1 : graphics.decodeIpf2
+        const fill = (shift) => {
+            for (let y = 0; y < H; y++) for (let x = 0; x < W; x++) {
+                const p = 1000 + 4 * (y * W + x), moved = x >= 12 && x < 24 && y >= 4
+                sys.poke(p, (moved ? x + shift : x) * 8); sys.poke(p + 1, y * 16); sys.poke(p + 2, (x ^ y) * 8); sys.poke(p + 3, moved ? 128 : 255)
+            }
+        }
+        fill(0); encode(1000, 8000, W, H, 4, hasAlpha, -1)
+        fill(9); encode(1000, 12000, W, H, 4, hasAlpha, -1)
+        const len = graphics.encodeIpfDelta(8000, 12000, 16000, W, H, type, hasAlpha)
+        decode(12000, FB_RG, FB_BA, W, H, hasAlpha)
+        const expected = plane(FB_RG, H * FB_WIDTH).concat(plane(FB_BA, H * FB_WIDTH))
+        decode(8000, FB_RG, FB_BA, W, H, hasAlpha)
+        graphics.applyIpfDelta(16000, FB_RG, FB_BA, W, H, type, hasAlpha)
+        const patched = plane(FB_RG, H * FB_WIDTH).concat(plane(FB_BA, H * FB_WIDTH))
+        const label = `${type === 0 ? "iPF1" : "iPF2"}${hasAlpha ? "+alpha" : ""}`
+        t.ok(len > 1 && len < 32 * (12 + (hasAlpha ? 8 : 0)), `${label} delta only carries the changed blocks (${len} bytes)`)
+        t.eq(patched.join(), expected.join(), `${label} delta applies onto the previous frame`)
+    }
+
+    // iPF1 streams are what encodeIpf1d has always written: skip 3, patch 1, end
+    for (let i = 0; i < 48; i++) { sys.poke(8000 + i, 0x88); sys.poke(12000 + i, 0x88) }
+    sys.poke(12000 + 36, 0x11)
+    t.eq(graphics.encodeIpf1d(8000, 12000, 16000, 16, 4), 17, "encodeIpf1d writes SKIP/PATCH/END")
+    t.eq([0, 1, 2, 3, 4, 16].map(i => sys.peek(16000 + i)).join(), "0,3,1,1,17,255", "encodeIpf1d stream layout")
+    sys.poke(16000, 7)
+    t.throws(() => graphics.applyIpf1d(16000, FB_RG, FB_BA, 16, 4), /Corrupt delta/, "unknown delta opcodes are rejected")
+
+    // MOVE reads the previous frame even where the same stream has already written
+    graphics.encodeIpf1(1000, 8000, W, H, 4, false, 0)
+    graphics.decodeIpf1(8000, FB_RG, FB_BA, W, H, false)
+    const before = [plane(FB_RG, H * FB_WIDTH), plane(FB_BA, H * FB_WIDTH)]
+    ;[3, 7, 1, 0, 3, 1, 0xFF, 0, 255].forEach((b, i) => sys.poke(16000 + i, b)) // MOVE 7 (+1,0), MOVE 1 (-1,0), END
+    graphics.applyIpf1d(16000, FB_RG, FB_BA, W, H)
+    const moved = [plane(FB_RG, H * FB_WIDTH), plane(FB_BA, H * FB_WIDTH)]
+    let moveErrors = 0
+    for (let p = 0; p < 2; p++) for (let y = 0; y < H; y++) for (let x = 0; x < W; x++) {
+        const o = y * FB_WIDTH + x
+        const want = y >= 4 ? before[p][o] : x < 28 ? before[p][o + 4] : before[p][o - 4]
+        if (moved[p][o] !== want) moveErrors++
+    }
+    t.eq(moveErrors, 0, "MOVE copies blocks from the previous frame")
+
+    // ---- errors ----
+    t.throws(() => graphics.decodeIpf1(8000, FB_RG, 50000, W, H, false), /same domain/, "mixed-domain destinations are rejected")
+    t.throws(() => graphics.decodeIpf1(-1, FB_RG, FB_BA, W, H, false), /user-space/, "hardware sources are rejected")
+
+    vm.dispose()
+    return t.report()
+}
@@ -1,10 +1,17 @@
 // harness/test/t_tvdos.mjs -- TVDOS userland: path resolution, real-disk reads,
 // copy-on-write overlay (the repo is never mutated), require(), and modules
-// seeing host globals.
+// seeing host globals. MOV playback of encoder_mov output needs the libipf
+// addon and ipf_encoder/encoder_mov (`make napi encoder_mov`).
 
 import fs from "node:fs"
+import os from "node:os"
 import path from "node:path"
+import { execFileSync } from "node:child_process"
+import { fileURLToPath } from "node:url"
 import { createVM, makeT } from "../index.mjs"
+import { loadIpfCodec } from "../lib/ipf.mjs"
+
+const ENCODER_MOV = path.join(path.dirname(fileURLToPath(import.meta.url)), "../../ipf_encoder/encoder_mov")
 
 export function run() {
     const t = makeT("tvdos")
@@ -55,6 +62,103 @@ export function run() {
     t.ok(m.zlen > 0 && m.zlen < 99, "module can use host globals (gzip)")
     t.throws(() => { m.add = 1 }, undefined, "require() returns a frozen exports object")
 
+    // ---- mediadec_ipf seeks through a MOV seek index ----
+    // Four 1-fps frames with keyframes indexed at frames 0 and 2, read through
+    // an in-memory stand-in for seqread (the harness has no disk drive).
+    const mov = [0x1F, 0x54, 0x53, 0x56, 0x4D, 0x4D, 0x4F, 0x56, 8, 0, 8, 0, 1, 0, 4, 0, 0, 0, 0xFF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
+    const starts = []
+    for (let f = 0; f < 4; f++) {
+        if (f > 0) mov.push(0xFF, 0xFF)
+        starts.push(mov.length)
+        mov.push(4, 0, 1, 0, 0, 0, 0xAA)
+    }
+    mov.push(0xFF, 0xFF)
+    const u32 = (v) => [v & 255, (v >>> 8) & 255, (v >>> 16) & 255, v >>> 24]
+    const indexOffset = mov.length
+    mov.push(0xFD, 0xFF, ...u32(20), ...u32(2), ...u32(0), ...u32(starts[0]), ...u32(2), ...u32(starts[2]))
+    mov.splice(22, 4, ...u32(indexOffset))
+    const openMov = (bytes) => {
+        let pos = 8
+        const sr = {
+            readBytes(n, ptr) {
+                const p = ptr === undefined ? sys.malloc(n) : ptr
+                for (let i = 0; i < n; i++) sys.poke(p + i, bytes[pos++] | 0)
+                return p
+            },
+            readShort() { pos += 2; return bytes[pos - 2] | (bytes[pos - 1] << 8) },
+            readInt() { pos += 4; return bytes[pos - 4] | (bytes[pos - 3] << 8) | (bytes[pos - 2] << 16) | (bytes[pos - 1] << 24) },
+            skip(n) { pos += n },
+            seek(p) { pos = p },
+            getReadCount() { return pos },
+        }
+        const common = vm.sandbox.require("A:/tvdos/include/mediadec_common.mjs")
+        return { sr, dec: vm.sandbox.require("A:/tvdos/include/mediadec_ipf.mjs").create(null, sr, bytes.length, {}, common) }
+    }
+    const { sr: movSr, dec } = openMov(mov)
+    const headerEnd = movSr.getReadCount()
+    dec.seekSeconds(3)
+    t.eq(movSr.getReadCount(), starts[2], "seekSeconds(+3) lands on the keyframe at frame 2")
+    t.eq(dec.frameCount, 2, "frameCount follows the seek")
+    dec.seekSeconds(-5)
+    t.eq(movSr.getReadCount(), starts[0], "seekSeconds(-5) goes back to frame 0")
+    const unindexed = openMov(mov.slice(0, 22).concat([0, 0, 0, 0], mov.slice(26, indexOffset)))
+    unindexed.dec.seekSeconds(3)
+    t.eq(unindexed.sr.getReadCount(), headerEnd, "files without an index don't seek")
+
+    // ---- mediadec_ipf plays an encoder_mov --stream file end to end ----
+    // Streamed packets (6,t / 7,t) carry the same frames as plain delta ones,
+    // so both files must put the same pictures on the display planes.
+    if (loadIpfCodec() && fs.existsSync(ENCODER_MOV)) {
+        const W = 64, H = 48, FRAMES = 8
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), "tsvm-mov-"))
+        const raw = Buffer.alloc(W * H * 3 * FRAMES)
+        for (let f = 0; f < FRAMES; f++) for (let y = 0; y < H; y++) for (let x = 0; x < W; x++) {
+            const p = 3 * ((f * H + y) * W + x), box = x >= 10 + 4 * f && x < 26 + 4 * f && y >= 16 && y < 32
+            raw[p] = box ? 255 : x * 4; raw[p + 1] = box ? 40 : y * 5; raw[p + 2] = box ? 40 : (x ^ y) * 4
+        }
+        fs.writeFileSync(path.join(dir, "in.rgb"), raw)
+        const encode = (name, extra) => {
+            execFileSync(ENCODER_MOV, ["--raw", "-i", path.join(dir, "in.rgb"), "-s", `${W}x${H}`, "-r", "10",
+                "-d", "-g", "4", "-j", "1", "-o", path.join(dir, name), ...extra], { stdio: "ignore" })
+            return fs.readFileSync(path.join(dir, name))
+        }
+        const streamed = encode("s.mov", ["--stream"]), plain = encode("p.mov", [])
+        fs.rmSync(dir, { recursive: true, force: true })
+
+        const { gzip } = vm.sandbox
+        const planes = () => {
+            let h = 0x811c9dc5
+            for (const base of [-1048577, -1310721]) for (let y = 0; y < H; y++) for (let x = 0; x < W; x++)
+                h = Math.imul(h ^ sys.peek(base - (y * 560 + x)), 0x01000193) >>> 0
+            return h
+        }
+        // Step on a fake clock that only moves while the decoder is idle, so no frame is skipped
+        const play = (bytes) => {
+            const nanoTime = sys.nanoTime, decompStream = gzip.decompStreamFromTo
+            let clock = 0, streamedPackets = 0
+            sys.nanoTime = () => clock
+            gzip.decompStreamFromTo = (...args) => { streamedPackets++; return decompStream(...args) }
+            const shown = []
+            try {
+                const { dec } = openMov(bytes)
+                for (let r = dec.step(); r.type !== "eof"; r = dec.step()) {
+                    if (r.type === "frame") shown.push(planes())
+                    else clock += 1000000
+                }
+                dec.close()
+            }
+            catch (e) { shown.push(`error: ${e.message}`) }
+            finally { sys.nanoTime = nanoTime; gzip.decompStreamFromTo = decompStream }
+            return { shown, streamedPackets }
+        }
+        const s = play(streamed), p = play(plain)
+        t.eq(s.streamedPackets, FRAMES, "every frame of the --stream file is a streamed packet")
+        t.eq(p.streamedPackets, 0, "the plain delta file has no streamed packets")
+        t.eq(s.shown.length, FRAMES, "every streamed frame is shown")
+        t.eq(s.shown.join(), p.shown.join(), "streamed frames match the plain delta frames")
+        t.ok(new Set(s.shown).size > 1, "the frames differ from each other")
+    }
+
     vm.dispose()
     return t.report()
 }
@@ -0,0 +1,933 @@
+/**
+ * iPF Benchmark - encode/decode throughput and quality of libipf
+ *
+ * Generates deterministic synthetic images (nothing is read from disk, so
+ * runs are comparable across machines and checkouts), then times encoding
+ * and decoding of every image for each combination of iPF type, alpha,
+ * progressive order and zstd:
+ * - Encode: ipf_encode_image, then ZSTD_compress at the level encoder_ipf
+ *   uses when the case is compressed
+ * - Decode: ZSTD_decompress when compressed, then ipf_decode_image to RGB
+ *   or RGBA, as decoder_ipf does
+ *
+ * Each operation repeats until --min-time has passed, in each of --rounds
+ * passes over all the cases so a busy moment can't spoil one case's
+ * numbers, and the fastest run counts. Throughput is in MB of source pixels (3 or 4 bytes each) per
+ * second. Compression ratio is source bytes over file bytes, header
+ * included, and PSNR compares the decoded pixels with the source.
+ *
+ * --json saves the results, and --compare reads a saved run back and
+ * reports the change of every case, failing when a case got slower than
+ * --threshold or its output changed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include <zstd.h>
+
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define IPF_ZSTD_LEVEL 7  // As encoder_ipf writes files
+
+#define MAX_SIZES 16
+#define MAX_NAME 96
+
+#define PSNR_IDENTICAL 100.0  // Reported when the decoded pixels match exactly
+
+typedef enum {
+    KIND_GRADIENT = 0,
+    KIND_NOISE,
+    KIND_UI,
+    KIND_TEXT,
+    KIND_PHOTO,
+    KIND_SPRITES,
+    KIND_COUNT
+} corpus_kind_t;
+
+static const char *KIND_NAMES[KIND_COUNT] = { "gradient", "noise", "ui", "text", "photo", "sprites" };
+
+// An odd size for the edge blocks, the VM's screen, and full HD
+static const int DEFAULT_SIZES[][2] = { { 125, 93 }, { 560, 448 }, { 1920, 1080 } };
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    int sizes[MAX_SIZES][2];
+    int size_count;
+    int kinds;               // Bit per corpus_kind_t
+    const char *filter;      // Only cases whose name contains this
+    double min_time;         // Seconds each operation is repeated for, per round
+    int rounds;              // Passes over all the cases
+    const char *json_file;
+    const char *compare_file;
+    double threshold;        // Percent slower that counts as a regression
+    int list_only;
+    int verbose;
+} bench_config_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    int image;               // Index into the generated images
+    int type;
+    int flags;
+    int width;
+    int height;
+    int alpha;
+    size_t raw_bytes;        // Source pixels, 3 or 4 bytes each
+    size_t blocks;
+    size_t file_bytes;       // Header and (compressed) block data
+    int encode_runs;         // Over all rounds
+    int decode_runs;
+    double encode_s;         // Fastest run
+    double decode_s;
+    double psnr;
+} bench_result_t;
+
+typedef struct {
+    uint8_t *rgba;           // Source, padded for ipf_encode_src_span
+    size_t stride;
+    int width;
+    int height;
+} corpus_image_t;
+
+/**
+ * Everything a case needs, allocated once per image so the timed loops
+ * don't measure malloc.
+ */
+typedef struct {
+    uint8_t *blocks;
+    uint8_t *packed;
+    size_t packed_capacity;
+    uint8_t *unpacked;
+    uint8_t *pixels;
+    size_t pixels_stride;
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+} bench_buffers_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Benchmark - encode/decode throughput and quality of libipf\n");
+    printf("\nUsage: %s [options]\n\n", program);
+    printf("Corpus:\n");
+    printf("  -s, --sizes LIST         Image sizes, e.g. 560x448,1920x1080\n");
+    printf("                           (default: 125x93,560x448,1920x1080)\n");
+    printf("  -k, --kinds LIST         Images: gradient, noise, ui, text, photo, sprites\n");
+    printf("                           (default: all)\n");
+    printf("  -F, --filter TEXT        Only run cases whose name contains TEXT\n");
+    printf("  -l, --list               List the cases and exit\n");
+    printf("\nTiming:\n");
+    printf("  -t, --min-time MS        Repeat each encode and decode for MS (default: 50)\n");
+    printf("  -r, --rounds N           Passes over all cases, keeping the fastest (default: 3)\n");
+    printf("\nResults:\n");
+    printf("  -o, --json FILE          Save the results as JSON (- for stdout)\n");
+    printf("  -c, --compare FILE       Compare with results saved by --json\n");
+    printf("  --threshold PCT          Slowdown that fails --compare (default: 5)\n");
+    printf("  -v, --verbose            Print the run counts as well\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nEvery image is run as iPF1 and iPF2, with and without alpha, progressive\n");
+    printf("and zstd. Speeds are the fastest run, in MB of RGB/RGBA source pixels.\n");
+    printf("--compare exits with 1 when a case is slower by more than the threshold\n");
+    printf("or its file size or PSNR changed.\n");
+    printf("\nExamples:\n");
+    printf("  %s -o before.json\n", program);
+    printf("  %s -c before.json              # After changing the codec\n", program);
+    printf("  %s -k photo -s 1920x1080 -F zstd -t 500\n", program);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int parse_sizes(const char *arg, bench_config_t *cfg) {
+    cfg->size_count = 0;
+    const char *p = arg;
+    while (*p) {
+        int w, h, n;
+        if (cfg->size_count == MAX_SIZES || sscanf(p, "%dx%d%n", &w, &h, &n) != 2 ||
+            w < 1 || h < 1 || w > 65535 || h > 65535) {
+            return -1;
+        }
+        cfg->sizes[cfg->size_count][0] = w;
+        cfg->sizes[cfg->size_count][1] = h;
+        cfg->size_count++;
+        p += n;
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+    return cfg->size_count > 0 ? 0 : -1;
+}
+
+static int parse_kinds(const char *arg) {
+    int kinds = 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        int found = -1;
+        for (int k = 0; k < KIND_COUNT; k++) {
+            if (strcmp(tok, KIND_NAMES[k]) == 0) found = k;
+        }
+        if (found < 0) return -1;
+        kinds |= 1 << found;
+    }
+    return kinds;
+}
+
+// =============================================================================
+// Corpus
+// =============================================================================
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static uint32_t hash3(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t h = x * 0x8DA6B343u ^ y * 0xD8163841u ^ z * 0xCB1AB31Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+static void put_pixel(corpus_image_t *img, int x, int y, int r, int g, int b, int a) {
+    uint8_t *p = img->rgba + (size_t)y * img->stride + (size_t)x * 4;
+    p[0] = (uint8_t)r;
+    p[1] = (uint8_t)g;
+    p[2] = (uint8_t)b;
+    p[3] = (uint8_t)a;
+}
+
+static void fill_rect(corpus_image_t *img, int x0, int y0, int w, int h, int r, int g, int b) {
+    for (int y = y0 < 0 ? 0 : y0; y < y0 + h && y < img->height; y++) {
+        for (int x = x0 < 0 ? 0 : x0; x < x0 + w && x < img->width; x++) {
+            put_pixel(img, x, y, r, g, b, 255);
+        }
+    }
+}
+
+static void gen_gradient(corpus_image_t *img) {
+    int w = img->width > 1 ? img->width - 1 : 1;
+    int h = img->height > 1 ? img->height - 1 : 1;
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            put_pixel(img, x, y, x * 255 / w, y * 255 / h, (x + y) * 255 / (w + h), 255);
+        }
+    }
+}
+
+static void gen_noise(corpus_image_t *img, uint32_t *rng) {
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            uint32_t v = xorshift32(rng);
+            put_pixel(img, x, y, v & 255, (v >> 8) & 255, (v >> 16) & 255, 255);
+        }
+    }
+}
+
+/**
+ * Desktop-like screen: flat windows with borders and title bars, and rows of
+ * buttons, on a flat background.
+ */
+static void gen_ui(corpus_image_t *img, uint32_t *rng) {
+    static const uint8_t PALETTE[6][3] = {
+        { 0xC0, 0xC0, 0xC0 }, { 0xFF, 0xFF, 0xFF }, { 0x00, 0x00, 0x80 },
+        { 0x80, 0x80, 0x80 }, { 0x00, 0x80, 0x80 }, { 0xFF, 0xFF, 0xE0 }
+    };
+
+    fill_rect(img, 0, 0, img->width, img->height, 0x00, 0x80, 0x80);
+
+    int windows = 3 + (img->width * img->height) / 60000;
+    for (int i = 0; i < windows; i++) {
+        int w = img->width / 4 + (int)(xorshift32(rng) % (uint32_t)(img->width / 2 + 1));
+        int h = img->height / 4 + (int)(xorshift32(rng) % (uint32_t)(img->height / 2 + 1));
+        int x = (int)(xorshift32(rng) % (uint32_t)img->width) - w / 4;
+        int y = (int)(xorshift32(rng) % (uint32_t)img->height) - h / 4;
+        const uint8_t *face = PALETTE[xorshift32(rng) % 2 ? 0 : 5];
+
+        fill_rect(img, x, y, w, h, 0x00, 0x00, 0x00);
+        fill_rect(img, x + 1, y + 1, w - 2, h - 2, face[0], face[1], face[2]);
+        fill_rect(img, x + 1, y + 1, w - 2, 14, PALETTE[2][0], PALETTE[2][1], PALETTE[2][2]);
+
+        for (int bx = x + 6; bx + 40 < x + w; bx += 48) {
+            const uint8_t *c = PALETTE[xorshift32(rng) % 6];
+            fill_rect(img, bx, y + h - 22, 40, 16, PALETTE[3][0], PALETTE[3][1], PALETTE[3][2]);
+            fill_rect(img, bx, y + h - 22, 39, 15, c[0], c[1], c[2]);
+        }
+    }
+}
+
+/**
+ * Lines of 5x7 glyphs in a 6x8 cell, in a few ink colours on paper.
+ */
+static void gen_text(corpus_image_t *img, uint32_t *rng) {
+    static const uint8_t INKS[4][3] = { { 0, 0, 0 }, { 0, 0, 0xA0 }, { 0xA0, 0, 0 }, { 0x30, 0x30, 0x30 } };
+    uint32_t glyphs[96];
+    for (int i = 0; i < 96; i++) glyphs[i] = xorshift32(rng) & xorshift32(rng) & 0x7FFFFFFFu;
+
+    fill_rect(img, 0, 0, img->width, img->height, 0xF8, 0xF8, 0xF0);
+    for (int row = 0; row * 9 + 8 <= img->height; row++) {
+        const uint8_t *ink = INKS[row % 4];
+        int line_end = img->width - (int)(xorshift32(rng) % (uint32_t)(img->width / 3 + 1));
+        for (int col = 0; col * 6 + 6 <= line_end; col++) {
+            if (xorshift32(rng) % 7 == 0) continue;  // Space
+            uint32_t glyph = glyphs[xorshift32(rng) % 96];
+            for (int gy = 0; gy < 7; gy++) {
+                for (int gx = 0; gx < 5; gx++) {
+                    if (glyph >> ((gy * 5 + gx) % 31) & 1) {
+                        put_pixel(img, col * 6 + gx, row * 9 + gy + 1, ink[0], ink[1], ink[2], 255);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Value noise at (x, y) on a lattice of the given cell size, smoothly
+ * interpolated, in [0, 1).
+ */
+static double value_noise(double x, double y, int cell, uint32_t seed) {
+    double fx = x / cell, fy = y / cell;
+    int ix = (int)floor(fx), iy = (int)floor(fy);
+    double tx = fx - ix, ty = fy - iy;
+    tx = tx * tx * (3 - 2 * tx);
+    ty = ty * ty * (3 - 2 * ty);
+
+    double v00 = (hash3((uint32_t)ix, (uint32_t)iy, seed) >> 8) / 16777216.0;
+    double v10 = (hash3((uint32_t)ix + 1, (uint32_t)iy, seed) >> 8) / 16777216.0;
+    double v01 = (hash3((uint32_t)ix, (uint32_t)iy + 1, seed) >> 8) / 16777216.0;
+    double v11 = (hash3((uint32_t)ix + 1, (uint32_t)iy + 1, seed) >> 8) / 16777216.0;
+    double top = v00 + (v10 - v00) * tx;
+    double bottom = v01 + (v11 - v01) * tx;
+    return top + (bottom - top) * ty;
+}
+
+static double fractal_noise(int x, int y, uint32_t seed) {
+    double sum = 0, amplitude = 0.5, total = 0;
+    for (int octave = 0, cell = 128; octave < 6 && cell >= 2; octave++, cell /= 2) {
+        sum += value_noise(x, y, cell, seed + (uint32_t)octave) * amplitude;
+        total += amplitude;
+        amplitude *= 0.55;
+    }
+    return sum / total;
+}
+
+/**
+ * Photo-like: fractal noise for light, and two slower fields tinting it.
+ */
+static void gen_photo(corpus_image_t *img, uint32_t seed) {
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            double light = fractal_noise(x, y, seed) * 1.6 - 0.3;
+            double warm = value_noise(x, y, 96, seed + 100) - 0.5;
+            double green = value_noise(x, y, 160, seed + 200) - 0.5;
+            int r = (int)lround((light + warm * 0.5) * 255);
+            int g = (int)lround((light + green * 0.4) * 255);
+            int b = (int)lround((light - warm * 0.5) * 255);
+            put_pixel(img, x, y, r < 0 ? 0 : r > 255 ? 255 : r, g < 0 ? 0 : g > 255 ? 255 : g,
+                      b < 0 ? 0 : b > 255 ? 255 : b, 255);
+        }
+    }
+}
+
+/**
+ * Shaded discs with soft edges on a transparent background, overlapping.
+ */
+static void gen_sprites(corpus_image_t *img, uint32_t *rng) {
+    memset(img->rgba, 0, img->stride * (size_t)img->height);
+
+    int count = 4 + (img->width * img->height) / 8000;
+    for (int i = 0; i < count; i++) {
+        int radius = 4 + (int)(xorshift32(rng) % (uint32_t)(img->width / 8 + 4));
+        int cx = (int)(xorshift32(rng) % (uint32_t)img->width);
+        int cy = (int)(xorshift32(rng) % (uint32_t)img->height);
+        uint32_t colour = xorshift32(rng);
+        int cr = colour & 255, cg = (colour >> 8) & 255, cb = (colour >> 16) & 255;
+
+        for (int y = cy - radius - 2; y <= cy + radius + 2; y++) {
+            if (y < 0 || y >= img->height) continue;
+            for (int x = cx - radius - 2; x <= cx + radius + 2; x++) {
+                if (x < 0 || x >= img->width) continue;
+                double d = sqrt((double)(x - cx) * (x - cx) + (double)(y - cy) * (y - cy));
+                double cover = radius + 1.5 - d;
+                if (cover <= 0) continue;
+                if (cover > 1) cover = 1;
+                double shade = 1.2 - 0.6 * d / radius;
+
+                uint8_t *p = img->rgba + (size_t)y * img->stride + (size_t)x * 4;
+                double src_a = cover * (0.6 + 0.4 * ((colour >> 24) & 1));
+                double dst_a = p[3] / 255.0;
+                double out_a = src_a + dst_a * (1 - src_a);
+                for (int c = 0; c < 3; c++) {
+                    double src = (c == 0 ? cr : c == 1 ? cg : cb) * shade;
+                    if (src > 255) src = 255;
+                    double mixed = (src * src_a + p[c] * dst_a * (1 - src_a)) / out_a;
+                    p[c] = (uint8_t)lround(mixed);
+                }
+                p[3] = (uint8_t)lround(out_a * 255);
+            }
+        }
+    }
+}
+
+static int corpus_generate(corpus_image_t *img, corpus_kind_t kind, int width, int height) {
+    ipf_header_t header = { (uint16_t)width, (uint16_t)height, IPF_FLAG_ALPHA, IPF_TYPE_1, 0 };
+    img->width = width;
+    img->height = height;
+    img->stride = (size_t)width * 4;
+
+    // Whole rows of blocks, plus what the encoder reads past the last one
+    size_t rows = (size_t)ipf_blocks_y(&header) * 4;
+    size_t size = rows * img->stride;
+    size_t span = ipf_encode_src_span(&header, img->stride, 4);
+    img->rgba = calloc(size > span ? size : span, 1);
+    if (!img->rgba) return -1;
+
+    uint32_t seed = hash3((uint32_t)kind + 1, (uint32_t)width, (uint32_t)height) | 1;
+    uint32_t rng = seed;
+    switch (kind) {
+        case KIND_GRADIENT: gen_gradient(img); break;
+        case KIND_NOISE: gen_noise(img, &rng); break;
+        case KIND_UI: gen_ui(img, &rng); break;
+        case KIND_TEXT: gen_text(img, &rng); break;
+        case KIND_PHOTO: gen_photo(img, seed); break;
+        case KIND_SPRITES: gen_sprites(img, &rng); break;
+        default: break;
+    }
+    return 0;
+}
+
+// =============================================================================
+// Benchmark
+// =============================================================================
+
+static int buffers_init(bench_buffers_t *buf, const corpus_image_t *img) {
+    ipf_header_t header = { (uint16_t)img->width, (uint16_t)img->height, IPF_FLAG_ALPHA, IPF_TYPE_2, 0 };
+    size_t blocks_size = ipf_blocks_size(&header);  // Largest type and alpha
+
+    memset(buf, 0, sizeof(*buf));
+    buf->pixels_stride = (size_t)ipf_blocks_x(&header) * 4 * 4;
+    buf->packed_capacity = IPF_HEADER_SIZE + ZSTD_compressBound(blocks_size);
+    buf->blocks = malloc(blocks_size);
+    buf->packed = malloc(buf->packed_capacity);
+    buf->unpacked = malloc(blocks_size);
+    buf->pixels = malloc(buf->pixels_stride * (size_t)ipf_blocks_y(&header) * 4);
+    buf->cctx = ZSTD_createCCtx();
+    buf->dctx = ZSTD_createDCtx();
+    return buf->blocks && buf->packed && buf->unpacked && buf->pixels && buf->cctx && buf->dctx ? 0 : -1;
+}
+
+static void buffers_free(bench_buffers_t *buf) {
+    free(buf->blocks);
+    free(buf->packed);
+    free(buf->unpacked);
+    free(buf->pixels);
+    ZSTD_freeCCtx(buf->cctx);
+    ZSTD_freeDCtx(buf->dctx);
+}
+
+static void case_name(char *name, const char *kind, int width, int height, int type, int flags) {
+    snprintf(name, MAX_NAME, "%s-%dx%d-ipf%d%s%s%s", kind, width, height, type + 1,
+             flags & IPF_FLAG_ALPHA ? "-alpha" : "",
+             flags & IPF_FLAG_PROGRESSIVE ? "-prog" : "",
+             flags & IPF_FLAG_ZSTD ? "-zstd" : "");
+}
+
+/**
+ * Encode into buf->packed as a whole file would be: header, then the block
+ * data, compressed when the header says so. Returns the file size, 0 on error.
+ */
+static size_t encode_once(const ipf_header_t *header, const corpus_image_t *img, bench_buffers_t *buf) {
+    size_t blocks_size = ipf_blocks_size(header);
+    if (ipf_encode_image(header, img->rgba, img->stride, 4, 0, buf->blocks) != IPF_OK) return 0;
+
+    ipf_write_header(header, buf->packed);
+    if (!(header->flags & IPF_FLAG_ZSTD)) {
+        memcpy(buf->packed + IPF_HEADER_SIZE, buf->blocks, blocks_size);
+        return IPF_HEADER_SIZE + blocks_size;
+    }
+
+    size_t packed = ZSTD_compressCCtx(buf->cctx, buf->packed + IPF_HEADER_SIZE,
+                                      buf->packed_capacity - IPF_HEADER_SIZE,
+                                      buf->blocks, blocks_size, IPF_ZSTD_LEVEL);
+    return ZSTD_isError(packed) ? 0 : IPF_HEADER_SIZE + packed;
+}
+
+static int decode_once(const uint8_t *file, size_t size, bench_buffers_t *buf) {
+    ipf_header_t header;
+    if (ipf_parse_header(file, size, &header) != IPF_OK) return -1;
+
+    size_t blocks_size = ipf_blocks_size(&header);
+    const uint8_t *blocks = file + IPF_HEADER_SIZE;
+    if (header.flags & IPF_FLAG_ZSTD) {
+        size_t got = ZSTD_decompressDCtx(buf->dctx, buf->unpacked, blocks_size,
+                                         blocks, size - IPF_HEADER_SIZE);
+        if (ZSTD_isError(got) || got != blocks_size) return -1;
+        blocks = buf->unpacked;
+    } else if (size - IPF_HEADER_SIZE < blocks_size) {
+        return -1;
+    }
+
+    ipf_decode_image(&header, blocks, IPF_PIXELS_RGB, buf->pixels, buf->pixels_stride);
+    return 0;
+}
+
+static double psnr(const corpus_image_t *img, const bench_buffers_t *buf, int alpha) {
+    int channels = alpha ? 4 : 3;
+    double sum = 0;
+    for (int y = 0; y < img->height; y++) {
+        const uint8_t *src = img->rgba + (size_t)y * img->stride;
+        const uint8_t *dec = buf->pixels + (size_t)y * buf->pixels_stride;
+        for (int x = 0; x < img->width; x++) {
+            for (int c = 0; c < channels; c++) {
+                int d = src[x * 4 + c] - dec[x * channels + c];
+                sum += d * d;
+            }
+        }
+    }
+    if (sum == 0) return PSNR_IDENTICAL;
+    double mse = sum / ((double)img->width * img->height * channels);
+    return 10 * log10(255.0 * 255.0 / mse);
+}
+
+static void case_init(bench_result_t *res, const char *kind, int image, int width, int height,
+                      int type, int flags) {
+    ipf_header_t header = { (uint16_t)width, (uint16_t)height, (uint8_t)flags, (uint8_t)type, 0 };
+
+    memset(res, 0, sizeof(*res));
+    case_name(res->name, kind, width, height, type, flags);
+    res->image = image;
+    res->type = type;
+    res->flags = flags;
+    res->width = width;
+    res->height = height;
+    res->alpha = flags & IPF_FLAG_ALPHA ? 1 : 0;
+    res->raw_bytes = (size_t)width * height * (res->alpha ? 4 : 3);
+    res->blocks = (size_t)ipf_blocks_x(&header) * ipf_blocks_y(&header);
+    res->encode_s = res->decode_s = INFINITY;
+}
+
+/**
+ * One round of a case: time encoding and decoding, keeping the fastest runs
+ * of all rounds so far.
+ */
+static int run_case(const bench_config_t *cfg, const corpus_image_t *img, bench_buffers_t *buf,
+                    bench_result_t *res) {
+    ipf_header_t header = { (uint16_t)img->width, (uint16_t)img->height, (uint8_t)res->flags,
+                            (uint8_t)res->type, 0 };
+    header.uncompressed_size = (uint32_t)ipf_blocks_size(&header);
+
+    double deadline = now_seconds() + cfg->min_time;
+    int runs = 0;
+    do {
+        double start = now_seconds();
+        res->file_bytes = encode_once(&header, img, buf);
+        double took = now_seconds() - start;
+        if (!res->file_bytes) return -1;
+        if (took < res->encode_s) res->encode_s = took;
+        res->encode_runs++;
+    } while (++runs < 3 || now_seconds() < deadline);
+
+    deadline = now_seconds() + cfg->min_time;
+    runs = 0;
+    do {
+        double start = now_seconds();
+        int err = decode_once(buf->packed, res->file_bytes, buf);
+        double took = now_seconds() - start;
+        if (err) return -1;
+        if (took < res->decode_s) res->decode_s = took;
+        res->decode_runs++;
+    } while (++runs < 3 || now_seconds() < deadline);
+
+    res->psnr = psnr(img, buf, res->alpha);
+    return 0;
+}
+
+// =============================================================================
+// Results
+// =============================================================================
+
+static double mb_per_s(size_t bytes, double seconds) {
+    return seconds > 0 ? bytes / 1e6 / seconds : 0;
+}
+
+static double ratio(const bench_result_t *r) {
+    return (double)r->raw_bytes / r->file_bytes;
+}
+
+static int write_json(const char *path, const bench_config_t *cfg, const bench_result_t *results, size_t count) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"tool\":\"bench_ipf\",\"version\":1,\"min_time_ms\":%.0f,\"rounds\":%d,\"zstd_level\":%d,"
+            "\"compiler\":\"%s\",\n", cfg->min_time * 1000, cfg->rounds, IPF_ZSTD_LEVEL, __VERSION__);
+    fprintf(fp, "\"cases\":[\n");
+    for (size_t i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(fp, "{\"name\":\"%s\",\"width\":%d,\"height\":%d,\"raw_bytes\":%zu,\"file_bytes\":%zu,"
+                "\"blocks\":%zu,\"encode_ms\":%.4f,\"decode_ms\":%.4f,\"encode_mb_s\":%.2f,\"decode_mb_s\":%.2f,"
+                "\"encode_blocks_s\":%.0f,\"decode_blocks_s\":%.0f,\"ratio\":%.4f,\"psnr\":%.4f}%s\n",
+                r->name, r->width, r->height, r->raw_bytes, r->file_bytes, r->blocks,
+                r->encode_s * 1000, r->decode_s * 1000,
+                mb_per_s(r->raw_bytes, r->encode_s), mb_per_s(r->raw_bytes, r->decode_s),
+                r->blocks / r->encode_s, r->blocks / r->decode_s, ratio(r), r->psnr,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+
+    if (fp != stdout && fclose(fp) != 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * A case saved by --json. The files are written one case per line, which is
+ * all the reading back relies on.
+ */
+typedef struct {
+    char name[MAX_NAME];
+    double encode_ms;
+    double decode_ms;
+    double file_bytes;
+    double psnr;
+} baseline_case_t;
+
+static double json_number(const char *line, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p ? strtod(p + strlen(pattern), NULL) : NAN;
+}
+
+static baseline_case_t *load_baseline(const char *path, size_t *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open baseline %s\n", path);
+        return NULL;
+    }
+
+    baseline_case_t *cases = NULL;
+    size_t capacity = 0;
+    char line[1024];
+    *count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        const char *name = strstr(line, "{\"name\":\"");
+        if (!name) continue;
+        name += 9;
+        const char *end = strchr(name, '"');
+        if (!end || end - name >= MAX_NAME) continue;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            baseline_case_t *grown = realloc(cases, capacity * sizeof(*cases));
+            if (!grown) {
+                free(cases);
+                fclose(fp);
+                return NULL;
+            }
+            cases = grown;
+        }
+        baseline_case_t *c = &cases[(*count)++];
+        memcpy(c->name, name, (size_t)(end - name));
+        c->name[end - name] = '\0';
+        c->encode_ms = json_number(line, "encode_ms");
+        c->decode_ms = json_number(line, "decode_ms");
+        c->file_bytes = json_number(line, "file_bytes");
+        c->psnr = json_number(line, "psnr");
+    }
+    fclose(fp);
+
+    if (*count == 0) {
+        fprintf(stderr, "Error: No cases in baseline %s\n", path);
+        free(cases);
+        return NULL;
+    }
+    return cases;
+}
+
+static const baseline_case_t *find_baseline(const baseline_case_t *cases, size_t count, const char *name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(cases[i].name, name) == 0) return &cases[i];
+    }
+    return NULL;
+}
+
+/**
+ * Percent change in speed: positive is faster than the baseline.
+ */
+static double speedup(double baseline_ms, double seconds) {
+    return (baseline_ms / (seconds * 1000) - 1) * 100;
+}
+
+static int compare_results(const bench_config_t *cfg, const bench_result_t *results, size_t count, FILE *out) {
+    size_t base_count;
+    baseline_case_t *base = load_baseline(cfg->compare_file, &base_count);
+    if (!base) return -1;
+
+    fprintf(out, "\nCompared with %s (threshold %.1f%%):\n", cfg->compare_file, cfg->threshold);
+    fprintf(out, "%-40s %9s %9s  %s\n", "Case", "Encode", "Decode", "");
+
+    size_t matched = 0, regressions = 0, changed = 0;
+    double log_encode = 0, log_decode = 0;
+    for (size_t i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        const baseline_case_t *b = find_baseline(base, base_count, r->name);
+        if (!b) {
+            fprintf(out, "%-40s %9s %9s  new case\n", r->name, "-", "-");
+            continue;
+        }
+        matched++;
+
+        double enc = speedup(b->encode_ms, r->encode_s);
+        double dec = speedup(b->decode_ms, r->decode_s);
+        log_encode += log(b->encode_ms / (r->encode_s * 1000));
+        log_decode += log(b->decode_ms / (r->decode_s * 1000));
+
+        int slower = enc < -cfg->threshold || dec < -cfg->threshold;
+        int output = (size_t)b->file_bytes != r->file_bytes || fabs(b->psnr - r->psnr) > 0.00005;
+        regressions += slower;
+        changed += output;
+
+        char note[128] = "";
+        if (output) {
+            snprintf(note, sizeof(note), "OUTPUT CHANGED: %.0f -> %zu bytes, PSNR %.2f -> %.2f",
+                     b->file_bytes, r->file_bytes, b->psnr, r->psnr);
+        } else if (slower) {
+            snprintf(note, sizeof(note), "SLOWER");
+        }
+        if (slower || output || cfg->verbose) {
+            fprintf(out, "%-40s %+8.1f%% %+8.1f%%  %s\n", r->name, enc, dec, note);
+        }
+    }
+    free(base);
+
+    if (matched == 0) {
+        fprintf(out, "No cases in common with the baseline\n");
+        return -1;
+    }
+    fprintf(out, "Geometric mean over %zu cases: encode %+.1f%%, decode %+.1f%%\n", matched,
+           (exp(log_encode / matched) - 1) * 100, (exp(log_decode / matched) - 1) * 100);
+    fprintf(out, "%zu slower than the threshold, %zu with changed output\n", regressions, changed);
+    return regressions || changed ? 1 : 0;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    bench_config_t cfg = {
+        .size_count = 0,
+        .kinds = (1 << KIND_COUNT) - 1,
+        .filter = NULL,
+        .min_time = 0.05,
+        .rounds = 3,
+        .json_file = NULL,
+        .compare_file = NULL,
+        .threshold = 5.0,
+        .list_only = 0,
+        .verbose = 0
+    };
+    for (size_t i = 0; i < sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]); i++) {
+        cfg.sizes[cfg.size_count][0] = DEFAULT_SIZES[i][0];
+        cfg.sizes[cfg.size_count][1] = DEFAULT_SIZES[i][1];
+        cfg.size_count++;
+    }
+
+    static struct option long_options[] = {
+        {"sizes",     required_argument, 0, 's'},
+        {"kinds",     required_argument, 0, 'k'},
+        {"filter",    required_argument, 0, 'F'},
+        {"list",      no_argument,       0, 'l'},
+        {"min-time",  required_argument, 0, 't'},
+        {"rounds",    required_argument, 0, 'r'},
+        {"json",      required_argument, 0, 'o'},
+        {"compare",   required_argument, 0, 'c'},
+        {"threshold", required_argument, 0, 'T'},
+        {"verbose",   no_argument,       0, 'v'},
+        {"help",      no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:k:F:lt:r:o:c:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                if (parse_sizes(optarg, &cfg) < 0) {
+                    fprintf(stderr, "Error: Invalid size list: %s (use WxH,WxH)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                cfg.kinds = parse_kinds(optarg);
+                if (cfg.kinds < 0) {
+                    fprintf(stderr, "Error: Unknown image kind in %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'F':
+                cfg.filter = optarg;
+                break;
+            case 'l':
+                cfg.list_only = 1;
+                break;
+            case 't':
+                cfg.min_time = atof(optarg) / 1000;
+                if (cfg.min_time < 0) {
+                    fprintf(stderr, "Error: Minimum time must not be negative\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                cfg.rounds = atoi(optarg);
+                if (cfg.rounds < 1) {
+                    fprintf(stderr, "Error: Rounds must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'o':
+                cfg.json_file = optarg;
+                break;
+            case 'c':
+                cfg.compare_file = optarg;
+                break;
+            case 'T':
+                cfg.threshold = atof(optarg);
+                if (cfg.threshold < 0) {
+                    fprintf(stderr, "Error: Threshold must not be negative\n");
+                    return 1;
+                }
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    size_t capacity = (size_t)cfg.size_count * KIND_COUNT * 16;
+    int image_count = cfg.size_count * KIND_COUNT;
+    bench_result_t *results = calloc(capacity, sizeof(*results));
+    corpus_image_t *images = calloc((size_t)image_count, sizeof(*images));
+    bench_buffers_t *buffers = calloc((size_t)image_count, sizeof(*buffers));
+    if (!results || !images || !buffers) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+
+    size_t count = 0;
+    for (int k = 0; k < KIND_COUNT; k++) {
+        if (!(cfg.kinds & (1 << k))) continue;
+        for (int s = 0; s < cfg.size_count; s++) {
+            for (int type = IPF_TYPE_1; type <= IPF_TYPE_2; type++) {
+                for (int combo = 0; combo < 8; combo++) {
+                    int flags = (combo & 1 ? IPF_FLAG_ALPHA : 0) | (combo & 2 ? IPF_FLAG_PROGRESSIVE : 0) |
+                                (combo & 4 ? IPF_FLAG_ZSTD : 0);
+                    bench_result_t *r = &results[count];
+                    case_init(r, KIND_NAMES[k], k * cfg.size_count + s, cfg.sizes[s][0], cfg.sizes[s][1],
+                              type, flags);
+                    if (cfg.filter && !strstr(r->name, cfg.filter)) continue;
+                    if (cfg.list_only) printf("%s\n", r->name);
+                    count++;
+                }
+            }
+        }
+    }
+    if (count == 0) fprintf(stderr, "Error: No cases match\n");
+    if (cfg.list_only || count == 0) {
+        free(results);
+        free(images);
+        free(buffers);
+        return count == 0 ? 1 : 0;
+    }
+
+    // Generate only the images some case uses
+    int failed = 0;
+    for (size_t i = 0; i < count && !failed; i++) {
+        int image = results[i].image;
+        if (images[image].rgba) continue;
+        if (corpus_generate(&images[image], (corpus_kind_t)(image / cfg.size_count),
+                            results[i].width, results[i].height) < 0 ||
+            buffers_init(&buffers[image], &images[image]) < 0) {
+            fprintf(stderr, "Error: Out of memory for %dx%d\n", results[i].width, results[i].height);
+            failed = 1;
+        }
+    }
+
+    // Keep the table off stdout when the JSON goes there
+    FILE *out = cfg.json_file && strcmp(cfg.json_file, "-") == 0 ? stderr : stdout;
+    for (int round = 0; round < cfg.rounds && !failed; round++) {
+        if (cfg.rounds > 1) fprintf(stderr, "\rRound %d of %d...", round + 1, cfg.rounds);
+        for (size_t i = 0; i < count && !failed; i++) {
+            bench_result_t *r = &results[i];
+            if (run_case(&cfg, &images[r->image], &buffers[r->image], r) < 0) {
+                fprintf(stderr, "\nError: %s failed to round-trip\n", r->name);
+                failed = 1;
+            }
+        }
+    }
+    if (cfg.rounds > 1 && !failed) fprintf(stderr, "\r%*s\r", 24, "");
+
+    if (!failed) {
+        fprintf(out, "%-40s %9s %9s %9s %9s %7s %7s\n", "Case", "Enc MB/s", "Dec MB/s",
+                "Enc Mblk", "Dec Mblk", "Ratio", "PSNR");
+        for (size_t i = 0; i < count; i++) {
+            const bench_result_t *r = &results[i];
+            fprintf(out, "%-40s %9.1f %9.1f %9.2f %9.2f %7.2f %7.2f", r->name,
+                    mb_per_s(r->raw_bytes, r->encode_s), mb_per_s(r->raw_bytes, r->decode_s),
+                    r->blocks / r->encode_s / 1e6, r->blocks / r->decode_s / 1e6, ratio(r), r->psnr);
+            if (cfg.verbose) fprintf(out, "  (%d/%d runs)", r->encode_runs, r->decode_runs);
+            fprintf(out, "\n");
+        }
+    }
+
+    for (int i = 0; i < image_count; i++) {
+        if (!images[i].rgba) continue;
+        buffers_free(&buffers[i]);
+        free(images[i].rgba);
+    }
+    free(images);
+    free(buffers);
+
+    int status = failed ? 1 : 0;
+    if (!failed) {
+        if (cfg.json_file && write_json(cfg.json_file, &cfg, results, count) < 0) status = 1;
+        if (!status && cfg.compare_file) {
+            int cmp = compare_results(&cfg, results, count, out);
+            status = cmp != 0 ? 1 : 0;
+        }
+    }
+
+    free(results);
+    return status;
+}
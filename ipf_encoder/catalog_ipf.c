@@ -0,0 +1,912 @@
+/**
+ * iPF Catalog - directory index of iPF files with embedded thumbnails
+ *
+ * Scans a tree for iPF files and writes one small catalog holding each
+ * file's path, size, header fields, content hash and a thumbnail, so a file
+ * manager or asset browser lists a directory with a single read instead of
+ * opening and decoding every image. The layout is in terranmon.txt (iPF
+ * Catalog).
+ *
+ * Thumbnails are taken in the block domain: each thumbnail pixel is the
+ * average of the one 4x4 block under it, so only that many blocks are
+ * decoded. Runs are incremental: files whose mtime and size match the old
+ * catalog are not opened at all, and files that were rewritten unchanged
+ * keep their entries after a hash comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <zlib.h>
+
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MAX_PATH 4096
+
+#define CATALOG_MAGIC "\x1F\x54\x53\x56\x4D\x69\x50\x43"  // "\x1FTSVMiPC"
+#define CATALOG_VERSION 1
+#define CATALOG_HEADER_SIZE 16
+#define CATALOG_DEFAULT_NAME "ipf.cat"
+
+#define DEFAULT_THUMB_SIZE 16
+#define MAX_THUMB_SIZE 64
+
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+static const uint8_t GZIP_MAGIC[3] = { 0x1F, 0x8B, 0x08 };
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    char *root;
+    char *catalog_file;
+    char *list_file;     // --list: print this catalog instead of scanning
+    int json;
+    int thumb_size;      // Longest thumbnail side, 0 for none
+    int rebuild;         // Ignore the old catalog
+    int verbose;
+} catalog_config_t;
+
+typedef struct {
+    char *path;          // Relative to the root, '/'-separated
+    uint64_t mtime_ns;
+    uint32_t file_size;
+    uint64_t hash;       // FNV-1a 64 of the whole file
+    ipf_header_t header;
+    uint8_t thumb_w;
+    uint8_t thumb_h;
+    uint8_t *thumb;      // thumb_w * thumb_h pixels of (R<<4|G, B<<4|A)
+} catalog_entry_t;
+
+typedef struct {
+    catalog_entry_t *items;
+    size_t count;
+    size_t capacity;
+    int thumb_size;
+} catalog_t;
+
+typedef struct {
+    size_t added;
+    size_t updated;
+    size_t touched;      // New mtime, same content
+    size_t unchanged;
+    size_t removed;
+    size_t skipped;      // Not readable as iPF
+    uint64_t bytes_read;
+} catalog_stats_t;
+
+/**
+ * Buffers reused from file to file.
+ */
+typedef struct {
+    ZSTD_DCtx *dctx;
+    z_stream zs;
+    int zs_ready;
+    uint8_t *file;
+    size_t file_cap;
+    uint8_t *blocks;
+    size_t blocks_cap;
+    uint8_t *pixels;
+    size_t pixels_cap;
+    uint32_t *order;
+    size_t order_cap;
+} catalog_work_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Catalog - directory index of iPF files with thumbnails\n");
+    printf("\nUsage: %s [options] DIR\n", program);
+    printf("       %s -l CATALOG [--json]\n\n", program);
+    printf("Options:\n");
+    printf("  -o, --output FILE        Catalog to write (default: DIR/%s)\n", CATALOG_DEFAULT_NAME);
+    printf("  -t, --thumb N            Longest thumbnail side in pixels (default: %d, max: %d,\n",
+           DEFAULT_THUMB_SIZE, MAX_THUMB_SIZE);
+    printf("                           0 = no thumbnails)\n");
+    printf("  -f, --rebuild            Ignore the existing catalog and read every file\n");
+    printf("  -l, --list CATALOG       Print a catalog's entries instead of scanning\n");
+    printf("  --json                   With --list, one JSON object per entry\n");
+    printf("  -v, --verbose            Report every file added, updated or removed\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nFiles whose mtime and size are unchanged since the last run are not read.\n");
+    printf("\nExamples:\n");
+    printf("  %s assets/disk0                  # Write assets/disk0/%s\n", program, CATALOG_DEFAULT_NAME);
+    printf("  %s -l assets/disk0/%s --json\n", program, CATALOG_DEFAULT_NAME);
+}
+
+static int ensure_capacity(uint8_t **buf, size_t *cap, size_t need) {
+    if (*cap >= need) return 0;
+    uint8_t *grown = realloc(*buf, need);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = need;
+    return 0;
+}
+
+static uint64_t fnv1a64(const uint8_t *data, size_t len) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * True for .ipf, .ipf1, .ipf2 and similar extensions.
+ */
+static int has_ipf_extension(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot || strncasecmp(dot + 1, "ipf", 3) != 0) return 0;
+    for (const char *c = dot + 4; *c; c++) {
+        if (*c < '0' || *c > '9') return 0;
+    }
+    return 1;
+}
+
+static void entry_free(catalog_entry_t *e) {
+    free(e->path);
+    free(e->thumb);
+}
+
+static void catalog_free(catalog_t *cat) {
+    for (size_t i = 0; i < cat->count; i++) entry_free(&cat->items[i]);
+    free(cat->items);
+    memset(cat, 0, sizeof(*cat));
+}
+
+static catalog_entry_t *catalog_push(catalog_t *cat) {
+    if (cat->count == cat->capacity) {
+        size_t cap = cat->capacity ? cat->capacity * 2 : 64;
+        catalog_entry_t *items = realloc(cat->items, cap * sizeof(*items));
+        if (!items) return NULL;
+        cat->items = items;
+        cat->capacity = cap;
+    }
+    catalog_entry_t *e = &cat->items[cat->count++];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const catalog_entry_t *)a)->path, ((const catalog_entry_t *)b)->path);
+}
+
+/**
+ * Entry for path in a catalog sorted by path, or NULL.
+ */
+static catalog_entry_t *catalog_find(const catalog_t *cat, const char *path) {
+    catalog_entry_t key;
+    key.path = (char *)path;
+    return cat->count ? bsearch(&key, cat->items, cat->count, sizeof(catalog_entry_t), compare_entries) : NULL;
+}
+
+// =============================================================================
+// Catalog File
+// =============================================================================
+
+static void put_u16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+// Fixed part of an entry after its path: width, height, flags, type, file
+// size, mtime, hash, thumbnail width and height
+#define ENTRY_FIXED_SIZE (2 + 2 + 1 + 1 + 4 + 8 + 8 + 1 + 1)
+
+static size_t entry_body_size(const catalog_entry_t *e) {
+    return 2 + strlen(e->path) + ENTRY_FIXED_SIZE + (size_t)e->thumb_w * e->thumb_h * 2;
+}
+
+/**
+ * Read a whole catalog. A missing file gives an empty catalog; anything
+ * unreadable is reported and also treated as empty, so it gets rebuilt.
+ */
+static int catalog_load(const char *path, catalog_t *cat, int quiet_if_missing) {
+    memset(cat, 0, sizeof(*cat));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        if (errno == ENOENT && quiet_if_missing) return 0;
+        fprintf(stderr, "Error: Cannot open catalog %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(fp), &st) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    uint8_t *data = malloc(size ? size : 1);
+    if (!data || fread(data, 1, size, fp) != size) {
+        fprintf(stderr, "Error: Cannot read catalog %s\n", path);
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (size < CATALOG_HEADER_SIZE || memcmp(data, CATALOG_MAGIC, 8) != 0 || data[8] != CATALOG_VERSION) {
+        fprintf(stderr, "Error: %s is not a version %d iPF catalog\n", path, CATALOG_VERSION);
+        free(data);
+        return -1;
+    }
+    cat->thumb_size = data[9];
+    uint32_t count = get_u32(data + 12);
+
+    const uint8_t *p = data + CATALOG_HEADER_SIZE;
+    const uint8_t *end = data + size;
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 2) goto corrupt;
+        size_t body = get_u16(p);
+        p += 2;
+        if ((size_t)(end - p) < body || body < 2) goto corrupt;
+        const uint8_t *next = p + body;
+
+        size_t path_len = get_u16(p);
+        if (body < 2 + path_len + ENTRY_FIXED_SIZE) goto corrupt;
+        catalog_entry_t *e = catalog_push(cat);
+        if (!e) goto corrupt;
+        e->path = malloc(path_len + 1);
+        if (!e->path) goto corrupt;
+        memcpy(e->path, p + 2, path_len);
+        e->path[path_len] = '\0';
+
+        const uint8_t *f = p + 2 + path_len;
+        e->header.width = (uint16_t)get_u16(f);
+        e->header.height = (uint16_t)get_u16(f + 2);
+        e->header.flags = f[4];
+        e->header.type = f[5];
+        e->file_size = get_u32(f + 6);
+        e->mtime_ns = get_u64(f + 10);
+        e->hash = get_u64(f + 18);
+        e->thumb_w = f[26];
+        e->thumb_h = f[27];
+
+        size_t thumb_bytes = (size_t)e->thumb_w * e->thumb_h * 2;
+        if (body != 2 + path_len + ENTRY_FIXED_SIZE + thumb_bytes) goto corrupt;
+        if (thumb_bytes) {
+            e->thumb = malloc(thumb_bytes);
+            if (!e->thumb) goto corrupt;
+            memcpy(e->thumb, f + ENTRY_FIXED_SIZE, thumb_bytes);
+        }
+        p = next;
+    }
+
+    free(data);
+    if (cat->count > 1) qsort(cat->items, cat->count, sizeof(catalog_entry_t), compare_entries);
+    return 0;
+
+corrupt:
+    fprintf(stderr, "Error: Catalog %s is corrupt\n", path);
+    free(data);
+    catalog_free(cat);
+    return -1;
+}
+
+/**
+ * Write the catalog next to its final name, then move it into place, so a
+ * reader never sees half of one.
+ */
+static int catalog_save(const char *path, const catalog_t *cat) {
+    size_t total = CATALOG_HEADER_SIZE;
+    for (size_t i = 0; i < cat->count; i++) total += 2 + entry_body_size(&cat->items[i]);
+
+    uint8_t *data = malloc(total);
+    if (!data) {
+        fprintf(stderr, "Error: Out of memory writing the catalog\n");
+        return -1;
+    }
+
+    memcpy(data, CATALOG_MAGIC, 8);
+    data[8] = CATALOG_VERSION;
+    data[9] = (uint8_t)cat->thumb_size;
+    put_u16(data + 10, 0);
+    put_u32(data + 12, (uint32_t)cat->count);
+
+    uint8_t *p = data + CATALOG_HEADER_SIZE;
+    for (size_t i = 0; i < cat->count; i++) {
+        const catalog_entry_t *e = &cat->items[i];
+        size_t path_len = strlen(e->path);
+        size_t thumb_bytes = (size_t)e->thumb_w * e->thumb_h * 2;
+
+        put_u16(p, (uint32_t)entry_body_size(e));
+        put_u16(p + 2, (uint32_t)path_len);
+        memcpy(p + 4, e->path, path_len);
+        uint8_t *f = p + 4 + path_len;
+        put_u16(f, e->header.width);
+        put_u16(f + 2, e->header.height);
+        f[4] = e->header.flags;
+        f[5] = e->header.type;
+        put_u32(f + 6, e->file_size);
+        put_u64(f + 10, e->mtime_ns);
+        put_u64(f + 18, e->hash);
+        f[26] = e->thumb_w;
+        f[27] = e->thumb_h;
+        if (thumb_bytes) memcpy(f + ENTRY_FIXED_SIZE, e->thumb, thumb_bytes);
+        p = f + ENTRY_FIXED_SIZE + thumb_bytes;
+    }
+
+    char tmp[MAX_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write %s: %s\n", tmp, strerror(errno));
+        free(data);
+        return -1;
+    }
+    size_t written = fwrite(data, 1, total, fp);
+    int closed = fclose(fp);
+    free(data);
+    if (written != total || closed != 0 || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// Thumbnails
+// =============================================================================
+
+/**
+ * The block data of a file: in place when stored raw, otherwise inflated
+ * into w->blocks. Unflagged legacy payloads may be gzip, as in decoder_ipf.
+ */
+static const uint8_t *unpack_blocks(catalog_work_t *w, const char *path, const ipf_header_t *header,
+                                    const uint8_t *payload, size_t payload_size) {
+    size_t raw_size = ipf_blocks_size(header);
+    int is_zstd = payload_size >= 4 && memcmp(payload, ZSTD_MAGIC, 4) == 0;
+    int is_gzip = payload_size >= 3 && memcmp(payload, GZIP_MAGIC, 3) == 0;
+    int flagged = (header->flags & IPF_FLAG_ZSTD) != 0;
+    int zstd = flagged ? !is_gzip : (payload_size < raw_size && is_zstd && !is_gzip);
+    int gzip = flagged ? is_gzip : (payload_size < raw_size && is_gzip);
+
+    if (!zstd && !gzip) {
+        if (payload_size < raw_size) {
+            fprintf(stderr, "Warning: %s: Block data is truncated\n", path);
+            return NULL;
+        }
+        return payload;
+    }
+    if (ensure_capacity(&w->blocks, &w->blocks_cap, raw_size ? raw_size : 1) < 0) return NULL;
+
+    if (zstd) {
+        size_t got = ZSTD_decompressDCtx(w->dctx, w->blocks, raw_size, payload, payload_size);
+        if (ZSTD_isError(got) || got != raw_size) {
+            fprintf(stderr, "Warning: %s: Zstd decompression failed\n", path);
+            return NULL;
+        }
+        return w->blocks;
+    }
+
+    if (!w->zs_ready) {
+        if (inflateInit2(&w->zs, 16 + MAX_WBITS) != Z_OK) return NULL;
+        w->zs_ready = 1;
+    } else {
+        inflateReset(&w->zs);
+    }
+    w->zs.next_in = (Bytef *)payload;
+    w->zs.avail_in = (uInt)payload_size;
+    w->zs.next_out = w->blocks;
+    w->zs.avail_out = (uInt)raw_size;
+    int ret = inflate(&w->zs, Z_FINISH);
+    if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) || w->zs.avail_out != 0) {
+        fprintf(stderr, "Warning: %s: Gzip decompression failed\n", path);
+        return NULL;
+    }
+    return w->blocks;
+}
+
+/**
+ * Thumbnail size fitting limit on the longest side, keeping the aspect
+ * ratio, and never finer than the units it samples (blocks or pixels).
+ */
+static void thumb_dimensions(int units_x, int units_y, int limit, int *tw, int *th) {
+    if (units_x >= units_y) {
+        *tw = units_x < limit ? units_x : limit;
+        *th = (int)(((long)units_y * *tw + units_x / 2) / units_x);
+    } else {
+        *th = units_y < limit ? units_y : limit;
+        *tw = (int)(((long)units_x * *th + units_y / 2) / units_y);
+    }
+    if (*tw < 1) *tw = 1;
+    if (*th < 1) *th = 1;
+}
+
+/**
+ * Average of a decoded block's 16 pixels, nibble by nibble.
+ */
+static void average_block(const uint8_t *pixels, size_t stride, uint8_t *out) {
+    int r = 0, g = 0, b = 0, a = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const uint8_t *p = pixels + y * stride + x * 2;
+            r += p[0] >> 4;
+            g += p[0] & 15;
+            b += p[1] >> 4;
+            a += p[1] & 15;
+        }
+    }
+    out[0] = (uint8_t)((((r + 8) / 16) << 4) | ((g + 8) / 16));
+    out[1] = (uint8_t)((((b + 8) / 16) << 4) | ((a + 8) / 16));
+}
+
+static int make_thumbnail(catalog_work_t *w, catalog_entry_t *e, const uint8_t *blocks, int limit) {
+    const ipf_header_t *h = &e->header;
+    int indexed = h->type == IPF_TYPE_INDEXED;
+    int units_x = indexed ? h->width : ipf_blocks_x(h);
+    int units_y = indexed ? h->height : ipf_blocks_y(h);
+    int tw, th;
+    thumb_dimensions(units_x, units_y, limit, &tw, &th);
+
+    e->thumb = malloc((size_t)tw * th * 2);
+    if (!e->thumb) return -1;
+    e->thumb_w = (uint8_t)tw;
+    e->thumb_h = (uint8_t)th;
+
+    if (indexed) {
+        // Small enough to look up whole; sample the pixel under each thumbnail pixel
+        size_t stride = (size_t)ipf_blocks_x(h) * 4 * 2;
+        if (ensure_capacity(&w->pixels, &w->pixels_cap, stride * h->height) < 0) return -1;
+        ipf_decode_image(h, blocks, IPF_PIXELS_TSVM, w->pixels, stride);
+        for (int ty = 0; ty < th; ty++) {
+            int y = (int)(((2L * ty + 1) * h->height) / (2 * th));
+            for (int tx = 0; tx < tw; tx++) {
+                int x = (int)(((2L * tx + 1) * h->width) / (2 * tw));
+                memcpy(e->thumb + ((size_t)ty * tw + tx) * 2, w->pixels + y * stride + (size_t)x * 2, 2);
+            }
+        }
+        return 0;
+    }
+
+    // Progressive files store blocks by pass, so find each block's slot
+    int progressive = (h->flags & IPF_FLAG_PROGRESSIVE) != 0;
+    size_t block_count = (size_t)units_x * units_y;
+    if (progressive) {
+        if (w->order_cap < block_count * 2) {
+            uint32_t *grown = realloc(w->order, block_count * 2 * sizeof(*grown));
+            if (!grown) return -1;
+            w->order = grown;
+            w->order_cap = block_count * 2;
+        }
+        uint32_t *slot = w->order + block_count;
+        ipf_adam7_order(units_x, units_y, w->order);
+        for (size_t i = 0; i < block_count; i++) slot[w->order[i]] = (uint32_t)i;
+    }
+
+    int block_size = ipf_block_size(h);
+    uint8_t pixels[4 * 8];
+    for (int ty = 0; ty < th; ty++) {
+        int by = (int)(((2L * ty + 1) * units_y) / (2 * th));
+        for (int tx = 0; tx < tw; tx++) {
+            int bx = (int)(((2L * tx + 1) * units_x) / (2 * tw));
+            size_t index = (size_t)by * units_x + bx;
+            if (progressive) index = w->order[block_count + index];
+            ipf_decode_block(h, blocks + index * block_size, IPF_PIXELS_TSVM, pixels, 8);
+            average_block(pixels, 8, e->thumb + ((size_t)ty * tw + tx) * 2);
+        }
+    }
+    return 0;
+}
+
+// =============================================================================
+// Scanning
+// =============================================================================
+
+typedef struct {
+    char **paths;        // Relative to the root
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+static int path_list_add(path_list_t *list, const char *rel) {
+    if (list->count == list->capacity) {
+        size_t cap = list->capacity ? list->capacity * 2 : 64;
+        char **paths = realloc(list->paths, cap * sizeof(*paths));
+        if (!paths) return -1;
+        list->paths = paths;
+        list->capacity = cap;
+    }
+    list->paths[list->count] = strdup(rel);
+    return list->paths[list->count++] ? 0 : -1;
+}
+
+static void path_list_free(path_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->paths[i]);
+    free(list->paths);
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int scan_directory(path_list_t *list, const char *root, const char *rel) {
+    char dir[MAX_PATH];
+    snprintf(dir, sizeof(dir), "%s%s%s", root, *rel ? "/" : "", rel);
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: Cannot open directory %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent *ent;
+    char path[MAX_PATH], child[MAX_PATH];
+
+    while (result == 0 && (ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, *rel ? "/" : "", ent->d_name) >= (int)sizeof(child) ||
+            snprintf(path, sizeof(path), "%s/%s", root, child) >= (int)sizeof(path)) {
+            fprintf(stderr, "Warning: Path too long, skipped: %s/%s\n", dir, ent->d_name);
+            continue;
+        }
+
+        struct stat st;
+        if (stat(path, &st) < 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            result = scan_directory(list, root, child);
+        } else if (S_ISREG(st.st_mode) && has_ipf_extension(ent->d_name)) {
+            result = path_list_add(list, child);
+        }
+    }
+
+    closedir(d);
+    return result;
+}
+
+/**
+ * Read a changed file and fill in e: the hash always, and the header and
+ * thumbnail unless old has the same content. Returns 1 if the content
+ * matched old, 0 for a new entry, -1 if the file is not a readable iPF.
+ */
+static int read_entry(catalog_work_t *w, const char *full, catalog_entry_t *e, const catalog_entry_t *old,
+                      int thumb_size, catalog_stats_t *stats) {
+    int fd = open(full, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: %s: %s\n", full, strerror(errno));
+        return -1;
+    }
+    size_t size = e->file_size;
+    int ok = ensure_capacity(&w->file, &w->file_cap, size ? size : 1) == 0;
+    size_t got = 0;
+    while (ok && got < size) {
+        ssize_t n = read(fd, w->file + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (!ok || got != size) {
+        fprintf(stderr, "Warning: %s: Cannot read file\n", full);
+        return -1;
+    }
+    stats->bytes_read += size;
+
+    e->hash = fnv1a64(w->file, size);
+    if (old && old->hash == e->hash && old->file_size == e->file_size) {
+        return 1;
+    }
+
+    int err = ipf_parse_header(w->file, size, &e->header);
+    if (err != IPF_OK) {
+        fprintf(stderr, "Warning: %s: %s\n", full, ipf_strerror(err));
+        return -1;
+    }
+    if (thumb_size == 0) return 0;
+
+    // An empty image has no blocks to sample; list it without a thumbnail
+    if (e->header.width == 0 || e->header.height == 0) return 0;
+
+    const uint8_t *blocks = unpack_blocks(w, full, &e->header, w->file + IPF_HEADER_SIZE, size - IPF_HEADER_SIZE);
+    if (!blocks) return -1;
+    if (make_thumbnail(w, e, blocks, thumb_size) < 0) {
+        fprintf(stderr, "Warning: %s: Out of memory for the thumbnail\n", full);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Take an entry over from the old catalog.
+ */
+static void adopt_entry(catalog_entry_t *e, catalog_entry_t *old) {
+    e->header = old->header;
+    e->thumb_w = old->thumb_w;
+    e->thumb_h = old->thumb_h;
+    e->thumb = old->thumb;
+    old->thumb = NULL;
+}
+
+static int build_catalog(const catalog_config_t *cfg) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    catalog_t old;
+    memset(&old, 0, sizeof(old));
+    if (!cfg->rebuild && catalog_load(cfg->catalog_file, &old, 1) < 0) {
+        fprintf(stderr, "Rebuilding the catalog\n");
+    }
+    // A different thumbnail size means new thumbnails for everything
+    int reuse_thumbs = old.thumb_size == cfg->thumb_size;
+
+    path_list_t files;
+    memset(&files, 0, sizeof(files));
+    if (scan_directory(&files, cfg->root, "") < 0) {
+        path_list_free(&files);
+        catalog_free(&old);
+        return -1;
+    }
+    if (files.count > 1) qsort(files.paths, files.count, sizeof(char *), compare_paths);
+
+    catalog_t cat;
+    memset(&cat, 0, sizeof(cat));
+    cat.thumb_size = cfg->thumb_size;
+    catalog_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    catalog_work_t work;
+    memset(&work, 0, sizeof(work));
+    work.dctx = ZSTD_createDCtx();
+
+    int result = work.dctx ? 0 : -1;
+    for (size_t i = 0; i < files.count && result == 0; i++) {
+        char full[MAX_PATH];
+        snprintf(full, sizeof(full), "%s/%s", cfg->root, files.paths[i]);
+        struct stat st;
+        if (stat(full, &st) < 0) continue;
+        if ((uint64_t)st.st_size > UINT32_MAX) {
+            fprintf(stderr, "Warning: %s: Too large for the catalog\n", full);
+            stats.skipped++;
+            continue;
+        }
+
+        catalog_entry_t *e = catalog_push(&cat);
+        if (!e || !(e->path = strdup(files.paths[i]))) {
+            if (e) cat.count--;
+            result = -1;
+            break;
+        }
+        e->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000u + (uint64_t)st.st_mtim.tv_nsec;
+        e->file_size = (uint32_t)st.st_size;
+
+        catalog_entry_t *prev = catalog_find(&old, e->path);
+        if (prev && reuse_thumbs && prev->mtime_ns == e->mtime_ns && prev->file_size == e->file_size) {
+            e->hash = prev->hash;
+            adopt_entry(e, prev);
+            stats.unchanged++;
+            continue;
+        }
+
+        int read = read_entry(&work, full, e, reuse_thumbs ? prev : NULL, cfg->thumb_size, &stats);
+        if (read < 0) {
+            entry_free(e);
+            cat.count--;
+            stats.skipped++;
+            continue;
+        }
+        if (read == 1) {
+            adopt_entry(e, prev);
+            stats.touched++;
+        } else if (prev) {
+            stats.updated++;
+            if (cfg->verbose) printf("  updated %s\n", e->path);
+        } else {
+            stats.added++;
+            if (cfg->verbose) printf("  added   %s\n", e->path);
+        }
+    }
+
+    for (size_t i = 0; i < old.count; i++) {
+        if (catalog_find(&cat, old.items[i].path)) continue;
+        stats.removed++;
+        if (cfg->verbose) printf("  removed %s\n", old.items[i].path);
+    }
+
+    if (result == 0) result = catalog_save(cfg->catalog_file, &cat);
+    else fprintf(stderr, "Error: Out of memory\n");
+
+    if (result == 0) {
+        printf("Catalogued %zu files in %s: %zu added, %zu updated, %zu touched, %zu unchanged, %zu removed",
+               cat.count, cfg->catalog_file, stats.added, stats.updated, stats.touched, stats.unchanged,
+               stats.removed);
+        if (stats.skipped) printf(", %zu skipped", stats.skipped);
+        printf("\n  Read %.2f MB in %.3f s\n", stats.bytes_read / 1e6, elapsed_seconds(&start));
+    }
+
+    ZSTD_freeDCtx(work.dctx);
+    if (work.zs_ready) inflateEnd(&work.zs);
+    free(work.file);
+    free(work.blocks);
+    free(work.pixels);
+    free(work.order);
+    catalog_free(&cat);
+    catalog_free(&old);
+    path_list_free(&files);
+    return result;
+}
+
+// =============================================================================
+// Listing
+// =============================================================================
+
+static const char *type_name(int type) {
+    switch (type) {
+        case IPF_TYPE_1: return "iPF1";
+        case IPF_TYPE_2: return "iPF2";
+        case IPF_TYPE_INDEXED: return "indexed";
+        default: return "unknown";
+    }
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+        if (*c == '"' || *c == '\\') printf("\\%c", *c);
+        else if (*c < 0x20) printf("\\u%04x", *c);
+        else putchar(*c);
+    }
+    putchar('"');
+}
+
+static int list_catalog(const catalog_config_t *cfg) {
+    catalog_t cat;
+    if (catalog_load(cfg->list_file, &cat, 0) < 0) return -1;
+
+    for (size_t i = 0; i < cat.count; i++) {
+        const catalog_entry_t *e = &cat.items[i];
+        int alpha = (e->header.flags & IPF_FLAG_ALPHA) != 0;
+        int zstd = (e->header.flags & IPF_FLAG_ZSTD) != 0;
+        int progressive = (e->header.flags & IPF_FLAG_PROGRESSIVE) != 0;
+
+        if (cfg->json) {
+            printf("{\"path\":");
+            print_json_string(e->path);
+            printf(",\"width\":%u,\"height\":%u,\"type\":\"%s\",\"alpha\":%s,\"zstd\":%s,\"progressive\":%s,"
+                   "\"size\":%u,\"hash\":\"%016llx\",\"thumb\":[%u,%u]}\n",
+                   e->header.width, e->header.height, type_name(e->header.type), alpha ? "true" : "false",
+                   zstd ? "true" : "false", progressive ? "true" : "false", e->file_size,
+                   (unsigned long long)e->hash, e->thumb_w, e->thumb_h);
+        } else {
+            printf("%-40s %5ux%-5u %-7s %-5s %-4s %-4s %9u  %016llx\n", e->path, e->header.width,
+                   e->header.height, type_name(e->header.type), alpha ? "alpha" : "-", zstd ? "zstd" : "-",
+                   progressive ? "prog" : "-", e->file_size, (unsigned long long)e->hash);
+        }
+    }
+    if (!cfg->json) printf("%zu files\n", cat.count);
+
+    catalog_free(&cat);
+    return 0;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    catalog_config_t cfg = {
+        .root = NULL,
+        .catalog_file = NULL,
+        .list_file = NULL,
+        .json = 0,
+        .thumb_size = DEFAULT_THUMB_SIZE,
+        .rebuild = 0,
+        .verbose = 0
+    };
+
+    static struct option long_options[] = {
+        {"output",  required_argument, 0, 'o'},
+        {"thumb",   required_argument, 0, 't'},
+        {"rebuild", no_argument,       0, 'f'},
+        {"list",    required_argument, 0, 'l'},
+        {"json",    no_argument,       0, 'J'},
+        {"verbose", no_argument,       0, 'v'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:t:fl:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'o':
+                cfg.catalog_file = optarg;
+                break;
+            case 't':
+                cfg.thumb_size = atoi(optarg);
+                if (cfg.thumb_size < 0 || cfg.thumb_size > MAX_THUMB_SIZE) {
+                    fprintf(stderr, "Error: Thumbnail size must be 0 to %d\n", MAX_THUMB_SIZE);
+                    return 1;
+                }
+                break;
+            case 'f':
+                cfg.rebuild = 1;
+                break;
+            case 'l':
+                cfg.list_file = optarg;
+                break;
+            case 'J':
+                cfg.json = 1;
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (cfg.list_file) return list_catalog(&cfg) == 0 ? 0 : 1;
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "Error: Give one directory to catalog\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    cfg.root = argv[optind];
+    size_t root_len = strlen(cfg.root);
+    while (root_len > 1 && cfg.root[root_len - 1] == '/') cfg.root[--root_len] = '\0';
+
+    struct stat st;
+    if (stat(cfg.root, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "Error: Not a directory: %s\n", cfg.root);
+        return 1;
+    }
+
+    char default_catalog[MAX_PATH];
+    if (!cfg.catalog_file) {
+        snprintf(default_catalog, sizeof(default_catalog), "%s/%s", cfg.root, CATALOG_DEFAULT_NAME);
+        cfg.catalog_file = default_catalog;
+    }
+
+    return build_catalog(&cfg) == 0 ? 0 : 1;
+}
@@ -1,532 +1,2450 @@
 /**
  * iPF Decoder - TSVM Interchangeable Picture Format Decoder
  *
- * Decodes iPF format (Type 1 or Type 2) images to standard formats via FFmpeg.
+ * Decodes iPF format (Type 1 or Type 2) images to PNG, QOI, PPM/PAM, TGA or
+ * raw pixels in-process, falling back to FFmpeg for other formats. Batch mode
+ * decodes whole directories across worker threads.
+ *
+ * --stats reports the time spent reading, inflating, decoding and writing,
+ * and --trace draws batch workers on a timeline; see ipf_stats.h.
+ * --simulate-io times a load from a modelled slow disk instead, and
+ * --sweep ranks other layouts of the same image by how soon they show.
+ * --layer composites several images onto one canvas, blending each
+ * layer's blocks in place.
+ * --upscale and --fit write enlarged or resampled rows straight from the
+ * block nibbles, a block row at a time.
  *
  * Created by CuriousTorvald and Claude on 2025-12-19.
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <string.h>
-#include <math.h>
-#include <getopt.h>
-#include <zstd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <glob.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <zlib.h>
+
+#include "image_writer.h"
+#include "ipf_stats.h"
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MAX_PATH 4096
+
+// Graphics adapter framebuffer geometry (one byte per pixel per plane)
+#define TSVM_FB_WIDTH  560
+#define TSVM_FB_HEIGHT 448
+#define PLANES_ZSTD_LEVEL 19  // Planes are baked once and loaded many times
+#define MAX_UPSCALE 16
+#define MAX_SCALED_SIZE 65535
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+/**
+ * A storage device for --simulate-io: one seek, then reads of chunk bytes
+ * issued back to back, each costing latency plus its bytes over bandwidth.
+ */
+typedef struct {
+    const char *name;
+    double bandwidth;    // Bytes per second
+    double latency;      // Seconds per read
+    double seek;         // Seconds before the first read
+    size_t chunk;        // Bytes per read
+    double cpu_scale;    // Multiplier on host decode time
+} io_model_t;
+
+// One --layer: an iPF drawn onto the canvas
+typedef struct {
+    char *path;
+    int x;
+    int y;
+    int opacity;         // 0..255
+} layer_t;
+
+typedef struct {
+    char *input_file;
+    char *output_file;
+    int verbose;
+    int raw_output;  // Output raw RGB instead of using FFmpeg
+    FILE *msg;       // Informational output (stderr when pixels go to stdout)
+    int format;      // image_format_t, or -1 to pick by output extension
+    image_writer_opts_t writer_opts;
+    char *batch_source;  // Directory, glob pattern or list file (batch mode)
+    char *output_dir;    // Batch export directory; NULL verifies only
+    int jobs;            // Batch worker threads
+    int planes;          // Emit adapter RG/BA planes instead of an image
+    int planes_zstd;     // Zstd level for the planes blob, 0 for uncompressed
+    int gray;            // Decode Y only, to 8-bit greyscale
+    int upscale;         // Nearest-neighbour factor, 0 for none
+    int fit_width;       // --fit box, 0 for none
+    int fit_height;
+    layer_t *layers;     // --layer list, drawn in order; compositing mode when any
+    int layer_count;
+    int canvas_width;    // 0 takes the first layer's size
+    int canvas_height;
+    uint8_t background[4];  // RGBA
+    ipf_stats_output_t stats_out;
+    ipf_stats_t *stats;  // NULL unless stats or a trace were asked for
+    int simulate_io;     // Time a load from io_model instead of writing output
+    io_model_t io_model;
+    int sweep;           // Also rank other layouts of the same image
+} decoder_config_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Decoder - TSVM Interchangeable Picture Format\n");
+    printf("\nUsage: %s -i input.ipf -o output.png [options]\n", program);
+    printf("       %s -b SOURCE [-O DIR] [options]\n\n", program);
+    printf("Required:\n");
+    printf("  -i, --input FILE         Input iPF file\n");
+    printf("  -o, --output FILE        Output image file (format chosen by extension)\n");
+    printf("\nOptions:\n");
+    printf("  --raw                    Output raw RGB24/RGBA data instead of image file\n");
+    printf("                           (use -o - to stream raw pixels to stdout)\n");
+    printf("  -f, --format NAME        Force output format: png, qoi, ppm, pam, tga, raw, ffmpeg\n");
+    printf("  --png-level N            PNG deflate level 0-9 (default: 1)\n");
+    printf("  --png-filter NAME        PNG row filter: none, sub, up, avg, paeth, adaptive\n");
+    printf("                           (default: up)\n");
+    printf("  --gray                   Output 8-bit greyscale from luma alone; chroma and alpha\n");
+    printf("                           are skipped (QOI has no grey and gets RGB)\n");
+    printf("  --upscale N              Enlarge N times (1-%d), each pixel an N x N square\n", MAX_UPSCALE);
+    printf("  --fit WxH                Scale to fit in WxH, keeping the aspect ratio; bilinear\n");
+    printf("                           in YCoCg before the VM's RGB conversion\n");
+    printf("  --planes                 Output the graphics adapter's RG and BA planes (560-byte\n");
+    printf("                           stride, RG plane then BA plane) for bulk loading\n");
+    printf("  --zstd[=LEVEL]           Compress --planes output with Zstd (default level: %d)\n", PLANES_ZSTD_LEVEL);
+    printf("  --stats[=FMT[:FILE]]     Report stage timings and counters as text or json\n");
+    printf("                           (default: text, to stderr; a FILE is appended to)\n");
+    printf("  --trace FILE             Write a Chrome trace of the stages (per worker in batch mode)\n");
+    printf("  -v, --verbose            Verbose output\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nLoad simulation (no -o):\n");
+    printf("  --simulate-io[=DEV]      Time loading the file from a storage device: first pixels,\n");
+    printf("                           first whole-frame preview, full image and speed index\n");
+    printf("                           (DEV: disc, drum, tape, serial, hsdpa; default: disc;\n");
+    printf("                           append ,bw=B/s ,baud=N ,lat=MS ,seek=MS ,chunk=B ,cpu=X)\n");
+    printf("  --sweep                  Also re-encode in every type, Zstd level and ordering\n");
+    printf("                           and rank the layouts by speed index\n");
+    printf("\nCompositing (no -i):\n");
+    printf("  -l, --layer FILE[@X,Y][:OPACITY]\n");
+    printf("                           Draw an iPF onto the canvas at X,Y (default: 0,0) with\n");
+    printf("                           source-over blending and OPACITY 0-1; repeat for more\n");
+    printf("                           layers, drawn in order\n");
+    printf("  --canvas WxH[:RRGGBB[AA]]  Canvas size and background (default: the first layer's\n");
+    printf("                           size, transparent); RGBA output unless it is opaque\n");
+    printf("\nBatch mode:\n");
+    printf("  -b, --batch SRC          Decode many files: a directory (searched recursively),\n");
+    printf("                           a quoted glob pattern, or a list file of paths\n");
+    printf("  -O, --output-dir DIR     Export decoded images under DIR (default format: png);\n");
+    printf("                           without it the files are only verified\n");
+    printf("  -j, --jobs N             Worker threads (default: number of CPUs)\n");
+    printf("\nPNG, QOI, PPM/PAM and TGA are written natively; other extensions go through FFmpeg.\n");
+    printf("IPF_STATS=json[:FILE] and IPF_TRACE=FILE do the same as --stats and --trace.\n");
+    printf("\nExamples:\n");
+    printf("  %s -i photo.ipf -o photo.png\n", program);
+    printf("  %s -i logo.ipf -o logo.jpg -v\n", program);
+    printf("  %s -i frame.ipf -o - --raw | other_tool\n", program);
+    printf("  %s -i boot.ipf -o boot.planes --planes --zstd\n", program);
+    printf("  %s -i scan.ipf -o scan.pgm --gray\n", program);
+    printf("  %s -i sprite.ipf -o sprite.png --upscale 4\n", program);
+    printf("  %s -i photo.ipf -o preview.png --fit 1920x1080\n", program);
+    printf("  %s -o scene.png --canvas 560x448:000000 -l bg.ipf -l hero.ipf@96,200 -l hud.ipf@0,400:0.75\n", program);
+    printf("  %s -i title.ipf --simulate-io=serial --sweep\n", program);
+    printf("  %s -b assets/disk0                   # Verify every iPF in the tree\n", program);
+    printf("  %s -b 'shots/*.ipf' -O out -f qoi    # Export a set of files\n", program);
+}
+
+// =============================================================================
+// iPF File Reading
+// =============================================================================
+
+static int read_ipf_header(FILE *fp, ipf_header_t *header) {
+    uint8_t buf[IPF_HEADER_SIZE];
+    size_t got = fread(buf, 1, IPF_HEADER_SIZE, fp);
+    int err = ipf_parse_header(buf, got, header);
+    if (err != IPF_OK) {
+        fprintf(stderr, "Error: %s\n", ipf_strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// Block Source
+// =============================================================================
+
+typedef enum {
+    PAYLOAD_RAW = 0,
+    PAYLOAD_ZSTD,
+    PAYLOAD_GZIP
+} payload_kind_t;
+
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+static const uint8_t GZIP_MAGIC[3] = { 0x1F, 0x8B, 0x08 };
+
+/**
+ * Work out how the block data is stored. The z-flag marks Zstd, but older
+ * files (e.g. assets/disk0/ycocg.ipf1) carry gzip without any flag; the VM
+ * sniffs the stream magic for these, so do the same. An unflagged payload
+ * is only taken as compressed when it is too short to be raw blocks.
+ */
+static payload_kind_t detect_payload(const ipf_header_t *header, const uint8_t *head, size_t head_len,
+                                     size_t payload_size, size_t raw_size) {
+    int is_zstd = head_len >= 4 && memcmp(head, ZSTD_MAGIC, 4) == 0;
+    int is_gzip = head_len >= 3 && memcmp(head, GZIP_MAGIC, 3) == 0;
+
+    if (header->flags & IPF_FLAG_ZSTD) return is_gzip ? PAYLOAD_GZIP : PAYLOAD_ZSTD;
+    if (payload_size >= raw_size) return PAYLOAD_RAW;
+    if (is_gzip) return PAYLOAD_GZIP;
+    if (is_zstd) return PAYLOAD_ZSTD;
+    return PAYLOAD_RAW;
+}
+
+/**
+ * Pulls block bytes out of the file on demand, decompressing through a
+ * streaming Zstd or zlib context as needed. Only a fixed-size input
+ * buffer is held, so memory use does not depend on the image size.
+ */
+typedef struct {
+    FILE *fp;
+    payload_kind_t kind;
+    ZSTD_DStream *dstream;
+    z_stream zs;
+    int zs_ready;
+    uint8_t *in_buf;
+    size_t in_buf_size;
+    size_t in_pos;
+    size_t in_len;
+    size_t payload_size;  // (size_t)-1 when not a regular file
+} block_reader_t;
+
+static size_t block_reader_fill(block_reader_t *r) {
+    if (r->in_pos == r->in_len) {
+        r->in_len = fread(r->in_buf, 1, r->in_buf_size, r->fp);
+        r->in_pos = 0;
+    }
+    return r->in_len - r->in_pos;
+}
+
+/**
+ * Set up a reader positioned just past the header. raw_size is the size of
+ * the uncompressed block data, used to tell legacy gzip files from raw ones.
+ */
+static int block_reader_init(block_reader_t *r, FILE *fp, const ipf_header_t *header, size_t raw_size) {
+    memset(r, 0, sizeof(*r));
+    r->fp = fp;
+    r->in_buf_size = ZSTD_DStreamInSize();
+    r->in_buf = malloc(r->in_buf_size);
+    if (!r->in_buf) {
+        fprintf(stderr, "Error: Failed to allocate read buffer\n");
+        return -1;
+    }
+
+    struct stat st;
+    size_t payload_size = (size_t)-1;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= IPF_HEADER_SIZE) {
+        payload_size = (size_t)st.st_size - IPF_HEADER_SIZE;
+    }
+
+    block_reader_fill(r);
+    r->kind = detect_payload(header, r->in_buf, r->in_len, payload_size, raw_size);
+    r->payload_size = payload_size;
+
+    if (r->kind == PAYLOAD_ZSTD) {
+        r->dstream = ZSTD_createDStream();
+        if (!r->dstream) {
+            fprintf(stderr, "Error: Failed to allocate decompression stream\n");
+            return -1;
+        }
+        ZSTD_initDStream(r->dstream);
+    } else if (r->kind == PAYLOAD_GZIP) {
+        if (inflateInit2(&r->zs, 16 + MAX_WBITS) != Z_OK) {
+            fprintf(stderr, "Error: Failed to allocate decompression stream\n");
+            return -1;
+        }
+        r->zs_ready = 1;
+    }
+    return 0;
+}
+
+/**
+ * Read exactly len decompressed bytes into dst.
+ * Returns 0 on success, -1 on truncated or corrupt data.
+ */
+static int block_reader_read(block_reader_t *r, uint8_t *dst, size_t len) {
+    size_t done = 0;
+
+    while (done < len) {
+        // Decompressors may still hold output once the file is drained
+        size_t avail = block_reader_fill(r);
+        size_t before = done;
+
+        if (r->kind == PAYLOAD_RAW) {
+            size_t n = avail < len - done ? avail : len - done;
+            memcpy(dst + done, r->in_buf + r->in_pos, n);
+            r->in_pos += n;
+            done += n;
+        } else if (r->kind == PAYLOAD_ZSTD) {
+            ZSTD_outBuffer output = { dst, len, done };
+            ZSTD_inBuffer input = { r->in_buf, r->in_len, r->in_pos };
+            size_t ret = ZSTD_decompressStream(r->dstream, &output, &input);
+            if (ZSTD_isError(ret)) {
+                fprintf(stderr, "Error: Zstd decompression failed: %s\n", ZSTD_getErrorName(ret));
+                return -1;
+            }
+            r->in_pos = input.pos;
+            done = output.pos;
+        } else {
+            r->zs.next_in = r->in_buf + r->in_pos;
+            r->zs.avail_in = (uInt)avail;
+            r->zs.next_out = dst + done;
+            r->zs.avail_out = (uInt)(len - done);
+            int ret = inflate(&r->zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                fprintf(stderr, "Error: Gzip decompression failed: %s\n", r->zs.msg ? r->zs.msg : "corrupt data");
+                return -1;
+            }
+            r->in_pos = r->in_len - r->zs.avail_in;
+            done = len - r->zs.avail_out;
+            if (ret == Z_STREAM_END && done < len) avail = 0;
+        }
+
+        if (done == before && avail == 0) {
+            fprintf(stderr, r->kind == PAYLOAD_RAW ? "Error: Failed to read block data\n"
+                                                   : "Error: Unexpected end of compressed block data\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void block_reader_free(block_reader_t *r) {
+    if (r->dstream) ZSTD_freeDStream(r->dstream);
+    if (r->zs_ready) inflateEnd(&r->zs);
+    free(r->in_buf);
+}
+
+/**
+ * Count one decoded file towards --stats.
+ */
+static void count_decoded(ipf_stats_t *stats, const ipf_header_t *header, int zstd,
+                          size_t payload_size, size_t raw_size) {
+    if (!stats) return;
+    stats->files++;
+    if (header->type != IPF_TYPE_INDEXED) stats->blocks += (uint64_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+    stats->pixels += (uint64_t)header->width * header->height;
+    if (zstd && payload_size != (size_t)-1) {
+        stats->zstd_raw += raw_size;
+        stats->zstd_packed += payload_size;
+    }
+}
+
+// =============================================================================
+// Pixel Output
+// =============================================================================
+
+/**
+ * Bytes per output pixel: one for --gray, else RGB24 or RGBA.
+ */
+static int output_channels(const decoder_config_t *cfg, const ipf_header_t *header) {
+    if (cfg->gray) return 1;
+    return (header->flags & IPF_FLAG_ALPHA) ? 4 : 3;
+}
+
+/**
+ * Open the output for decoded scanlines: raw pixels for --raw, otherwise the
+ * format named by --format or the output extension.
+ */
+static image_writer_t *open_output(const decoder_config_t *cfg, int width, int height, int channels) {
+    image_format_t fmt;
+    if (cfg->raw_output) fmt = IMG_FMT_RAW;
+    else if (cfg->format >= 0) fmt = (image_format_t)cfg->format;
+    else fmt = image_format_from_path(cfg->output_file);
+
+    if (fmt == IMG_FMT_FFMPEG && strcmp(cfg->output_file, "-") == 0) {
+        fprintf(stderr, "Error: Use --raw or --format to write to stdout\n");
+        return NULL;
+    }
+
+    if (cfg->verbose) {
+        fprintf(cfg->msg, "Output format: %s\n", image_format_name(fmt));
+    }
+
+    return image_writer_open(cfg->output_file, fmt, width, height, channels, &cfg->writer_opts);
+}
+
+// =============================================================================
+// Framebuffer Planes
+// =============================================================================
+
+/**
+ * The graphics adapter keeps two 560x448 planes, one byte per pixel each:
+ * RG (R<<4|G) in the framebuffer and BA (B<<4|A) in framebuffer2. A planes
+ * blob is the RG plane followed by the BA plane, holding exactly what
+ * decodeIpf1/decodeIpf2 would poke: 560-byte rows, block-padded height, and
+ * zero bytes right of the image. Load it with a bulk copy such as
+ * dma.ramToFrame/ramToFrame2 instead of decoding on the VM.
+ */
+typedef struct {
+    uint8_t *data;       // RG plane, then BA plane
+    size_t plane_size;
+} fb_planes_t;
+
+static int fb_planes_init(fb_planes_t *p, const ipf_header_t *header, const char *name) {
+    memset(p, 0, sizeof(*p));
+    if (header->type == IPF_TYPE_INDEXED) {
+        fprintf(stderr, "Error: %s: Indexed images have no RG/BA planes; their indices are the 8bpp framebuffer\n",
+                name);
+        return -1;
+    }
+    if (header->width > TSVM_FB_WIDTH || header->height > TSVM_FB_HEIGHT) {
+        fprintf(stderr, "Error: %s: %dx%d does not fit the %dx%d framebuffer\n", name,
+                header->width, header->height, TSVM_FB_WIDTH, TSVM_FB_HEIGHT);
+        return -1;
+    }
+
+    int rows = (header->height + 3) / 4 * 4;
+    p->plane_size = (size_t)rows * TSVM_FB_WIDTH;
+    p->data = calloc(2, p->plane_size);
+    if (!p->data) {
+        fprintf(stderr, "Error: Failed to allocate framebuffer planes\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void fb_planes_decode(fb_planes_t *p, const ipf_header_t *header, const uint8_t *blocks) {
+    ipf_decode_planes(header, blocks, p->data, p->data + p->plane_size, TSVM_FB_WIDTH);
+}
+
+/**
+ * Write the blob to path ("-" for stdout), as a single Zstd frame when
+ * zstd_level is non-zero; the VM's decompressor recognises it by its magic.
+ */
+static int fb_planes_write(const fb_planes_t *p, const char *path, int zstd_level) {
+    const uint8_t *out = p->data;
+    size_t out_size = p->plane_size * 2;
+    uint8_t *packed = NULL;
+
+    if (zstd_level > 0) {
+        size_t bound = ZSTD_compressBound(out_size);
+        packed = malloc(bound);
+        if (!packed) {
+            fprintf(stderr, "Error: Failed to allocate compression buffer\n");
+            return -1;
+        }
+        size_t ret = ZSTD_compress(packed, bound, p->data, out_size, zstd_level);
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "Error: Zstd compression failed: %s\n", ZSTD_getErrorName(ret));
+            free(packed);
+            return -1;
+        }
+        out = packed;
+        out_size = ret;
+    }
+
+    int to_stdout = strcmp(path, "-") == 0;
+    FILE *fp = to_stdout ? stdout : fopen(path, "wb");
+    int result = 0;
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open output file: %s\n", path);
+        result = -1;
+    } else {
+        if (fwrite(out, 1, out_size, fp) != out_size) result = -1;
+        if (to_stdout ? fflush(fp) != 0 : fclose(fp) != 0) result = -1;
+        if (result < 0) fprintf(stderr, "Error: Failed to write output: %s\n", path);
+    }
+
+    free(packed);
+    return result;
+}
+
+static void fb_planes_free(fb_planes_t *p) {
+    free(p->data);
+}
+
+// =============================================================================
+// Scaled Output
+// =============================================================================
+
+/**
+ * An image with no pixels has nothing to scale, and the --fit ratios
+ * would divide by its zero side.
+ */
+static int check_scalable(const ipf_header_t *header, const char *name) {
+    if (header->width > 0 && header->height > 0) return 0;
+    fprintf(stderr, "Error: %s: Cannot scale a %dx%d image\n", name, header->width, header->height);
+    return -1;
+}
+
+/**
+ * Output size for --upscale N, or the largest size that fits in the --fit
+ * box with the image's aspect ratio.
+ */
+static void scaled_size(const decoder_config_t *cfg, const ipf_header_t *header, int *width, int *height) {
+    if (cfg->upscale > 0) {
+        *width = header->width * cfg->upscale;
+        *height = header->height * cfg->upscale;
+        return;
+    }
+    double sx = (double)cfg->fit_width / header->width;
+    double sy = (double)cfg->fit_height / header->height;
+    double s = sx < sy ? sx : sy;
+    *width = (int)(header->width * s + 0.5);
+    *height = (int)(header->height * s + 0.5);
+    if (*width < 1) *width = 1;
+    if (*height < 1) *height = 1;
+}
+
+/**
+ * A one-row header for decoding a single row of palette indices.
+ */
+static ipf_header_t indexed_row_header(const ipf_header_t *header) {
+    ipf_header_t row = *header;
+    row.height = 1;
+    return row;
+}
+
+/**
+ * --upscale: every pixel written as an N x N square, one block row (or
+ * index row) at a time.
+ */
+static int write_upscaled(const decoder_config_t *cfg, const ipf_header_t *header, const uint8_t *blocks,
+                          image_writer_t *writer) {
+    int channels = (header->flags & IPF_FLAG_ALPHA) ? 4 : 3;
+    int scale = cfg->upscale;
+    int out_height = header->height * scale;
+    int result = 0;
+
+    if (header->type == IPF_TYPE_INDEXED) {
+        ipf_header_t row_header = indexed_row_header(header);
+        uint8_t *native = malloc((size_t)header->width * channels);
+        uint8_t *row = malloc((size_t)header->width * scale * channels);
+        if (!native || !row) result = -1;
+        for (int y = 0; y < header->height && result == 0; y++) {
+            ipf_decode_image(&row_header, blocks + (size_t)y * header->width, IPF_PIXELS_RGB, native, 0);
+            for (int x = 0; x < header->width; x++) {
+                for (int k = 0; k < scale; k++) {
+                    memcpy(row + ((size_t)x * scale + k) * channels, native + (size_t)x * channels, channels);
+                }
+            }
+            for (int k = 0; k < scale && result == 0 && writer; k++) {
+                result = image_writer_write_rows(writer, row, 0, 1);
+            }
+        }
+        free(native);
+        free(row);
+        return result;
+    }
+
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    size_t row_size = (size_t)blocks_x * ipf_block_size(header);
+    size_t band_stride = (size_t)blocks_x * 4 * scale * channels;
+    uint8_t *band = malloc(band_stride * 4 * scale);
+    if (!band) return -1;
+
+    for (int by = 0; by < blocks_y && result == 0; by++) {
+        ipf_decode_block_row_upscaled(header, blocks + (size_t)by * row_size, scale, band, band_stride);
+        int rows = out_height - by * 4 * scale;
+        if (rows > 4 * scale) rows = 4 * scale;
+        if (writer) result = image_writer_write_rows(writer, band, band_stride, rows);
+    }
+    free(band);
+    return result;
+}
+
+/**
+ * Native rows for --fit, kept as four planes of 8 rows: two block rows,
+ * enough for any pair of neighbouring rows. Block images hold Y, Co, Cg
+ * and alpha nibbles; indexed ones hold R, G, B and A bytes.
+ */
+typedef struct {
+    const ipf_header_t *header;
+    const uint8_t *blocks;
+    size_t stride;
+    uint8_t *data;
+    uint8_t *planes[4][8];   // [channel][row & 7]
+    int row_in_slot[8];
+    uint8_t *native;         // Indexed row decoded to RGB(A)
+} fit_rows_t;
+
+static int fit_rows_init(fit_rows_t *f, const ipf_header_t *header, const uint8_t *blocks) {
+    f->header = header;
+    f->blocks = blocks;
+    f->stride = (size_t)ipf_blocks_x(header) * 4;
+    f->data = malloc(f->stride * 8 * 4);
+    f->native = malloc(f->stride * 4);
+    if (!f->data || !f->native) return -1;
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 8; r++) f->planes[c][r] = f->data + (size_t)(c * 8 + r) * f->stride;
+    }
+    for (int r = 0; r < 8; r++) f->row_in_slot[r] = -1;
+    return 0;
+}
+
+static void fit_rows_free(fit_rows_t *f) {
+    free(f->data);
+    free(f->native);
+}
+
+/**
+ * Make native row y available in its slot.
+ */
+static void fit_rows_load(fit_rows_t *f, int y) {
+    const ipf_header_t *header = f->header;
+    if (f->row_in_slot[y & 7] == y) return;
+
+    if (header->type == IPF_TYPE_INDEXED) {
+        int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+        int channels = has_alpha ? 4 : 3;
+        ipf_header_t row_header = indexed_row_header(header);
+        ipf_decode_image(&row_header, f->blocks + (size_t)y * header->width, IPF_PIXELS_RGB, f->native, 0);
+        for (int x = 0; x < header->width; x++) {
+            for (int c = 0; c < 4; c++) {
+                f->planes[c][y & 7][x] = c < channels ? f->native[x * channels + c] : 255;
+            }
+        }
+        f->row_in_slot[y & 7] = y;
+        return;
+    }
+
+    int by = y / 4;
+    int first = (by * 4) & 7;
+    uint8_t *const planes[4] = { f->planes[0][first], f->planes[1][first], f->planes[2][first], f->planes[3][first] };
+    ipf_unpack_block_row(header, f->blocks + (size_t)by * ipf_blocks_x(header) * ipf_block_size(header),
+                         planes, f->stride);
+    for (int r = 0; r < 4; r++) f->row_in_slot[first + r] = by * 4 + r;
+}
+
+/**
+ * --fit: bilinear resampling of the native Y, Co, Cg and alpha nibbles,
+ * converted to RGB only at the output pixel. Sample positions are pixel
+ * centres, clamped to the image (padding is never sampled).
+ */
+static int write_fitted(const decoder_config_t *cfg, const ipf_header_t *header, const uint8_t *blocks,
+                        image_writer_t *writer) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int channels = has_alpha ? 4 : 3;
+    int indexed = header->type == IPF_TYPE_INDEXED;
+    int width = header->width, height = header->height;
+    int out_width, out_height;
+    scaled_size(cfg, header, &out_width, &out_height);
+
+    fit_rows_t rows;
+    memset(&rows, 0, sizeof(rows));
+    int *x0 = malloc(sizeof(int) * out_width);
+    float *fx = malloc(sizeof(float) * out_width);
+    float *column = malloc(sizeof(float) * 4 * width);  // Vertically blended native row
+    uint8_t *out = malloc((size_t)out_width * channels);
+    int result = (x0 && fx && column && out && fit_rows_init(&rows, header, blocks) == 0) ? 0 : -1;
+
+    for (int ox = 0; ox < out_width && result == 0; ox++) {
+        float sx = (ox + 0.5f) * width / out_width - 0.5f;
+        if (sx < 0) sx = 0;
+        x0[ox] = (int)sx;
+        fx[ox] = sx - x0[ox];
+        if (x0[ox] >= width - 1) {
+            x0[ox] = width - 1;
+            fx[ox] = 0;
+        }
+    }
+
+    for (int oy = 0; oy < out_height && result == 0; oy++) {
+        float sy = (oy + 0.5f) * height / out_height - 0.5f;
+        if (sy < 0) sy = 0;
+        int y0 = (int)sy;
+        float fy = sy - y0;
+        if (y0 >= height - 1) {
+            y0 = height - 1;
+            fy = 0;
+        }
+        int y1 = y0 + (fy > 0);
+        fit_rows_load(&rows, y0);
+        fit_rows_load(&rows, y1);
+
+        for (int c = 0; c < 4; c++) {
+            const uint8_t *a = rows.planes[c][y0 & 7];
+            const uint8_t *b = rows.planes[c][y1 & 7];
+            for (int x = 0; x < width; x++) column[x * 4 + c] = a[x] + (b[x] - a[x]) * fy;
+        }
+
+        for (int ox = 0; ox < out_width; ox++) {
+            const float *p = column + x0[ox] * 4;
+            const float *q = fx[ox] > 0 ? p + 4 : p;
+            float v[4];
+            for (int c = 0; c < 4; c++) v[c] = p[c] + (q[c] - p[c]) * fx[ox];
+
+            uint8_t *px = out + (size_t)ox * channels;
+            if (indexed) {
+                for (int c = 0; c < channels; c++) px[c] = (uint8_t)(v[c] + 0.5f);
+            } else {
+                ipf_ycocg_to_rgb(v[0], v[1], v[2], px);
+                if (has_alpha) px[3] = (uint8_t)(v[3] * 17.0f + 0.5f);
+            }
+        }
+        if (writer) result = image_writer_write_rows(writer, out, 0, 1);
+    }
+
+    fit_rows_free(&rows);
+    free(x0);
+    free(fx);
+    free(column);
+    free(out);
+    return result;
+}
+
+/**
+ * Write a decoded file at its --upscale or --fit size. blocks is the
+ * whole stored payload; progressive files are put back in raster order
+ * first, which costs a copy of the blocks but never of the pixels.
+ */
+static int write_scaled(const decoder_config_t *cfg, const ipf_header_t *header, const uint8_t *blocks,
+                        image_writer_t *writer, const char *name) {
+    uint8_t *raster = NULL;
+
+    if (header->type != IPF_TYPE_INDEXED && (header->flags & IPF_FLAG_PROGRESSIVE)) {
+        int blocks_x = ipf_blocks_x(header);
+        int blocks_y = ipf_blocks_y(header);
+        size_t count = (size_t)blocks_x * blocks_y;
+        int block_size = ipf_block_size(header);
+        uint32_t *order = malloc(count * sizeof(*order));
+        raster = malloc(ipf_blocks_size(header));
+        if (!order || !raster) {
+            free(order);
+            free(raster);
+            fprintf(stderr, "Error: %s: Failed to allocate block buffer\n", name);
+            return -1;
+        }
+        ipf_adam7_order(blocks_x, blocks_y, order);
+        for (size_t i = 0; i < count; i++) {
+            memcpy(raster + (size_t)order[i] * block_size, blocks + i * block_size, block_size);
+        }
+        free(order);
+        blocks = raster;
+    }
+
+    int result = cfg->upscale > 0 ? write_upscaled(cfg, header, blocks, writer)
+                                  : write_fitted(cfg, header, blocks, writer);
+    if (result < 0) fprintf(stderr, "Error: %s: Failed to write scaled output\n", name);
+    free(raster);
+    return result;
+}
+
+// =============================================================================
+// Main Decoding
+// =============================================================================
+
+/**
+ * Decode a raster-ordered iPF one block row at a time.
+ * Holds one row of blocks and one 4-scanline band, so peak memory is O(width).
+ */
+static int decode_ipf_streaming(const decoder_config_t *cfg, FILE *fp, const ipf_header_t *header) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+
+    int channels = output_channels(cfg, header);
+    int blocks_x = (header->width + 3) / 4;
+    int blocks_y = (header->height + 3) / 4;
+    int block_size = ipf_block_size(header);
+    size_t band_stride = (size_t)blocks_x * 4 * channels;
+    size_t block_row_size = (size_t)blocks_x * block_size;
+
+    uint8_t *block_row = malloc(block_row_size);
+    uint8_t *band = malloc(band_stride * 4);
+    if (!block_row || !band) {
+        free(block_row);
+        free(band);
+        fprintf(stderr, "Error: Failed to allocate band buffer\n");
+        return -1;
+    }
+
+    block_reader_t reader;
+    image_writer_t *writer = NULL;
+    uint64_t t = ipf_stats_start(cfg->stats);
+    int result = block_reader_init(&reader, fp, header, block_row_size * blocks_y);
+    if (result == 0) {
+        writer = open_output(cfg, header->width, header->height, channels);
+        if (!writer) result = -1;
+    }
+    t = ipf_stats_lap(cfg->stats, "write", t);
+
+    for (int by = 0; by < blocks_y && result == 0; by++) {
+        if (block_reader_read(&reader, block_row, block_row_size) < 0) {
+            result = -1;
+            break;
+        }
+        t = ipf_stats_lap(cfg->stats, "inflate", t);
+
+        if (cfg->gray) ipf_decode_gray_row(header, block_row, band, band_stride);
+        else ipf_decode_block_row(header, IPF_PIXELS_RGB, block_row, band, band_stride);
+        t = ipf_stats_lap(cfg->stats, "decode", t);
+
+        int rows = header->height - by * 4;
+        if (rows > 4) rows = 4;
+        if (image_writer_write_rows(writer, band, band_stride, rows) < 0) {
+            fprintf(stderr, "Error: Failed to write output\n");
+            result = -1;
+        }
+        t = ipf_stats_lap(cfg->stats, "write", t);
+    }
+
+    if (writer && image_writer_close(writer) < 0) result = -1;
+    ipf_stats_lap(cfg->stats, "write", t);
+    if (result == 0) {
+        count_decoded(cfg->stats, header, reader.kind == PAYLOAD_ZSTD, reader.payload_size,
+                      block_row_size * blocks_y);
+    }
+    block_reader_free(&reader);
+    free(block_row);
+    free(band);
+
+    if (result == 0 && cfg->verbose) {
+        fprintf(cfg->msg, "Decoded %d blocks (%dx%d), streamed %s\n", blocks_x * blocks_y, blocks_x, blocks_y,
+                cfg->gray ? "grey" : (has_alpha ? "RGBA" : "RGB24"));
+    }
+
+    return result;
+}
+
+/**
+ * Decode the whole image into memory before writing it out.
+ * Used when the block order does not follow scanlines (progressive files),
+ * and for indexed images, which are small and not made of blocks.
+ */
+static int decode_ipf_whole(const decoder_config_t *cfg, FILE *fp, const ipf_header_t *header) {
+    int channels = output_channels(cfg, header);
+    int blocks_x = (header->width + 3) / 4;
+    int blocks_y = (header->height + 3) / 4;
+    size_t row_stride = (size_t)blocks_x * 4 * channels;
+    size_t image_size = row_stride * blocks_y * 4;
+    size_t block_data_size = ipf_blocks_size(header);
+
+    uint8_t *block_data = malloc(block_data_size);
+    uint8_t *image = malloc(image_size);
+    if (!block_data || !image) {
+        free(block_data);
+        free(image);
+        fprintf(stderr, "Error: Failed to allocate image buffer\n");
+        return -1;
+    }
+
+    block_reader_t reader;
+    uint64_t t = ipf_stats_start(cfg->stats);
+    int result = block_reader_init(&reader, fp, header, block_data_size);
+    if (result == 0) result = block_reader_read(&reader, block_data, block_data_size);
+    if (result == 0) count_decoded(cfg->stats, header, reader.kind == PAYLOAD_ZSTD, reader.payload_size, block_data_size);
+    block_reader_free(&reader);
+    t = ipf_stats_lap(cfg->stats, "inflate", t);
+
+    if (result < 0) {
+        free(block_data);
+        free(image);
+        return -1;
+    }
+
+    // Decode blocks, placing progressive ones by their Adam7 pass
+    if (cfg->gray) ipf_decode_gray(header, block_data, image, row_stride);
+    else ipf_decode_image(header, block_data, IPF_PIXELS_RGB, image, row_stride);
+    t = ipf_stats_lap(cfg->stats, "decode", t);
+
+    free(block_data);
+
+    if (cfg->verbose && header->type == IPF_TYPE_INDEXED) {
+        fprintf(cfg->msg, "Decoded %dx%d palette indices\n", header->width, header->height);
+    } else if (cfg->verbose) {
+        fprintf(cfg->msg, "Decoded %d blocks (%dx%d)\n", blocks_x * blocks_y, blocks_x, blocks_y);
+    }
+
+    // Output image
+    image_writer_t *writer = open_output(cfg, header->width, header->height, channels);
+    if (!writer) {
+        result = -1;
+    } else {
+        if (image_writer_write_rows(writer, image, row_stride, header->height) < 0) {
+            fprintf(stderr, "Error: Failed to write output\n");
+            result = -1;
+        }
+        if (image_writer_close(writer) < 0) result = -1;
+    }
+    ipf_stats_lap(cfg->stats, "write", t);
+
+    free(image);
+
+    return result;
+}
+
+/**
+ * Decode into framebuffer planes (see fb_planes_t) and write the blob.
+ */
+static int decode_ipf_planes(const decoder_config_t *cfg, FILE *fp, const ipf_header_t *header) {
+    size_t block_data_size = ipf_blocks_size(header);
+
+    fb_planes_t planes;
+    if (fb_planes_init(&planes, header, cfg->input_file) < 0) return -1;
+
+    // At most 188 KB of blocks for a full screen, so take them in one go
+    uint8_t *block_data = malloc(block_data_size);
+    if (!block_data) {
+        fb_planes_free(&planes);
+        fprintf(stderr, "Error: Failed to allocate block buffer\n");
+        return -1;
+    }
+
+    block_reader_t reader;
+    uint64_t t = ipf_stats_start(cfg->stats);
+    int result = block_reader_init(&reader, fp, header, block_data_size);
+    if (result == 0) result = block_reader_read(&reader, block_data, block_data_size);
+    if (result == 0) count_decoded(cfg->stats, header, reader.kind == PAYLOAD_ZSTD, reader.payload_size, block_data_size);
+    block_reader_free(&reader);
+    t = ipf_stats_lap(cfg->stats, "inflate", t);
+
+    if (result == 0) {
+        fb_planes_decode(&planes, header, block_data);
+        t = ipf_stats_lap(cfg->stats, "decode", t);
+        result = fb_planes_write(&planes, cfg->output_file, cfg->planes_zstd);
+        ipf_stats_lap(cfg->stats, "write", t);
+    }
+
+    if (result == 0 && cfg->verbose) {
+        fprintf(cfg->msg, "Wrote RG/BA planes: 2 x %zu bytes (%d rows at stride %d)%s\n", planes.plane_size,
+                (int)(planes.plane_size / TSVM_FB_WIDTH), TSVM_FB_WIDTH, cfg->planes_zstd ? ", zstd" : "");
+    }
+
+    free(block_data);
+    fb_planes_free(&planes);
+    return result;
+}
+
+/**
+ * Decode at the --upscale or --fit size. The blocks are read whole (they
+ * are the small part); pixels only ever exist a few rows at a time.
+ */
+static int decode_ipf_scaled(const decoder_config_t *cfg, FILE *fp, const ipf_header_t *header) {
+    if (check_scalable(header, cfg->input_file) < 0) return -1;
+
+    size_t block_data_size = ipf_blocks_size(header);
+    uint8_t *block_data = malloc(block_data_size);
+    if (!block_data) {
+        fprintf(stderr, "Error: Failed to allocate block buffer\n");
+        return -1;
+    }
+
+    block_reader_t reader;
+    uint64_t t = ipf_stats_start(cfg->stats);
+    int result = block_reader_init(&reader, fp, header, block_data_size);
+    if (result == 0) result = block_reader_read(&reader, block_data, block_data_size);
+    if (result == 0) count_decoded(cfg->stats, header, reader.kind == PAYLOAD_ZSTD, reader.payload_size, block_data_size);
+    block_reader_free(&reader);
+    t = ipf_stats_lap(cfg->stats, "inflate", t);
+
+    int width, height;
+    scaled_size(cfg, header, &width, &height);
+    image_writer_t *writer = NULL;
+    if (result == 0) {
+        writer = open_output(cfg, width, height, output_channels(cfg, header));
+        if (!writer) result = -1;
+    }
+    if (result == 0) result = write_scaled(cfg, header, block_data, writer, cfg->input_file);
+    t = ipf_stats_lap(cfg->stats, "decode", t);
+    if (writer && image_writer_close(writer) < 0) result = -1;
+    ipf_stats_lap(cfg->stats, "write", t);
+    free(block_data);
+
+    if (result == 0 && cfg->verbose) {
+        fprintf(cfg->msg, "Scaled %dx%d to %dx%d (%s)\n", header->width, header->height, width, height,
+                cfg->upscale ? "nearest" : "bilinear YCoCg");
+    }
+    return result;
+}
+
+static int decode_ipf(const decoder_config_t *cfg) {
+    uint64_t t = ipf_stats_start(cfg->stats);
+    FILE *fp = fopen(cfg->input_file, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open input file: %s\n", cfg->input_file);
+        return -1;
+    }
+
+    // Read header
+    ipf_header_t header;
+    if (read_ipf_header(fp, &header) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    ipf_stats_lap(cfg->stats, "read", t);
+
+    int has_alpha = (header.flags & IPF_FLAG_ALPHA) != 0;
+    int use_zstd = (header.flags & IPF_FLAG_ZSTD) != 0;
+    int progressive = (header.flags & IPF_FLAG_PROGRESSIVE) != 0;
+
+    if (cfg->verbose) {
+        fprintf(cfg->msg, "iPF Header:\n");
+        fprintf(cfg->msg, "  Size: %dx%d\n", header.width, header.height);
+        if (header.type == IPF_TYPE_INDEXED) {
+            fprintf(cfg->msg, "  Type: indexed (256 colours)\n");
+        } else {
+            fprintf(cfg->msg, "  Type: iPF%d (%s)\n", header.type + 1,
+                    header.type == 0 ? "4:2:0" : "4:2:2");
+        }
+        fprintf(cfg->msg, "  Flags: %s%s%s\n",
+                has_alpha ? "alpha " : "",
+                use_zstd ? "zstd " : "",
+                progressive ? "progressive " : "");
+        fprintf(cfg->msg, "  Uncompressed size: %u bytes\n", header.uncompressed_size);
+    }
+
+    int result;
+    if (cfg->planes) {
+        result = decode_ipf_planes(cfg, fp, &header);
+    } else if (cfg->upscale || cfg->fit_width) {
+        result = decode_ipf_scaled(cfg, fp, &header);
+    } else if (progressive || header.type == IPF_TYPE_INDEXED) {
+        result = decode_ipf_whole(cfg, fp, &header);
+    } else {
+        result = decode_ipf_streaming(cfg, fp, &header);
+    }
+
+    fclose(fp);
+
+    if (cfg->stats) {
+        cfg->stats->bytes_in += ipf_stats_file_size(cfg->input_file);
+        cfg->stats->bytes_out += ipf_stats_file_size(cfg->output_file);
+    }
+    return result;
+}
+
+// =============================================================================
+// Compositing
+// =============================================================================
+
+/**
+ * Parse "FILE[@X,Y][:OPACITY]" for --layer; OPACITY is 0..1. The suffixes
+ * are only taken when they parse, so paths with '@' or ':' still work.
+ */
+static int parse_layer(const char *spec, layer_t *layer) {
+    size_t len = strlen(spec);
+    layer->x = 0;
+    layer->y = 0;
+    layer->opacity = 255;
+
+    const char *colon = strrchr(spec, ':');
+    if (colon) {
+        char *end;
+        double op = strtod(colon + 1, &end);
+        if (end != colon + 1 && *end == '\0') {
+            if (op < 0.0 || op > 1.0) {
+                fprintf(stderr, "Error: Layer opacity must be 0-1: %s\n", spec);
+                return -1;
+            }
+            layer->opacity = (int)(op * 255.0 + 0.5);
+            len = (size_t)(colon - spec);
+        }
+    }
+
+    for (size_t i = len; i-- > 0;) {
+        if (spec[i] != '@') continue;
+        int x, y, n = 0;
+        if (sscanf(spec + i + 1, "%d,%d%n", &x, &y, &n) == 2 && (size_t)n == len - i - 1) {
+            layer->x = x;
+            layer->y = y;
+            len = i;
+        }
+        break;
+    }
+
+    if (len == 0) {
+        fprintf(stderr, "Error: Layer needs a file: %s\n", spec);
+        return -1;
+    }
+    layer->path = strndup(spec, len);
+    return layer->path ? 0 : -1;
+}
+
+/**
+ * Parse "WxH[:RRGGBB[AA]]" or ":RRGGBB[AA]" for --canvas.
+ */
+static int parse_canvas(const char *spec, decoder_config_t *cfg) {
+    const char *colour = strchr(spec, ':');
+    if (spec[0] != ':') {
+        int w, h, n = 0;
+        if (sscanf(spec, "%dx%d%n", &w, &h, &n) != 2 || (colour ? spec + n != colour : spec[n] != '\0') ||
+            w < 1 || h < 1 || w > 65535 || h > 65535) {
+            fprintf(stderr, "Error: Canvas must be WxH[:RRGGBB[AA]]: %s\n", spec);
+            return -1;
+        }
+        cfg->canvas_width = w;
+        cfg->canvas_height = h;
+    }
+    if (colour) {
+        size_t digits = strlen(colour + 1);
+        char *end;
+        unsigned long v = strtoul(colour + 1, &end, 16);
+        if ((digits != 6 && digits != 8) || *end != '\0') {
+            fprintf(stderr, "Error: Canvas colour must be RRGGBB or RRGGBBAA: %s\n", colour + 1);
+            return -1;
+        }
+        if (digits == 6) v = (v << 8) | 0xFF;
+        for (int c = 0; c < 4; c++) cfg->background[c] = (uint8_t)(v >> (24 - c * 8));
+    }
+    return 0;
+}
+
+/**
+ * Read one layer and draw it straight onto the canvas. Raster files go a
+ * block row at a time and stop once they pass the bottom of the canvas;
+ * progressive and indexed ones are read whole, as blocks only.
+ */
+static int composite_layer(const decoder_config_t *cfg, const ipf_canvas_t *canvas, const layer_t *layer) {
+    uint64_t t = ipf_stats_start(cfg->stats);
+    FILE *fp = fopen(layer->path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open layer: %s\n", layer->path);
+        return -1;
+    }
+
+    ipf_header_t header;
+    if (read_ipf_header(fp, &header) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    t = ipf_stats_lap(cfg->stats, "read", t);
+
+    int streaming = header.type != IPF_TYPE_INDEXED && !(header.flags & IPF_FLAG_PROGRESSIVE);
+    int blocks_y = ipf_blocks_y(&header);
+    size_t raw_size = ipf_blocks_size(&header);
+    size_t chunk = streaming ? (size_t)ipf_blocks_x(&header) * ipf_block_size(&header) : raw_size;
+
+    uint8_t *blocks = malloc(chunk);
+    if (!blocks) {
+        fprintf(stderr, "Error: Failed to allocate block buffer\n");
+        fclose(fp);
+        return -1;
+    }
+
+    block_reader_t reader;
+    int result = block_reader_init(&reader, fp, &header, raw_size);
+    int rows = 0;
+    if (result == 0 && streaming) {
+        for (int by = 0; by < blocks_y && layer->y + by * 4 < canvas->height; by++) {
+            if (block_reader_read(&reader, blocks, chunk) < 0) {
+                result = -1;
+                break;
+            }
+            t = ipf_stats_lap(cfg->stats, "inflate", t);
+            ipf_composite_block_row(&header, blocks, by, canvas, layer->x, layer->y, layer->opacity);
+            t = ipf_stats_lap(cfg->stats, "decode", t);
+            rows++;
+        }
+    } else if (result == 0) {
+        result = block_reader_read(&reader, blocks, chunk);
+        t = ipf_stats_lap(cfg->stats, "inflate", t);
+        if (result == 0) ipf_composite(&header, blocks, canvas, layer->x, layer->y, layer->opacity);
+        ipf_stats_lap(cfg->stats, "decode", t);
+        rows = blocks_y;
+    }
+    if (result == 0) {
+        count_decoded(cfg->stats, &header, reader.kind == PAYLOAD_ZSTD, reader.payload_size, raw_size);
+        if (cfg->stats) cfg->stats->bytes_in += ipf_stats_file_size(layer->path);
+    } else {
+        fprintf(stderr, "Error: %s: failed to read block data\n", layer->path);
+    }
+    block_reader_free(&reader);
+    free(blocks);
+    fclose(fp);
+
+    if (result == 0 && cfg->verbose) {
+        fprintf(cfg->msg, "  %s: %dx%d at %d,%d, opacity %d/255%s\n", layer->path, header.width, header.height,
+                layer->x, layer->y, layer->opacity,
+                rows < blocks_y ? " (clipped rows not read)" : "");
+    }
+    return result;
+}
+
+/**
+ * Draw every --layer in order onto one canvas and write it. The canvas is
+ * the only full-size pixel buffer; without --canvas it takes the first
+ * layer's size, and it is RGB when its background is opaque, else RGBA.
+ */
+static int composite_layers(const decoder_config_t *cfg) {
+    int width = cfg->canvas_width, height = cfg->canvas_height;
+    if (width == 0) {
+        FILE *fp = fopen(cfg->layers[0].path, "rb");
+        ipf_header_t header;
+        if (!fp) {
+            fprintf(stderr, "Error: Failed to open layer: %s\n", cfg->layers[0].path);
+            return -1;
+        }
+        int ok = read_ipf_header(fp, &header) == 0;
+        fclose(fp);
+        if (!ok) return -1;
+        width = header.width;
+        height = header.height;
+    }
+
+    int channels = cfg->background[3] == 255 ? 3 : 4;
+    ipf_canvas_t canvas = { NULL, width, height, channels, (size_t)width * channels };
+    canvas.pixels = malloc(canvas.stride * height);
+    if (!canvas.pixels) {
+        fprintf(stderr, "Error: Failed to allocate canvas\n");
+        return -1;
+    }
+    for (size_t i = 0; i < (size_t)width * height; i++) memcpy(canvas.pixels + i * channels, cfg->background, channels);
+
+    if (cfg->verbose) {
+        fprintf(cfg->msg, "Canvas %dx%d %s, background %02X%02X%02X%02X\n", width, height,
+                channels == 4 ? "RGBA" : "RGB24", cfg->background[0], cfg->background[1],
+                cfg->background[2], cfg->background[3]);
+    }
+
+    int result = 0;
+    for (int i = 0; i < cfg->layer_count && result == 0; i++) {
+        result = composite_layer(cfg, &canvas, &cfg->layers[i]);
+    }
+
+    if (result == 0) {
+        uint64_t t = ipf_stats_start(cfg->stats);
+        image_writer_t *writer = open_output(cfg, width, height, channels);
+        if (!writer) {
+            result = -1;
+        } else {
+            if (image_writer_write_rows(writer, canvas.pixels, canvas.stride, height) < 0) {
+                fprintf(stderr, "Error: Failed to write output\n");
+                result = -1;
+            }
+            if (image_writer_close(writer) < 0) result = -1;
+        }
+        ipf_stats_lap(cfg->stats, "write", t);
+        if (cfg->stats) cfg->stats->bytes_out += ipf_stats_file_size(cfg->output_file);
+    }
+
+    free(canvas.pixels);
+    return result;
+}
+
+// =============================================================================
+// Load Simulation
+// =============================================================================
+
+/**
+ * Storage presets for --simulate-io. The seek figures are the averages of
+ * latency_simulator_storage_device.kts, without its jitter so runs repeat;
+ * serial and hsdpa follow the VM's BlockTransferInterface (10 bits per
+ * byte, 4096-byte blocks) and HSDPA (133 Mbaud, 1 MB buffer).
+ */
+static const io_model_t IO_PRESETS[] = {
+    // 5 ms + 2 ms * sqrt(1905) average arm travel plus 8 ms rotation
+    { "disc",   1000000.0, 0.0005, 0.1003, 4096, 1.0 },
+    { "drum",    256000.0, 0.0,    0.0100, 4096, 1.0 },  // Half a turn at 3000 rpm
+    { "tape",     65536.0, 0.0,    0.2000, 4096, 1.0 },  // Base seek, head already near
+    { "serial",   11520.0, 0.0010, 0.0,    4096, 1.0 },  // 115200 baud, one ACK per block
+    { "hsdpa", 13333333.0, 0.0,    0.0, 1048576, 1.0 },
+};
+
+#define IO_PRESET_COUNT (sizeof(IO_PRESETS) / sizeof(IO_PRESETS[0]))
+#define SIM_RUNS 3  // Repeat each simulation and keep the fastest CPU times
+
+/**
+ * Parse "PRESET[,KEY=VALUE...]" (or only KEY=VALUE pairs on top of disc).
+ * Keys: bw (bytes/s, k/m suffixes), baud, lat and seek (ms), chunk (bytes)
+ * and cpu (multiplier on host decode time, for a slower machine).
+ */
+static int parse_io_model(const char *spec, io_model_t *model) {
+    *model = IO_PRESETS[0];
+    if (!spec || !*spec) return 0;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    int first = 1;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","), first = 0) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            size_t i;
+            for (i = 0; i < IO_PRESET_COUNT; i++) {
+                if (strcmp(tok, IO_PRESETS[i].name) == 0) break;
+            }
+            if (!first || i == IO_PRESET_COUNT) {
+                fprintf(stderr, "Error: Unknown storage device: %s (use disc, drum, tape, serial or hsdpa)\n", tok);
+                return -1;
+            }
+            *model = IO_PRESETS[i];
+            continue;
+        }
+
+        *eq = '\0';
+        char *end;
+        double value = strtod(eq + 1, &end);
+        if (*end == 'k' || *end == 'K') value *= 1e3, end++;
+        else if (*end == 'm' || *end == 'M') value *= 1e6, end++;
+        if (end == eq + 1 || *end || value < 0) {
+            fprintf(stderr, "Error: Bad value for %s: %s\n", tok, eq + 1);
+            return -1;
+        }
+
+        if (strcmp(tok, "bw") == 0) model->bandwidth = value;
+        else if (strcmp(tok, "baud") == 0) model->bandwidth = value / 10.0;
+        else if (strcmp(tok, "lat") == 0) model->latency = value / 1000.0;
+        else if (strcmp(tok, "seek") == 0) model->seek = value / 1000.0;
+        else if (strcmp(tok, "chunk") == 0) model->chunk = (size_t)value;
+        else if (strcmp(tok, "cpu") == 0) model->cpu_scale = value;
+        else {
+            fprintf(stderr, "Error: Unknown storage parameter: %s (use bw, baud, lat, seek, chunk or cpu)\n", tok);
+            return -1;
+        }
+    }
+
+    if (model->bandwidth <= 0 || model->chunk == 0) {
+        fprintf(stderr, "Error: Storage bandwidth and chunk size must be positive\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Seconds until the first bytes of a file_size-byte file have arrived.
+ * Reads go out one after another from the start of the file, each costing
+ * the per-read latency plus its bytes over the bandwidth.
+ */
+static double io_arrival(const io_model_t *m, size_t bytes, size_t file_size) {
+    if (bytes > file_size) bytes = file_size;
+    size_t reads = (bytes + m->chunk - 1) / m->chunk;
+    size_t end = reads * m->chunk;
+    if (end > file_size) end = file_size;
+    return m->seek + reads * m->latency + end / m->bandwidth;
+}
+
+/**
+ * Decompresses an in-memory payload while handing the decompressor only
+ * as many device reads as it has asked for, so fed tells how much of the
+ * file one step of decoding had to wait for.
+ */
+typedef struct {
+    payload_kind_t kind;
+    const uint8_t *payload;
+    size_t payload_size;
+    size_t fed;          // Payload bytes delivered so far
+    size_t in_pos;       // Of those, bytes consumed
+    size_t chunk;
+    ZSTD_DStream *dstream;
+    z_stream zs;
+    int zs_ready;
+} sim_reader_t;
+
+static int sim_reader_init(sim_reader_t *r, const ipf_header_t *header, const uint8_t *payload,
+                           size_t payload_size, size_t chunk) {
+    memset(r, 0, sizeof(*r));
+    r->payload = payload;
+    r->payload_size = payload_size;
+    r->chunk = chunk;
+    r->kind = detect_payload(header, payload, payload_size, payload_size, ipf_blocks_size(header));
+
+    if (r->kind == PAYLOAD_ZSTD) {
+        r->dstream = ZSTD_createDStream();
+        if (!r->dstream) return -1;
+        ZSTD_initDStream(r->dstream);
+    } else if (r->kind == PAYLOAD_GZIP) {
+        if (inflateInit2(&r->zs, 16 + MAX_WBITS) != Z_OK) return -1;
+        r->zs_ready = 1;
+    }
+    return 0;
+}
+
+/**
+ * Deliver up to the end of the next device read.
+ */
+static int sim_reader_feed(sim_reader_t *r) {
+    if (r->fed == r->payload_size) return -1;
+    size_t file_end = (IPF_HEADER_SIZE + r->fed) / r->chunk * r->chunk + r->chunk;
+    r->fed = file_end - IPF_HEADER_SIZE;
+    if (r->fed > r->payload_size) r->fed = r->payload_size;
+    return 0;
+}
+
+static int sim_reader_read(sim_reader_t *r, uint8_t *dst, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        size_t before = done;
+        if (r->kind == PAYLOAD_RAW) {
+            size_t n = r->fed - r->in_pos;
+            if (n > len - done) n = len - done;
+            memcpy(dst + done, r->payload + r->in_pos, n);
+            r->in_pos += n;
+            done += n;
+        } else if (r->kind == PAYLOAD_ZSTD) {
+            ZSTD_outBuffer output = { dst, len, done };
+            ZSTD_inBuffer input = { r->payload, r->fed, r->in_pos };
+            size_t ret = ZSTD_decompressStream(r->dstream, &output, &input);
+            if (ZSTD_isError(ret)) return -1;
+            r->in_pos = input.pos;
+            done = output.pos;
+        } else {
+            r->zs.next_in = (Bytef *)r->payload + r->in_pos;
+            r->zs.avail_in = (uInt)(r->fed - r->in_pos);
+            r->zs.next_out = dst + done;
+            r->zs.avail_out = (uInt)(len - done);
+            int ret = inflate(&r->zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) return -1;
+            r->in_pos = r->fed - r->zs.avail_in;
+            done = len - r->zs.avail_out;
+            if (ret == Z_STREAM_END && done < len) return -1;
+        }
+        // Out of input, or holding a partial frame: wait for the next read
+        if (done < len && (done == before || r->in_pos == r->fed) && sim_reader_feed(r) < 0 && done == before) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void sim_reader_free(sim_reader_t *r) {
+    if (r->dstream) ZSTD_freeDStream(r->dstream);
+    if (r->zs_ready) inflateEnd(&r->zs);
+}
+
+typedef struct {
+    size_t file_size;
+    double io_done;        // Last byte arrived
+    double first_pixels;   // First block row, pass or band shown
+    double first_preview;  // Something shown across the whole frame
+    double full;           // Last pixel decoded
+    double speed_index;    // Integral over time of the frame not yet complete
+    double inflate_cpu;
+    double decode_cpu;
+} io_sim_result_t;
+
+/**
+ * One step of loading: out_bytes more block data, after which the frame is
+ * complete to the given fraction.
+ */
+typedef struct {
+    size_t out_bytes;
+    double complete;
+    int preview;         // The whole frame has something on it from here
+    int pass;            // Adam7 pass, 0 for raster steps
+} sim_step_t;
+
+/**
+ * Split loading into steps: block rows for raster files, Adam7 passes for
+ * progressive ones, 4-pixel bands for indexed. A progressive file's first
+ * pass already covers the whole frame, coarsely, so it counts as half done
+ * from then on and the remaining passes fill in the other half.
+ */
+static sim_step_t *sim_plan(const ipf_header_t *header, size_t *count) {
+    int indexed = header->type == IPF_TYPE_INDEXED;
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    sim_step_t *steps = calloc(blocks_y > 7 ? blocks_y : 7, sizeof(*steps));
+    if (!steps) return NULL;
+    size_t n = 0;
+
+    if (!indexed && (header->flags & IPF_FLAG_PROGRESSIVE)) {
+        size_t pass_blocks[8] = { 0 };
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) pass_blocks[ipf_adam7_pass(bx, by)]++;
+        }
+        size_t total = (size_t)blocks_x * blocks_y, done = 0;
+        for (int pass = 1; pass <= 7; pass++) {
+            if (!pass_blocks[pass]) continue;
+            done += pass_blocks[pass];
+            steps[n].out_bytes = pass_blocks[pass] * ipf_block_size(header);
+            steps[n].complete = 0.5 + 0.5 * done / total;
+            steps[n].preview = 1;
+            steps[n].pass = pass;
+            n++;
+        }
+    } else {
+        for (int by = 0; by < blocks_y; by++) {
+            int rows = header->height - by * 4;
+            if (rows > 4) rows = 4;
+            steps[n].out_bytes = indexed ? (size_t)header->width * rows : (size_t)blocks_x * ipf_block_size(header);
+            steps[n].complete = (double)(by + 1) / blocks_y;
+            steps[n].preview = by == blocks_y - 1;
+            n++;
+        }
+    }
+    *count = n;
+    return steps;
+}
+
+/**
+ * Load a whole iPF file through the storage model: decompress and decode
+ * it for real, step by step, timing the CPU work, and let each step start
+ * once the reads it needed have arrived and the previous step is done.
+ */
+static int simulate_load(const io_model_t *model, const uint8_t *file, size_t file_size, int verbose,
+                         FILE *msg, io_sim_result_t *res) {
+    ipf_header_t header;
+    int err = ipf_parse_header(file, file_size, &header);
+    if (err != IPF_OK) {
+        fprintf(stderr, "Error: %s\n", ipf_strerror(err));
+        return -1;
+    }
+
+    int indexed = header.type == IPF_TYPE_INDEXED;
+    int blocks_x = ipf_blocks_x(&header);
+    int blocks_y = ipf_blocks_y(&header);
+    int block_size = ipf_block_size(&header);
+    int channels = (header.flags & IPF_FLAG_ALPHA) ? 4 : 3;
+    size_t stride = (size_t)blocks_x * 4 * channels;
+
+    size_t count = 0;
+    sim_step_t *steps = sim_plan(&header, &count);
+    size_t out_cap = 0;
+    for (size_t i = 0; steps && i < count; i++) {
+        if (steps[i].out_bytes > out_cap) out_cap = steps[i].out_bytes;
+    }
+    uint8_t *out = malloc(out_cap ? out_cap : 1);
+    uint8_t *image = malloc(stride * blocks_y * 4);
+    uint32_t *order = NULL;
+    if (!indexed && (header.flags & IPF_FLAG_PROGRESSIVE)) {
+        order = malloc((size_t)blocks_x * blocks_y * sizeof(*order));
+        if (order) ipf_adam7_order(blocks_x, blocks_y, order);
+    }
+    if (!steps || !out || !image || ((header.flags & IPF_FLAG_PROGRESSIVE) && !indexed && !order)) {
+        fprintf(stderr, "Error: Failed to allocate simulation buffers\n");
+        free(steps);
+        free(out);
+        free(image);
+        free(order);
+        return -1;
+    }
+
+    int result = 0;
+    double best_cpu = -1;
+    for (int run = 0; run < SIM_RUNS && result == 0; run++) {
+        sim_reader_t reader;
+        if (sim_reader_init(&reader, &header, file + IPF_HEADER_SIZE, file_size - IPF_HEADER_SIZE,
+                            model->chunk) < 0) {
+            fprintf(stderr, "Error: Failed to allocate decompression stream\n");
+            result = -1;
+            break;
+        }
+
+        io_sim_result_t r;
+        memset(&r, 0, sizeof(r));
+        r.file_size = file_size;
+        r.io_done = io_arrival(model, file_size, file_size);
+        r.first_preview = -1;
+        double clock = io_arrival(model, IPF_HEADER_SIZE, file_size);
+        double shown = 0, shown_at = 0;
+        size_t block_index = 0;
+        int row = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t t0 = ipf_stats_now();
+            if (sim_reader_read(&reader, out, steps[i].out_bytes) < 0) {
+                fprintf(stderr, "Error: Truncated or corrupt block data\n");
+                result = -1;
+                break;
+            }
+            uint64_t t1 = ipf_stats_now();
+
+            if (indexed) {
+                ipf_header_t band = header;
+                band.height = (uint16_t)(steps[i].out_bytes / header.width);
+                ipf_decode_image(&band, out, IPF_PIXELS_RGB, image + (size_t)row * stride, stride);
+                row += band.height;
+            } else if (order) {
+                for (size_t b = 0; b < steps[i].out_bytes / block_size; b++, block_index++) {
+                    uint32_t at = order[block_index];
+                    ipf_decode_block(&header, out + b * block_size, IPF_PIXELS_RGB,
+                                     image + (at / blocks_x) * 4 * stride + (at % blocks_x) * 4 * channels, stride);
+                }
+            } else {
+                ipf_decode_block_row(&header, IPF_PIXELS_RGB, out, image + (size_t)row * stride, stride);
+                row += 4;
+            }
+            uint64_t t2 = ipf_stats_now();
+
+            double inflate = (t1 - t0) / 1e9 * model->cpu_scale;
+            double decode = (t2 - t1) / 1e9 * model->cpu_scale;
+            double ready = io_arrival(model, IPF_HEADER_SIZE + reader.fed, file_size);
+            double start = clock > ready ? clock : ready;
+            clock = start + inflate + decode;
+            r.inflate_cpu += inflate;
+            r.decode_cpu += decode;
+
+            r.speed_index += (1.0 - shown) * (clock - shown_at);
+            shown = steps[i].complete;
+            shown_at = clock;
+            if (i == 0) r.first_pixels = clock;
+            if (steps[i].preview && r.first_preview < 0) r.first_preview = clock;
+
+            if (verbose && run == 0) {
+                fprintf(msg, "  %s %-3zu %8zu bytes read by %8.2f ms, shown at %8.2f ms (%3.0f%%)\n",
+                        steps[i].pass ? "pass" : "step", steps[i].pass ? (size_t)steps[i].pass : i,
+                        IPF_HEADER_SIZE + reader.fed, ready * 1e3, clock * 1e3, shown * 100);
+            }
+        }
+        r.full = clock;
+        sim_reader_free(&reader);
+
+        double cpu = r.inflate_cpu + r.decode_cpu;
+        if (result == 0 && (best_cpu < 0 || cpu < best_cpu)) {
+            best_cpu = cpu;
+            *res = r;
+        }
+    }
+
+    free(steps);
+    free(out);
+    free(image);
+    free(order);
+    return result;
+}
+
+static void describe_layout(const ipf_header_t *header, payload_kind_t kind, int zstd_level, int flushed,
+                            char *buf, size_t size) {
+    const char *type = header->type == IPF_TYPE_INDEXED ? "indexed" : header->type == IPF_TYPE_2 ? "iPF2" : "iPF1";
+    char packing[32] = "raw";
+    if (kind == PAYLOAD_GZIP) snprintf(packing, sizeof(packing), "gzip");
+    else if (zstd_level > 0) snprintf(packing, sizeof(packing), "zstd %d", zstd_level);
+    else if (kind == PAYLOAD_ZSTD) snprintf(packing, sizeof(packing), "zstd");
+    snprintf(buf, size, "%s%s, %s%s", type, (header->flags & IPF_FLAG_ALPHA) ? "+alpha" : "", packing,
+             !(header->flags & IPF_FLAG_PROGRESSIVE) ? "" : flushed ? ", progressive, flushed" : ", progressive");
+}
+
+static void print_io_model(FILE *msg, const io_model_t *m) {
+    fprintf(msg, "Storage: %s, %.1f kB/s, %zu-byte reads, %.2f ms per read, %.1f ms seek", m->name,
+            m->bandwidth / 1e3, m->chunk, m->latency * 1e3, m->seek * 1e3);
+    if (m->cpu_scale != 1.0) fprintf(msg, ", CPU x%g", m->cpu_scale);
+    fprintf(msg, "\n");
+}
+
+static int read_whole_file(const char *path, uint8_t **data, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open input file: %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(fp), &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: %s is not a regular file\n", path);
+        fclose(fp);
+        return -1;
+    }
+    *size = (size_t)st.st_size;
+    *data = malloc(*size ? *size : 1);
+    if (!*data || fread(*data, 1, *size, fp) != *size) {
+        fprintf(stderr, "Error: Failed to read input file: %s\n", path);
+        free(*data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * A layout --sweep tries, and how it fared.
+ */
+typedef struct {
+    ipf_header_t header;
+    payload_kind_t kind;
+    int zstd_level;          // 0 for raw blocks, -1 for the input file as it is
+    int flush_passes;        // End a Zstd block after every Adam7 pass
+    io_sim_result_t sim;
+} sweep_entry_t;
+
+static const int SWEEP_ZSTD_LEVELS[] = { 1, 3, 7, 19 };
+#define SWEEP_LEVEL_COUNT (sizeof(SWEEP_ZSTD_LEVELS) / sizeof(SWEEP_ZSTD_LEVELS[0]))
+
+static int compare_sweep(const void *a, const void *b) {
+    double x = ((const sweep_entry_t *)a)->sim.speed_index;
+    double y = ((const sweep_entry_t *)b)->sim.speed_index;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Compress progressive blocks as one Zstd frame, flushed at the end of
+ * every Adam7 pass. A one-shot frame of a small image is a single Zstd
+ * block that decompresses only once all of it has arrived, which leaves
+ * nothing for the early passes to show; flushing lets each pass decode as
+ * soon as its own bytes are in. Any Zstd decoder reads the result.
+ */
+static size_t compress_flushing_passes(const ipf_header_t *header, const uint8_t *blocks, uint8_t *dst,
+                                       size_t dst_cap, int level) {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (!cctx) return (size_t)-1;
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+
+    size_t pass_blocks[8] = { 0 };
+    for (int by = 0; by < ipf_blocks_y(header); by++) {
+        for (int bx = 0; bx < ipf_blocks_x(header); bx++) pass_blocks[ipf_adam7_pass(bx, by)]++;
+    }
+
+    ZSTD_outBuffer out = { dst, dst_cap, 0 };
+    size_t offset = 0, ret = 0;
+    for (int pass = 1; pass <= 7 && !ZSTD_isError(ret); pass++) {
+        size_t len = pass_blocks[pass] * ipf_block_size(header);
+        ZSTD_inBuffer in = { blocks + offset, len, 0 };
+        ZSTD_EndDirective mode = pass == 7 ? ZSTD_e_end : ZSTD_e_flush;
+        do {
+            ret = ZSTD_compressStream2(cctx, &out, &in, mode);
+        } while (!ZSTD_isError(ret) && ret != 0);
+        offset += len;
+    }
+
+    ZSTD_freeCCtx(cctx);
+    return ZSTD_isError(ret) ? ret : out.pos;
+}
+
+/**
+ * Encode the decoded image in one layout and load it through the model.
+ */
+static int sweep_try(const decoder_config_t *cfg, const uint8_t *image, size_t stride, int channels,
+                     sweep_entry_t *e) {
+    size_t blocks_size = ipf_blocks_size(&e->header);
+    uint8_t *blocks = malloc(blocks_size);
+    uint8_t *file = malloc(IPF_HEADER_SIZE + ZSTD_compressBound(blocks_size));
+    int result = blocks && file ? 0 : -1;
+
+    if (result == 0) result = ipf_encode_image(&e->header, image, stride, channels, -1, blocks) == IPF_OK ? 0 : -1;
+    size_t payload = blocks_size;
+    if (result == 0 && e->flush_passes) {
+        payload = compress_flushing_passes(&e->header, blocks, file + IPF_HEADER_SIZE,
+                                           ZSTD_compressBound(blocks_size), e->zstd_level);
+        if (ZSTD_isError(payload)) result = -1;
+    } else if (result == 0 && e->zstd_level > 0) {
+        payload = ZSTD_compress(file + IPF_HEADER_SIZE, ZSTD_compressBound(blocks_size), blocks, blocks_size,
+                                e->zstd_level);
+        if (ZSTD_isError(payload)) result = -1;
+    } else if (result == 0) {
+        memcpy(file + IPF_HEADER_SIZE, blocks, blocks_size);
+    }
+    if (result == 0) {
+        e->header.uncompressed_size = (uint32_t)blocks_size;
+        ipf_write_header(&e->header, file);
+        result = simulate_load(&cfg->io_model, file, IPF_HEADER_SIZE + payload, 0, cfg->msg, &e->sim);
+    } else {
+        fprintf(stderr, "Error: Failed to encode a sweep candidate\n");
+    }
+
+    free(blocks);
+    free(file);
+    return result;
+}
+
+/**
+ * Re-encode the input in every block type, packing and ordering (raw,
+ * Zstd at several levels, progressive at the same levels, one-shot and
+ * flushed per pass) and rank them
+ * by speed index. The candidates start from the input's decoded pixels, so
+ * they carry its quantisation; only their layout differs.
+ */
+static int simulate_sweep(const decoder_config_t *cfg, const uint8_t *file, size_t file_size,
+                          const io_sim_result_t *input_sim) {
+    ipf_header_t header;
+    ipf_parse_header(file, file_size, &header);
+    int has_alpha = (header.flags & IPF_FLAG_ALPHA) != 0;
+    int channels = has_alpha ? 4 : 3;
+    size_t stride = (size_t)ipf_blocks_x(&header) * 4 * channels;
+    size_t blocks_size = ipf_blocks_size(&header);
+
+    uint8_t *blocks = malloc(blocks_size ? blocks_size : 1);
+    uint8_t *image = calloc((size_t)ipf_blocks_y(&header) * 4, stride);
+    size_t variants = 1 + 3 * SWEEP_LEVEL_COUNT;
+    size_t max_entries = 1 + 2 * variants;
+    sweep_entry_t *entries = calloc(max_entries, sizeof(*entries));
+    sim_reader_t reader;
+    int result = blocks && image && entries ? 0 : -1;
+    if (result == 0) {
+        result = sim_reader_init(&reader, &header, file + IPF_HEADER_SIZE, file_size - IPF_HEADER_SIZE,
+                                 (size_t)-1 / 2);
+        if (result == 0) result = sim_reader_read(&reader, blocks, blocks_size);
+        sim_reader_free(&reader);
+    }
+    if (result < 0) {
+        fprintf(stderr, "Error: Failed to decode the input for the sweep\n");
+        free(blocks);
+        free(image);
+        free(entries);
+        return -1;
+    }
+    ipf_decode_image(&header, blocks, IPF_PIXELS_RGB, image, stride);
+    free(blocks);
+
+    size_t n = 0;
+    entries[n].header = header;
+    entries[n].kind = reader.kind;
+    entries[n].zstd_level = -1;
+    entries[n].sim = *input_sim;
+    n++;
+
+    for (int type = IPF_TYPE_1; type <= IPF_TYPE_2 && result == 0; type++) {
+        for (size_t v = 0; v < variants && result == 0; v++) {
+            sweep_entry_t *e = &entries[n];
+            e->header.width = header.width;
+            e->header.height = header.height;
+            e->header.type = (uint8_t)type;
+            e->header.flags = has_alpha ? IPF_FLAG_ALPHA : 0;
+            e->zstd_level = v == 0 ? 0 : SWEEP_ZSTD_LEVELS[(v - 1) % SWEEP_LEVEL_COUNT];
+            e->kind = v == 0 ? PAYLOAD_RAW : PAYLOAD_ZSTD;
+            if (v > 0) e->header.flags |= IPF_FLAG_ZSTD;
+            if (v > SWEEP_LEVEL_COUNT) e->header.flags |= IPF_FLAG_PROGRESSIVE;
+            e->flush_passes = v > 2 * SWEEP_LEVEL_COUNT;
+            result = sweep_try(cfg, image, stride, channels, e);
+            n++;
+        }
+    }
+    free(image);
+
+    if (result == 0) {
+        qsort(entries, n, sizeof(*entries), compare_sweep);
+        fprintf(cfg->msg, "\nLayouts ranked by speed index (ms):\n");
+        fprintf(cfg->msg, "  %-4s %-40s %9s %9s %9s %9s %9s\n", "rank", "layout", "bytes", "first", "preview",
+                "full", "index");
+        for (size_t i = 0; i < n; i++) {
+            char layout[64];
+            describe_layout(&entries[i].header, entries[i].kind, entries[i].zstd_level, entries[i].flush_passes,
+                            layout, sizeof(layout));
+            if (entries[i].zstd_level < 0) {
+                size_t len = strlen(layout);
+                snprintf(layout + len, sizeof(layout) - len, " (input)");
+            }
+            const io_sim_result_t *r = &entries[i].sim;
+            fprintf(cfg->msg, "  %-4zu %-40s %9zu %9.2f %9.2f %9.2f %9.2f\n", i + 1, layout, r->file_size,
+                    r->first_pixels * 1e3, r->first_preview * 1e3, r->full * 1e3, r->speed_index * 1e3);
+        }
+    }
+
+    free(entries);
+    return result;
+}
 
-// =============================================================================
-// Constants
-// =============================================================================
+/**
+ * --simulate-io: report how long the input takes to appear when loaded from
+ * the modelled device, and with --sweep how other layouts would compare.
+ */
+static int simulate_io(const decoder_config_t *cfg) {
+    uint8_t *file;
+    size_t file_size;
+    if (read_whole_file(cfg->input_file, &file, &file_size) < 0) return -1;
+
+    ipf_header_t header;
+    int err = ipf_parse_header(file, file_size, &header);
+    if (err != IPF_OK) {
+        fprintf(stderr, "Error: %s\n", ipf_strerror(err));
+        free(file);
+        return -1;
+    }
 
-#define IPF_MAGIC "\x1F\x54\x53\x56\x4D\x69\x50\x46"  // "\x1FTSVMiPF"
-#define IPF_HEADER_SIZE 28  // 8 magic + 2 width + 2 height + 1 flags + 1 type + 10 reserved + 4 uncompressed
+    char layout[64];
+    payload_kind_t kind = detect_payload(&header, file + IPF_HEADER_SIZE, file_size - IPF_HEADER_SIZE,
+                                         file_size - IPF_HEADER_SIZE, ipf_blocks_size(&header));
+    describe_layout(&header, kind, 0, 0, layout, sizeof(layout));
+    print_io_model(cfg->msg, &cfg->io_model);
+    fprintf(cfg->msg, "Input: %s, %dx%d, %zu bytes (%s)\n", cfg->input_file, header.width, header.height,
+            file_size, layout);
 
-#define IPF_TYPE_1 0  // 4:2:0 chroma subsampling
-#define IPF_TYPE_2 1  // 4:2:2 chroma subsampling
+    io_sim_result_t sim;
+    int result = simulate_load(&cfg->io_model, file, file_size, cfg->verbose, cfg->msg, &sim);
+    if (result == 0) {
+        fprintf(cfg->msg, "  Last byte read:  %9.2f ms\n", sim.io_done * 1e3);
+        fprintf(cfg->msg, "  First pixels:    %9.2f ms\n", sim.first_pixels * 1e3);
+        fprintf(cfg->msg, "  First preview:   %9.2f ms%s\n", sim.first_preview * 1e3,
+                (header.flags & IPF_FLAG_PROGRESSIVE) ? "" : " (not progressive: the full image)");
+        fprintf(cfg->msg, "  Full image:      %9.2f ms\n", sim.full * 1e3);
+        fprintf(cfg->msg, "  Speed index:     %9.2f ms\n", sim.speed_index * 1e3);
+        fprintf(cfg->msg, "  CPU inflate:     %9.3f ms\n", sim.inflate_cpu * 1e3);
+        fprintf(cfg->msg, "  CPU decode:      %9.3f ms\n", sim.decode_cpu * 1e3);
+    }
 
-#define IPF_FLAG_ALPHA       0x01
-#define IPF_FLAG_ZSTD        0x10
-#define IPF_FLAG_PROGRESSIVE 0x80
+    if (result == 0 && cfg->sweep) result = simulate_sweep(cfg, file, file_size, &sim);
 
-#define MAX_PATH 4096
+    free(file);
+    return result;
+}
 
 // =============================================================================
-// Structures
+// Batch Decoding
 // =============================================================================
 
 typedef struct {
-    uint16_t width;
-    uint16_t height;
-    uint8_t flags;
-    uint8_t type;
-    uint32_t uncompressed_size;
-} ipf_header_t;
+    char *path;
+    const char *rel;  // Path relative to the batch root, used for export names
+} batch_file_t;
 
 typedef struct {
-    char *input_file;
-    char *output_file;
-    int verbose;
-    int raw_output;  // Output raw RGB instead of using FFmpeg
-} decoder_config_t;
+    batch_file_t *items;
+    size_t count;
+    size_t capacity;
+} batch_list_t;
 
-// =============================================================================
-// Utility Functions
-// =============================================================================
+typedef struct {
+    size_t files_ok;
+    size_t files_failed;
+    uint64_t bytes_in;      // Mapped file bytes
+    uint64_t bytes_blocks;  // Block data after decompression
+    uint64_t pixels;
+} batch_stats_t;
 
-static void print_usage(const char *program) {
-    printf("iPF Decoder - TSVM Interchangeable Picture Format\n");
-    printf("\nUsage: %s -i input.ipf -o output.png [options]\n\n", program);
-    printf("Required:\n");
-    printf("  -i, --input FILE         Input iPF file\n");
-    printf("  -o, --output FILE        Output image file (any format FFmpeg supports)\n");
-    printf("\nOptions:\n");
-    printf("  --raw                    Output raw RGB24/RGBA data instead of image file\n");
-    printf("  -v, --verbose            Verbose output\n");
-    printf("  -h, --help               Show this help\n");
-    printf("\nExamples:\n");
-    printf("  %s -i photo.ipf -o photo.png\n", program);
-    printf("  %s -i logo.ipf -o logo.jpg -v\n", program);
-}
+typedef struct {
+    const decoder_config_t *cfg;
+    const batch_list_t *list;
+    image_format_t fmt;
+    const char *ext;  // Export file extension
+    size_t next;      // Next file index, claimed atomically by workers
+} batch_t;
+
+/**
+ * Per-thread state. Decompression contexts and buffers live as long as the
+ * worker and are reused for every file it picks up.
+ */
+typedef struct {
+    batch_t *batch;
+    pthread_t thread;
+    ZSTD_DCtx *dctx;
+    z_stream zs;
+    int zs_ready;
+    uint8_t *block_buf;
+    size_t block_cap;
+    uint8_t *band;
+    size_t band_cap;
+    batch_stats_t stats;
+    ipf_stats_t timing;  // Merged into cfg->stats when it is set
+} batch_worker_t;
+
+static int batch_list_add(batch_list_t *list, const char *path, size_t root_len) {
+    if (list->count == list->capacity) {
+        size_t cap = list->capacity ? list->capacity * 2 : 64;
+        batch_file_t *items = realloc(list->items, cap * sizeof(*items));
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = cap;
+    }
 
-static float clampf(float v, float lo, float hi) {
-    return v < lo ? lo : (v > hi ? hi : v);
+    char *copy = strdup(path);
+    if (!copy) return -1;
+
+    const char *rel = copy + root_len;
+    while (*rel == '/') rel++;
+    if (root_len == 0) {
+        // Flat sources keep only the file name
+        const char *slash = strrchr(copy, '/');
+        if (slash) rel = slash + 1;
+    }
+
+    list->items[list->count].path = copy;
+    list->items[list->count].rel = rel;
+    list->count++;
+    return 0;
 }
 
-// =============================================================================
-// iPF File Reading
-// =============================================================================
+static void batch_list_free(batch_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->items[i].path);
+    free(list->items);
+}
 
-static int read_ipf_header(FILE *fp, ipf_header_t *header) {
-    uint8_t magic[8];
+static int compare_batch_files(const void *a, const void *b) {
+    return strcmp(((const batch_file_t *)a)->path, ((const batch_file_t *)b)->path);
+}
 
-    if (fread(magic, 1, 8, fp) != 8) {
-        fprintf(stderr, "Error: Failed to read magic\n");
-        return -1;
+/**
+ * True for .ipf, .ipf1, .ipf2 and similar extensions.
+ */
+static int has_ipf_extension(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot || strncasecmp(dot + 1, "ipf", 3) != 0) return 0;
+    for (const char *c = dot + 4; *c; c++) {
+        if (*c < '0' || *c > '9') return 0;
     }
+    return 1;
+}
 
-    if (memcmp(magic, IPF_MAGIC, 8) != 0) {
-        fprintf(stderr, "Error: Invalid iPF magic\n");
+static int scan_directory(batch_list_t *list, const char *dir, size_t root_len) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: Cannot open directory %s: %s\n", dir, strerror(errno));
         return -1;
     }
 
-    // Read width (uint16 LE)
-    if (fread(&header->width, 2, 1, fp) != 1) return -1;
+    int result = 0;
+    struct dirent *ent;
+    char path[MAX_PATH];
+
+    while (result == 0 && (ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
 
-    // Read height (uint16 LE)
-    if (fread(&header->height, 2, 1, fp) != 1) return -1;
+        struct stat st;
+        if (stat(path, &st) < 0) continue;
 
-    // Read flags
-    if (fread(&header->flags, 1, 1, fp) != 1) return -1;
+        if (S_ISDIR(st.st_mode)) {
+            result = scan_directory(list, path, root_len);
+        } else if (S_ISREG(st.st_mode) && has_ipf_extension(ent->d_name)) {
+            result = batch_list_add(list, path, root_len);
+        }
+    }
 
-    // Read type
-    if (fread(&header->type, 1, 1, fp) != 1) return -1;
+    closedir(d);
+    return result;
+}
 
-    // Skip reserved (10 bytes)
-    fseek(fp, 10, SEEK_CUR);
+/**
+ * Collect batch inputs. A directory is searched recursively for iPF files,
+ * a pattern containing wildcards is expanded with glob(3), and anything else
+ * is read as a list file with one path per line ('#' starts a comment).
+ */
+static int collect_batch_inputs(const char *source, batch_list_t *list) {
+    struct stat st;
+    int result = 0;
 
-    // Read uncompressed size (uint32 LE)
-    if (fread(&header->uncompressed_size, 4, 1, fp) != 1) return -1;
+    if (stat(source, &st) == 0 && S_ISDIR(st.st_mode)) {
+        size_t root_len = strlen(source);
+        while (root_len > 1 && source[root_len - 1] == '/') root_len--;
+        char root[MAX_PATH];
+        snprintf(root, sizeof(root), "%.*s", (int)root_len, source);
+        result = scan_directory(list, root, root_len);
+    } else if (strpbrk(source, "*?[")) {
+        glob_t g;
+        int ret = glob(source, 0, NULL, &g);
+        if (ret != 0 && ret != GLOB_NOMATCH) {
+            fprintf(stderr, "Error: Failed to expand pattern: %s\n", source);
+            return -1;
+        }
+        for (size_t i = 0; ret == 0 && i < g.gl_pathc && result == 0; i++) {
+            result = batch_list_add(list, g.gl_pathv[i], 0);
+        }
+        if (ret == 0) globfree(&g);
+    } else {
+        FILE *fp = fopen(source, "r");
+        if (!fp) {
+            fprintf(stderr, "Error: Failed to open batch list: %s\n", source);
+            return -1;
+        }
+        char line[MAX_PATH];
+        while (result == 0 && fgets(line, sizeof(line), fp)) {
+            char *start = line;
+            while (*start == ' ' || *start == '\t') start++;
+            size_t len = strlen(start);
+            while (len > 0 && (start[len - 1] == '\n' || start[len - 1] == '\r' ||
+                               start[len - 1] == ' ' || start[len - 1] == '\t')) {
+                start[--len] = '\0';
+            }
+            if (len == 0 || start[0] == '#') continue;
+            result = batch_list_add(list, start, 0);
+        }
+        fclose(fp);
+    }
 
+    if (result < 0) return -1;
+    if (list->count > 1) qsort(list->items, list->count, sizeof(batch_file_t), compare_batch_files);
     return 0;
 }
 
-// =============================================================================
-// YCoCg to RGB Conversion
-// =============================================================================
-
 /**
- * Convert YCoCg to RGB for 4 pixels sharing the same chroma.
- * y_values: 4 Y values packed as nibbles (Y0|Y1 in low byte, Y2|Y3 in high byte style)
- * a_values: 4 alpha values packed similarly
- * co, cg: 4-bit chroma values [0..15]
- *
- * Output: fills rgb array with R,G,B[,A] values for 4 pixels
- */
-static void ycocg_to_rgb_quad(int co, int cg, int y0, int y1, int y2, int y3,
-                              int a0, int a1, int a2, int a3,
-                              int has_alpha, uint8_t *rgb) {
-    // Convert chroma from [0..15] to [-1..1]
-    float co_f = (co - 7) / 8.0f;
-    float cg_f = (cg - 7) / 8.0f;
-
-    int ys[4] = {y0, y1, y2, y3};
-    int as[4] = {a0, a1, a2, a3};
-
-    int stride = has_alpha ? 4 : 3;
-
-    for (int i = 0; i < 4; i++) {
-        float y = ys[i] / 15.0f;
-
-        // YCoCg to RGB conversion
-        float tmp = y - cg_f / 2.0f;
-        float g = clampf(cg_f + tmp, 0.0f, 1.0f);
-        float b = clampf(tmp - co_f / 2.0f, 0.0f, 1.0f);
-        float r = clampf(b + co_f, 0.0f, 1.0f);
-
-        rgb[i * stride + 0] = (uint8_t)(r * 255.0f + 0.5f);
-        rgb[i * stride + 1] = (uint8_t)(g * 255.0f + 0.5f);
-        rgb[i * stride + 2] = (uint8_t)(b * 255.0f + 0.5f);
-
-        if (has_alpha) {
-            rgb[i * stride + 3] = (uint8_t)(as[i] * 17);  // Scale 0-15 to 0-255
-        }
-    }
-}
-
-/**
- * Decode iPF1 block (4:2:0 chroma subsampling).
- * Input: 12 bytes (or 20 with alpha)
- * Output: 16 pixels in RGB24/RGBA format
- */
-static void decode_ipf1_block(const uint8_t *block, int has_alpha, uint8_t *pixels, int stride) {
-    // Read chroma (4 values for 2x2 regions)
-    int co1 = block[0] & 0x0F;
-    int co2 = (block[0] >> 4) & 0x0F;
-    int co3 = block[1] & 0x0F;
-    int co4 = (block[1] >> 4) & 0x0F;
-
-    int cg1 = block[2] & 0x0F;
-    int cg2 = (block[2] >> 4) & 0x0F;
-    int cg3 = block[3] & 0x0F;
-    int cg4 = (block[3] >> 4) & 0x0F;
-
-    // Read Y values (16 values)
-    // Layout: [Y1|Y0|Y5|Y4], [Y3|Y2|Y7|Y6], [Y9|Y8|YD|YC], [YB|YA|YF|YE]
-    int Y[16];
-    Y[0] = block[4] & 0x0F;
-    Y[1] = (block[4] >> 4) & 0x0F;
-    Y[4] = block[5] & 0x0F;
-    Y[5] = (block[5] >> 4) & 0x0F;
-    Y[2] = block[6] & 0x0F;
-    Y[3] = (block[6] >> 4) & 0x0F;
-    Y[6] = block[7] & 0x0F;
-    Y[7] = (block[7] >> 4) & 0x0F;
-    Y[8] = block[8] & 0x0F;
-    Y[9] = (block[8] >> 4) & 0x0F;
-    Y[12] = block[9] & 0x0F;
-    Y[13] = (block[9] >> 4) & 0x0F;
-    Y[10] = block[10] & 0x0F;
-    Y[11] = (block[10] >> 4) & 0x0F;
-    Y[14] = block[11] & 0x0F;
-    Y[15] = (block[11] >> 4) & 0x0F;
-
-    // Read alpha values if present
-    int A[16];
-    if (has_alpha) {
-        A[0] = block[12] & 0x0F;
-        A[1] = (block[12] >> 4) & 0x0F;
-        A[4] = block[13] & 0x0F;
-        A[5] = (block[13] >> 4) & 0x0F;
-        A[2] = block[14] & 0x0F;
-        A[3] = (block[14] >> 4) & 0x0F;
-        A[6] = block[15] & 0x0F;
-        A[7] = (block[15] >> 4) & 0x0F;
-        A[8] = block[16] & 0x0F;
-        A[9] = (block[16] >> 4) & 0x0F;
-        A[12] = block[17] & 0x0F;
-        A[13] = (block[17] >> 4) & 0x0F;
-        A[10] = block[18] & 0x0F;
-        A[11] = (block[18] >> 4) & 0x0F;
-        A[14] = block[19] & 0x0F;
-        A[15] = (block[19] >> 4) & 0x0F;
-    } else {
-        for (int i = 0; i < 16; i++) A[i] = 15;
+ * Create every missing directory leading up to the file at path.
+ */
+static int make_parent_dirs(const char *path) {
+    char buf[MAX_PATH];
+    snprintf(buf, sizeof(buf), "%s", path);
+
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Error: Cannot create directory %s: %s\n", buf, strerror(errno));
+            return -1;
+        }
+        *p = '/';
     }
+    return 0;
+}
 
-    int channels = has_alpha ? 4 : 3;
-    uint8_t quad[16];  // 4 pixels max
-
-    // Decode 4 quads (2x2 regions), each sharing one chroma pair
-    // Top-left quad (pixels 0,1,4,5) uses co1/cg1
-    ycocg_to_rgb_quad(co1, cg1, Y[0], Y[1], Y[4], Y[5], A[0], A[1], A[4], A[5], has_alpha, quad);
-    memcpy(pixels + 0 * stride + 0 * channels, quad + 0 * channels, channels);
-    memcpy(pixels + 0 * stride + 1 * channels, quad + 1 * channels, channels);
-    memcpy(pixels + 1 * stride + 0 * channels, quad + 2 * channels, channels);
-    memcpy(pixels + 1 * stride + 1 * channels, quad + 3 * channels, channels);
-
-    // Top-right quad (pixels 2,3,6,7) uses co2/cg2
-    ycocg_to_rgb_quad(co2, cg2, Y[2], Y[3], Y[6], Y[7], A[2], A[3], A[6], A[7], has_alpha, quad);
-    memcpy(pixels + 0 * stride + 2 * channels, quad + 0 * channels, channels);
-    memcpy(pixels + 0 * stride + 3 * channels, quad + 1 * channels, channels);
-    memcpy(pixels + 1 * stride + 2 * channels, quad + 2 * channels, channels);
-    memcpy(pixels + 1 * stride + 3 * channels, quad + 3 * channels, channels);
-
-    // Bottom-left quad (pixels 8,9,12,13) uses co3/cg3
-    ycocg_to_rgb_quad(co3, cg3, Y[8], Y[9], Y[12], Y[13], A[8], A[9], A[12], A[13], has_alpha, quad);
-    memcpy(pixels + 2 * stride + 0 * channels, quad + 0 * channels, channels);
-    memcpy(pixels + 2 * stride + 1 * channels, quad + 1 * channels, channels);
-    memcpy(pixels + 3 * stride + 0 * channels, quad + 2 * channels, channels);
-    memcpy(pixels + 3 * stride + 1 * channels, quad + 3 * channels, channels);
-
-    // Bottom-right quad (pixels 10,11,14,15) uses co4/cg4
-    ycocg_to_rgb_quad(co4, cg4, Y[10], Y[11], Y[14], Y[15], A[10], A[11], A[14], A[15], has_alpha, quad);
-    memcpy(pixels + 2 * stride + 2 * channels, quad + 0 * channels, channels);
-    memcpy(pixels + 2 * stride + 3 * channels, quad + 1 * channels, channels);
-    memcpy(pixels + 3 * stride + 2 * channels, quad + 2 * channels, channels);
-    memcpy(pixels + 3 * stride + 3 * channels, quad + 3 * channels, channels);
-}
-
-/**
- * Decode iPF2 block (4:2:2 chroma subsampling).
- * Input: 16 bytes (or 24 with alpha)
- * Output: 16 pixels in RGB24/RGBA format
- */
-static void decode_ipf2_block(const uint8_t *block, int has_alpha, uint8_t *pixels, int stride) {
-    // Read chroma (8 values for horizontal pairs)
-    int co[8], cg[8];
-    co[0] = block[0] & 0x0F;
-    co[1] = (block[0] >> 4) & 0x0F;
-    co[2] = block[1] & 0x0F;
-    co[3] = (block[1] >> 4) & 0x0F;
-    co[4] = block[2] & 0x0F;
-    co[5] = (block[2] >> 4) & 0x0F;
-    co[6] = block[3] & 0x0F;
-    co[7] = (block[3] >> 4) & 0x0F;
-
-    cg[0] = block[4] & 0x0F;
-    cg[1] = (block[4] >> 4) & 0x0F;
-    cg[2] = block[5] & 0x0F;
-    cg[3] = (block[5] >> 4) & 0x0F;
-    cg[4] = block[6] & 0x0F;
-    cg[5] = (block[6] >> 4) & 0x0F;
-    cg[6] = block[7] & 0x0F;
-    cg[7] = (block[7] >> 4) & 0x0F;
-
-    // Read Y values (16 values) - same layout as iPF1
-    int Y[16];
-    Y[0] = block[8] & 0x0F;
-    Y[1] = (block[8] >> 4) & 0x0F;
-    Y[4] = block[9] & 0x0F;
-    Y[5] = (block[9] >> 4) & 0x0F;
-    Y[2] = block[10] & 0x0F;
-    Y[3] = (block[10] >> 4) & 0x0F;
-    Y[6] = block[11] & 0x0F;
-    Y[7] = (block[11] >> 4) & 0x0F;
-    Y[8] = block[12] & 0x0F;
-    Y[9] = (block[12] >> 4) & 0x0F;
-    Y[12] = block[13] & 0x0F;
-    Y[13] = (block[13] >> 4) & 0x0F;
-    Y[10] = block[14] & 0x0F;
-    Y[11] = (block[14] >> 4) & 0x0F;
-    Y[14] = block[15] & 0x0F;
-    Y[15] = (block[15] >> 4) & 0x0F;
-
-    // Read alpha values if present
-    int A[16];
-    if (has_alpha) {
-        A[0] = block[16] & 0x0F;
-        A[1] = (block[16] >> 4) & 0x0F;
-        A[4] = block[17] & 0x0F;
-        A[5] = (block[17] >> 4) & 0x0F;
-        A[2] = block[18] & 0x0F;
-        A[3] = (block[18] >> 4) & 0x0F;
-        A[6] = block[19] & 0x0F;
-        A[7] = (block[19] >> 4) & 0x0F;
-        A[8] = block[20] & 0x0F;
-        A[9] = (block[20] >> 4) & 0x0F;
-        A[12] = block[21] & 0x0F;
-        A[13] = (block[21] >> 4) & 0x0F;
-        A[10] = block[22] & 0x0F;
-        A[11] = (block[22] >> 4) & 0x0F;
-        A[14] = block[23] & 0x0F;
-        A[15] = (block[23] >> 4) & 0x0F;
-    } else {
-        for (int i = 0; i < 16; i++) A[i] = 15;
-    }
+/**
+ * Export path for an input: output_dir/rel with a plain .ipf extension swapped
+ * for ext. Numbered extensions are kept (ycocg.ipf1 -> ycocg.ipf1.png)
+ * so that sibling .ipf1/.ipf2 files do not collide.
+ */
+static void batch_output_path(const decoder_config_t *cfg, const char *ext, const char *rel,
+                              char *out, size_t out_size) {
+    const char *dot = strrchr(rel, '.');
+    const char *slash = strrchr(rel, '/');
+    int stem_len = (int)strlen(rel);
+    if (dot && (!slash || dot > slash) && strcasecmp(dot, ".ipf") == 0) stem_len = (int)(dot - rel);
+
+    snprintf(out, out_size, "%s/%.*s.%s", cfg->output_dir, stem_len, rel, ext);
+}
 
-    int channels = has_alpha ? 4 : 3;
+static int ensure_capacity(uint8_t **buf, size_t *cap, size_t need) {
+    if (*cap >= need) return 0;
+    uint8_t *grown = realloc(*buf, need);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = need;
+    return 0;
+}
 
-    // iPF2: 4:2:2 - each horizontal pair shares chroma
-    // Row 0: pixels 0,1 share co[0]/cg[0], pixels 2,3 share co[1]/cg[1]
-    // Row 1: pixels 4,5 share co[2]/cg[2], pixels 6,7 share co[3]/cg[3]
-    // Row 2: pixels 8,9 share co[4]/cg[4], pixels 10,11 share co[5]/cg[5]
-    // Row 3: pixels 12,13 share co[6]/cg[6], pixels 14,15 share co[7]/cg[7]
-
-    int pixel_map[8][4] = {
-        {0, 1, 0, 1},    // co/cg index 0: pixels 0,1
-        {2, 3, 2, 3},    // co/cg index 1: pixels 2,3
-        {4, 5, 4, 5},    // co/cg index 2: pixels 4,5
-        {6, 7, 6, 7},    // co/cg index 3: pixels 6,7
-        {8, 9, 8, 9},    // co/cg index 4: pixels 8,9
-        {10, 11, 10, 11}, // co/cg index 5: pixels 10,11
-        {12, 13, 12, 13}, // co/cg index 6: pixels 12,13
-        {14, 15, 14, 15}  // co/cg index 7: pixels 14,15
-    };
+/**
+ * Decompress the payload of a mapped file into the worker's block buffer.
+ * Raw payloads are used in place. Returns the block data, or NULL on error.
+ */
+static const uint8_t *batch_unpack_blocks(batch_worker_t *w, const char *path, const ipf_header_t *header,
+                                          const uint8_t *payload, size_t payload_size, size_t raw_size) {
+    payload_kind_t kind = detect_payload(header, payload, payload_size, payload_size, raw_size);
+
+    if (kind == PAYLOAD_RAW) {
+        if (payload_size < raw_size) {
+            fprintf(stderr, "Error: %s: Block data is truncated\n", path);
+            return NULL;
+        }
+        return payload;
+    }
 
-    for (int ci = 0; ci < 8; ci++) {
-        int p0 = pixel_map[ci][0];
-        int p1 = pixel_map[ci][1];
+    if (ensure_capacity(&w->block_buf, &w->block_cap, raw_size) < 0) {
+        fprintf(stderr, "Error: %s: Failed to allocate decompression buffer\n", path);
+        return NULL;
+    }
 
-        uint8_t quad[16];  // 4 pixels max (ycocg_to_rgb_quad writes 4 pixels)
-        ycocg_to_rgb_quad(co[ci], cg[ci], Y[p0], Y[p1], Y[p0], Y[p1],
-                          A[p0], A[p1], A[p0], A[p1], has_alpha, quad);
+    if (kind == PAYLOAD_ZSTD) {
+        // Stream into a buffer of exactly raw_size, so trailing data is ignored
+        ZSTD_DCtx_reset(w->dctx, ZSTD_reset_session_only);
+        ZSTD_outBuffer output = { w->block_buf, raw_size, 0 };
+        ZSTD_inBuffer input = { payload, payload_size, 0 };
+        while (output.pos < output.size) {
+            size_t pos_before = output.pos;
+            size_t ret = ZSTD_decompressStream(w->dctx, &output, &input);
+            if (ZSTD_isError(ret)) {
+                fprintf(stderr, "Error: %s: Zstd decompression failed: %s\n", path, ZSTD_getErrorName(ret));
+                return NULL;
+            }
+            if (output.pos == pos_before && input.pos == input.size) {
+                fprintf(stderr, "Error: %s: Unexpected end of compressed block data\n", path);
+                return NULL;
+            }
+        }
+    } else {
+        if (!w->zs_ready) {
+            if (inflateInit2(&w->zs, 16 + MAX_WBITS) != Z_OK) {
+                fprintf(stderr, "Error: %s: Failed to allocate decompression stream\n", path);
+                return NULL;
+            }
+            w->zs_ready = 1;
+        } else {
+            inflateReset(&w->zs);
+        }
 
-        int row = p0 / 4;
-        int col0 = p0 % 4;
-        int col1 = p1 % 4;
+        w->zs.next_in = (Bytef *)payload;
+        w->zs.avail_in = (uInt)payload_size;
+        w->zs.next_out = w->block_buf;
+        w->zs.avail_out = (uInt)raw_size;
+        int ret = inflate(&w->zs, Z_FINISH);
+        if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) || w->zs.avail_out != 0) {
+            fprintf(stderr, "Error: %s: Gzip decompression failed: %s\n", path,
+                    w->zs.msg ? w->zs.msg : "unexpected end of data");
+            return NULL;
+        }
+    }
 
-        memcpy(pixels + row * stride + col0 * channels, quad + 0 * channels, channels);
-        memcpy(pixels + row * stride + col1 * channels, quad + 1 * channels, channels);
+    w->stats.bytes_blocks += raw_size;
+    if (kind == PAYLOAD_ZSTD) {
+        w->timing.zstd_raw += raw_size;
+        w->timing.zstd_packed += payload_size;
     }
+    return w->block_buf;
 }
 
-// =============================================================================
-// Main Decoding
-// =============================================================================
+/**
+ * Decode one file through the worker's reused contexts. With an output
+ * directory the image is exported, otherwise it is decoded and discarded.
+ */
+static int batch_decode_file(batch_worker_t *w, const batch_file_t *file) {
+    const decoder_config_t *cfg = w->batch->cfg;
+    ipf_stats_t *timing = cfg->stats ? &w->timing : NULL;
+    uint64_t file_start = ipf_stats_start(timing);
+
+    int fd = open(file->path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: %s: %s\n", file->path, strerror(errno));
+        return -1;
+    }
 
-static int decode_ipf(const decoder_config_t *cfg) {
-    FILE *fp = fopen(cfg->input_file, "rb");
-    if (!fp) {
-        fprintf(stderr, "Error: Failed to open input file: %s\n", cfg->input_file);
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < IPF_HEADER_SIZE) {
+        fprintf(stderr, "Error: %s: File too short for an iPF header\n", file->path);
+        close(fd);
         return -1;
     }
 
-    // Read header
-    ipf_header_t header;
-    if (read_ipf_header(fp, &header) < 0) {
-        fclose(fp);
+    size_t file_size = (size_t)st.st_size;
+    uint8_t *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: %s: mmap failed: %s\n", file->path, strerror(errno));
         return -1;
     }
+    madvise(map, file_size, MADV_SEQUENTIAL);
+    w->stats.bytes_in += file_size;
+    w->timing.bytes_in += file_size;
 
-    int has_alpha = (header.flags & IPF_FLAG_ALPHA) != 0;
-    int use_zstd = (header.flags & IPF_FLAG_ZSTD) != 0;
-    int progressive = (header.flags & IPF_FLAG_PROGRESSIVE) != 0;
+    int result = -1;
+    image_writer_t *writer = NULL;
+    ipf_header_t header;
 
-    if (cfg->verbose) {
-        printf("iPF Header:\n");
-        printf("  Size: %dx%d\n", header.width, header.height);
-        printf("  Type: iPF%d (%s)\n", header.type + 1,
-               header.type == 0 ? "4:2:0" : "4:2:2");
-        printf("  Flags: %s%s%s\n",
-               has_alpha ? "alpha " : "",
-               use_zstd ? "zstd " : "",
-               progressive ? "progressive " : "");
-        printf("  Uncompressed size: %u bytes\n", header.uncompressed_size);
+    if (ipf_parse_header(map, file_size, &header) != IPF_OK) {
+        fprintf(stderr, "Error: %s: Not a valid iPF file\n", file->path);
+        goto done;
     }
 
-    if (progressive) {
-        fprintf(stderr, "Warning: Progressive mode not implemented, decoding as sequential\n");
+    int has_alpha = (header.flags & IPF_FLAG_ALPHA) != 0;
+    int channels = output_channels(cfg, &header);
+    int blocks_x = (header.width + 3) / 4;
+    int blocks_y = (header.height + 3) / 4;
+    size_t block_row_size = (size_t)blocks_x * ipf_block_size(&header);
+    size_t band_stride = (size_t)blocks_x * 4 * channels;
+    // Progressive blocks land anywhere in the image, so those take a full-height band,
+    // as do indexed images, which have no blocks
+    int progressive = (header.flags & IPF_FLAG_PROGRESSIVE) != 0 || header.type == IPF_TYPE_INDEXED;
+    size_t band_rows = progressive ? (size_t)blocks_y * 4 : 4;
+    uint64_t t = ipf_stats_lap(timing, "read", file_start);
+
+    const uint8_t *blocks = batch_unpack_blocks(w, file->path, &header, map + IPF_HEADER_SIZE,
+                                                file_size - IPF_HEADER_SIZE, ipf_blocks_size(&header));
+    if (!blocks) goto done;
+    t = ipf_stats_lap(timing, "inflate", t);
+
+    if (ensure_capacity(&w->band, &w->band_cap, band_stride * band_rows) < 0) {
+        fprintf(stderr, "Error: %s: Failed to allocate band buffer\n", file->path);
+        goto done;
     }
 
-    // Read compressed/raw block data
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, IPF_HEADER_SIZE, SEEK_SET);
+    char out_path[MAX_PATH];
+    if (cfg->output_dir) {
+        batch_output_path(cfg, w->batch->ext, file->rel, out_path, sizeof(out_path));
+        if (make_parent_dirs(out_path) < 0) goto done;
+    }
 
-    size_t compressed_size = file_size - IPF_HEADER_SIZE;
-    uint8_t *compressed_data = malloc(compressed_size);
-    if (!compressed_data) {
-        fclose(fp);
-        fprintf(stderr, "Error: Failed to allocate memory\n");
-        return -1;
+    if (cfg->planes) {
+        fb_planes_t planes;
+        if (fb_planes_init(&planes, &header, file->path) < 0) goto done;
+        fb_planes_decode(&planes, &header, blocks);
+        t = ipf_stats_lap(timing, "decode", t);
+        result = cfg->output_dir ? fb_planes_write(&planes, out_path, cfg->planes_zstd) : 0;
+        fb_planes_free(&planes);
+        t = ipf_stats_lap(timing, "write", t);
+        goto finished;
     }
 
-    if (fread(compressed_data, 1, compressed_size, fp) != compressed_size) {
-        free(compressed_data);
-        fclose(fp);
-        fprintf(stderr, "Error: Failed to read block data\n");
-        return -1;
+    if (cfg->upscale || cfg->fit_width) {
+        if (check_scalable(&header, file->path) < 0) goto done;
+        int width, height;
+        scaled_size(cfg, &header, &width, &height);
+        if (cfg->output_dir) {
+            writer = image_writer_open(out_path, w->batch->fmt, width, height, channels, &cfg->writer_opts);
+            if (!writer) goto done;
+        }
+        result = write_scaled(cfg, &header, blocks, writer, file->path);
+        t = ipf_stats_lap(timing, "decode", t);
+        if (writer && image_writer_close(writer) < 0) result = -1;
+        t = ipf_stats_lap(timing, "write", t);
+        goto finished;
     }
-    fclose(fp);
 
-    // Decompress if needed
-    uint8_t *block_data;
-    size_t block_data_size;
+    if (cfg->output_dir) {
+        writer = image_writer_open(out_path, w->batch->fmt, header.width, header.height,
+                                   channels, &cfg->writer_opts);
+        if (!writer) goto done;
+    }
 
-    if (use_zstd) {
-        block_data_size = header.uncompressed_size;
-        block_data = malloc(block_data_size);
-        if (!block_data) {
-            free(compressed_data);
-            fprintf(stderr, "Error: Failed to allocate decompression buffer\n");
-            return -1;
+    result = 0;
+    if (progressive) {
+        if (cfg->gray) ipf_decode_gray(&header, blocks, w->band, band_stride);
+        else ipf_decode_image(&header, blocks, IPF_PIXELS_RGB, w->band, band_stride);
+        t = ipf_stats_lap(timing, "decode", t);
+        if (writer && image_writer_write_rows(writer, w->band, band_stride, header.height) < 0) {
+            fprintf(stderr, "Error: %s: Failed to write output\n", file->path);
+            result = -1;
         }
-
-        size_t result = ZSTD_decompress(block_data, block_data_size,
-                                        compressed_data, compressed_size);
-        if (ZSTD_isError(result)) {
-            fprintf(stderr, "Error: Zstd decompression failed: %s\n",
-                    ZSTD_getErrorName(result));
-            free(block_data);
-            free(compressed_data);
-            return -1;
+        t = ipf_stats_lap(timing, "write", t);
+    }
+    for (int by = 0; by < blocks_y && result == 0 && !progressive; by++) {
+        const uint8_t *block_row = blocks + (size_t)by * block_row_size;
+        if (cfg->gray) ipf_decode_gray_row(&header, block_row, w->band, band_stride);
+        else ipf_decode_block_row(&header, IPF_PIXELS_RGB, block_row, w->band, band_stride);
+        t = ipf_stats_lap(timing, "decode", t);
+
+        int rows = header.height - by * 4;
+        if (rows > 4) rows = 4;
+        if (writer && image_writer_write_rows(writer, w->band, band_stride, rows) < 0) {
+            fprintf(stderr, "Error: %s: Failed to write output\n", file->path);
+            result = -1;
         }
+        t = ipf_stats_lap(timing, "write", t);
+    }
+
+    if (writer && image_writer_close(writer) < 0) result = -1;
+    ipf_stats_lap(timing, "write", t);
 
+finished:
+    if (result == 0) {
+        count_decoded(timing, &header, 0, 0, 0);
+        if (timing && cfg->output_dir) timing->bytes_out += ipf_stats_file_size(out_path);
+        w->stats.pixels += (uint64_t)header.width * header.height;
         if (cfg->verbose) {
-            printf("Decompressed: %zu -> %zu bytes\n", compressed_size, block_data_size);
+            if (header.type == IPF_TYPE_INDEXED) {
+                fprintf(cfg->msg, "  %s: %dx%d indexed%s\n", file->path, header.width, header.height,
+                        has_alpha ? " alpha" : "");
+            } else {
+                fprintf(cfg->msg, "  %s: %dx%d iPF%d%s\n", file->path, header.width, header.height,
+                        header.type + 1, has_alpha ? " alpha" : "");
+            }
         }
-
-        free(compressed_data);
-    } else {
-        block_data = compressed_data;
-        block_data_size = compressed_size;
     }
 
-    // Allocate output image
-    int channels = has_alpha ? 4 : 3;
-    size_t image_size = (size_t)header.width * header.height * channels;
-    uint8_t *image = malloc(image_size);
-    if (!image) {
-        free(block_data);
-        fprintf(stderr, "Error: Failed to allocate image buffer\n");
-        return -1;
+done:
+    munmap(map, file_size);
+    ipf_stats_event(timing, "file", file->path, file_start);
+    return result;
+}
+
+static void *batch_worker_main(void *arg) {
+    batch_worker_t *w = arg;
+    batch_t *batch = w->batch;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (i >= batch->list->count) break;
+
+        if (batch_decode_file(w, &batch->list->items[i]) == 0) {
+            w->stats.files_ok++;
+        } else {
+            w->stats.files_failed++;
+        }
     }
+    if (batch->cfg->stats) ipf_stats_add_thread_cpu(&w->timing);
+    return NULL;
+}
 
-    // Decode blocks
-    int blocks_x = (header.width + 3) / 4;
-    int blocks_y = (header.height + 3) / 4;
-    int block_size = (header.type == IPF_TYPE_1) ? (has_alpha ? 20 : 12) : (has_alpha ? 24 : 16);
-    int row_stride = header.width * channels;
-    int block_stride = 4 * channels;  // 4 pixels per block row
-
-    size_t block_offset = 0;
-    for (int by = 0; by < blocks_y; by++) {
-        for (int bx = 0; bx < blocks_x; bx++) {
-            // Calculate output position
-            uint8_t *block_pixels = image + by * 4 * row_stride + bx * block_stride;
-
-            if (header.type == IPF_TYPE_1) {
-                decode_ipf1_block(block_data + block_offset, has_alpha, block_pixels, row_stride);
-            } else {
-                decode_ipf2_block(block_data + block_offset, has_alpha, block_pixels, row_stride);
-            }
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
 
-            block_offset += block_size;
+/**
+ * Decode every file named by cfg->batch_source across a pool of workers and
+ * report aggregate throughput. Returns 0 only if every file decoded.
+ */
+static int decode_batch(const decoder_config_t *cfg) {
+    batch_t batch = { .cfg = cfg, .list = NULL, .fmt = IMG_FMT_PNG, .ext = NULL, .next = 0 };
+
+    if (cfg->output_dir && !cfg->planes) {
+        if (cfg->raw_output) batch.fmt = IMG_FMT_RAW;
+        else if (cfg->format >= 0) batch.fmt = (image_format_t)cfg->format;
+        if (batch.fmt == IMG_FMT_FFMPEG) {
+            fprintf(stderr, "Error: Batch export needs a native format (png, qoi, ppm, pam, tga, raw)\n");
+            return -1;
         }
     }
+    batch.ext = cfg->planes ? "planes" : image_format_name(batch.fmt);
 
-    free(block_data);
+    batch_list_t list = { 0 };
+    if (collect_batch_inputs(cfg->batch_source, &list) < 0) {
+        batch_list_free(&list);
+        return -1;
+    }
+    if (list.count == 0) {
+        fprintf(stderr, "Error: No iPF files found in %s\n", cfg->batch_source);
+        batch_list_free(&list);
+        return -1;
+    }
+    batch.list = &list;
 
-    if (cfg->verbose) {
-        printf("Decoded %d blocks (%dx%d)\n", blocks_x * blocks_y, blocks_x, blocks_y);
+    int jobs = cfg->jobs;
+    if (jobs <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = n > 0 ? (int)n : 1;
     }
+    if ((size_t)jobs > list.count) jobs = (int)list.count;
 
-    // Output image
-    int result = 0;
+    batch_worker_t *workers = calloc(jobs, sizeof(batch_worker_t));
+    if (!workers) {
+        fprintf(stderr, "Error: Failed to allocate workers\n");
+        batch_list_free(&list);
+        return -1;
+    }
 
-    if (cfg->raw_output) {
-        // Write raw RGB/RGBA data
-        FILE *out = fopen(cfg->output_file, "wb");
-        if (!out) {
-            fprintf(stderr, "Error: Failed to open output file: %s\n", cfg->output_file);
-            result = -1;
-        } else {
-            fwrite(image, 1, image_size, out);
-            fclose(out);
-            if (cfg->verbose) {
-                printf("Wrote %zu bytes raw %s data\n", image_size, has_alpha ? "RGBA" : "RGB24");
-            }
-        }
-    } else {
-        // Use FFmpeg to write output image
-        char cmd[MAX_PATH * 2];
-        const char *pix_fmt = has_alpha ? "rgba" : "rgb24";
+    fprintf(cfg->msg, "Batch: %zu files, %d worker%s, %s\n", list.count, jobs, jobs == 1 ? "" : "s",
+            cfg->output_dir ? "exporting" : "verifying");
 
-        snprintf(cmd, sizeof(cmd),
-                 "ffmpeg -hide_banner -v quiet -y -f rawvideo -pix_fmt %s -s %dx%d "
-                 "-i - \"%s\"",
-                 pix_fmt, header.width, header.height, cfg->output_file);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-        if (cfg->verbose) {
-            printf("FFmpeg command: %s\n", cmd);
+    int started = 0;
+    for (int i = 0; i < jobs; i++) {
+        workers[i].batch = &batch;
+        ipf_stats_init(&workers[i].timing, i + 1, cfg->stats && cfg->stats->tracing);
+        workers[i].dctx = ZSTD_createDCtx();
+        if (!workers[i].dctx) {
+            fprintf(stderr, "Error: Failed to allocate decompression context\n");
+            break;
         }
-
-        FILE *pipe = popen(cmd, "w");
-        if (!pipe) {
-            fprintf(stderr, "Error: Failed to start FFmpeg\n");
-            result = -1;
-        } else {
-            fwrite(image, 1, image_size, pipe);
-            int status = pclose(pipe);
-            if (status != 0) {
-                fprintf(stderr, "Error: FFmpeg failed with status %d\n", status);
-                result = -1;
-            }
+        if (pthread_create(&workers[i].thread, NULL, batch_worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread\n");
+            ZSTD_freeDCtx(workers[i].dctx);
+            workers[i].dctx = NULL;
+            break;
+        }
+        started++;
+    }
+    if (started == 0) batch_worker_main(&workers[0]);
+
+    batch_stats_t total = { 0 };
+    for (int i = 0; i < jobs; i++) {
+        if (i < started) pthread_join(workers[i].thread, NULL);
+        total.files_ok += workers[i].stats.files_ok;
+        total.files_failed += workers[i].stats.files_failed;
+        total.bytes_in += workers[i].stats.bytes_in;
+        total.bytes_blocks += workers[i].stats.bytes_blocks;
+        total.pixels += workers[i].stats.pixels;
+        if (cfg->stats && ipf_stats_merge(cfg->stats, &workers[i].timing) < 0) {
+            fprintf(stderr, "Warning: Trace is missing events (out of memory)\n");
         }
+        ipf_stats_free(&workers[i].timing);
+        if (workers[i].dctx) ZSTD_freeDCtx(workers[i].dctx);
+        if (workers[i].zs_ready) inflateEnd(&workers[i].zs);
+        free(workers[i].block_buf);
+        free(workers[i].band);
     }
 
-    free(image);
+    double secs = elapsed_seconds(&start);
+    if (secs <= 0) secs = 1e-9;
+
+    fprintf(cfg->msg, "Decoded %zu of %zu files (%zu failed) in %.3f s\n",
+            total.files_ok, list.count, total.files_failed, secs);
+    fprintf(cfg->msg, "  Input:  %.2f MB mapped, %.2f MB block data inflated\n",
+            total.bytes_in / 1e6, total.bytes_blocks / 1e6);
+    fprintf(cfg->msg, "  Speed:  %.1f files/s, %.2f MB/s in, %.2f Mpx/s\n",
+            total.files_ok / secs, total.bytes_in / 1e6 / secs, total.pixels / 1e6 / secs);
+
+    // Trace events point at the list's paths, so report before freeing it
+    int result = total.files_failed == 0 ? 0 : -1;
+    if (cfg->stats) {
+        ipf_stats_finish(cfg->stats);
+        if (ipf_stats_report(cfg->stats, &cfg->stats_out, "decoder_ipf", cfg->batch_source) < 0) result = -1;
+    }
 
+    free(workers);
+    batch_list_free(&list);
     return result;
 }
 
@@ -539,20 +2457,59 @@ int main(int argc, char *argv[]) {
         .input_file = NULL,
         .output_file = NULL,
         .verbose = 0,
-        .raw_output = 0
+        .raw_output = 0,
+        .msg = stdout,
+        .format = -1,
+        .writer_opts = IMAGE_WRITER_OPTS_DEFAULT,
+        .batch_source = NULL,
+        .output_dir = NULL,
+        .jobs = 0,
+        .planes = 0,
+        .planes_zstd = 0,
+        .gray = 0,
+        .upscale = 0,
+        .fit_width = 0,
+        .fit_height = 0,
+        .layers = NULL,
+        .layer_count = 0,
+        .canvas_width = 0,
+        .canvas_height = 0,
+        .background = { 0, 0, 0, 0 },
+        .stats_out = { IPF_STATS_OFF, NULL, NULL },
+        .stats = NULL,
+        .simulate_io = 0,
+        .sweep = 0
     };
+    parse_io_model(NULL, &cfg.io_model);
 
     static struct option long_options[] = {
-        {"input",   required_argument, 0, 'i'},
-        {"output",  required_argument, 0, 'o'},
-        {"raw",     no_argument,       0, 'R'},
-        {"verbose", no_argument,       0, 'v'},
-        {"help",    no_argument,       0, 'h'},
+        {"input",      required_argument, 0, 'i'},
+        {"output",     required_argument, 0, 'o'},
+        {"raw",        no_argument,       0, 'R'},
+        {"format",     required_argument, 0, 'f'},
+        {"png-level",  required_argument, 0, 'L'},
+        {"png-filter", required_argument, 0, 'F'},
+        {"batch",      required_argument, 0, 'b'},
+        {"output-dir", required_argument, 0, 'O'},
+        {"jobs",       required_argument, 0, 'j'},
+        {"planes",     no_argument,       0, 'P'},
+        {"gray",       no_argument,       0, 'G'},
+        {"upscale",    required_argument, 0, 'U'},
+        {"fit",        required_argument, 0, 'X'},
+        {"layer",      required_argument, 0, 'l'},
+        {"canvas",     required_argument, 0, 'C'},
+        {"zstd",       optional_argument, 0, 'Z'},
+        {"stats",      optional_argument, 0, 'S'},
+        {"trace",      required_argument, 0, 'T'},
+        {"simulate-io", optional_argument, 0, 'I'},
+        {"sweep",      no_argument,       0, 'W'},
+        {"verbose",    no_argument,       0, 'v'},
+        {"help",       no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "i:o:vh", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:o:f:b:O:j:l:vh", long_options, NULL)) != -1) {
         switch (opt) {
             case 'i':
                 cfg.input_file = optarg;
@@ -563,8 +2520,98 @@ int main(int argc, char *argv[]) {
             case 'R':
                 cfg.raw_output = 1;
                 break;
+            case 'f':
+                cfg.format = image_format_from_name(optarg);
+                if (cfg.format < 0) {
+                    fprintf(stderr, "Error: Unknown output format: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                cfg.writer_opts.png_level = atoi(optarg);
+                if (cfg.writer_opts.png_level < 0 || cfg.writer_opts.png_level > 9) {
+                    fprintf(stderr, "Error: PNG level must be 0-9\n");
+                    return 1;
+                }
+                break;
+            case 'F':
+                cfg.writer_opts.png_filter = png_filter_from_name(optarg);
+                if (cfg.writer_opts.png_filter < 0) {
+                    fprintf(stderr, "Error: Unknown PNG filter: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'b':
+                cfg.batch_source = optarg;
+                break;
+            case 'O':
+                cfg.output_dir = optarg;
+                break;
+            case 'j':
+                cfg.jobs = atoi(optarg);
+                if (cfg.jobs < 1) {
+                    fprintf(stderr, "Error: Jobs must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'P':
+                cfg.planes = 1;
+                break;
+            case 'G':
+                cfg.gray = 1;
+                break;
+            case 'U':
+                cfg.upscale = atoi(optarg);
+                if (cfg.upscale < 1 || cfg.upscale > MAX_UPSCALE) {
+                    fprintf(stderr, "Error: Upscale factor must be 1-%d\n", MAX_UPSCALE);
+                    return 1;
+                }
+                break;
+            case 'X':
+                if (sscanf(optarg, "%dx%d", &cfg.fit_width, &cfg.fit_height) != 2 ||
+                    cfg.fit_width < 1 || cfg.fit_height < 1 ||
+                    cfg.fit_width > MAX_SCALED_SIZE || cfg.fit_height > MAX_SCALED_SIZE) {
+                    fprintf(stderr, "Error: --fit takes WxH, each 1-%d\n", MAX_SCALED_SIZE);
+                    return 1;
+                }
+                break;
+            case 'l': {
+                layer_t *grown = realloc(cfg.layers, (cfg.layer_count + 1) * sizeof(*grown));
+                if (!grown) return 1;
+                cfg.layers = grown;
+                if (parse_layer(optarg, &cfg.layers[cfg.layer_count]) < 0) return 1;
+                cfg.layer_count++;
+                break;
+            }
+            case 'C':
+                if (parse_canvas(optarg, &cfg) < 0) return 1;
+                break;
+            case 'Z':
+                cfg.planes_zstd = optarg ? atoi(optarg) : PLANES_ZSTD_LEVEL;
+                if (cfg.planes_zstd < 1 || cfg.planes_zstd > ZSTD_maxCLevel()) {
+                    fprintf(stderr, "Error: Zstd level must be 1-%d\n", ZSTD_maxCLevel());
+                    return 1;
+                }
+                break;
+            case 'S':
+                if (ipf_stats_parse(optarg ? optarg : "text", &cfg.stats_out) < 0) {
+                    fprintf(stderr, "Error: Unknown stats format: %s (use text or json)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                cfg.stats_out.trace_path = optarg;
+                break;
+            case 'I':
+                cfg.simulate_io = 1;
+                if (parse_io_model(optarg, &cfg.io_model) < 0) return 1;
+                break;
+            case 'W':
+                cfg.sweep = 1;
+                break;
             case 'v':
                 cfg.verbose = 1;
+                cfg.writer_opts.verbose = 1;
                 break;
             case 'h':
                 print_usage(argv[0]);
@@ -575,17 +2622,89 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (cfg.planes_zstd && !cfg.planes) {
+        fprintf(stderr, "Error: --zstd applies to --planes output only\n");
+        return 1;
+    }
+
+    if (cfg.gray && (cfg.planes || cfg.simulate_io)) {
+        fprintf(stderr, "Error: --gray writes an image; it does not go with --planes or --simulate-io\n");
+        return 1;
+    }
+
+    if ((cfg.upscale || cfg.fit_width) &&
+        ((cfg.upscale && cfg.fit_width) || cfg.planes || cfg.gray || cfg.simulate_io || cfg.layer_count || cfg.canvas_width)) {
+        fprintf(stderr, "Error: --upscale or --fit (one of them) goes with plain image output only\n");
+        return 1;
+    }
+
+    if (cfg.sweep && !cfg.simulate_io) {
+        fprintf(stderr, "Error: --sweep needs --simulate-io\n");
+        return 1;
+    }
+    if (cfg.simulate_io) {
+        if (!cfg.input_file || cfg.output_file || cfg.batch_source || cfg.planes) {
+            fprintf(stderr, "Error: --simulate-io takes one -i file and writes no output\n");
+            return 1;
+        }
+        return simulate_io(&cfg) == 0 ? 0 : 1;
+    }
+
+    ipf_stats_t stats;
+    ipf_stats_from_env(&cfg.stats_out);
+    if (cfg.stats_out.format != IPF_STATS_OFF || cfg.stats_out.trace_path) {
+        ipf_stats_init(&stats, 0, cfg.stats_out.trace_path != NULL);
+        cfg.stats = &stats;
+    }
+
+    if (cfg.layer_count > 0 || cfg.canvas_width > 0) {
+        int result = -1;
+        if (!cfg.layer_count || !cfg.output_file || cfg.input_file || cfg.batch_source || cfg.planes || cfg.gray) {
+            fprintf(stderr, "Error: Compositing takes --layer files and -o, and no -i, -b, --planes or --gray\n");
+        } else {
+            if (strcmp(cfg.output_file, "-") == 0) cfg.msg = stderr;
+            result = composite_layers(&cfg);
+        }
+        if (result == 0) fprintf(cfg.msg, "Successfully composited: %s\n", cfg.output_file);
+        for (int i = 0; i < cfg.layer_count; i++) free(cfg.layers[i].path);
+        free(cfg.layers);
+        if (cfg.stats) {
+            ipf_stats_finish(cfg.stats);
+            if (result == 0 && ipf_stats_report(cfg.stats, &cfg.stats_out, "decoder_ipf", cfg.output_file) < 0) result = -1;
+            ipf_stats_free(cfg.stats);
+        }
+        return result == 0 ? 0 : 1;
+    }
+
+    if (cfg.batch_source) {
+        int result = decode_batch(&cfg);
+        if (cfg.stats) ipf_stats_free(cfg.stats);
+        return result == 0 ? 0 : 1;
+    }
+
     // Validate required arguments
     if (!cfg.input_file || !cfg.output_file) {
         fprintf(stderr, "Error: Input and output files are required\n\n");
         print_usage(argv[0]);
+        if (cfg.stats) ipf_stats_free(cfg.stats);
         return 1;
     }
 
+    // Keep stdout clean when it carries the pixel stream
+    if (strcmp(cfg.output_file, "-") == 0) {
+        cfg.msg = stderr;
+    }
+
     int result = decode_ipf(&cfg);
 
     if (result == 0) {
-        printf("Successfully decoded: %s\n", cfg.output_file);
+        fprintf(cfg.msg, "Successfully decoded: %s\n", cfg.output_file);
+    }
+
+    if (cfg.stats) {
+        ipf_stats_finish(cfg.stats);
+        if (ipf_stats_report(cfg.stats, &cfg.stats_out, "decoder_ipf", cfg.input_file) < 0) result = -1;
+        ipf_stats_free(cfg.stats);
     }
 
     return result == 0 ? 0 : 1;
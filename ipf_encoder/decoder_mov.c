@@ -0,0 +1,1255 @@
+/**
+ * MOV Decoder - TSVM legacy movie (MOV/iPF) demuxer and decoder
+ *
+ * Host-side counterpart of encoder_mov and playmov:
+ * - The whole file is mapped and demuxed once: iPF video packets (4,t / 5,t,
+ *   their delta frames and the streamed 6,t / 7,t packets), audio, sync,
+ *   background and seek index packets
+ * - Each keyframe starts a GOP, and GOPs are decoded by a pool of workers,
+ *   each applying its delta frames (MOVE runs included) onto its own copy
+ *   of the reference blocks
+ * - Frames go out as one image per frame (PNG, QOI, PPM/PAM, TGA or raw,
+ *   named by a printf-style pattern), or in order as a single raw stream
+ *   or FFmpeg pipe
+ *
+ * --stats lists every packet with its size and bitrate, then the bitrate of
+ * every second of video, and checks the seek index against the keyframes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <zlib.h>
+
+#include "image_writer.h"
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MOV_MAGIC "\x1F\x54\x53\x56\x4D\x4D\x4F\x56"  // "\x1FTSVMMOV"
+#define MOV_HEADER_SIZE 32
+#define MOV_INDEX_OFFSET_OFFSET 22
+
+#define MOV_SYNC_PACKET       0xFFFF  // 255,255
+#define MOV_BACKGROUND_PACKET 0xFEFF  // 254,255
+#define MOV_INDEX_PACKET      0xFFFD  // 253,255
+
+#define MAX_PATH 4096
+
+// Frames held for in-order output, on top of two per worker
+#define MOV_WINDOW_BYTES (256u << 20)
+
+static const int MP2_FRAME_SIZES[14] = { 144, 216, 252, 288, 360, 432, 504, 576, 720, 864, 1008, 1152, 1440, 1728 };
+
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+static const uint8_t GZIP_MAGIC[3] = { 0x1F, 0x8B, 0x08 };
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    char *input_file;
+    char *output_file;   // Frame pattern, raw stream or video file; NULL verifies only
+    char *audio_file;    // Where to extract the audio packets' payloads
+    int verbose;
+    int raw_output;      // One raw RGB24/RGBA stream instead of images
+    FILE *msg;           // Informational output (stderr when pixels go to stdout)
+    int format;          // image_format_t, or -1 to pick by output extension
+    image_writer_opts_t writer_opts;
+    int jobs;            // Decoding threads
+    int stats;           // Print the packet and bitrate report
+    int start;           // First frame to output, from 0
+    int count;           // Frames to output, 0 = to the end
+} decoder_config_t;
+
+typedef enum {
+    OUTPUT_NONE = 0,     // Decode and verify only
+    OUTPUT_IMAGES,       // One file per frame
+    OUTPUT_STREAM        // Every frame in order, raw or through FFmpeg
+} output_mode_t;
+
+typedef struct {
+    size_t offset;       // Payload, after the size fields
+    uint32_t size;       // Payload bytes
+    uint32_t raw_size;   // Decompressed bytes, for streamed packets
+    uint16_t type;
+    size_t group;        // Offset of the frame's first packet, right after the preceding sync
+} mov_frame_t;
+
+typedef struct {
+    uint32_t frame;
+    uint32_t offset;
+} index_entry_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    int width;
+    int height;
+    int fps;
+    uint32_t header_frames;
+    uint32_t index_offset;
+
+    mov_frame_t *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    size_t *gops;        // First frame of every GOP
+    size_t gop_count;
+    size_t gop_capacity;
+    index_entry_t *index;
+    size_t index_count;
+    int has_alpha;       // Any frame has alpha, so output is RGBA
+} mov_file_t;
+
+/**
+ * Running totals for --stats. Audio packets count towards the frame that
+ * follows them, as the player queues them before showing that frame.
+ */
+typedef struct {
+    uint64_t video_bytes;
+    uint64_t audio_bytes;
+    uint64_t overhead_bytes;  // Packet types, size fields, sync and background packets
+    size_t audio_packets;
+    size_t keyframes;
+    size_t largest_packet;
+    size_t largest_frame;
+    long second;              // Second being accumulated, -1 before the first packet
+    uint64_t second_video;
+    uint64_t second_audio;
+    int second_keyframes;
+    uint64_t peak_second;     // Most video bytes in any one second
+} mov_stats_t;
+
+typedef struct {
+    uint8_t *pixels;
+    int ready;
+} window_slot_t;
+
+typedef struct {
+    const decoder_config_t *cfg;
+    const mov_file_t *mov;
+    output_mode_t mode;
+    image_format_t fmt;
+    int channels;
+    size_t stride;           // Bytes per row of the padded pixel buffer
+    size_t pixels_size;
+    size_t first;            // Output frames [first, last)
+    size_t last;
+    size_t last_gop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t next_gop;
+    size_t next_write;       // Next frame the stream writer expects
+    int failed;
+    window_slot_t *window;
+    size_t window_size;
+} decode_job_t;
+
+typedef struct {
+    decode_job_t *job;
+    pthread_t thread;
+    ZSTD_DCtx *dctx;         // Independently compressed packets
+    ZSTD_DCtx *dstream;      // The GOP's zstd stream, for streamed packets
+    z_stream zs;             // Legacy gzip packets
+    int zs_ready;
+    uint8_t *packet;         // Decompressed payload
+    size_t packet_capacity;
+    uint8_t *blocks;         // What the player is showing
+    uint8_t *pixels;         // Scratch for image output
+    ipf_header_t header;     // Of the current GOP
+    size_t frames;
+    uint64_t raw_bytes;
+} decode_worker_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("MOV Decoder - TSVM legacy movie (MOV/iPF) demuxer and decoder\n");
+    printf("\nUsage: %s -i input.mov [-o OUTPUT] [options]\n\n", program);
+    printf("Required:\n");
+    printf("  -i, --input FILE         Input MOV file\n");
+    printf("\nOutput:\n");
+    printf("  -o, --output PATH        A frame pattern such as 'out/%%05d.png' writes one image\n");
+    printf("                           per frame, numbered from 1; any other name is one video\n");
+    printf("                           through FFmpeg. Without -o the movie is only verified\n");
+    printf("  --raw                    Write every frame as raw RGB24/RGBA to one file\n");
+    printf("                           (use -o - to stream raw pixels to stdout)\n");
+    printf("  -f, --format NAME        Force the image format: png, qoi, ppm, pam, tga, raw\n");
+    printf("  --png-level N            PNG deflate level 0-9 (default: 1)\n");
+    printf("  --png-filter NAME        PNG row filter: none, sub, up, avg, paeth, adaptive\n");
+    printf("                           (default: up)\n");
+    printf("  -a, --audio FILE         Extract the audio track (MP2 frames or raw PCM) to FILE\n");
+    printf("\nOptions:\n");
+    printf("  -s, --start N            First frame to output, from 0 (default: 0)\n");
+    printf("  -n, --frames N           Frames to output (default: to the end)\n");
+    printf("  -j, --jobs N             Decoding threads (default: number of CPUs)\n");
+    printf("  --stats                  List every packet, the bitrate of every second and\n");
+    printf("                           check the seek index\n");
+    printf("  -v, --verbose            Verbose output\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nGOPs (a keyframe and the delta frames after it) are decoded in parallel.\n");
+    printf("\nExamples:\n");
+    printf("  %s -i film.mov -o 'frames/%%05d.png'\n", program);
+    printf("  %s -i film.mov -o film.mp4 -a film.mp2\n", program);
+    printf("  %s -i film.mov -o - --raw | other_tool\n", program);
+    printf("  %s -i film.mov --stats                 # Verify and report bitrates\n", program);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * A frame pattern has exactly one integer conversion such as %d or %05d;
+ * %% is allowed anywhere. Anything else would be handed to snprintf.
+ */
+static int is_frame_pattern(const char *path) {
+    int conversions = 0;
+    for (const char *p = path; *p; p++) {
+        if (*p != '%') continue;
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        p++;
+        if (*p == '0') p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != 'd') return -1;
+        conversions++;
+    }
+    return conversions == 0 ? 0 : conversions == 1 ? 1 : -1;
+}
+
+// Low byte 4..7 with a known high byte: iPF, delta or streamed
+static int is_ipf_packet(uint16_t type) {
+    return (type & 255) >= 4 && (type & 255) <= 7 && (type >> 8) < 4;
+}
+
+static const char *packet_type_name(uint16_t type, char *buf, size_t len) {
+    int lo = type & 255, hi = type >> 8;
+    if (type == MOV_SYNC_PACKET) return "sync";
+    if (type == MOV_BACKGROUND_PACKET) return "background";
+    if (type == MOV_INDEX_PACKET) return "seek index";
+    if (is_ipf_packet(type)) {
+        snprintf(buf, len, "%siPF%d%s%s", lo >= 6 ? "streamed " : "", (hi & 1) + 1,
+                 hi >= 2 ? " delta" : "", lo & 1 ? " alpha" : "");
+    } else if (hi == 17) {
+        snprintf(buf, len, "MP2 (%d)", lo);
+    } else if (type == 0x1000 || type == 0x1001) {
+        snprintf(buf, len, "PCM %s", lo ? "mono" : "stereo");
+    } else {
+        snprintf(buf, len, "%d,%d", lo, hi);
+    }
+    return buf;
+}
+
+// =============================================================================
+// Demuxing
+// =============================================================================
+
+static int open_mov(const char *path, mov_file_t *mov) {
+    memset(mov, 0, sizeof(*mov));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < MOV_HEADER_SIZE) {
+        fprintf(stderr, "Error: %s: File too short for a MOV header\n", path);
+        close(fd);
+        return -1;
+    }
+
+    mov->size = (size_t)st.st_size;
+    mov->data = mmap(NULL, mov->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mov->data == MAP_FAILED) {
+        mov->data = NULL;
+        fprintf(stderr, "Error: %s: mmap failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (memcmp(mov->data, MOV_MAGIC, 8) != 0) {
+        fprintf(stderr, "Error: %s: Not a MOV file\n", path);
+        return -1;
+    }
+
+    mov->width = get_u16(mov->data + 8);
+    mov->height = get_u16(mov->data + 10);
+    mov->fps = get_u16(mov->data + 12);
+    mov->header_frames = get_u32(mov->data + 14);
+    mov->index_offset = get_u32(mov->data + MOV_INDEX_OFFSET_OFFSET);
+    if (mov->width == 0 || mov->height == 0) {
+        fprintf(stderr, "Error: %s: Invalid dimensions %dx%d\n", path, mov->width, mov->height);
+        return -1;
+    }
+    return 0;
+}
+
+static void close_mov(mov_file_t *mov) {
+    if (mov->data) munmap(mov->data, mov->size);
+    free(mov->frames);
+    free(mov->gops);
+    free(mov->index);
+}
+
+static int add_frame(mov_file_t *mov, const mov_frame_t *frame) {
+    if (mov->frame_count == mov->frame_capacity) {
+        size_t capacity = mov->frame_capacity ? mov->frame_capacity * 2 : 1024;
+        mov_frame_t *frames = realloc(mov->frames, capacity * sizeof(*frames));
+        if (!frames) return -1;
+        mov->frames = frames;
+        mov->frame_capacity = capacity;
+    }
+
+    // Keyframes start a GOP; so does anything the decoder can't carry a reference across
+    int keyframe = (frame->type >> 8) < 2 || !is_ipf_packet(frame->type);
+    if (mov->frame_count == 0 || keyframe) {
+        if (mov->gop_count == mov->gop_capacity) {
+            size_t capacity = mov->gop_capacity ? mov->gop_capacity * 2 : 64;
+            size_t *gops = realloc(mov->gops, capacity * sizeof(*gops));
+            if (!gops) return -1;
+            mov->gops = gops;
+            mov->gop_capacity = capacity;
+        }
+        mov->gops[mov->gop_count++] = mov->frame_count;
+    }
+
+    if (is_ipf_packet(frame->type) && (frame->type & 1)) mov->has_alpha = 1;
+    mov->frames[mov->frame_count++] = *frame;
+    return 0;
+}
+
+static void stats_flush_second(const decoder_config_t *cfg, mov_stats_t *s) {
+    if (s->second < 0) return;
+    fprintf(cfg->msg, "Second %5ld: video %9.1f kbit/s, audio %7.1f kbit/s, %d keyframe%s\n", s->second,
+            s->second_video * 8 / 1000.0, s->second_audio * 8 / 1000.0, s->second_keyframes,
+            s->second_keyframes == 1 ? "" : "s");
+    if (s->second_video > s->peak_second) s->peak_second = s->second_video;
+    s->second_video = s->second_audio = 0;
+    s->second_keyframes = 0;
+}
+
+/**
+ * Count a packet towards the frame it is shown with, and list it.
+ */
+static void stats_packet(const decoder_config_t *cfg, const mov_file_t *mov, mov_stats_t *s,
+                         size_t at, uint16_t type, size_t payload, size_t total) {
+    size_t frame = mov->frame_count;
+    int video = type < 2047;
+    char name[32];
+
+    s->overhead_bytes += total - payload;
+    if (video) {
+        s->video_bytes += payload;
+        if (payload > s->largest_packet) {
+            s->largest_packet = payload;
+            s->largest_frame = frame;
+        }
+        if (is_ipf_packet(type) && (type >> 8) < 2) s->keyframes++;
+    } else if (type >= 4096 && type <= 6143) {
+        s->audio_bytes += payload;
+        s->audio_packets++;
+    }
+
+    if (!cfg->stats) return;
+
+    if (mov->fps > 0) {
+        long second = (long)(frame / mov->fps);
+        if (second != s->second) {
+            stats_flush_second(cfg, s);
+            s->second = second;
+        }
+        if (video) {
+            s->second_video += payload;
+            if (is_ipf_packet(type) && (type >> 8) < 2) s->second_keyframes++;
+        } else {
+            s->second_audio += payload;
+        }
+    }
+
+    if (video && mov->fps > 0) {
+        fprintf(cfg->msg, "%10zu  frame %6zu  %-24s %8zu bytes  %9.1f kbit/s\n", at, frame,
+                packet_type_name(type, name, sizeof(name)), payload, payload * 8.0 * mov->fps / 1000.0);
+    } else if (payload > 0) {
+        fprintf(cfg->msg, "%10zu  frame %6zu  %-24s %8zu bytes\n", at, frame,
+                packet_type_name(type, name, sizeof(name)), payload);
+    }
+}
+
+/**
+ * Read the seek index at pos, which holds the packet type.
+ */
+static int read_index(mov_file_t *mov, size_t pos) {
+    if (pos + 10 > mov->size) return -1;
+    uint32_t size = get_u32(mov->data + pos + 2);
+    uint32_t count = get_u32(mov->data + pos + 6);
+    if (size < 4 || (size - 4) / 8 != count || pos + 6 + (size_t)size > mov->size) return -1;
+
+    mov->index = malloc((count ? count : 1) * sizeof(*mov->index));
+    if (!mov->index) return -1;
+    const uint8_t *p = mov->data + pos + 10;
+    for (uint32_t i = 0; i < count; i++, p += 8) {
+        mov->index[i] = (index_entry_t){ get_u32(p), get_u32(p + 4) };
+    }
+    mov->index_count = count;
+    return 0;
+}
+
+/**
+ * Walk every packet from the header to the seek index (or the end of the
+ * file), recording the video frames and GOPs. Audio payloads are copied to
+ * audio_out when given.
+ */
+static int demux_mov(const decoder_config_t *cfg, mov_file_t *mov, FILE *audio_out, mov_stats_t *stats) {
+    const uint8_t *data = mov->data;
+    size_t pos = MOV_HEADER_SIZE;
+    size_t group = pos;
+    size_t index_at = 0;
+    size_t at = pos;
+
+    while (pos + 2 <= mov->size) {
+        at = pos;
+        uint16_t type = get_u16(data + pos);
+        pos += 2;
+
+        if (type == MOV_SYNC_PACKET) {
+            stats->overhead_bytes += 2;
+            group = pos;
+            continue;
+        }
+        if (type == MOV_BACKGROUND_PACKET) {
+            pos += 4;
+            stats->overhead_bytes += 6;
+            continue;
+        }
+        if (type == MOV_INDEX_PACKET) {
+            index_at = at;
+            break;
+        }
+
+        mov_frame_t frame = { .type = type, .group = group };
+        int lo = type & 255, hi = type >> 8;
+
+        if (type < 2047) {
+            if (pos + 4 > mov->size) goto truncated;
+            if (lo >= 6 && lo <= 7) {  // Streamed iPF: compressed and raw size
+                if (pos + 8 > mov->size) goto truncated;
+                frame.size = get_u32(data + pos);
+                frame.raw_size = get_u32(data + pos + 4);
+                pos += 8;
+            } else if (lo == 1) {      // 256-colour frame with its palette
+                if (pos + 516 > mov->size) goto truncated;
+                frame.size = 516 + get_u32(data + pos + 512);
+            } else if (lo == 2) {      // Two byte-planes, each with its own size
+                uint32_t first = get_u32(data + pos);
+                if (pos + 8 + (size_t)first > mov->size) goto truncated;
+                frame.size = 8 + first + get_u32(data + pos + 4 + first);
+            } else {
+                frame.size = get_u32(data + pos);
+                pos += 4;
+            }
+            frame.offset = pos;
+            if (frame.size > mov->size - pos) goto truncated;
+            pos += frame.size;
+
+            stats_packet(cfg, mov, stats, at, type, frame.size, pos - at);
+            if (add_frame(mov, &frame) < 0) {
+                fprintf(stderr, "Error: Failed to allocate the frame list\n");
+                return -1;
+            }
+        } else if (type >= 4096 && type <= 6143) {
+            size_t size;
+            if (hi == 17) {
+                int rate = (lo & 127) >> 1;
+                if (rate >= 14) {
+                    fprintf(stderr, "Error: Unknown MP2 packet %d,%d at %zu\n", lo, hi, at);
+                    return -1;
+                }
+                size = (size_t)MP2_FRAME_SIZES[rate] + (lo >> 7);
+            } else {
+                if (pos + 4 > mov->size) goto truncated;
+                size = get_u32(data + pos);
+                pos += 4;
+            }
+            if (size > mov->size - pos) goto truncated;
+            if (audio_out && fwrite(data + pos, 1, size, audio_out) != size) {
+                fprintf(stderr, "Error: Failed to write audio\n");
+                return -1;
+            }
+            pos += size;
+            stats_packet(cfg, mov, stats, at, type, size, pos - at);
+        } else {
+            fprintf(stderr, "Error: Unknown packet type %d,%d at %zu\n", lo, hi, at);
+            return -1;
+        }
+    }
+
+    if (index_at && read_index(mov, index_at) < 0) {
+        fprintf(stderr, "Error: Corrupt seek index at %zu\n", index_at);
+        return -1;
+    }
+    if (index_at && mov->index_offset != index_at && cfg->verbose) {
+        fprintf(cfg->msg, "Warning: Header points at %u, but the seek index is at %zu\n", mov->index_offset, index_at);
+    }
+    if (cfg->stats) stats_flush_second(cfg, stats);
+    return 0;
+
+truncated:
+    fprintf(stderr, "Error: Packet at %zu runs past the end of the file\n", at);
+    return -1;
+}
+
+/**
+ * Check that every index entry points at the start of a keyframe's packets.
+ * Returns the number of entries that don't.
+ */
+static size_t check_index(const mov_file_t *mov) {
+    size_t bad = 0;
+    for (size_t i = 0; i < mov->index_count; i++) {
+        const index_entry_t *e = &mov->index[i];
+        if (e->frame >= mov->frame_count || mov->frames[e->frame].group != e->offset ||
+            (mov->frames[e->frame].type >> 8) >= 2 || (i > 0 && e->frame <= mov->index[i - 1].frame)) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static void print_stats(const decoder_config_t *cfg, const mov_file_t *mov, const mov_stats_t *s) {
+    size_t longest = 0;
+    for (size_t g = 0; g < mov->gop_count; g++) {
+        size_t end = g + 1 < mov->gop_count ? mov->gops[g + 1] : mov->frame_count;
+        if (end - mov->gops[g] > longest) longest = end - mov->gops[g];
+    }
+    double seconds = mov->fps > 0 ? (double)mov->frame_count / mov->fps : 0;
+
+    fprintf(cfg->msg, "\nMovie: %dx%d, %d fps, %zu frames", mov->width, mov->height, mov->fps, mov->frame_count);
+    if (mov->header_frames != mov->frame_count) fprintf(cfg->msg, " (header says %u)", mov->header_frames);
+    fprintf(cfg->msg, ", %.2f MB\n", mov->size / 1e6);
+    fprintf(cfg->msg, "  Frames:   %zu keyframes, %zu delta frames, %zu GOPs, longest %zu frames\n",
+            s->keyframes, mov->frame_count - s->keyframes, mov->gop_count, longest);
+    fprintf(cfg->msg, "  Video:    %.2f MB, %.1f bytes/frame, largest %zu bytes (frame %zu)\n",
+            s->video_bytes / 1e6, mov->frame_count ? (double)s->video_bytes / mov->frame_count : 0.0,
+            s->largest_packet, s->largest_frame);
+    if (seconds > 0) {
+        fprintf(cfg->msg, "            %.1f kbit/s average, %.1f kbit/s peak second\n",
+                s->video_bytes * 8 / 1000.0 / seconds, s->peak_second * 8 / 1000.0);
+    }
+    fprintf(cfg->msg, "  Audio:    %.2f MB in %zu packets", s->audio_bytes / 1e6, s->audio_packets);
+    if (seconds > 0 && s->audio_packets) fprintf(cfg->msg, ", %.1f kbit/s", s->audio_bytes * 8 / 1000.0 / seconds);
+    fprintf(cfg->msg, "\n  Overhead: %llu bytes of packet types, sizes, sync and background packets\n",
+            (unsigned long long)s->overhead_bytes);
+
+    if (!mov->index_offset) {
+        fprintf(cfg->msg, "  Seek index: none\n");
+    } else {
+        size_t bad = check_index(mov);
+        fprintf(cfg->msg, "  Seek index: %zu entries at %u, ", mov->index_count, mov->index_offset);
+        if (bad) fprintf(cfg->msg, "%zu not at a keyframe\n", bad);
+        else fprintf(cfg->msg, "all at keyframes\n");
+    }
+}
+
+// =============================================================================
+// Frame Decoding
+// =============================================================================
+
+static int grow_packet(decode_worker_t *w, size_t capacity) {
+    if (capacity <= w->packet_capacity) return 0;
+    uint8_t *packet = realloc(w->packet, capacity);
+    if (!packet) return -1;
+    w->packet = packet;
+    w->packet_capacity = capacity;
+    return 0;
+}
+
+/**
+ * Decompress frame f's payload into w->packet. Streamed packets continue
+ * the GOP's zstd stream; others are whole zstd (or legacy gzip) frames.
+ * Returns the decompressed length, or -1.
+ */
+static long unpack_frame(decode_worker_t *w, size_t f) {
+    const mov_frame_t *frame = &w->job->mov->frames[f];
+    const uint8_t *src = w->job->mov->data + frame->offset;
+
+    if ((frame->type & 255) >= 6) {
+        if (grow_packet(w, frame->raw_size) < 0) return -1;
+        ZSTD_inBuffer input = { src, frame->size, 0 };
+        ZSTD_outBuffer output = { w->packet, frame->raw_size, 0 };
+        while (input.pos < input.size) {
+            size_t before_in = input.pos, before_out = output.pos;
+            size_t ret = ZSTD_decompressStream(w->dstream, &output, &input);
+            if (ZSTD_isError(ret)) {
+                fprintf(stderr, "Error: Frame %zu: %s\n", f, ZSTD_getErrorName(ret));
+                return -1;
+            }
+            if (input.pos == before_in && output.pos == before_out) break;
+        }
+        if (input.pos != input.size || output.pos != frame->raw_size) {
+            fprintf(stderr, "Error: Frame %zu: Streamed packet does not hold %u bytes\n", f, frame->raw_size);
+            return -1;
+        }
+        return (long)output.pos;
+    }
+
+    if (frame->size >= 4 && memcmp(src, ZSTD_MAGIC, 4) == 0) {
+        ZSTD_DCtx_reset(w->dctx, ZSTD_reset_session_only);
+        ZSTD_inBuffer input = { src, frame->size, 0 };
+        ZSTD_outBuffer output = { w->packet, w->packet_capacity, 0 };
+        for (;;) {
+            if (output.pos == output.size) {
+                if (grow_packet(w, w->packet_capacity * 2) < 0) return -1;
+                output.dst = w->packet;
+                output.size = w->packet_capacity;
+            }
+            size_t ret = ZSTD_decompressStream(w->dctx, &output, &input);
+            if (ZSTD_isError(ret)) {
+                fprintf(stderr, "Error: Frame %zu: %s\n", f, ZSTD_getErrorName(ret));
+                return -1;
+            }
+            if (ret == 0 && input.pos == input.size) return (long)output.pos;
+            if (input.pos == input.size && output.pos < output.size) {
+                fprintf(stderr, "Error: Frame %zu: Truncated zstd packet\n", f);
+                return -1;
+            }
+        }
+    }
+
+    if (frame->size >= 3 && memcmp(src, GZIP_MAGIC, 3) == 0) {
+        if (!w->zs_ready) {
+            if (inflateInit2(&w->zs, 16 + MAX_WBITS) != Z_OK) return -1;
+            w->zs_ready = 1;
+        } else {
+            inflateReset(&w->zs);
+        }
+        w->zs.next_in = (Bytef *)src;
+        w->zs.avail_in = frame->size;
+        size_t done = 0;
+        for (;;) {
+            if (done == w->packet_capacity && grow_packet(w, w->packet_capacity * 2) < 0) return -1;
+            w->zs.next_out = w->packet + done;
+            w->zs.avail_out = (uInt)(w->packet_capacity - done);
+            int ret = inflate(&w->zs, Z_NO_FLUSH);
+            done = w->packet_capacity - w->zs.avail_out;
+            if (ret == Z_STREAM_END) return (long)done;
+            if (ret != Z_OK && !(ret == Z_BUF_ERROR && w->zs.avail_out == 0)) {
+                fprintf(stderr, "Error: Frame %zu: Gzip decompression failed: %s\n", f,
+                        w->zs.msg ? w->zs.msg : "truncated data");
+                return -1;
+            }
+        }
+    }
+
+    // Stored as is
+    if (grow_packet(w, frame->size) < 0) return -1;
+    memcpy(w->packet, src, frame->size);
+    return (long)frame->size;
+}
+
+/**
+ * Bring w->blocks up to frame f. gop_start is set for the first frame of a
+ * GOP, which resets the reference and the zstd stream.
+ */
+static int decode_frame(decode_worker_t *w, size_t f, int gop_start) {
+    const mov_file_t *mov = w->job->mov;
+    const mov_frame_t *frame = &mov->frames[f];
+    int hi = frame->type >> 8;
+
+    if (!is_ipf_packet(frame->type)) {
+        fprintf(stderr, "Error: Frame %zu: Video packet %d,%d is not iPF; only iPF movies can be decoded\n",
+                f, frame->type & 255, hi);
+        return -1;
+    }
+
+    ipf_header_t header = {
+        .width = (uint16_t)mov->width,
+        .height = (uint16_t)mov->height,
+        .flags = (frame->type & 1) ? IPF_FLAG_ALPHA : 0,
+        .type = (uint8_t)(hi & 1),
+        .uncompressed_size = 0
+    };
+
+    if (gop_start) {
+        w->header = header;
+        ZSTD_DCtx_reset(w->dstream, ZSTD_reset_session_only);
+        if (hi >= 2) memset(w->blocks, 0, ipf_blocks_size(&header));  // Movie starts without a keyframe
+    } else if (hi < 2) {
+        w->header = header;
+    } else if (header.type != w->header.type || header.flags != w->header.flags) {
+        fprintf(stderr, "Error: Frame %zu: Delta frame does not match its keyframe's type\n", f);
+        return -1;
+    }
+
+    long len = unpack_frame(w, f);
+    if (len < 0) return -1;
+    w->raw_bytes += (uint64_t)len;
+
+    if (hi < 2) {
+        if ((size_t)len != ipf_blocks_size(&header)) {
+            fprintf(stderr, "Error: Frame %zu: Keyframe holds %ld bytes, expected %zu\n", f, len,
+                    ipf_blocks_size(&header));
+            return -1;
+        }
+        memcpy(w->blocks, w->packet, (size_t)len);
+    } else {
+        int err = ipf_delta_apply(&w->header, w->packet, (size_t)len, w->blocks);
+        if (err < 0) {
+            fprintf(stderr, "Error: Frame %zu: %s\n", f, ipf_strerror(err));
+            return -1;
+        }
+    }
+    w->frames++;
+    return 0;
+}
+
+/**
+ * Convert the current blocks to job->channels pixels. Frames without alpha
+ * in a movie with alpha are widened to opaque RGBA.
+ */
+static void render_frame(decode_worker_t *w, uint8_t *pixels) {
+    decode_job_t *job = w->job;
+    int has_alpha = (w->header.flags & IPF_FLAG_ALPHA) != 0;
+    int channels = has_alpha ? 4 : 3;
+    size_t stride = (size_t)ipf_blocks_x(&w->header) * 4 * channels;
+
+    ipf_decode_image(&w->header, w->blocks, IPF_PIXELS_RGB, pixels, stride);
+    if (channels == job->channels) return;
+
+    // Widen in place from the end, where the RGBA rows sit past the RGB ones
+    for (size_t y = ipf_blocks_y(&w->header) * 4; y-- > 0;) {
+        const uint8_t *src = pixels + y * stride;
+        uint8_t *dst = pixels + y * job->stride;
+        for (size_t x = (size_t)ipf_blocks_x(&w->header) * 4; x-- > 0;) {
+            dst[x * 4 + 3] = 255;
+            dst[x * 4 + 2] = src[x * 3 + 2];
+            dst[x * 4 + 1] = src[x * 3 + 1];
+            dst[x * 4] = src[x * 3];
+        }
+    }
+}
+
+static int write_image(decode_worker_t *w, size_t f) {
+    decode_job_t *job = w->job;
+    char path[MAX_PATH];
+    snprintf(path, sizeof(path), job->cfg->output_file, (int)(f + 1));
+
+    render_frame(w, w->pixels);
+    image_writer_t *writer = image_writer_open(path, job->fmt, job->mov->width, job->mov->height,
+                                               job->channels, &job->cfg->writer_opts);
+    if (!writer) return -1;
+    int result = image_writer_write_rows(writer, w->pixels, job->stride, job->mov->height);
+    if (image_writer_close(writer) < 0) result = -1;
+    if (result < 0) fprintf(stderr, "Error: Failed to write %s\n", path);
+    return result;
+}
+
+/**
+ * Hand frame f to the stream writer, waiting while it is too far ahead of
+ * the frames already written.
+ */
+static int queue_frame(decode_worker_t *w, size_t f) {
+    decode_job_t *job = w->job;
+
+    pthread_mutex_lock(&job->lock);
+    while (!job->failed && f >= job->next_write + job->window_size) pthread_cond_wait(&job->cond, &job->lock);
+    int failed = job->failed;
+    pthread_mutex_unlock(&job->lock);
+    if (failed) return -1;
+
+    window_slot_t *slot = &job->window[f % job->window_size];
+    render_frame(w, slot->pixels);
+
+    pthread_mutex_lock(&job->lock);
+    slot->ready = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    return 0;
+}
+
+static int decode_gop(decode_worker_t *w, size_t g) {
+    decode_job_t *job = w->job;
+    const mov_file_t *mov = job->mov;
+    size_t end = g + 1 < mov->gop_count ? mov->gops[g + 1] : mov->frame_count;
+    if (end > job->last) end = job->last;
+
+    for (size_t f = mov->gops[g]; f < end; f++) {
+        if (decode_frame(w, f, f == mov->gops[g]) < 0) return -1;
+        if (f < job->first) continue;
+
+        int result = 0;
+        if (job->mode == OUTPUT_IMAGES) result = write_image(w, f);
+        else if (job->mode == OUTPUT_STREAM) result = queue_frame(w, f);
+        if (result < 0) return -1;
+    }
+    return 0;
+}
+
+static void *decode_worker_main(void *arg) {
+    decode_worker_t *w = arg;
+    decode_job_t *job = w->job;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t g = job->next_gop++;
+        int stop = job->failed || g > job->last_gop;
+        pthread_mutex_unlock(&job->lock);
+        if (stop) break;
+
+        if (decode_gop(w, g) < 0) {
+            pthread_mutex_lock(&job->lock);
+            job->failed = 1;
+            pthread_cond_broadcast(&job->cond);
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+    }
+    return NULL;
+}
+
+// =============================================================================
+// Output
+// =============================================================================
+
+/**
+ * Open the single output of OUTPUT_STREAM: raw pixels, or FFmpeg encoding
+ * a video at the movie's frame rate.
+ */
+static FILE *open_stream(const decoder_config_t *cfg, const mov_file_t *mov, int channels, int *is_pipe) {
+    *is_pipe = 0;
+    if (strcmp(cfg->output_file, "-") == 0) return stdout;
+    if (cfg->raw_output || cfg->format == IMG_FMT_RAW) return fopen(cfg->output_file, "wb");
+
+    char rate[32] = "";
+    if (mov->fps > 0) snprintf(rate, sizeof(rate), "-r %d ", mov->fps);
+
+    char cmd[MAX_PATH * 2];
+    snprintf(cmd, sizeof(cmd),
+             "ffmpeg -hide_banner -v quiet -y -f rawvideo -pix_fmt %s -s %dx%d %s-i - \"%s\"",
+             channels == 4 ? "rgba" : "rgb24", mov->width, mov->height, rate, cfg->output_file);
+    if (cfg->verbose) fprintf(cfg->msg, "FFmpeg command: %s\n", cmd);
+
+    // A missing or failed FFmpeg then shows up as a write error
+    signal(SIGPIPE, SIG_IGN);
+    *is_pipe = 1;
+    return popen(cmd, "w");
+}
+
+/**
+ * Write the frames the workers queue, in order. Returns 0 once every frame
+ * in the range is out.
+ */
+static int write_stream(decode_job_t *job, FILE *out) {
+    size_t row_bytes = (size_t)job->mov->width * job->channels;
+
+    for (size_t f = job->first; f < job->last; f++) {
+        window_slot_t *slot = &job->window[f % job->window_size];
+
+        pthread_mutex_lock(&job->lock);
+        while (!job->failed && !slot->ready) pthread_cond_wait(&job->cond, &job->lock);
+        int failed = job->failed;
+        pthread_mutex_unlock(&job->lock);
+        if (failed) return -1;
+
+        int ok = 1;
+        for (int y = 0; y < job->mov->height && ok; y++) {
+            ok = fwrite(slot->pixels + y * job->stride, 1, row_bytes, out) == row_bytes;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        slot->ready = 0;
+        job->next_write = f + 1;
+        if (!ok) job->failed = 1;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+
+        if (!ok) {
+            fprintf(stderr, "Error: Failed to write output\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static output_mode_t pick_output(const decoder_config_t *cfg, image_format_t *fmt) {
+    *fmt = IMG_FMT_RAW;
+    if (!cfg->output_file) return OUTPUT_NONE;
+    if (cfg->raw_output || strcmp(cfg->output_file, "-") == 0) return OUTPUT_STREAM;
+
+    int pattern = is_frame_pattern(cfg->output_file);
+    if (pattern < 0) {
+        fprintf(stderr, "Error: Output pattern needs exactly one %%d: %s\n", cfg->output_file);
+        return (output_mode_t)-1;
+    }
+
+    *fmt = cfg->format >= 0 ? (image_format_t)cfg->format : image_format_from_path(cfg->output_file);
+    if (pattern) {
+        if (*fmt == IMG_FMT_FFMPEG) {
+            fprintf(stderr, "Error: Frame images need a native format (png, qoi, ppm, pam, tga, raw)\n");
+            return (output_mode_t)-1;
+        }
+        return OUTPUT_IMAGES;
+    }
+    if (*fmt != IMG_FMT_FFMPEG && *fmt != IMG_FMT_RAW) {
+        fprintf(stderr, "Error: Use a frame pattern such as out/%%05d.%s to write images\n", image_format_name(*fmt));
+        return (output_mode_t)-1;
+    }
+    return OUTPUT_STREAM;
+}
+
+// =============================================================================
+// Decoding
+// =============================================================================
+
+static int decode_mov(const decoder_config_t *cfg) {
+    mov_file_t mov;
+    mov_stats_t stats = { .second = -1 };
+    FILE *audio_out = NULL;
+    int result = -1;
+
+    image_format_t fmt;
+    output_mode_t mode = pick_output(cfg, &fmt);
+    if ((int)mode < 0) return -1;
+
+    if (open_mov(cfg->input_file, &mov) < 0) goto done;
+
+    if (cfg->audio_file) {
+        audio_out = fopen(cfg->audio_file, "wb");
+        if (!audio_out) {
+            fprintf(stderr, "Error: Cannot create %s: %s\n", cfg->audio_file, strerror(errno));
+            goto done;
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (demux_mov(cfg, &mov, audio_out, &stats) < 0) goto done;
+    if (audio_out) {
+        int closed = fclose(audio_out);
+        audio_out = NULL;
+        if (closed != 0) {
+            fprintf(stderr, "Error: Failed to write %s\n", cfg->audio_file);
+            goto done;
+        }
+        if (cfg->verbose) fprintf(cfg->msg, "Audio: %zu packets to %s\n", stats.audio_packets, cfg->audio_file);
+    }
+    if (cfg->stats) print_stats(cfg, &mov, &stats);
+
+    if (mov.frame_count == 0) {
+        fprintf(stderr, "Error: No video frames in %s\n", cfg->input_file);
+        goto done;
+    }
+    if ((size_t)cfg->start >= mov.frame_count) {
+        fprintf(stderr, "Error: Start frame %d is past the last frame (%zu)\n", cfg->start, mov.frame_count - 1);
+        goto done;
+    }
+
+    decode_job_t job = {
+        .cfg = cfg,
+        .mov = &mov,
+        .mode = mode,
+        .fmt = fmt,
+        .channels = mov.has_alpha ? 4 : 3,
+        .first = (size_t)cfg->start,
+        .last = mov.frame_count,
+        .next_write = (size_t)cfg->start,
+    };
+    if (cfg->count > 0 && job.first + (size_t)cfg->count < job.last) job.last = job.first + (size_t)cfg->count;
+
+    // Only the GOPs holding the requested frames
+    for (size_t g = 0; g < mov.gop_count; g++) {
+        if (mov.gops[g] <= job.first) job.next_gop = g;
+        if (mov.gops[g] < job.last) job.last_gop = g;
+    }
+    size_t gops = job.last_gop - job.next_gop + 1;
+
+    ipf_header_t padded = { .width = (uint16_t)mov.width, .height = (uint16_t)mov.height };
+    job.stride = (size_t)ipf_blocks_x(&padded) * 4 * job.channels;
+    job.pixels_size = job.stride * ipf_blocks_y(&padded) * 4;
+
+    // Largest block stream any frame can have: iPF2 with alpha
+    ipf_header_t largest = { .width = (uint16_t)mov.width, .height = (uint16_t)mov.height,
+                             .flags = IPF_FLAG_ALPHA, .type = IPF_TYPE_2 };
+
+    int jobs = cfg->jobs;
+    if (jobs <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = n > 0 ? (int)n : 1;
+    }
+    if ((size_t)jobs > gops) jobs = (int)gops;
+
+    FILE *out = NULL;
+    int out_is_pipe = 0;
+    if (mode == OUTPUT_STREAM) {
+        job.window_size = MOV_WINDOW_BYTES / job.pixels_size;
+        if (job.window_size < (size_t)jobs * 2) job.window_size = (size_t)jobs * 2;
+        if (job.window_size > job.last - job.first) job.window_size = job.last - job.first;
+        job.window = calloc(job.window_size, sizeof(window_slot_t));
+        for (size_t i = 0; job.window && i < job.window_size; i++) {
+            job.window[i].pixels = malloc(job.pixels_size);
+            if (!job.window[i].pixels) {
+                job.window_size = i;
+                fprintf(stderr, "Error: Failed to allocate frame buffers\n");
+                goto cleanup_window;
+            }
+        }
+        if (!job.window) {
+            fprintf(stderr, "Error: Failed to allocate frame buffers\n");
+            goto done;
+        }
+
+        out = open_stream(cfg, &mov, job.channels, &out_is_pipe);
+        if (!out) {
+            fprintf(stderr, "Error: Cannot open %s: %s\n", cfg->output_file, strerror(errno));
+            goto cleanup_window;
+        }
+    }
+
+    decode_worker_t *workers = calloc(jobs, sizeof(decode_worker_t));
+    if (!workers) {
+        fprintf(stderr, "Error: Failed to allocate workers\n");
+        goto cleanup_output;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    if (cfg->verbose) {
+        fprintf(cfg->msg, "Decoding frames %zu-%zu (%zu GOPs) with %d worker%s\n", job.first, job.last - 1,
+                gops, jobs, jobs == 1 ? "" : "s");
+    }
+
+    int started = 0;
+    for (int i = 0; i < jobs; i++) {
+        decode_worker_t *w = &workers[i];
+        w->job = &job;
+        w->dctx = ZSTD_createDCtx();
+        w->dstream = ZSTD_createDCtx();
+        w->blocks = malloc(ipf_blocks_size(&largest));
+        w->pixels = mode == OUTPUT_IMAGES ? malloc(job.pixels_size) : NULL;
+        if (!w->dctx || !w->dstream || !w->blocks || (mode == OUTPUT_IMAGES && !w->pixels) ||
+            grow_packet(w, ipf_delta_bound(&largest)) < 0) {
+            fprintf(stderr, "Error: Failed to allocate decoder buffers\n");
+            break;
+        }
+        if (pthread_create(&w->thread, NULL, decode_worker_main, w) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread\n");
+            break;
+        }
+        started++;
+    }
+
+    int ok = started > 0;
+    if (!ok) job.failed = 1;
+    if (ok && mode == OUTPUT_STREAM && write_stream(&job, out) < 0) ok = 0;
+
+    size_t decoded = 0;
+    uint64_t raw_bytes = 0;
+    for (int i = 0; i < jobs; i++) {
+        decode_worker_t *w = &workers[i];
+        if (i < started) pthread_join(w->thread, NULL);
+        decoded += w->frames;
+        raw_bytes += w->raw_bytes;
+        if (w->dctx) ZSTD_freeDCtx(w->dctx);
+        if (w->dstream) ZSTD_freeDCtx(w->dstream);
+        if (w->zs_ready) inflateEnd(&w->zs);
+        free(w->packet);
+        free(w->blocks);
+        free(w->pixels);
+    }
+    if (job.failed) ok = 0;
+    free(workers);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+
+    if (ok) {
+        double secs = elapsed_seconds(&start);
+        if (secs <= 0) secs = 1e-9;
+        fprintf(cfg->msg, "Decoded %zu frames, %zu output, in %.3f s (%.1f fps)\n", decoded,
+                job.last - job.first, secs, decoded / secs);
+        if (cfg->verbose) {
+            fprintf(cfg->msg, "  %.2f MB of packets inflated to %.2f MB of blocks\n",
+                    mov.size / 1e6, raw_bytes / 1e6);
+        }
+        result = 0;
+    }
+
+cleanup_output:
+    if (out && out != stdout) {
+        int closed = out_is_pipe ? pclose(out) : fclose(out);
+        if (closed != 0 && result == 0) {
+            fprintf(stderr, "Error: Failed to finish %s\n", cfg->output_file);
+            result = -1;
+        }
+    } else if (out == stdout && fflush(stdout) != 0) {
+        result = -1;
+    }
+
+cleanup_window:
+    for (size_t i = 0; job.window && i < job.window_size; i++) free(job.window[i].pixels);
+    free(job.window);
+
+done:
+    if (audio_out) fclose(audio_out);
+    close_mov(&mov);
+    return result;
+}
+
+// =============================================================================
+// Main Entry Point
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    decoder_config_t cfg = {
+        .input_file = NULL,
+        .output_file = NULL,
+        .audio_file = NULL,
+        .verbose = 0,
+        .raw_output = 0,
+        .msg = stdout,
+        .format = -1,
+        .writer_opts = IMAGE_WRITER_OPTS_DEFAULT,
+        .jobs = 0,
+        .stats = 0,
+        .start = 0,
+        .count = 0
+    };
+
+    static struct option long_options[] = {
+        {"input",      required_argument, 0, 'i'},
+        {"output",     required_argument, 0, 'o'},
+        {"raw",        no_argument,       0, 'R'},
+        {"format",     required_argument, 0, 'f'},
+        {"png-level",  required_argument, 0, 'L'},
+        {"png-filter", required_argument, 0, 'F'},
+        {"audio",      required_argument, 0, 'a'},
+        {"start",      required_argument, 0, 's'},
+        {"frames",     required_argument, 0, 'n'},
+        {"jobs",       required_argument, 0, 'j'},
+        {"stats",      no_argument,       0, 'S'},
+        {"verbose",    no_argument,       0, 'v'},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:o:f:a:s:n:j:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                cfg.input_file = optarg;
+                break;
+            case 'o':
+                cfg.output_file = optarg;
+                break;
+            case 'R':
+                cfg.raw_output = 1;
+                break;
+            case 'f':
+                cfg.format = image_format_from_name(optarg);
+                if (cfg.format < 0) {
+                    fprintf(stderr, "Error: Unknown output format: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                cfg.writer_opts.png_level = atoi(optarg);
+                if (cfg.writer_opts.png_level < 0 || cfg.writer_opts.png_level > 9) {
+                    fprintf(stderr, "Error: PNG level must be 0-9\n");
+                    return 1;
+                }
+                break;
+            case 'F':
+                cfg.writer_opts.png_filter = png_filter_from_name(optarg);
+                if (cfg.writer_opts.png_filter < 0) {
+                    fprintf(stderr, "Error: Unknown PNG filter: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                cfg.audio_file = optarg;
+                break;
+            case 's':
+                cfg.start = atoi(optarg);
+                if (cfg.start < 0) {
+                    fprintf(stderr, "Error: Start frame must not be negative\n");
+                    return 1;
+                }
+                break;
+            case 'n':
+                cfg.count = atoi(optarg);
+                if (cfg.count < 1) {
+                    fprintf(stderr, "Error: Frame count must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'j':
+                cfg.jobs = atoi(optarg);
+                if (cfg.jobs < 1) {
+                    fprintf(stderr, "Error: Jobs must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'S':
+                cfg.stats = 1;
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                cfg.writer_opts.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.input_file) {
+        fprintf(stderr, "Error: Input file is required\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (cfg.raw_output && !cfg.output_file) {
+        fprintf(stderr, "Error: --raw needs an output file, or -o - for stdout\n");
+        return 1;
+    }
+
+    // Keep stdout clean when it carries the pixel stream
+    if (cfg.output_file && strcmp(cfg.output_file, "-") == 0) {
+        cfg.msg = stderr;
+    }
+
+    return decode_mov(&cfg) == 0 ? 0 : 1;
+}
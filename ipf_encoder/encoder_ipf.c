@@ -8,6 +8,19 @@
  * - Optional alpha channel
  * - Optional Adam7 progressive ordering
  *
+ * --indexed writes a 256-colour image instead: pixels dithered to 4-4-4 and
+ * mapped to the default palette, one byte each, for a plain copy into the
+ * framebuffer in graphics mode 0. Alpha becomes a key on palette entry 255.
+ *
+ * Blocks are encoded by libipf, exactly as the VM's encodeIpf1/encodeIpf2.
+ *
+ * --stats reports where the time goes (ffprobe, FFmpeg decode, block
+ * quantisation, Zstd, file write); see ipf_stats.h.
+ *
+ * --auto encodes every type, dither and alpha choice on its own thread,
+ * decodes each with libipf as the VM would, and writes the smallest file
+ * whose PSNR or SSIM reaches the floor given.
+ *
  * Created by CuriousTorvald and Claude on 2025-12-19.
  */
 
@@ -17,64 +30,58 @@
 #include <string.h>
 #include <math.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <zstd.h>
 
+#include "ipf_stats.h"
+#include "libipf.h"
+
 // =============================================================================
 // Constants
 // =============================================================================
 
-#define IPF_MAGIC "\x1F\x54\x53\x56\x4D\x69\x50\x46"  // "\x1FTSVMiPF"
-#define IPF_HEADER_SIZE 28  // 8 magic + 2 width + 2 height + 1 flags + 1 type + 10 reserved + 4 uncompressed size
-
 #define DEFAULT_WIDTH 560
 #define DEFAULT_HEIGHT 448
 
-#define IPF_TYPE_1 0  // 4:2:0 chroma subsampling (12 bytes per block, +8 with alpha)
-#define IPF_TYPE_2 1  // 4:2:2 chroma subsampling (16 bytes per block, +8 with alpha)
+#define IPF_ZSTD_LEVEL 7
 
-#define IPF_FLAG_ALPHA       0x01  // Has alpha channel
-#define IPF_FLAG_ZSTD        0x10  // Zstd compressed
-#define IPF_FLAG_PROGRESSIVE 0x80  // Adam7 progressive ordering
+// --auto also tries this level; the format doesn't record it, so any level decodes
+#define AUTO_ZSTD_LEVEL_MAX 19
+#define AUTO_MAX_CANDIDATES 8  // Type x dither x alpha kept or stripped
 
-#define MAX_PATH 4096
+#define AUTO_DEFAULT_SSIM 0.90
+
+#define SSIM_WINDOW 8
+#define SSIM_STEP 4
 
-// Bayer dithering kernel (4x4)
-static const float BAYER_4X4[16] = {
-     0.0f/16.0f,  8.0f/16.0f,  2.0f/16.0f, 10.0f/16.0f,
-    12.0f/16.0f,  4.0f/16.0f, 14.0f/16.0f,  6.0f/16.0f,
-     3.0f/16.0f, 11.0f/16.0f,  1.0f/16.0f,  9.0f/16.0f,
-    15.0f/16.0f,  7.0f/16.0f, 13.0f/16.0f,  5.0f/16.0f
-};
-
-// Adam7 interlace pattern - pass number (1-7) for each pixel in 8x8 block
-// 0 = not in this standard pattern, we'll adapt for 4x4 blocks
-static const int ADAM7_PASS[8][8] = {
-    {1, 6, 4, 6, 2, 6, 4, 6},
-    {7, 7, 7, 7, 7, 7, 7, 7},
-    {5, 6, 5, 6, 5, 6, 5, 6},
-    {7, 7, 7, 7, 7, 7, 7, 7},
-    {3, 6, 4, 6, 3, 6, 4, 6},
-    {7, 7, 7, 7, 7, 7, 7, 7},
-    {5, 6, 5, 6, 5, 6, 5, 6},
-    {7, 7, 7, 7, 7, 7, 7, 7}
-};
+#define MAX_PATH 4096
 
 // =============================================================================
 // Structures
 // =============================================================================
 
+typedef enum {
+    AUTO_OFF = 0,
+    AUTO_PSNR,           // Floor in dB
+    AUTO_SSIM            // Floor in 0..1
+} auto_metric_t;
+
 typedef struct {
     char *input_file;
     char *output_file;
     int width;
     int height;
-    int ipf_type;        // 0 = iPF1, 1 = iPF2
+    int ipf_type;        // 0 = iPF1, 1 = iPF2, 2 = indexed
     int use_zstd;        // 1 = compress with Zstd
     int force_alpha;     // 1 = force alpha channel in output
     int no_alpha;        // 1 = strip alpha even if present in input
     int progressive;     // 1 = Adam7 progressive ordering
     int dither;          // Bayer dither pattern index (-1 = no dithering)
     int verbose;
+    auto_metric_t auto_metric;  // --auto: pick the smallest file meeting auto_floor
+    double auto_floor;
+    ipf_stats_output_t stats_out;
+    ipf_stats_t *stats;  // NULL unless stats or a trace were asked for
 } encoder_config_t;
 
 typedef struct {
@@ -85,6 +92,40 @@ typedef struct {
     int has_alpha;       // 1 if input image has meaningful alpha
 } image_t;
 
+/**
+ * An image as --auto compares it: colour premultiplied by alpha, so the
+ * colour of transparent pixels doesn't count and wrong or stripped alpha
+ * does, as planes so the sums over them vectorise.
+ */
+typedef struct {
+    int width;
+    int height;
+    uint8_t *planes[3];  // Premultiplied R, G, B
+    uint8_t *luma;       // Of the premultiplied colour, for SSIM
+} quality_planes_t;
+
+/**
+ * One --auto configuration: its blocks are encoded, decoded and measured on
+ * a thread of its own, then compressed at each level allowed.
+ */
+typedef struct {
+    const image_t *img;
+    const quality_planes_t *ref;
+    encoder_config_t cfg;  // Type, dither, zstd and order; no stats
+    int has_alpha;
+    pthread_t thread;
+
+    uint8_t *blocks;
+    size_t blocks_size;
+    uint8_t *packed;       // Compressed blocks, NULL when stored as they are
+    size_t packed_size;
+    int level;             // Zstd level of packed
+    size_t file_size;
+    double psnr;
+    double ssim;
+    int failed;
+} auto_candidate_t;
+
 // =============================================================================
 // Utility Functions
 // =============================================================================
@@ -98,26 +139,29 @@ static void print_usage(const char *program) {
     printf("\nOptions:\n");
     printf("  -s, --size WxH           Output size (default: %dx%d)\n", DEFAULT_WIDTH, DEFAULT_HEIGHT);
     printf("  -t, --type N             iPF type: 1 (4:2:0, default) or 2 (4:2:2)\n");
+    printf("  --indexed                256-colour default-palette indices instead of YCoCg\n");
+    printf("                           blocks, shown with a single copy in graphics mode 0\n");
     printf("  --no-zstd                Disable Zstd compression (default: enabled)\n");
     printf("  --alpha                  Force alpha channel in output\n");
     printf("  --no-alpha               Strip alpha channel from input\n");
     printf("  -p, --progressive        Use Adam7 progressive ordering\n");
     printf("  -d, --dither N           Bayer dither pattern (0=4x4, -1=none, default: 0)\n");
+    printf("  --auto[=METRIC:FLOOR]    Write the smallest encoding whose psnr (dB) or ssim\n");
+    printf("                           reaches FLOOR (default: ssim:%.2f), trying both types,\n", AUTO_DEFAULT_SSIM);
+    printf("                           dither on and off, alpha kept or stripped and zstd\n");
+    printf("                           levels %d and %d; overrides -t and -d\n", IPF_ZSTD_LEVEL, AUTO_ZSTD_LEVEL_MAX);
+    printf("  --stats[=FMT[:FILE]]     Report stage timings and counters as text or json\n");
+    printf("                           (default: text, to stderr; a FILE is appended to)\n");
+    printf("  --trace FILE             Write a Chrome trace of the stages to FILE\n");
     printf("  -v, --verbose            Verbose output\n");
     printf("  -h, --help               Show this help\n");
     printf("\nExamples:\n");
     printf("  %s -i photo.jpg -o photo.ipf\n", program);
     printf("  %s -i logo.png -o logo.ipf --alpha\n", program);
     printf("  %s -i image.png -o image.ipf -s 280x224 -t 2\n", program);
-}
-
-static int clampi(int v, int lo, int hi) {
-    return v < lo ? lo : (v > hi ? hi : v);
-}
-
-// Convert chroma value [-1..1] to 4-bit [0..15]
-static int chroma_to_four_bits(float f) {
-    return clampi((int)roundf(f * 8.0f) + 7, 0, 15);
+    printf("  %s -i sprite.png -o sprite.ipf --auto=psnr:30\n", program);
+    printf("  %s -i title.png -o title.ipf --indexed --alpha\n", program);
+    printf("\nIPF_STATS=json[:FILE] and IPF_TRACE=FILE do the same as --stats and --trace.\n");
 }
 
 // =============================================================================
@@ -179,13 +223,15 @@ static int probe_image_dimensions(const char *input_file, int *width, int *heigh
  * Returns image data or NULL on error.
  */
 static image_t* load_image(const char *input_file, int target_width, int target_height,
-                           int want_alpha, int verbose) {
+                           int want_alpha, int verbose, ipf_stats_t *stats) {
     int src_width, src_height, src_has_alpha;
 
     // Probe source dimensions
+    uint64_t t = ipf_stats_start(stats);
     if (probe_image_dimensions(input_file, &src_width, &src_height, &src_has_alpha) < 0) {
         return NULL;
     }
+    t = ipf_stats_lap(stats, "probe", t);
 
     if (verbose) {
         printf("Source image: %dx%d, alpha: %s\n",
@@ -237,6 +283,7 @@ static image_t* load_image(const char *input_file, int target_width, int target_
     // Read image data
     size_t bytes_read = fread(img->data, 1, data_size, fp);
     pclose(fp);
+    ipf_stats_lap(stats, "load", t);
 
     if (bytes_read != data_size) {
         fprintf(stderr, "Error: Expected %zu bytes, got %zu\n", data_size, bytes_read);
@@ -265,303 +312,165 @@ static void free_image(image_t *img) {
 // =============================================================================
 
 /**
- * Encode a 4x4 block to YCoCg with dithering.
- * Returns arrays of Y (16 values), A (16 values), Co (16 values), Cg (16 values).
+ * The header an image is written with; uncompressed_size is the block data.
+ * Progressive files always carry the zstd flag.
  */
-static void encode_block_to_ycocg(const image_t *img, int block_x, int block_y,
-                                  int dither_pattern,
-                                  int *Y_out, int *A_out, float *Co_out, float *Cg_out) {
-    for (int py = 0; py < 4; py++) {
-        for (int px = 0; px < 4; px++) {
-            int ox = block_x * 4 + px;
-            int oy = block_y * 4 + py;
-
-            // Handle out-of-bounds (extend edge pixels)
-            ox = clampi(ox, 0, img->width - 1);
-            oy = clampi(oy, 0, img->height - 1);
-
-            // Get dither threshold
-            float t = 0.0f;
-            if (dither_pattern >= 0) {
-                t = BAYER_4X4[(py % 4) * 4 + (px % 4)];
-            }
+static ipf_header_t make_header(const encoder_config_t *cfg, const image_t *img, int has_alpha) {
+    uint8_t flags = 0;
+    if (has_alpha) flags |= IPF_FLAG_ALPHA;
+    if (cfg->use_zstd) flags |= IPF_FLAG_ZSTD;
+    if (cfg->progressive) flags |= IPF_FLAG_PROGRESSIVE | IPF_FLAG_ZSTD;
 
-            // Read pixel
-            int offset = (oy * img->width + ox) * img->channels;
-            float r0 = img->data[offset + 0] / 255.0f;
-            float g0 = (img->channels >= 3) ? img->data[offset + 1] / 255.0f : r0;
-            float b0 = (img->channels >= 3) ? img->data[offset + 2] / 255.0f : r0;
-            float a0 = (img->channels == 4) ? img->data[offset + 3] / 255.0f : 1.0f;
-
-            // Apply dithering
-            float r = floorf((t / 15.0f + r0) * 15.0f) / 15.0f;
-            float g = floorf((t / 15.0f + g0) * 15.0f) / 15.0f;
-            float b = floorf((t / 15.0f + b0) * 15.0f) / 15.0f;
-            float a = floorf((t / 15.0f + a0) * 15.0f) / 15.0f;
-
-            // Convert to YCoCg
-            float co = r - b;           // [-1..1]
-            float tmp = b + co / 2.0f;
-            float cg = g - tmp;         // [-1..1]
-            float y = tmp + cg / 2.0f;  // [0..1]
-
-            int index = py * 4 + px;
-            Y_out[index] = (int)roundf(y * 15.0f);
-            A_out[index] = (int)roundf(a * 15.0f);
-            Co_out[index] = co;
-            Cg_out[index] = cg;
-        }
-    }
+    ipf_header_t header = { (uint16_t)img->width, (uint16_t)img->height, flags, (uint8_t)cfg->ipf_type, 0 };
+    header.uncompressed_size = (uint32_t)ipf_blocks_size(&header);
+    return header;
 }
 
 /**
- * Encode iPF1 block (4:2:0 chroma subsampling).
- * Returns 12 bytes (or 20 with alpha).
+ * Encode blocks with libipf, in raster or Adam7 order as the header says.
+ * ipf_encode_image reads whole 4x4 areas, so an image whose size is not a
+ * multiple of 4 is copied with its edge pixels repeated into the padding.
  */
-static int encode_ipf1_block(const int *Ys, const int *As, const float *COs, const float *CGs,
-                             int has_alpha, uint8_t *out) {
-    // Subsample Co/Cg by averaging 2x2 regions (4:2:0)
-    int cos1 = chroma_to_four_bits((COs[0] + COs[1] + COs[4] + COs[5]) / 4.0f);
-    int cos2 = chroma_to_four_bits((COs[2] + COs[3] + COs[6] + COs[7]) / 4.0f);
-    int cos3 = chroma_to_four_bits((COs[8] + COs[9] + COs[12] + COs[13]) / 4.0f);
-    int cos4 = chroma_to_four_bits((COs[10] + COs[11] + COs[14] + COs[15]) / 4.0f);
-
-    int cgs1 = chroma_to_four_bits((CGs[0] + CGs[1] + CGs[4] + CGs[5]) / 4.0f);
-    int cgs2 = chroma_to_four_bits((CGs[2] + CGs[3] + CGs[6] + CGs[7]) / 4.0f);
-    int cgs3 = chroma_to_four_bits((CGs[8] + CGs[9] + CGs[12] + CGs[13]) / 4.0f);
-    int cgs4 = chroma_to_four_bits((CGs[10] + CGs[11] + CGs[14] + CGs[15]) / 4.0f);
-
-    // Pack according to iPF1 format
-    // uint16 [Co4 | Co3 | Co2 | Co1]
-    out[0] = (cos2 << 4) | cos1;
-    out[1] = (cos4 << 4) | cos3;
-    // uint16 [Cg4 | Cg3 | Cg2 | Cg1]
-    out[2] = (cgs2 << 4) | cgs1;
-    out[3] = (cgs4 << 4) | cgs3;
-    // Y values: [Y1|Y0|Y5|Y4], [Y3|Y2|Y7|Y6], [Y9|Y8|YD|YC], [YB|YA|YF|YE]
-    out[4] = (Ys[1] << 4) | Ys[0];
-    out[5] = (Ys[5] << 4) | Ys[4];
-    out[6] = (Ys[3] << 4) | Ys[2];
-    out[7] = (Ys[7] << 4) | Ys[6];
-    out[8] = (Ys[9] << 4) | Ys[8];
-    out[9] = (Ys[13] << 4) | Ys[12];
-    out[10] = (Ys[11] << 4) | Ys[10];
-    out[11] = (Ys[15] << 4) | Ys[14];
-
-    int block_size = 12;
-
-    if (has_alpha) {
-        // Alpha values: same layout as Y
-        out[12] = (As[1] << 4) | As[0];
-        out[13] = (As[5] << 4) | As[4];
-        out[14] = (As[3] << 4) | As[2];
-        out[15] = (As[7] << 4) | As[6];
-        out[16] = (As[9] << 4) | As[8];
-        out[17] = (As[13] << 4) | As[12];
-        out[18] = (As[11] << 4) | As[10];
-        out[19] = (As[15] << 4) | As[14];
-        block_size = 20;
-    }
-
-    return block_size;
-}
+static uint8_t* encode_blocks(const image_t *img, const encoder_config_t *cfg,
+                              int has_alpha, size_t *out_size) {
+    ipf_header_t header = make_header(cfg, img, has_alpha);
+    size_t size = ipf_blocks_size(&header);
+    int channels = img->channels;
+    size_t stride = (size_t)img->width * channels;
+    const uint8_t *src = img->data;
+    uint8_t *padded = NULL;
+
+    if (ipf_encode_src_span(&header, stride, channels) > stride * img->height) {
+        int padded_width = ipf_blocks_x(&header) * 4;
+        int padded_height = ipf_blocks_y(&header) * 4;
+        size_t padded_stride = (size_t)padded_width * channels;
+        padded = malloc(padded_stride * padded_height);
+        if (!padded) return NULL;
+        for (int y = 0; y < padded_height; y++) {
+            const uint8_t *row = img->data + (size_t)(y < img->height ? y : img->height - 1) * stride;
+            uint8_t *out = padded + (size_t)y * padded_stride;
+            memcpy(out, row, stride);
+            for (int x = img->width; x < padded_width; x++) {
+                memcpy(out + (size_t)x * channels, row + stride - channels, channels);
+            }
+        }
+        src = padded;
+        stride = padded_stride;
+    }
 
-/**
- * Encode iPF2 block (4:2:2 chroma subsampling).
- * Returns 16 bytes (or 24 with alpha).
- */
-static int encode_ipf2_block(const int *Ys, const int *As, const float *COs, const float *CGs,
-                             int has_alpha, uint8_t *out) {
-    // Subsample Co/Cg horizontally only (4:2:2) - 8 values each
-    int cos1 = chroma_to_four_bits((COs[0] + COs[1]) / 2.0f);
-    int cos2 = chroma_to_four_bits((COs[2] + COs[3]) / 2.0f);
-    int cos3 = chroma_to_four_bits((COs[4] + COs[5]) / 2.0f);
-    int cos4 = chroma_to_four_bits((COs[6] + COs[7]) / 2.0f);
-    int cos5 = chroma_to_four_bits((COs[8] + COs[9]) / 2.0f);
-    int cos6 = chroma_to_four_bits((COs[10] + COs[11]) / 2.0f);
-    int cos7 = chroma_to_four_bits((COs[12] + COs[13]) / 2.0f);
-    int cos8 = chroma_to_four_bits((COs[14] + COs[15]) / 2.0f);
-
-    int cgs1 = chroma_to_four_bits((CGs[0] + CGs[1]) / 2.0f);
-    int cgs2 = chroma_to_four_bits((CGs[2] + CGs[3]) / 2.0f);
-    int cgs3 = chroma_to_four_bits((CGs[4] + CGs[5]) / 2.0f);
-    int cgs4 = chroma_to_four_bits((CGs[6] + CGs[7]) / 2.0f);
-    int cgs5 = chroma_to_four_bits((CGs[8] + CGs[9]) / 2.0f);
-    int cgs6 = chroma_to_four_bits((CGs[10] + CGs[11]) / 2.0f);
-    int cgs7 = chroma_to_four_bits((CGs[12] + CGs[13]) / 2.0f);
-    int cgs8 = chroma_to_four_bits((CGs[14] + CGs[15]) / 2.0f);
-
-    // Pack according to iPF2 format
-    // uint32 [Co8 | Co7 | Co6 | Co5 | Co4 | Co3 | Co2 | Co1]
-    out[0] = (cos2 << 4) | cos1;
-    out[1] = (cos4 << 4) | cos3;
-    out[2] = (cos6 << 4) | cos5;
-    out[3] = (cos8 << 4) | cos7;
-    // uint32 [Cg8 | Cg7 | Cg6 | Cg5 | Cg4 | Cg3 | Cg2 | Cg1]
-    out[4] = (cgs2 << 4) | cgs1;
-    out[5] = (cgs4 << 4) | cgs3;
-    out[6] = (cgs6 << 4) | cgs5;
-    out[7] = (cgs8 << 4) | cgs7;
-    // Y values: same as iPF1
-    out[8] = (Ys[1] << 4) | Ys[0];
-    out[9] = (Ys[5] << 4) | Ys[4];
-    out[10] = (Ys[3] << 4) | Ys[2];
-    out[11] = (Ys[7] << 4) | Ys[6];
-    out[12] = (Ys[9] << 4) | Ys[8];
-    out[13] = (Ys[13] << 4) | Ys[12];
-    out[14] = (Ys[11] << 4) | Ys[10];
-    out[15] = (Ys[15] << 4) | Ys[14];
-
-    int block_size = 16;
-
-    if (has_alpha) {
-        // Alpha values: same layout as Y
-        out[16] = (As[1] << 4) | As[0];
-        out[17] = (As[5] << 4) | As[4];
-        out[18] = (As[3] << 4) | As[2];
-        out[19] = (As[7] << 4) | As[6];
-        out[20] = (As[9] << 4) | As[8];
-        out[21] = (As[13] << 4) | As[12];
-        out[22] = (As[11] << 4) | As[10];
-        out[23] = (As[15] << 4) | As[14];
-        block_size = 24;
-    }
-
-    return block_size;
-}
+    uint8_t *output = malloc(size);
+    if (!output) {
+        free(padded);
+        return NULL;
+    }
 
-// =============================================================================
-// Adam7 Progressive Ordering
-// =============================================================================
+    // Without alpha in the output, a fourth input channel is ignored
+    uint64_t t = ipf_stats_start(cfg->stats);
+    ipf_encode_image(&header, src, stride, channels, cfg->dither, output);
+    ipf_stats_lap(cfg->stats, "encode", t);
 
-/**
- * Get Adam7 pass number for a block at (block_x, block_y).
- * For blocks, we use a simplified version based on block position.
- */
-static int get_adam7_pass(int block_x, int block_y) {
-    // Use Adam7 pattern for 8x8 blocks, but adapt for 4x4 block indices
-    int px = (block_x * 4) % 8;
-    int py = (block_y * 4) % 8;
-    return ADAM7_PASS[py][px];
+    free(padded);
+    *out_size = size;
+    return output;
 }
 
 /**
- * Encode blocks in Adam7 progressive order.
- * Returns the encoded block data in progressive order.
+ * Map every pixel to a default-palette index (IPF_TYPE_INDEXED).
  */
-static uint8_t* encode_progressive(const image_t *img, const encoder_config_t *cfg,
-                                   int has_alpha, size_t *out_size) {
-    int blocks_x = (img->width + 3) / 4;
-    int blocks_y = (img->height + 3) / 4;
-    int total_blocks = blocks_x * blocks_y;
-
-    int block_size = (cfg->ipf_type == IPF_TYPE_1) ? (has_alpha ? 20 : 12) : (has_alpha ? 24 : 16);
-    size_t max_size = (size_t)total_blocks * block_size;
+static uint8_t* encode_indexed(const image_t *img, const encoder_config_t *cfg,
+                               int has_alpha, size_t *out_size) {
+    ipf_header_t header = make_header(cfg, img, has_alpha);
+    size_t size = ipf_blocks_size(&header);
 
-    uint8_t *output = malloc(max_size);
+    uint8_t *output = malloc(size);
     if (!output) return NULL;
 
-    // Temporary storage for all encoded blocks
-    uint8_t *all_blocks = malloc(max_size);
-    if (!all_blocks) {
-        free(output);
-        return NULL;
-    }
-
-    // Encode all blocks first
-    size_t offset = 0;
-    for (int by = 0; by < blocks_y; by++) {
-        for (int bx = 0; bx < blocks_x; bx++) {
-            int Ys[16], As[16];
-            float COs[16], CGs[16];
+    // Without alpha in the output, a fourth input channel is ignored
+    uint64_t t = ipf_stats_start(cfg->stats);
+    ipf_encode_indexed(&header, img->data, (size_t)img->width * img->channels, img->channels,
+                       cfg->dither, output);
+    ipf_stats_lap(cfg->stats, "encode", t);
 
-            encode_block_to_ycocg(img, bx, by, cfg->dither, Ys, As, COs, CGs);
-
-            if (cfg->ipf_type == IPF_TYPE_1) {
-                encode_ipf1_block(Ys, As, COs, CGs, has_alpha, all_blocks + offset);
-            } else {
-                encode_ipf2_block(Ys, As, COs, CGs, has_alpha, all_blocks + offset);
-            }
-            offset += block_size;
-        }
-    }
-
-    // Reorder blocks according to Adam7 progressive order (7 passes)
-    size_t out_offset = 0;
-    for (int pass = 1; pass <= 7; pass++) {
-        for (int by = 0; by < blocks_y; by++) {
-            for (int bx = 0; bx < blocks_x; bx++) {
-                if (get_adam7_pass(bx, by) == pass) {
-                    int block_idx = by * blocks_x + bx;
-                    memcpy(output + out_offset, all_blocks + block_idx * block_size, block_size);
-                    out_offset += block_size;
-                }
-            }
-        }
-    }
-
-    free(all_blocks);
-    *out_size = out_offset;
+    *out_size = size;
     return output;
 }
 
+// =============================================================================
+// iPF File Writing
+// =============================================================================
+
 /**
- * Encode blocks in sequential (raster) order.
+ * Write the header and the (compressed) block data. block_data_size is the
+ * uncompressed size; data is size bytes, compressed when cfg->use_zstd.
  */
-static uint8_t* encode_sequential(const image_t *img, const encoder_config_t *cfg,
-                                  int has_alpha, size_t *out_size) {
-    int blocks_x = (img->width + 3) / 4;
-    int blocks_y = (img->height + 3) / 4;
-    int total_blocks = blocks_x * blocks_y;
+static int write_ipf_data(const char *output_file, const encoder_config_t *cfg, const image_t *img,
+                          int has_alpha, size_t block_data_size, const uint8_t *data, size_t size,
+                          int verbose) {
+    uint64_t t = ipf_stats_start(cfg->stats);
 
-    int block_size = (cfg->ipf_type == IPF_TYPE_1) ? (has_alpha ? 20 : 12) : (has_alpha ? 24 : 16);
-    size_t max_size = (size_t)total_blocks * block_size;
+    // Open output file
+    FILE *fp = fopen(output_file, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open output file: %s\n", output_file);
+        return -1;
+    }
 
-    uint8_t *output = malloc(max_size);
-    if (!output) return NULL;
+    uint8_t header_bytes[IPF_HEADER_SIZE];
+    ipf_header_t header = make_header(cfg, img, has_alpha);
+    header.uncompressed_size = (uint32_t)block_data_size;
+    ipf_write_header(&header, header_bytes);
+    fwrite(header_bytes, 1, IPF_HEADER_SIZE, fp);
 
-    size_t offset = 0;
-    for (int by = 0; by < blocks_y; by++) {
-        for (int bx = 0; bx < blocks_x; bx++) {
-            int Ys[16], As[16];
-            float COs[16], CGs[16];
+    // Write block data
+    fwrite(data, 1, size, fp);
 
-            encode_block_to_ycocg(img, bx, by, cfg->dither, Ys, As, COs, CGs);
+    fclose(fp);
+    ipf_stats_lap(cfg->stats, "write", t);
+    if (cfg->stats) {
+        int blocks_x = (img->width + 3) / 4, blocks_y = (img->height + 3) / 4;
+        cfg->stats->files++;
+        cfg->stats->bytes_out += IPF_HEADER_SIZE + size;
+        if (cfg->ipf_type != IPF_TYPE_INDEXED) cfg->stats->blocks += (uint64_t)blocks_x * blocks_y;
+        cfg->stats->pixels += (uint64_t)img->width * img->height;
+    }
 
-            if (cfg->ipf_type == IPF_TYPE_1) {
-                offset += encode_ipf1_block(Ys, As, COs, CGs, has_alpha, output + offset);
-            } else {
-                offset += encode_ipf2_block(Ys, As, COs, CGs, has_alpha, output + offset);
-            }
+    if (verbose) {
+        printf("Wrote %zu bytes to %s\n", IPF_HEADER_SIZE + size, output_file);
+        if (cfg->ipf_type == IPF_TYPE_INDEXED) {
+            printf("  Format: indexed (256 colours), %dx%d\n", cfg->width, cfg->height);
+        } else {
+            printf("  Format: iPF%d, %dx%d\n", cfg->ipf_type + 1, cfg->width, cfg->height);
         }
+        printf("  Flags: %s%s%s\n",
+               has_alpha ? "alpha " : "",
+               cfg->use_zstd ? "zstd " : "",
+               cfg->progressive ? "progressive " : "");
     }
 
-    *out_size = offset;
-    return output;
+    return 0;
 }
 
-// =============================================================================
-// iPF File Writing
-// =============================================================================
+/**
+ * Whether the output gets an alpha channel, from the options and the input.
+ */
+static int output_has_alpha(const encoder_config_t *cfg, const image_t *img) {
+    if (cfg->force_alpha) return 1;
+    return !cfg->no_alpha && img->has_alpha;
+}
 
 static int write_ipf_file(const char *output_file, const encoder_config_t *cfg,
                           const image_t *img, int verbose) {
     // Determine if we use alpha
-    int has_alpha = 0;
-    if (cfg->force_alpha) {
-        has_alpha = 1;
-    } else if (!cfg->no_alpha && img->has_alpha) {
-        has_alpha = 1;
-    }
+    int has_alpha = output_has_alpha(cfg, img);
 
     // Encode blocks
     size_t block_data_size;
     uint8_t *block_data;
 
-    if (cfg->progressive) {
-        block_data = encode_progressive(img, cfg, has_alpha, &block_data_size);
+    if (cfg->ipf_type == IPF_TYPE_INDEXED) {
+        block_data = encode_indexed(img, cfg, has_alpha, &block_data_size);
     } else {
-        block_data = encode_sequential(img, cfg, has_alpha, &block_data_size);
+        block_data = encode_blocks(img, cfg, has_alpha, &block_data_size);
     }
 
     if (!block_data) {
@@ -579,6 +488,7 @@ static int write_ipf_file(const char *output_file, const encoder_config_t *cfg,
     uint8_t *compressed_data = NULL;
 
     if (cfg->use_zstd) {
+        uint64_t t = ipf_stats_start(cfg->stats);
         size_t max_compressed = ZSTD_compressBound(block_data_size);
         compressed_data = malloc(max_compressed);
         if (!compressed_data) {
@@ -588,7 +498,7 @@ static int write_ipf_file(const char *output_file, const encoder_config_t *cfg,
         }
 
         output_size = ZSTD_compress(compressed_data, max_compressed,
-                                    block_data, block_data_size, 7);
+                                    block_data, block_data_size, IPF_ZSTD_LEVEL);
         if (ZSTD_isError(output_size)) {
             fprintf(stderr, "Error: Zstd compression failed: %s\n",
                     ZSTD_getErrorName(output_size));
@@ -598,6 +508,12 @@ static int write_ipf_file(const char *output_file, const encoder_config_t *cfg,
         }
 
         output_data = compressed_data;
+        ipf_stats_lap(cfg->stats, "compress", t);
+        if (cfg->stats) {
+            cfg->stats->zstd_level = IPF_ZSTD_LEVEL;
+            cfg->stats->zstd_raw += block_data_size;
+            cfg->stats->zstd_packed += output_size;
+        }
 
         if (verbose) {
             printf("Compressed: %zu -> %zu bytes (%.1f%%)\n",
@@ -606,66 +522,317 @@ static int write_ipf_file(const char *output_file, const encoder_config_t *cfg,
         }
     }
 
-    // Open output file
-    FILE *fp = fopen(output_file, "wb");
-    if (!fp) {
-        fprintf(stderr, "Error: Failed to open output file: %s\n", output_file);
-        free(block_data);
-        if (compressed_data) free(compressed_data);
+    int result = write_ipf_data(output_file, cfg, img, has_alpha, block_data_size,
+                                output_data, output_size, verbose);
+
+    free(block_data);
+    if (compressed_data) free(compressed_data);
+
+    return result;
+}
+
+// =============================================================================
+// Automatic Tuning (--auto)
+// =============================================================================
+
+static void quality_planes_free(quality_planes_t *q) {
+    for (int c = 0; c < 3; c++) free(q->planes[c]);
+    free(q->luma);
+    memset(q, 0, sizeof(*q));
+}
+
+/**
+ * Split interleaved RGB or RGBA pixels into premultiplied planes.
+ */
+static int quality_planes_init(quality_planes_t *q, const uint8_t *pixels, size_t stride, int channels,
+                               int width, int height) {
+    size_t count = (size_t)width * height;
+    memset(q, 0, sizeof(*q));
+    q->width = width;
+    q->height = height;
+    for (int c = 0; c < 3; c++) {
+        q->planes[c] = malloc(count);
+        if (!q->planes[c]) {
+            quality_planes_free(q);
+            return -1;
+        }
+    }
+    q->luma = malloc(count);
+    if (!q->luma) {
+        quality_planes_free(q);
         return -1;
     }
 
-    // Build flags byte
-    uint8_t flags = 0;
-    if (has_alpha) flags |= IPF_FLAG_ALPHA;
-    if (cfg->use_zstd) flags |= IPF_FLAG_ZSTD;
-    if (cfg->progressive) flags |= IPF_FLAG_PROGRESSIVE | IPF_FLAG_ZSTD;  // Progressive always sets zstd flag
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = pixels + (size_t)y * stride;
+        size_t i = (size_t)y * width;
+        for (int x = 0; x < width; x++, i++) {
+            const uint8_t *p = row + (size_t)x * channels;
+            int a = channels == 4 ? p[3] : 255;
+            int r = (p[0] * a + 127) / 255;
+            int g = (p[1] * a + 127) / 255;
+            int b = (p[2] * a + 127) / 255;
+            q->planes[0][i] = (uint8_t)r;
+            q->planes[1][i] = (uint8_t)g;
+            q->planes[2][i] = (uint8_t)b;
+            q->luma[i] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+    }
+    return 0;
+}
 
-    // Write header
-    // Magic: "\x1FTSVMiPF" (8 bytes)
-    fwrite(IPF_MAGIC, 1, 8, fp);
+static uint64_t plane_sse(const uint8_t *a, const uint8_t *b, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        int d = a[i] - b[i];
+        sum += (uint32_t)(d * d);
+    }
+    return sum;
+}
 
-    // Width (uint16 LE)
-    uint16_t width_le = (uint16_t)cfg->width;
-    fwrite(&width_le, 2, 1, fp);
+static double quality_psnr(const quality_planes_t *ref, const quality_planes_t *test) {
+    size_t count = (size_t)ref->width * ref->height;
+    uint64_t sse = 0;
+    for (int c = 0; c < 3; c++) sse += plane_sse(ref->planes[c], test->planes[c], count);
+    if (sse == 0) return 100.0;  // Identical
+    return 10.0 * log10(255.0 * 255.0 * count * 3 / (double)sse);
+}
 
-    // Height (uint16 LE)
-    uint16_t height_le = (uint16_t)cfg->height;
-    fwrite(&height_le, 2, 1, fp);
+/**
+ * Mean SSIM of the luma over SSIM_WINDOW-square windows, SSIM_STEP apart
+ * (smaller images use one window as large as they are).
+ */
+static double quality_ssim(const quality_planes_t *ref, const quality_planes_t *test) {
+    const double c1 = (0.01 * 255) * (0.01 * 255);
+    const double c2 = (0.03 * 255) * (0.03 * 255);
+    int win_w = ref->width < SSIM_WINDOW ? ref->width : SSIM_WINDOW;
+    int win_h = ref->height < SSIM_WINDOW ? ref->height : SSIM_WINDOW;
+    double n = (double)win_w * win_h;
+    double total = 0;
+    long windows = 0;
+
+    for (int wy = 0; wy + win_h <= ref->height; wy += SSIM_STEP) {
+        for (int wx = 0; wx + win_w <= ref->width; wx += SSIM_STEP) {
+            uint32_t sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (int y = wy; y < wy + win_h; y++) {
+                const uint8_t *a = ref->luma + (size_t)y * ref->width + wx;
+                const uint8_t *b = test->luma + (size_t)y * ref->width + wx;
+                for (int x = 0; x < win_w; x++) {
+                    sa += a[x];
+                    sb += b[x];
+                    saa += (uint32_t)a[x] * a[x];
+                    sbb += (uint32_t)b[x] * b[x];
+                    sab += (uint32_t)a[x] * b[x];
+                }
+            }
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+            windows++;
+        }
+    }
+    return windows ? total / windows : 1.0;
+}
 
-    // Flags (uint8)
-    fwrite(&flags, 1, 1, fp);
+static double candidate_quality(const encoder_config_t *cfg, const auto_candidate_t *c) {
+    return cfg->auto_metric == AUTO_PSNR ? c->psnr : c->ssim;
+}
 
-    // Type (uint8)
-    uint8_t type_byte = (uint8_t)cfg->ipf_type;
-    fwrite(&type_byte, 1, 1, fp);
+static int candidate_passes(const encoder_config_t *cfg, const auto_candidate_t *c) {
+    return candidate_quality(cfg, c) >= cfg->auto_floor;
+}
 
-    // Reserved (10 bytes)
-    uint8_t reserved[10] = {0};
-    fwrite(reserved, 1, 10, fp);
+/**
+ * Encode, decode and measure one candidate, then keep its smallest
+ * compression. Runs on its own thread.
+ */
+static void *auto_candidate_run(void *arg) {
+    auto_candidate_t *c = arg;
+    const image_t *img = c->img;
+
+    c->failed = 1;
+    c->blocks = encode_blocks(img, &c->cfg, c->has_alpha, &c->blocks_size);
+    if (!c->blocks) return NULL;
+
+    // Decode the way the VM will, with libipf
+    ipf_header_t header = {
+        .width = (uint16_t)img->width,
+        .height = (uint16_t)img->height,
+        .flags = (uint8_t)((c->has_alpha ? IPF_FLAG_ALPHA : 0) | (c->cfg.progressive ? IPF_FLAG_PROGRESSIVE : 0)),
+        .type = (uint8_t)c->cfg.ipf_type,
+        .uncompressed_size = (uint32_t)c->blocks_size
+    };
+    int channels = ipf_pixel_bytes(c->has_alpha, IPF_PIXELS_RGB);
+    size_t stride = (size_t)ipf_blocks_x(&header) * 4 * channels;
+    uint8_t *decoded = malloc(stride * ipf_blocks_y(&header) * 4);
+    if (!decoded) return NULL;
+    ipf_decode_image(&header, c->blocks, IPF_PIXELS_RGB, decoded, stride);
+
+    quality_planes_t test;
+    int err = quality_planes_init(&test, decoded, stride, channels, img->width, img->height);
+    free(decoded);
+    if (err) return NULL;
+    c->psnr = quality_psnr(c->ref, &test);
+    c->ssim = quality_ssim(c->ref, &test);
+    quality_planes_free(&test);
+
+    // Stored as they are unless zstd is allowed and smaller
+    c->file_size = IPF_HEADER_SIZE + c->blocks_size;
+    c->level = 0;
+    if (c->cfg.use_zstd) {
+        static const int levels[] = { IPF_ZSTD_LEVEL, AUTO_ZSTD_LEVEL_MAX };
+        size_t bound = ZSTD_compressBound(c->blocks_size);
+        uint8_t *scratch = malloc(bound);
+        c->packed = malloc(bound);
+        if (!scratch || !c->packed) {
+            free(scratch);
+            return NULL;
+        }
+        c->packed_size = 0;
+        for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+            size_t size = ZSTD_compress(scratch, bound, c->blocks, c->blocks_size, levels[i]);
+            if (ZSTD_isError(size)) continue;
+            if (c->packed_size == 0 || size < c->packed_size) {
+                memcpy(c->packed, scratch, size);
+                c->packed_size = size;
+                c->level = levels[i];
+            }
+        }
+        free(scratch);
+        if (c->packed_size == 0) return NULL;
+        c->file_size = IPF_HEADER_SIZE + c->packed_size;
+    }
 
-    // Uncompressed size (uint32 LE)
-    uint32_t uncompressed_size_le = (uint32_t)block_data_size;
-    fwrite(&uncompressed_size_le, 4, 1, fp);
+    c->failed = 0;
+    return NULL;
+}
 
-    // Write block data
-    fwrite(output_data, 1, output_size, fp);
+static void auto_candidate_describe(const auto_candidate_t *c, char *buf, size_t size) {
+    char packing[16];
+    if (c->cfg.use_zstd) snprintf(packing, sizeof(packing), "zstd %d", c->level);
+    else snprintf(packing, sizeof(packing), "stored");
+    snprintf(buf, size, "iPF%d, %s, %s, %s", c->cfg.ipf_type + 1,
+             c->cfg.dither >= 0 ? "dither" : "no dither",
+             c->has_alpha ? "alpha" : "no alpha", packing);
+}
 
-    fclose(fp);
+/**
+ * Try every type, dither and alpha choice the options allow in parallel,
+ * log them, and write the smallest that meets the floor, or the best
+ * looking one when none does.
+ */
+static int write_ipf_auto(const char *output_file, const encoder_config_t *cfg, const image_t *img) {
+    uint64_t t = ipf_stats_start(cfg->stats);
+    quality_planes_t ref;
+    if (quality_planes_init(&ref, img->data, (size_t)img->width * img->channels, img->channels,
+                            img->width, img->height) < 0) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
 
-    if (verbose) {
-        printf("Wrote %zu bytes to %s\n", IPF_HEADER_SIZE + output_size, output_file);
-        printf("  Format: iPF%d, %dx%d\n", cfg->ipf_type + 1, cfg->width, cfg->height);
-        printf("  Flags: %s%s%s\n",
-               has_alpha ? "alpha " : "",
-               cfg->use_zstd ? "zstd " : "",
-               cfg->progressive ? "progressive " : "");
+    // Stripping alpha is only a choice when the options leave it open
+    int alpha_choices[2], alpha_count = 0;
+    if (cfg->force_alpha) alpha_choices[alpha_count++] = 1;
+    else if (cfg->no_alpha || !img->has_alpha) alpha_choices[alpha_count++] = 0;
+    else {
+        alpha_choices[alpha_count++] = 1;
+        alpha_choices[alpha_count++] = 0;
     }
 
-    free(block_data);
-    if (compressed_data) free(compressed_data);
+    auto_candidate_t candidates[AUTO_MAX_CANDIDATES];
+    int count = 0;
+    for (int type = IPF_TYPE_1; type <= IPF_TYPE_2; type++) {
+        for (int dither = 0; dither >= -1; dither--) {
+            for (int a = 0; a < alpha_count; a++) {
+                auto_candidate_t *c = &candidates[count++];
+                memset(c, 0, sizeof(*c));
+                c->img = img;
+                c->ref = &ref;
+                c->cfg = *cfg;
+                c->cfg.ipf_type = type;
+                c->cfg.dither = dither;
+                // Progressive files are always flagged as compressed
+                c->cfg.use_zstd = cfg->use_zstd || cfg->progressive;
+                c->cfg.stats = NULL;
+                c->has_alpha = alpha_choices[a];
+            }
+        }
+    }
 
-    return 0;
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&candidates[i].thread, NULL, auto_candidate_run, &candidates[i]) != 0) {
+            candidates[i].thread = pthread_self();
+            auto_candidate_run(&candidates[i]);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (!pthread_equal(candidates[i].thread, pthread_self())) pthread_join(candidates[i].thread, NULL);
+    }
+    t = ipf_stats_lap(cfg->stats, "auto", t);
+    quality_planes_free(&ref);
+
+    // Smallest that passes; otherwise the best on the chosen metric, then the smallest
+    const auto_candidate_t *best = NULL;
+    int passed = 0;
+    for (int i = 0; i < count; i++) {
+        const auto_candidate_t *c = &candidates[i];
+        if (c->failed) continue;
+        double quality = candidate_quality(cfg, c);
+        if (candidate_passes(cfg, c)) {
+            if (!passed || c->file_size < best->file_size ||
+                (c->file_size == best->file_size && quality > candidate_quality(cfg, best))) {
+                best = c;
+                passed = 1;
+            }
+        } else if (!passed && (!best || quality > candidate_quality(cfg, best) ||
+                               (quality == candidate_quality(cfg, best) && c->file_size < best->file_size))) {
+            best = c;
+        }
+    }
+
+    printf("Auto: %s floor %.*f, %d candidates\n", cfg->auto_metric == AUTO_PSNR ? "PSNR" : "SSIM",
+           cfg->auto_metric == AUTO_PSNR ? 2 : 4, cfg->auto_floor, count);
+    for (int i = 0; i < count; i++) {
+        const auto_candidate_t *c = &candidates[i];
+        char desc[64];
+        auto_candidate_describe(c, desc, sizeof(desc));
+        if (c->failed) {
+            printf("  %-34s failed\n", desc);
+            continue;
+        }
+        printf("  %-34s %9zu bytes  PSNR %6.2f  SSIM %.4f  %s%s\n", desc, c->file_size, c->psnr, c->ssim,
+               candidate_passes(cfg, c) ? "pass" : "below floor", c == best ? "  <- chosen" : "");
+    }
+
+    int result = -1;
+    if (!best) {
+        fprintf(stderr, "Error: Failed to encode image blocks\n");
+    } else {
+        char desc[64];
+        auto_candidate_describe(best, desc, sizeof(desc));
+        if (!passed) {
+            fflush(stdout);
+            fprintf(stderr, "Warning: No candidate reaches the floor; writing the best one\n");
+        }
+        printf("Chose %s: %zu bytes\n", desc, best->file_size);
+
+        if (cfg->stats && best->cfg.use_zstd) {
+            cfg->stats->zstd_level = best->level;
+            cfg->stats->zstd_raw += best->blocks_size;
+            cfg->stats->zstd_packed += best->packed_size;
+        }
+        encoder_config_t out = best->cfg;
+        out.stats = cfg->stats;
+        result = write_ipf_data(output_file, &out, img, best->has_alpha, best->blocks_size,
+                                best->cfg.use_zstd ? best->packed : best->blocks,
+                                best->cfg.use_zstd ? best->packed_size : best->blocks_size, cfg->verbose);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(candidates[i].blocks);
+        free(candidates[i].packed);
+    }
+    return result;
 }
 
 // =============================================================================
@@ -676,6 +843,24 @@ static int parse_size(const char *arg, int *width, int *height) {
     return sscanf(arg, "%dx%d", width, height) == 2 ? 0 : -1;
 }
 
+/**
+ * Parse an --auto floor: "psnr:DB" or "ssim:X".
+ */
+static int parse_auto(const char *arg, encoder_config_t *cfg) {
+    char *end;
+    if (strncmp(arg, "psnr:", 5) == 0) {
+        cfg->auto_metric = AUTO_PSNR;
+        cfg->auto_floor = strtod(arg + 5, &end);
+        return *end || end == arg + 5 || cfg->auto_floor <= 0 ? -1 : 0;
+    }
+    if (strncmp(arg, "ssim:", 5) == 0) {
+        cfg->auto_metric = AUTO_SSIM;
+        cfg->auto_floor = strtod(arg + 5, &end);
+        return *end || end == arg + 5 || cfg->auto_floor <= 0 || cfg->auto_floor > 1 ? -1 : 0;
+    }
+    return -1;
+}
+
 int main(int argc, char *argv[]) {
     encoder_config_t cfg = {
         .input_file = NULL,
@@ -688,7 +873,11 @@ int main(int argc, char *argv[]) {
         .no_alpha = 0,
         .progressive = 0,
         .dither = 0,
-        .verbose = 0
+        .verbose = 0,
+        .auto_metric = AUTO_OFF,
+        .auto_floor = 0,
+        .stats_out = { IPF_STATS_OFF, NULL, NULL },
+        .stats = NULL
     };
 
     static struct option long_options[] = {
@@ -696,16 +885,21 @@ int main(int argc, char *argv[]) {
         {"output",      required_argument, 0, 'o'},
         {"size",        required_argument, 0, 's'},
         {"type",        required_argument, 0, 't'},
+        {"indexed",     no_argument,       0, 'X'},
         {"no-zstd",     no_argument,       0, 'Z'},
         {"alpha",       no_argument,       0, 'A'},
         {"no-alpha",    no_argument,       0, 'N'},
         {"progressive", no_argument,       0, 'p'},
         {"dither",      required_argument, 0, 'd'},
+        {"auto",        optional_argument, 0, 'U'},
+        {"stats",       optional_argument, 0, 'S'},
+        {"trace",       required_argument, 0, 'T'},
         {"verbose",     no_argument,       0, 'v'},
         {"help",        no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
 
+    int indexed = 0;
     int opt;
     while ((opt = getopt_long(argc, argv, "i:o:s:t:pd:vh", long_options, NULL)) != -1) {
         switch (opt) {
@@ -728,6 +922,9 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
                 break;
+            case 'X':
+                indexed = 1;
+                break;
             case 'Z':
                 cfg.use_zstd = 0;
                 break;
@@ -743,6 +940,24 @@ int main(int argc, char *argv[]) {
             case 'd':
                 cfg.dither = atoi(optarg);
                 break;
+            case 'U':
+                if (!optarg) {
+                    cfg.auto_metric = AUTO_SSIM;
+                    cfg.auto_floor = AUTO_DEFAULT_SSIM;
+                } else if (parse_auto(optarg, &cfg) < 0) {
+                    fprintf(stderr, "Error: Invalid --auto floor: %s (use psnr:DB or ssim:0..1)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'S':
+                if (ipf_stats_parse(optarg ? optarg : "text", &cfg.stats_out) < 0) {
+                    fprintf(stderr, "Error: Unknown stats format: %s (use text or json)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                cfg.stats_out.trace_path = optarg;
+                break;
             case 'v':
                 cfg.verbose = 1;
                 break;
@@ -762,20 +977,38 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (indexed) {
+        if (cfg.progressive || cfg.auto_metric != AUTO_OFF) {
+            fprintf(stderr, "Error: --indexed can't be combined with --progressive or --auto\n");
+            return 1;
+        }
+        cfg.ipf_type = IPF_TYPE_INDEXED;
+    }
+
+    ipf_stats_t stats;
+    ipf_stats_from_env(&cfg.stats_out);
+    if (cfg.stats_out.format != IPF_STATS_OFF || cfg.stats_out.trace_path) {
+        ipf_stats_init(&stats, 0, cfg.stats_out.trace_path != NULL);
+        cfg.stats = &stats;
+    }
+
     // Load image
     if (cfg.verbose) {
         printf("Loading image: %s\n", cfg.input_file);
     }
 
     image_t *img = load_image(cfg.input_file, cfg.width, cfg.height,
-                              cfg.force_alpha, cfg.verbose);
+                              cfg.force_alpha, cfg.verbose, cfg.stats);
     if (!img) {
         fprintf(stderr, "Error: Failed to load image\n");
+        if (cfg.stats) ipf_stats_free(cfg.stats);
         return 1;
     }
+    if (cfg.stats) cfg.stats->bytes_in += ipf_stats_file_size(cfg.input_file);
 
     // Encode and write iPF file
-    int result = write_ipf_file(cfg.output_file, &cfg, img, cfg.verbose);
+    int result = cfg.auto_metric != AUTO_OFF ? write_ipf_auto(cfg.output_file, &cfg, img)
+                                             : write_ipf_file(cfg.output_file, &cfg, img, cfg.verbose);
 
     free_image(img);
 
@@ -783,5 +1016,11 @@ int main(int argc, char *argv[]) {
         printf("Successfully encoded: %s\n", cfg.output_file);
     }
 
+    if (cfg.stats) {
+        ipf_stats_finish(cfg.stats);
+        if (ipf_stats_report(cfg.stats, &cfg.stats_out, "encoder_ipf", cfg.input_file) < 0) result = -1;
+        ipf_stats_free(cfg.stats);
+    }
+
     return result == 0 ? 0 : 1;
 }
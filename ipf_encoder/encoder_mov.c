@@ -0,0 +1,1359 @@
+/**
+ * MOV Encoder - TSVM legacy movie (MOV/iPF) encoder
+ *
+ * Host-side replacement for assets/disk0/tvdos/bin/encodemov.js:
+ * - Video comes through one long-lived FFmpeg rawvideo pipe (or a raw RGB24
+ *   stream), never as a file per frame
+ * - Frames are encoded to iPF by a pool of workers and written in order
+ *   through a bounded reorder queue
+ * - MP2 or PCM audio packets are interleaved on the same schedule
+ *   encodemov.js uses, so the result plays in playmov
+ *
+ * Frames go through libipf, which matches graphics.encodeIpf1/encodeIpf2
+ * bit for bit, including the Bayer pattern rotating with the frame number.
+ *
+ * With --delta, frames after the first become iPF delta packets the way
+ * encodemov2.js writes them, except that each frame is diffed against what
+ * the player is showing rather than against the previous source frame, so
+ * skipped blocks never drift. --motion adds MOVE runs, which copy blocks
+ * from elsewhere in the previous frame, for pans and scrolling.
+ *
+ * --bitrate caps every delta packet at the bytes the disk can deliver per
+ * frame. Blocks are then sent worst and longest-waiting first, and blocks
+ * left slightly off for too long are refreshed.
+ *
+ * Delta movies get a keyframe at every scene cut and at least every --gop
+ * frames. Every movie ends with a seek index of its keyframes, which the
+ * header points to (see terranmon.txt).
+ *
+ * --stream compresses each keyframe and the delta frames after it as one
+ * zstd stream, flushed at every frame, so the later frames of a GOP can
+ * refer back to the earlier ones. Players need to know the 6,t packets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zstd.h>
+
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MOV_MAGIC "\x1F\x54\x53\x56\x4D\x4D\x4F\x56"  // "\x1FTSVMMOV"
+#define MOV_HEADER_SIZE 32  // 8 magic + 2 width + 2 height + 2 fps + 4 frames + 2 unused + 2 audio queue + 10 reserved
+#define MOV_FRAME_COUNT_OFFSET 14
+#define MOV_INDEX_OFFSET_OFFSET 22
+#define MOV_INDEX_PACKET 0xFFFD  // 253,255
+
+#define MAX_PATH 4096
+
+// playmov decodes into a full-screen buffer, so frames can't be any larger
+#define TSVM_FB_WIDTH  560
+#define TSVM_FB_HEIGHT 448
+
+#define MOV_ZSTD_LEVEL 3  // What the VM's gzip.comp (ZstdOutputStream) uses
+#define MOV_KEYFRAME_THRESHOLD 0.576  // Delta bytes per pixel above which a keyframe is cheaper (encodemov2.js)
+#define MOV_MOTION_RANGE 16           // Blocks, so up to 64 pixels per frame
+#define MOV_GOP_SECONDS 5             // Default interval between delta-mode keyframes
+
+#define MOV_MIN_BUDGET 64             // Bytes per frame; an empty delta frame still needs a few
+#define MOV_REFRESH_SECONDS 2
+#define MOV_RATE_PASSES 4             // Compressions tried per frame to fill the budget
+#define MOV_STARVED (1ull << 48)      // Priority boost that puts starved blocks first
+#define MOV_AUDIO_BITRATE 256
+
+#define AUDIO_SAMPLE_RATE 32000
+#define MP2_FRAME_SAMPLES 2304    // Per MP2 frame, counted in the same units as the PCM packet size
+#define MP2_QUEUE_BLOCK_SIZE 0x240
+
+static const int MP2_BITRATES[14] = { 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 };
+static const int MP2_SAMPLE_RATES[4] = { 44100, 48000, 32000, 0 };
+static const int MP2_FRAME_SIZES[14] = { 144, 216, 252, 288, 360, 432, 504, 576, 720, 864, 1008, 1152, 1440, 1728 };
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    char *input_file;
+    char *output_file;
+    int width;
+    int height;
+    int fps;             // 0 = probe the input
+    int max_frames;      // 0 = until the input ends
+    int ipf_type;        // 0 = iPF1, 1 = iPF2
+    int delta;           // Delta frames between keyframes
+    int motion;          // Motion search for the delta frames
+    int bitrate;         // Video kbit/s for rate-controlled delta frames, 0 = no limit
+    int refresh;         // Frames before a slightly-off block is resent, 0 = MOV_REFRESH_SECONDS
+    int gop;             // Most frames between delta-mode keyframes, 0 = scene cuts only, -1 = MOV_GOP_SECONDS
+    int stream;          // One zstd stream per GOP instead of a zstd frame per packet
+    char *audio_file;    // MP2, or raw unsigned 8-bit stereo PCM with --pcm
+    int audio_from_input;
+    int pcm;
+    int audio_bitrate;   // kbps, when transcoding the input's audio to MP2
+    int zstd_level;
+    int jobs;
+    int raw_input;       // Input is raw RGB24 at the output size
+    int verbose;
+} mov_config_t;
+
+typedef enum {
+    AUDIO_NONE = 0,
+    AUDIO_PCM,
+    AUDIO_MP2
+} audio_format_t;
+
+typedef struct {
+    FILE *fp;
+    int is_pipe;
+    audio_format_t format;
+    int packet_size;         // MP2 frame size
+    uint8_t packet_type[2];
+    uint8_t head[4];         // MP2 header bytes read while probing, not yet written
+    int head_len;
+    uint8_t *buf;
+    uint64_t bytes;
+    size_t packets;
+} audio_source_t;
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_READ,       // Pixels loaded, waiting for a worker
+    SLOT_ENCODING,
+    SLOT_DONE        // Packet ready, waiting for the writer
+} slot_state_t;
+
+typedef struct {
+    slot_state_t state;
+    int frame;
+    uint8_t *rgb;
+    uint8_t *blocks;
+    uint8_t *packet;
+    size_t packet_size;
+    size_t raw_size;     // Uncompressed payload, stored in streamed packets
+} frame_slot_t;
+
+/**
+ * Reader, workers and writer share a ring of slots. Frame f always lives in
+ * slot (f - 1) % slot_count, so the reader stalls once it is slot_count
+ * frames ahead of the writer and memory stays bounded.
+ */
+typedef struct {
+    const mov_config_t *cfg;
+    ipf_header_t header;
+    FILE *video;
+    frame_slot_t *slots;
+    int slot_count;
+    size_t frame_bytes;   // RGB24 bytes per frame on the pipe
+    size_t packet_cap;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int frames_read;
+    int video_eof;
+    int next_encode;
+    int failed;
+} mov_pipeline_t;
+
+typedef struct {
+    mov_pipeline_t *p;
+    pthread_t thread;
+    ZSTD_CCtx *cctx;
+} mov_worker_t;
+
+// Keyframe positions for the seek index, written after the last frame
+typedef struct {
+    uint32_t frame;     // Frames before this one
+    uint32_t offset;    // File offset of the frame's first packet
+} index_entry_t;
+
+typedef struct {
+    index_entry_t *entries;
+    size_t count;
+    size_t capacity;
+} seek_index_t;
+
+// A changed block competing for the rate-controlled packet budget
+typedef struct {
+    uint32_t index;
+    uint32_t cost;      // Estimated stream bytes
+    uint64_t priority;
+} patch_candidate_t;
+
+/**
+ * Writer-side state for --delta: the picture the player has after the last
+ * written frame, as raster blocks.
+ */
+typedef struct {
+    uint8_t *reference;
+    uint8_t *changed;
+    ipf_vector_t *vectors;
+    ipf_vector_t global;
+    uint8_t *stream;
+    ZSTD_CCtx *cctx;
+    ZSTD_CCtx *zstream;             // --stream: the current GOP's zstd stream
+    int keyframes;
+    int gop;
+    int last_keyframe;
+    size_t moved_blocks;
+
+    // Rate control
+    size_t budget;                  // Bytes per video packet, 0 = none
+    int refresh;
+    int *scores;
+    uint16_t *age;                  // Frames each block has been off on screen without being sent
+    uint8_t *selected;
+    patch_candidate_t *candidates;
+    double ratio;                   // Compressed over raw delta bytes, running average
+    int over_budget;
+    size_t dropped;
+    size_t refreshed;
+} delta_state_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("MOV Encoder - TSVM legacy movie format (iPF video)\n");
+    printf("\nUsage: %s -i input.mp4 -o output.mov [options]\n\n", program);
+    printf("Required:\n");
+    printf("  -i, --input FILE         Input video (any FFmpeg input, including image\n");
+    printf("                           sequences such as frames/%%05d.png)\n");
+    printf("  -o, --output FILE        Output MOV file\n");
+    printf("\nOptions:\n");
+    printf("  -s, --size WxH           Frame size, at most %dx%d (default: %dx%d)\n",
+           TSVM_FB_WIDTH, TSVM_FB_HEIGHT, TSVM_FB_WIDTH, TSVM_FB_HEIGHT);
+    printf("  -r, --fps N              Frame rate (default: the input's, rounded)\n");
+    printf("  -n, --frames N           Encode at most N frames\n");
+    printf("  -t, --type N             iPF type: 1 (4:2:0, default) or 2 (4:2:2)\n");
+    printf("  -d, --delta              Delta frames between keyframes (no dithering)\n");
+    printf("  -m, --motion             Motion search for delta frames, for pans and scrolling\n");
+    printf("  -B, --bitrate N          Keep delta frames within N kbit/s of video, so a slow\n");
+    printf("                           disk never stalls playback (needs -d)\n");
+    printf("  -g, --gop N              With -d, a keyframe at least every N frames, for seeking\n");
+    printf("                           (default: %d seconds' worth; 0 = at scene cuts only)\n", MOV_GOP_SECONDS);
+    printf("  --stream                 With -d, compress each GOP as one zstd stream: smaller\n");
+    printf("                           delta frames, but older players can't play the file\n");
+    printf("  --refresh N              With -B, resend blocks left slightly off for N frames\n");
+    printf("                           (default: %d seconds' worth)\n", MOV_REFRESH_SECONDS);
+    printf("  -a, --audio FILE         Audio track: 32 kHz MP2, or raw PCM with --pcm\n");
+    printf("  -A, --audio-from-input   Transcode the input's own audio track\n");
+    printf("  --pcm                    Audio is unsigned 8-bit stereo PCM at 32 kHz\n");
+    printf("  -b, --audio-bitrate N    MP2 bitrate in kbps for -A (default: %d)\n", MOV_AUDIO_BITRATE);
+    printf("  -z, --zstd-level N       Frame compression level (default: %d)\n", MOV_ZSTD_LEVEL);
+    printf("  -j, --jobs N             Encoder threads (default: number of CPUs)\n");
+    printf("  --raw                    Input is raw RGB24 frames at the output size (- for stdin)\n");
+    printf("  -v, --verbose            Print every packet\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nExamples:\n");
+    printf("  %s -i film.mp4 -o film.mov -A\n", program);
+    printf("  %s -i 'steamboat/%%05d.png' -r 15 -a steamboat.mp2 -o steamboat.mov\n", program);
+    printf("  %s -i film.mkv -o film.mov -t 2 -A -b 192 -j 8\n", program);
+    printf("  %s -i cartoon.mp4 -o cartoon.mov -d -A\n", program);
+    printf("  %s -i game.mp4 -o game.mov -d -m -B 1200 -r 15\n", program);
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void put_u16(uint8_t *p, unsigned v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static int parse_size(const char *arg, int *width, int *height) {
+    return sscanf(arg, "%dx%d", width, height) == 2 ? 0 : -1;
+}
+
+// =============================================================================
+// Input via FFmpeg
+// =============================================================================
+
+/**
+ * Probe the input's frame rate. Returns the rounded rate and sets *exact to
+ * 0 when the input needs resampling to get there, or -1 on error.
+ */
+static int probe_fps(const char *input_file, int *exact) {
+    char cmd[MAX_PATH * 2];
+    snprintf(cmd, sizeof(cmd),
+             "ffprobe -v quiet -select_streams v:0 -show_entries stream=r_frame_rate "
+             "-of csv=p=0 \"%s\" 2>/dev/null",
+             input_file);
+
+    FILE *fp = popen(cmd, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to run ffprobe\n");
+        return -1;
+    }
+
+    char buffer[256];
+    int num = 0, den = 1;
+    int ok = fgets(buffer, sizeof(buffer), fp) != NULL;
+    pclose(fp);
+    if (ok) {
+        int fields = sscanf(buffer, "%d/%d", &num, &den);
+        ok = fields >= 1 && num > 0 && den > 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to read the frame rate of %s (use -r)\n", input_file);
+        return -1;
+    }
+
+    *exact = num % den == 0;
+    int fps = (int)((double)num / den + 0.5);
+    return fps > 0 ? fps : 1;
+}
+
+static FILE *open_video(const mov_config_t *cfg, int resample) {
+    if (cfg->raw_input) {
+        return strcmp(cfg->input_file, "-") == 0 ? stdin : fopen(cfg->input_file, "rb");
+    }
+
+    // Image sequences take the rate as an input option; anything else is resampled
+    int sequence = strchr(cfg->input_file, '%') != NULL;
+    char framerate[32] = "", fps_filter[32] = "", limit[32] = "";
+    if (sequence && cfg->fps) snprintf(framerate, sizeof(framerate), "-framerate %d ", cfg->fps);
+    if (!sequence && resample) snprintf(fps_filter, sizeof(fps_filter), ",fps=%d", cfg->fps);
+    if (cfg->max_frames) snprintf(limit, sizeof(limit), "-frames:v %d ", cfg->max_frames);
+
+    char cmd[MAX_PATH * 2];
+    snprintf(cmd, sizeof(cmd),
+             "ffmpeg -hide_banner -v quiet %s-i \"%s\" -an -f rawvideo -pix_fmt rgb24 -vf "
+             "\"scale=%d:%d:force_original_aspect_ratio=increase,crop=%d:%d%s\" %s-",
+             framerate, cfg->input_file, cfg->width, cfg->height, cfg->width, cfg->height,
+             fps_filter, limit);
+
+    if (cfg->verbose) {
+        printf("FFmpeg command: %s\n", cmd);
+    }
+
+    return popen(cmd, "r");
+}
+
+static void close_video(const mov_config_t *cfg, FILE *fp) {
+    if (!fp || fp == stdin) return;
+    if (cfg->raw_input) fclose(fp);
+    else pclose(fp);
+}
+
+// =============================================================================
+// Audio
+// =============================================================================
+
+static int mp2_rate_index(int packet_size, int mono) {
+    for (int i = 0; i < 14; i++) {
+        if (MP2_FRAME_SIZES[i] == packet_size) return i * 2 + mono;
+    }
+    return -1;
+}
+
+/**
+ * Size of the MP2 frame starting with these header bytes, as
+ * audio.mp2GetInitialFrameSize computes it, or -1 if it isn't one.
+ */
+static int mp2_frame_size(const uint8_t *h) {
+    if (h[0] != 0xFF || h[1] != 0xFD || h[2] - 0x10 >= 0xE0) return -1;
+    int rate = MP2_SAMPLE_RATES[(h[2] >> 2) & 3];
+    int bitrate_index = ((h[2] >> 4) & 15) - 1;
+    if (rate == 0 || bitrate_index > 13) return -1;
+    return (int)floor(144000.0 * MP2_BITRATES[bitrate_index] / rate) + ((h[2] >> 1) & 1);
+}
+
+static size_t audio_read(audio_source_t *a, uint8_t *dst, size_t len) {
+    size_t n = 0;
+    while (a->head_len > 0 && n < len) {
+        dst[n++] = a->head[4 - a->head_len--];
+    }
+    return n + fread(dst + n, 1, len - n, a->fp);
+}
+
+static int audio_has_more(audio_source_t *a) {
+    if (a->format == AUDIO_NONE) return 0;
+    if (a->head_len > 0) return 1;
+    int c = getc(a->fp);
+    if (c == EOF) return 0;
+    ungetc(c, a->fp);
+    return 1;
+}
+
+static int audio_open(const mov_config_t *cfg, audio_source_t *a, int audio_sample_size) {
+    memset(a, 0, sizeof(*a));
+    if (!cfg->audio_file && !cfg->audio_from_input) return 0;
+
+    if (cfg->audio_from_input) {
+        char cmd[MAX_PATH * 2];
+        if (cfg->pcm) {
+            snprintf(cmd, sizeof(cmd),
+                     "ffmpeg -hide_banner -v quiet -i \"%s\" -vn -ac 2 -ar %d -f u8 -",
+                     cfg->input_file, AUDIO_SAMPLE_RATE);
+        } else {
+            snprintf(cmd, sizeof(cmd),
+                     "ffmpeg -hide_banner -v quiet -i \"%s\" -vn -acodec libtwolame -psymodel 4 "
+                     "-b:a %dk -ar %d -f mp2 -",
+                     cfg->input_file, cfg->audio_bitrate, AUDIO_SAMPLE_RATE);
+        }
+        if (cfg->verbose) printf("FFmpeg audio command: %s\n", cmd);
+        a->fp = popen(cmd, "r");
+        a->is_pipe = 1;
+    } else {
+        a->fp = fopen(cfg->audio_file, "rb");
+    }
+    if (!a->fp) {
+        fprintf(stderr, "Error: Cannot open audio %s\n", cfg->audio_file ? cfg->audio_file : "from input");
+        return -1;
+    }
+
+    if (cfg->pcm) {
+        a->format = AUDIO_PCM;
+        a->packet_type[0] = 1;
+        a->packet_type[1] = 16;
+        a->buf = malloc(audio_sample_size + 2);
+        return a->buf ? 0 : -1;
+    }
+
+    a->format = AUDIO_MP2;
+    a->head_len = (int)fread(a->head, 1, 4, a->fp);
+    a->packet_size = a->head_len == 4 ? mp2_frame_size(a->head) : -1;
+    if (a->packet_size < 0) {
+        fprintf(stderr, "Error: Audio is not 32 kHz MPEG-1 Layer II (MP2) without CRC\n");
+        return -1;
+    }
+    int rate_index = mp2_rate_index(a->packet_size, (a->head[3] >> 6) == 3);
+    if (rate_index < 0) {
+        fprintf(stderr, "Error: Unknown MP2 packet size: %d\n", a->packet_size);
+        return -1;
+    }
+    a->packet_type[0] = (uint8_t)rate_index;
+    a->packet_type[1] = 17;
+    a->buf = malloc(a->packet_size);
+    return a->buf ? 0 : -1;
+}
+
+static void audio_close(audio_source_t *a) {
+    if (a->fp) {
+        if (a->is_pipe) pclose(a->fp);
+        else fclose(a->fp);
+    }
+    free(a->buf);
+}
+
+// =============================================================================
+// Encoding Pipeline
+// =============================================================================
+
+static void *reader_main(void *arg) {
+    mov_pipeline_t *p = arg;
+
+    for (int f = 1; !p->cfg->max_frames || f <= p->cfg->max_frames; f++) {
+        frame_slot_t *slot = &p->slots[(f - 1) % p->slot_count];
+
+        pthread_mutex_lock(&p->lock);
+        while (slot->state != SLOT_FREE && !p->failed) pthread_cond_wait(&p->changed, &p->lock);
+        int failed = p->failed;
+        pthread_mutex_unlock(&p->lock);
+        if (failed) break;
+
+        // A free slot belongs to the reader alone, so fill it unlocked
+        if (fread(slot->rgb, 1, p->frame_bytes, p->video) != p->frame_bytes) break;
+
+        pthread_mutex_lock(&p->lock);
+        slot->frame = f;
+        slot->state = SLOT_READ;
+        p->frames_read = f;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->video_eof = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void *worker_main(void *arg) {
+    mov_worker_t *w = arg;
+    mov_pipeline_t *p = w->p;
+    size_t stride = (size_t)p->header.width * 3;
+    size_t blocks_size = ipf_blocks_size(&p->header);
+    int delta = p->cfg->delta;
+
+    for (;;) {
+        frame_slot_t *slot;
+        int f;
+
+        pthread_mutex_lock(&p->lock);
+        for (;;) {
+            f = p->next_encode;
+            slot = &p->slots[(f - 1) % p->slot_count];
+            if (p->failed || (p->video_eof && f > p->frames_read)) {
+                pthread_mutex_unlock(&p->lock);
+                return NULL;
+            }
+            if (slot->state == SLOT_READ && slot->frame == f) break;
+            pthread_cond_wait(&p->changed, &p->lock);
+        }
+        p->next_encode++;
+        slot->state = SLOT_ENCODING;
+        pthread_mutex_unlock(&p->lock);
+
+        // encodemov.js passes the frame number as the dither pattern; encodemov2.js keeps it
+        // still so unchanged areas diff to nothing. Delta frames are compressed by the writer.
+        ipf_encode_image(&p->header, slot->rgb, stride, 3, delta ? 0 : f, slot->blocks);
+        size_t n = delta ? 0 : ZSTD_compressCCtx(w->cctx, slot->packet, p->packet_cap, slot->blocks,
+                                                 blocks_size, p->cfg->zstd_level);
+
+        pthread_mutex_lock(&p->lock);
+        if (ZSTD_isError(n)) {
+            fprintf(stderr, "Error: Zstd compression failed: %s\n", ZSTD_getErrorName(n));
+            p->failed = 1;
+        } else {
+            slot->packet_size = n;
+            slot->state = SLOT_DONE;
+        }
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+/**
+ * Block until it is known whether frame f exists. Returns 1 if it does, 0 if
+ * the input ended before it, or -1 if the pipeline failed.
+ */
+static int wait_frame_known(mov_pipeline_t *p, int f) {
+    pthread_mutex_lock(&p->lock);
+    while (!p->failed && p->frames_read < f && !p->video_eof) pthread_cond_wait(&p->changed, &p->lock);
+    int r = p->failed ? -1 : p->frames_read >= f;
+    pthread_mutex_unlock(&p->lock);
+    return r;
+}
+
+static frame_slot_t *wait_frame_done(mov_pipeline_t *p, int f) {
+    frame_slot_t *slot = &p->slots[(f - 1) % p->slot_count];
+    pthread_mutex_lock(&p->lock);
+    while (!p->failed && !(slot->state == SLOT_DONE && slot->frame == f)) pthread_cond_wait(&p->changed, &p->lock);
+    if (p->failed) slot = NULL;
+    pthread_mutex_unlock(&p->lock);
+    return slot;
+}
+
+static void release_slot(mov_pipeline_t *p, frame_slot_t *slot) {
+    pthread_mutex_lock(&p->lock);
+    slot->state = SLOT_FREE;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void fail_pipeline(mov_pipeline_t *p) {
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// =============================================================================
+// MOV Writing
+// =============================================================================
+
+static int compress_packet(const mov_pipeline_t *p, delta_state_t *d, frame_slot_t *slot,
+                           const uint8_t *payload, size_t size) {
+    size_t n = ZSTD_compressCCtx(d->cctx, slot->packet, p->packet_cap, payload, size, p->cfg->zstd_level);
+    if (ZSTD_isError(n)) {
+        fprintf(stderr, "Error: Zstd compression failed: %s\n", ZSTD_getErrorName(n));
+        return -1;
+    }
+    slot->packet_size = n;
+    return 0;
+}
+
+/**
+ * Compress the payload that goes out: alone, or with --stream as the next
+ * flush of the GOP's zstd stream, which a keyframe restarts.
+ */
+static int pack_frame(const mov_pipeline_t *p, delta_state_t *d, frame_slot_t *slot,
+                      const uint8_t *payload, size_t size, int keyframe) {
+    slot->raw_size = size;
+    if (!d->zstream) return compress_packet(p, d, slot, payload, size);
+
+    if (keyframe) ZSTD_CCtx_reset(d->zstream, ZSTD_reset_session_only);
+    ZSTD_inBuffer in = { payload, size, 0 };
+    ZSTD_outBuffer out = { slot->packet, p->packet_cap, 0 };
+    size_t left = ZSTD_compressStream2(d->zstream, &out, &in, ZSTD_e_flush);
+    if (ZSTD_isError(left) || left != 0) {
+        fprintf(stderr, "Error: Zstd stream compression failed: %s\n",
+                ZSTD_isError(left) ? ZSTD_getErrorName(left) : "packet buffer too small");
+        return -1;
+    }
+    slot->packet_size = out.pos;
+    return 0;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    const patch_candidate_t *x = a, *y = b;
+    if (x->priority != y->priority) return x->priority < y->priority ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+// Most candidates, in order, whose estimated bytes stay within allowance
+static size_t fit_candidates(const patch_candidate_t *c, size_t count, double allowance) {
+    double total = 1;  // END
+    size_t k = 0;
+    while (k < count && total + c[k].cost <= allowance) total += c[k++].cost;
+    return k;
+}
+
+static size_t candidates_cost(const patch_candidate_t *c, size_t k) {
+    size_t total = 1;
+    for (size_t i = 0; i < k; i++) total += c[i].cost;
+    return total;
+}
+
+/**
+ * Write the first k candidates of the ranking as a delta stream and compress
+ * it into slot. Returns the stream length, or 0 on error.
+ */
+static size_t try_candidates(const mov_pipeline_t *p, delta_state_t *d, frame_slot_t *slot, size_t blocks, size_t k) {
+    memset(d->selected, IPF_BLOCK_SKIP, blocks);
+    for (size_t i = 0; i < k; i++) d->selected[d->candidates[i].index] = d->changed[d->candidates[i].index];
+    size_t len = ipf_delta_write(&p->header, slot->blocks, d->selected, d->vectors, d->stream);
+    return compress_packet(p, d, slot, d->stream, len) < 0 ? 0 : len;
+}
+
+/**
+ * Rate-controlled delta frame. Blocks that are off are ranked by score
+ * times the frames they have waited. Blocks off for d->refresh frames or
+ * more, even slightly, are starved and go first. The most that fit the
+ * budget are sent, found by trying a few compressions. Returns the stream length with the packet in slot, or 0 on
+ * error.
+ */
+static size_t budget_delta(const mov_pipeline_t *p, delta_state_t *d, frame_slot_t *slot, size_t *moved) {
+    const ipf_header_t *h = &p->header;
+    size_t blocks = (size_t)ipf_blocks_x(h) * ipf_blocks_y(h);
+    uint32_t patch_cost = (uint32_t)ipf_block_size(h) + 1;
+
+    if (p->cfg->motion) {
+        for (size_t i = 0; i < blocks; i++) {
+            d->changed[i] = d->scores[i] > IPF_DELTA_THRESHOLD ? IPF_BLOCK_PATCH : IPF_BLOCK_SKIP;
+        }
+        *moved = ipf_motion_search(h, d->reference, slot->blocks, d->changed, d->vectors, MOV_MOTION_RANGE, &d->global);
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < blocks; i++) {
+        int score = d->scores[i];
+        int wanted = p->cfg->motion ? d->changed[i] != IPF_BLOCK_SKIP : score > IPF_DELTA_THRESHOLD;
+        if (!wanted && (score == 0 || d->age[i] < d->refresh)) {
+            d->changed[i] = IPF_BLOCK_SKIP;
+            continue;
+        }
+        if (!wanted || !p->cfg->motion) d->changed[i] = IPF_BLOCK_PATCH;
+        d->candidates[count++] = (patch_candidate_t){
+            .index = (uint32_t)i,
+            .cost = d->changed[i] == IPF_BLOCK_MOVE ? 2 : patch_cost,
+            .priority = (uint64_t)score * (d->age[i] + 1u) + (d->age[i] >= d->refresh ? MOV_STARVED : 0)
+        };
+    }
+    qsort(d->candidates, count, sizeof(*d->candidates), compare_candidates);
+
+    // Start from what the running compression ratio says fits, then correct
+    // towards the budget with the real compressed sizes
+    size_t fits = 0, too_many = count + 1;
+    size_t k = fit_candidates(d->candidates, count, d->budget / d->ratio);
+    size_t len = 0;
+    for (int pass = 0; pass < MOV_RATE_PASSES; pass++) {
+        len = try_candidates(p, d, slot, blocks, k);
+        if (!len) return 0;
+        if (slot->packet_size <= d->budget) {
+            fits = k;
+            if (k == count || slot->packet_size > d->budget * 9 / 10) break;
+        } else {
+            too_many = k;
+        }
+        double scale = (double)d->budget / slot->packet_size * 0.95;
+        size_t next = fit_candidates(d->candidates, count, candidates_cost(d->candidates, k) * scale);
+        if (next <= fits) next = fits + 1;
+        if (next >= too_many) next = fits + (too_many - fits) / 2;
+        if (next == k || next <= fits) break;
+        k = next;
+    }
+    if (k != fits) {
+        k = fits;
+        len = try_candidates(p, d, slot, blocks, k);
+        if (!len) return 0;
+    }
+
+    if (len > 64) d->ratio = d->ratio * 0.75 + 0.25 * slot->packet_size / len;
+    d->dropped += count - k;
+    for (size_t i = 0; i < blocks; i++) {
+        if (d->selected[i] != IPF_BLOCK_SKIP) {
+            if (d->age[i] >= d->refresh) d->refreshed++;
+            d->age[i] = 0;
+        } else if (d->scores[i] > 0) {
+            if (d->age[i] < UINT16_MAX) d->age[i]++;
+        } else {
+            d->age[i] = 0;
+        }
+    }
+    if (*moved) {
+        size_t sent = 0;
+        for (size_t i = 0; i < blocks; i++) sent += d->selected[i] == IPF_BLOCK_MOVE;
+        *moved = sent;
+    }
+    return len;
+}
+
+/**
+ * Turn the frame in slot into a keyframe or a delta packet against the
+ * player's current picture, and bring that picture up to date. Keyframes
+ * are taken on the first frame, at scene cuts and every d->gop frames.
+ * Returns the packet type's high byte, or -1 on error.
+ */
+static int delta_packet(const mov_pipeline_t *p, delta_state_t *d, frame_slot_t *slot) {
+    const ipf_header_t *h = &p->header;
+    size_t blocks_size = ipf_blocks_size(h);
+    size_t keyframe_limit = (size_t)(h->width * h->height * MOV_KEYFRAME_THRESHOLD);
+    size_t moved = 0;
+    int due = slot->frame == 1 || (d->gop && slot->frame - d->last_keyframe >= d->gop);
+
+    if (!due && d->budget) {
+        // A keyframe is still taken at a scene cut, but only if it fits the budget
+        size_t off = ipf_delta_scores(h, d->reference, slot->blocks, d->scores);
+        if (off * (ipf_block_size(h) + 1) > keyframe_limit) {
+            if (compress_packet(p, d, slot, slot->blocks, blocks_size) < 0) return -1;
+            if (slot->packet_size <= d->budget) {
+                if (d->zstream && pack_frame(p, d, slot, slot->blocks, blocks_size, 1) < 0) return -1;
+                goto keyframe;
+            }
+        }
+
+        // The budget is met by the frame compressed alone; streamed, its
+        // packet comes out the same size or (nearly always) smaller
+        size_t len = budget_delta(p, d, slot, &moved);
+        if (!len || ipf_delta_apply(h, d->stream, len, d->reference) < 0) return -1;
+        if (d->zstream && pack_frame(p, d, slot, d->stream, len, 0) < 0) return -1;
+        d->moved_blocks += moved;
+        return h->type + 2;
+    }
+
+    if (!due) {
+        if (ipf_delta_diff(h, d->reference, slot->blocks, d->changed) > 0 && p->cfg->motion) {
+            moved = ipf_motion_search(h, d->reference, slot->blocks, d->changed, d->vectors,
+                                      MOV_MOTION_RANGE, &d->global);
+        }
+        size_t len = ipf_delta_write(h, slot->blocks, d->changed, d->vectors, d->stream);
+        if (len <= keyframe_limit) {
+            if (ipf_delta_apply(h, d->stream, len, d->reference) < 0) return -1;
+            if (pack_frame(p, d, slot, d->stream, len, 0) < 0) return -1;
+            d->moved_blocks += moved;
+            return h->type + 2;
+        }
+    }
+
+    if (pack_frame(p, d, slot, slot->blocks, blocks_size, 1) < 0) return -1;
+    if (d->budget && slot->packet_size > d->budget) d->over_budget++;
+
+keyframe:
+    memcpy(d->reference, slot->blocks, blocks_size);
+    d->last_keyframe = slot->frame;
+    if (d->age) memset(d->age, 0, (size_t)ipf_blocks_x(h) * ipf_blocks_y(h) * sizeof(*d->age));
+    d->keyframes++;
+    return h->type;
+}
+
+static int write_header(FILE *out, const mov_config_t *cfg, const audio_source_t *audio, int audio_sample_size) {
+    uint8_t h[MOV_HEADER_SIZE] = { 0 };
+    memcpy(h, MOV_MAGIC, 8);
+    put_u16(h + 8, cfg->width);
+    put_u16(h + 10, cfg->height);
+    put_u16(h + 12, cfg->fps);
+    put_u32(h + 14, cfg->max_frames);  // Patched once the input has ended
+    h[18] = 0xFF;                      // Global type is deprecated
+    h[19] = 0x00;
+
+    if (audio->format == AUDIO_MP2) {
+        int queue = (int)ceil((double)audio_sample_size / MP2_FRAME_SAMPLES) + 1;
+        h[20] = MP2_QUEUE_BLOCK_SIZE & 0xFF;
+        h[21] = (MP2_QUEUE_BLOCK_SIZE >> 8) | (queue << 4);
+    }
+
+    return fwrite(h, 1, sizeof(h), out) == sizeof(h) ? 0 : -1;
+}
+
+static int index_add(seek_index_t *index, int frame, long offset) {
+    if (offset < 0 || (unsigned long)offset > UINT32_MAX) return 0;  // Past what the index can address
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : 256;
+        index_entry_t *entries = realloc(index->entries, capacity * sizeof(*entries));
+        if (!entries) return -1;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    index->entries[index->count++] = (index_entry_t){ (uint32_t)frame, (uint32_t)offset };
+    return 0;
+}
+
+/**
+ * Append the seek index packet and point the header at it. Old players stop
+ * at the unknown packet type, which comes after the last frame.
+ */
+static int write_index(FILE *out, const seek_index_t *index) {
+    long offset = ftell(out);
+    if (offset < 0 || (unsigned long)offset > UINT32_MAX) return 0;
+
+    uint8_t head[10];
+    put_u16(head, MOV_INDEX_PACKET);
+    put_u32(head + 2, (uint32_t)(4 + index->count * 8));
+    put_u32(head + 6, (uint32_t)index->count);
+    if (fwrite(head, 1, sizeof(head), out) != sizeof(head)) return -1;
+    for (size_t i = 0; i < index->count; i++) {
+        uint8_t entry[8];
+        put_u32(entry, index->entries[i].frame);
+        put_u32(entry + 4, index->entries[i].offset);
+        if (fwrite(entry, 1, sizeof(entry), out) != sizeof(entry)) return -1;
+    }
+
+    uint8_t pointer[4];
+    put_u32(pointer, (uint32_t)offset);
+    if (fseek(out, MOV_INDEX_OFFSET_OFFSET, SEEK_SET) != 0 || fwrite(pointer, 1, 4, out) != 4) return -1;
+    return 0;
+}
+
+/**
+ * How many audio packets go before frame f; a port of encodemov.js's
+ * getRepeatCount. Once the video has ended the rest of the track is drained.
+ */
+static int audio_repeat_count(const audio_source_t *a, int f, int video_ended,
+                              long samples_written, int audio_sample_size) {
+    if (a->format == AUDIO_PCM) return f == 1 ? 2 : 1;
+    if (f == 2) return 1;
+    if (video_ended) return INT_MAX;
+    int r = (int)ceil((double)(audio_sample_size - samples_written) / audio_sample_size);
+    return r * (f == 1 ? 2 : 1);
+}
+
+static int write_audio_packets(FILE *out, audio_source_t *a, int f, int video_ended,
+                               long *samples_written, int audio_sample_size, int verbose) {
+    int repeat = audio_repeat_count(a, f, video_ended, *samples_written, audio_sample_size);
+
+    for (int q = 0; q < repeat && audio_has_more(a); q++) {
+        size_t want = (a->format == AUDIO_PCM)
+            ? (size_t)((f % 2 == 1) ? audio_sample_size : audio_sample_size + 2)
+            : (size_t)a->packet_size;
+        size_t n = audio_read(a, a->buf, want);
+        if (n == 0) break;
+
+        if (a->format == AUDIO_MP2 && f > 1) *samples_written += MP2_FRAME_SAMPLES;
+
+        // MP2 packets carry no size; the player knows it from the rate index
+        uint8_t size[4];
+        put_u32(size, (uint32_t)n);
+        if (fwrite(a->packet_type, 1, 2, out) != 2 ||
+            (a->format != AUDIO_MP2 && fwrite(size, 1, 4, out) != 4) ||
+            fwrite(a->buf, 1, n, out) != n) {
+            return -1;
+        }
+
+        a->bytes += n;
+        a->packets++;
+        if (verbose) printf("Frame %d (%s) -> %zu bytes\n", f, a->format == AUDIO_MP2 ? "MP2fr" : "PCMu8", n);
+    }
+    return 0;
+}
+
+static int encode_mov(const mov_config_t *cfg) {
+    int resample = 0;
+    mov_config_t run = *cfg;
+    if (!run.fps) {
+        int exact;
+        run.fps = probe_fps(cfg->input_file, &exact);
+        if (run.fps < 0) return -1;
+        if (!exact) {
+            fprintf(stderr, "Note: Resampling the input to %d fps\n", run.fps);
+            resample = 1;
+        }
+    } else {
+        resample = 1;
+    }
+
+    // Samples per frame, times 2 for stereo
+    const int audio_sample_size = 2 * (AUDIO_SAMPLE_RATE / run.fps + 1);
+
+    audio_source_t audio;
+    if (audio_open(&run, &audio, audio_sample_size) < 0) {
+        audio_close(&audio);
+        return -1;
+    }
+
+    mov_pipeline_t p = {
+        .cfg = &run,
+        .header = { .width = run.width, .height = run.height, .flags = 0, .type = run.ipf_type },
+        .next_encode = 1
+    };
+    p.frame_bytes = (size_t)run.width * run.height * 3;
+    size_t blocks_size = ipf_blocks_size(&p.header);
+    size_t delta_bound = ipf_delta_bound(&p.header);
+    p.packet_cap = ZSTD_compressBound(run.delta && delta_bound > blocks_size ? delta_bound : blocks_size);
+
+    int jobs = run.jobs;
+    if (jobs <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = n > 0 ? (int)n : 1;
+    }
+    p.slot_count = jobs * 2 + 2;
+
+    FILE *out = fopen(run.output_file, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot create output file %s\n", run.output_file);
+        audio_close(&audio);
+        return -1;
+    }
+
+    p.video = open_video(&run, resample);
+    if (!p.video) {
+        fprintf(stderr, "Error: Failed to open video input %s\n", run.input_file);
+        fclose(out);
+        audio_close(&audio);
+        return -1;
+    }
+
+    // libipf reads whole edge blocks, so each slot is padded to the encoder's span
+    size_t rgb_cap = ipf_encode_src_span(&p.header, (size_t)run.width * 3, 3);
+    p.slots = calloc(p.slot_count, sizeof(frame_slot_t));
+    mov_worker_t *workers = calloc(jobs, sizeof(mov_worker_t));
+    int ok = p.slots && workers;
+    for (int i = 0; ok && i < p.slot_count; i++) {
+        p.slots[i].rgb = calloc(1, rgb_cap);
+        p.slots[i].blocks = malloc(blocks_size);
+        p.slots[i].packet = malloc(p.packet_cap);
+        ok = p.slots[i].rgb && p.slots[i].blocks && p.slots[i].packet;
+    }
+    for (int i = 0; ok && i < jobs; i++) {
+        workers[i].p = &p;
+        workers[i].cctx = ZSTD_createCCtx();
+        ok = workers[i].cctx != NULL;
+    }
+    delta_state_t delta = { 0 };
+    if (ok && run.delta) {
+        delta.reference = malloc(blocks_size);
+        delta.changed = malloc((size_t)ipf_blocks_x(&p.header) * ipf_blocks_y(&p.header));
+        delta.vectors = calloc((size_t)ipf_blocks_x(&p.header) * ipf_blocks_y(&p.header), sizeof(ipf_vector_t));
+        delta.stream = malloc(delta_bound);
+        delta.cctx = ZSTD_createCCtx();
+        delta.gop = run.gop < 0 ? MOV_GOP_SECONDS * run.fps : run.gop;
+        ok = delta.reference && delta.changed && delta.vectors && delta.stream && delta.cctx;
+        if (ok && run.stream) {
+            delta.zstream = ZSTD_createCCtx();
+            ok = delta.zstream &&
+                 !ZSTD_isError(ZSTD_CCtx_setParameter(delta.zstream, ZSTD_c_compressionLevel, run.zstd_level));
+        }
+    }
+    if (ok && run.bitrate) {
+        size_t blocks = (size_t)ipf_blocks_x(&p.header) * ipf_blocks_y(&p.header);
+        delta.budget = (size_t)run.bitrate * 1000 / 8 / run.fps;
+        delta.refresh = run.refresh ? run.refresh : MOV_REFRESH_SECONDS * run.fps;
+        delta.ratio = 0.5;
+        delta.scores = malloc(blocks * sizeof(int));
+        delta.age = calloc(blocks, sizeof(uint16_t));
+        delta.selected = malloc(blocks);
+        delta.candidates = malloc(blocks * sizeof(patch_candidate_t));
+        ok = delta.scores && delta.age && delta.selected && delta.candidates;
+        if (ok && delta.budget < MOV_MIN_BUDGET) {
+            fprintf(stderr, "Error: %d kbit/s leaves %zu bytes per frame; at least %d are needed\n",
+                    run.bitrate, delta.budget, MOV_MIN_BUDGET);
+            ok = 0;
+        }
+    }
+    if (!ok) fprintf(stderr, "Error: Failed to allocate encoder buffers\n");
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.changed, NULL);
+
+    if (ok && write_header(out, &run, &audio, audio_sample_size) < 0) {
+        fprintf(stderr, "Error: Failed to write output file\n");
+        ok = 0;
+    }
+
+    pthread_t reader;
+    int reader_started = 0, started = 0;
+    if (ok) {
+        printf("Encoding %s -> %s: %dx%d iPF%d%s at %d fps, %d worker%s, audio: %s\n",
+               run.input_file, run.output_file, run.width, run.height, run.ipf_type + 1,
+               run.delta ? " with delta frames" : "", run.fps,
+               jobs, jobs == 1 ? "" : "s",
+               audio.format == AUDIO_MP2 ? "MP2" : audio.format == AUDIO_PCM ? "PCMu8" : "none");
+        fflush(stdout);
+
+        reader_started = pthread_create(&reader, NULL, reader_main, &p) == 0;
+        for (int i = 0; reader_started && i < jobs; i++) {
+            if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) break;
+            started++;
+        }
+        if (!reader_started || started == 0) {
+            fprintf(stderr, "Error: Failed to start encoder threads\n");
+            ok = 0;
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    static const uint8_t SYNC_PACKET[2] = { 0xFF, 0xFF };
+    uint8_t video_type[2] = { run.stream ? 6 : 4, (uint8_t)run.ipf_type };
+    long samples_written = 0;
+    int frames = 0;
+    uint64_t video_bytes = 0;
+    seek_index_t index = { 0 };
+
+    for (int f = 1; ok; f++) {
+        if (f > 1 && fwrite(SYNC_PACKET, 1, 2, out) != 2) ok = 0;
+        long frame_offset = ftell(out);
+
+        int has_frame = wait_frame_known(&p, f);
+        if (has_frame < 0) {
+            ok = 0;
+            break;
+        }
+
+        if (ok && audio_has_more(&audio) &&
+            write_audio_packets(out, &audio, f, !has_frame, &samples_written, audio_sample_size, run.verbose) < 0) {
+            ok = 0;
+        }
+
+        if (ok && has_frame) {
+            frame_slot_t *slot = wait_frame_done(&p, f);
+            if (!slot) {
+                ok = 0;
+                break;
+            }
+
+            if (run.delta) {
+                int type = delta_packet(&p, &delta, slot);
+                if (type < 0) {
+                    ok = 0;
+                    break;
+                }
+                video_type[1] = (uint8_t)type;
+            }
+
+            uint8_t size[8];
+            put_u32(size, (uint32_t)slot->packet_size);
+            put_u32(size + 4, (uint32_t)slot->raw_size);
+            size_t size_len = run.stream ? 8 : 4;
+            if (fwrite(video_type, 1, 2, out) != 2 || fwrite(size, 1, size_len, out) != size_len ||
+                fwrite(slot->packet, 1, slot->packet_size, out) != slot->packet_size) {
+                ok = 0;
+            }
+            video_bytes += slot->packet_size;
+            frames = f;
+
+            // Keyframes to seek to, at most one a second
+            if (ok && video_type[1] < 2 &&
+                (index.count == 0 || f - 1 - (int)index.entries[index.count - 1].frame >= run.fps) &&
+                index_add(&index, f - 1, frame_offset) < 0) {
+                fprintf(stderr, "Error: Failed to allocate the seek index\n");
+                ok = 0;
+            }
+
+            if (run.verbose) {
+                printf("Frame %d -> %zu bytes%s\n", f, slot->packet_size,
+                       run.delta && video_type[1] >= 2 ? " (delta)" : "");
+            }
+            else if (f % run.fps == 0) {
+                fprintf(stderr, "\rFrame %d (%.1f fps)", f, f / elapsed_seconds(&start));
+            }
+
+            release_slot(&p, slot);
+            samples_written -= audio_sample_size;
+        }
+
+        if (!has_frame && !audio_has_more(&audio)) break;
+    }
+    if (!run.verbose && frames >= run.fps) fprintf(stderr, "\n");
+
+    if (!ok) {
+        fprintf(stderr, "Error: Encoding stopped at frame %d\n", frames + 1);
+        fail_pipeline(&p);
+    }
+    if (reader_started) pthread_join(reader, NULL);
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+    if (ok && write_index(out, &index) < 0) {
+        fprintf(stderr, "Error: Failed to write the seek index\n");
+        ok = 0;
+    }
+
+    // The frame count is only known now
+    if (ok) {
+        uint8_t count[4];
+        put_u32(count, (uint32_t)frames);
+        if (fseek(out, MOV_FRAME_COUNT_OFFSET, SEEK_SET) != 0 || fwrite(count, 1, 4, out) != 4) {
+            fprintf(stderr, "Error: Failed to update the frame count\n");
+            ok = 0;
+        }
+    }
+    if (fclose(out) != 0) ok = 0;
+
+    if (ok) {
+        double secs = elapsed_seconds(&start);
+        if (secs <= 0) secs = 1e-9;
+        printf("Encoded %d frames in %.2f s (%.1f fps)\n", frames, secs, frames / secs);
+        printf("  Video: %.2f MB, %.1f KB per frame\n", video_bytes / 1e6,
+               frames ? video_bytes / 1024.0 / frames : 0.0);
+        if (run.delta) printf("  Keyframes: %d of %d\n", delta.keyframes, frames);
+        printf("  Seek index: %zu entries\n", index.count);
+        if (run.motion) printf("  Moved blocks: %zu\n", delta.moved_blocks);
+        if (delta.budget) {
+            printf("  Budget: %zu bytes per frame; %d keyframe%s over it, %zu patches deferred, %zu starved blocks refreshed\n",
+                   delta.budget, delta.over_budget, delta.over_budget == 1 ? "" : "s",
+                   delta.dropped, delta.refreshed);
+        }
+        if (audio.format != AUDIO_NONE) {
+            printf("  Audio: %.2f MB in %zu packets\n", audio.bytes / 1e6, audio.packets);
+        }
+    }
+
+    close_video(&run, p.video);
+    pthread_cond_destroy(&p.changed);
+    pthread_mutex_destroy(&p.lock);
+    for (int i = 0; workers && i < jobs; i++) {
+        if (workers[i].cctx) ZSTD_freeCCtx(workers[i].cctx);
+    }
+    for (int i = 0; p.slots && i < p.slot_count; i++) {
+        free(p.slots[i].rgb);
+        free(p.slots[i].blocks);
+        free(p.slots[i].packet);
+    }
+    if (delta.cctx) ZSTD_freeCCtx(delta.cctx);
+    if (delta.zstream) ZSTD_freeCCtx(delta.zstream);
+    free(delta.reference);
+    free(delta.changed);
+    free(delta.vectors);
+    free(delta.scores);
+    free(delta.age);
+    free(delta.selected);
+    free(delta.candidates);
+    free(delta.stream);
+    free(index.entries);
+    free(workers);
+    free(p.slots);
+    audio_close(&audio);
+
+    return ok && frames > 0 ? 0 : -1;
+}
+
+// =============================================================================
+// Main Entry Point
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    mov_config_t cfg = {
+        .input_file = NULL,
+        .output_file = NULL,
+        .width = TSVM_FB_WIDTH,
+        .height = TSVM_FB_HEIGHT,
+        .fps = 0,
+        .max_frames = 0,
+        .ipf_type = IPF_TYPE_1,
+        .delta = 0,
+        .motion = 0,
+        .bitrate = 0,
+        .refresh = 0,
+        .gop = -1,
+        .stream = 0,
+        .audio_file = NULL,
+        .audio_from_input = 0,
+        .pcm = 0,
+        .audio_bitrate = MOV_AUDIO_BITRATE,
+        .zstd_level = MOV_ZSTD_LEVEL,
+        .jobs = 0,
+        .raw_input = 0,
+        .verbose = 0
+    };
+
+    static struct option long_options[] = {
+        {"input",            required_argument, 0, 'i'},
+        {"output",           required_argument, 0, 'o'},
+        {"size",             required_argument, 0, 's'},
+        {"fps",              required_argument, 0, 'r'},
+        {"frames",           required_argument, 0, 'n'},
+        {"type",             required_argument, 0, 't'},
+        {"delta",            no_argument,       0, 'd'},
+        {"motion",           no_argument,       0, 'm'},
+        {"bitrate",          required_argument, 0, 'B'},
+        {"refresh",          required_argument, 0, 'F'},
+        {"gop",              required_argument, 0, 'g'},
+        {"stream",           no_argument,       0, 'S'},
+        {"audio",            required_argument, 0, 'a'},
+        {"audio-from-input", no_argument,       0, 'A'},
+        {"pcm",              no_argument,       0, 'P'},
+        {"audio-bitrate",    required_argument, 0, 'b'},
+        {"zstd-level",       required_argument, 0, 'z'},
+        {"jobs",             required_argument, 0, 'j'},
+        {"raw",              no_argument,       0, 'R'},
+        {"verbose",          no_argument,       0, 'v'},
+        {"help",             no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:o:s:r:n:t:dmB:g:a:Ab:z:j:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                cfg.input_file = optarg;
+                break;
+            case 'o':
+                cfg.output_file = optarg;
+                break;
+            case 's':
+                if (parse_size(optarg, &cfg.width, &cfg.height) < 0) {
+                    fprintf(stderr, "Error: Invalid size format. Use WxH (e.g., 560x448)\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                cfg.fps = atoi(optarg);
+                if (cfg.fps < 1 || cfg.fps > 65535) {
+                    fprintf(stderr, "Error: Frame rate must be 1-65535\n");
+                    return 1;
+                }
+                break;
+            case 'n':
+                cfg.max_frames = atoi(optarg);
+                if (cfg.max_frames < 1) {
+                    fprintf(stderr, "Error: Frame count must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 't': {
+                int t = atoi(optarg);
+                if (t != 1 && t != 2) {
+                    fprintf(stderr, "Error: Type must be 1 or 2\n");
+                    return 1;
+                }
+                cfg.ipf_type = t - 1;
+                break;
+            }
+            case 'd':
+                cfg.delta = 1;
+                break;
+            case 'm':
+                cfg.motion = 1;
+                break;
+            case 'B':
+                cfg.bitrate = atoi(optarg);
+                if (cfg.bitrate < 1) {
+                    fprintf(stderr, "Error: Bitrate must be at least 1 kbit/s\n");
+                    return 1;
+                }
+                break;
+            case 'g':
+                cfg.gop = atoi(optarg);
+                if (cfg.gop < 0) {
+                    fprintf(stderr, "Error: GOP must be 0 or more frames\n");
+                    return 1;
+                }
+                break;
+            case 'S':
+                cfg.stream = 1;
+                break;
+            case 'F':
+                cfg.refresh = atoi(optarg);
+                if (cfg.refresh < 1) {
+                    fprintf(stderr, "Error: Refresh must be at least 1 frame\n");
+                    return 1;
+                }
+                break;
+            case 'a':
+                cfg.audio_file = optarg;
+                break;
+            case 'A':
+                cfg.audio_from_input = 1;
+                break;
+            case 'P':
+                cfg.pcm = 1;
+                break;
+            case 'b':
+                cfg.audio_bitrate = atoi(optarg);
+                if (cfg.audio_bitrate < 32 || cfg.audio_bitrate > 384) {
+                    fprintf(stderr, "Error: MP2 bitrate must be 32-384 kbps\n");
+                    return 1;
+                }
+                break;
+            case 'z':
+                cfg.zstd_level = atoi(optarg);
+                if (cfg.zstd_level < 1 || cfg.zstd_level > ZSTD_maxCLevel()) {
+                    fprintf(stderr, "Error: Zstd level must be 1-%d\n", ZSTD_maxCLevel());
+                    return 1;
+                }
+                break;
+            case 'j':
+                cfg.jobs = atoi(optarg);
+                if (cfg.jobs < 1) {
+                    fprintf(stderr, "Error: Jobs must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'R':
+                cfg.raw_input = 1;
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.input_file || !cfg.output_file) {
+        fprintf(stderr, "Error: Input and output files are required\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (cfg.width < 1 || cfg.width > TSVM_FB_WIDTH || cfg.height < 1 || cfg.height > TSVM_FB_HEIGHT) {
+        fprintf(stderr, "Error: Frame size must be within %dx%d\n", TSVM_FB_WIDTH, TSVM_FB_HEIGHT);
+        return 1;
+    }
+    if (cfg.audio_file && cfg.audio_from_input) {
+        fprintf(stderr, "Error: Use either --audio or --audio-from-input\n");
+        return 1;
+    }
+    if (cfg.raw_input && (!cfg.fps || cfg.audio_from_input)) {
+        fprintf(stderr, "Error: --raw needs -r and cannot take audio from the input\n");
+        return 1;
+    }
+    if ((cfg.motion || cfg.bitrate || cfg.stream) && !cfg.delta) {
+        fprintf(stderr, "Error: --motion, --bitrate and --stream need --delta\n");
+        return 1;
+    }
+    if (strcmp(cfg.output_file, "-") == 0) {
+        fprintf(stderr, "Error: Output must be a seekable file\n");
+        return 1;
+    }
+
+    return encode_mov(&cfg) == 0 ? 0 : 1;
+}
@@ -0,0 +1,556 @@
+/**
+ * Image Writers - in-process PNG/QOI/PPM/PAM/TGA output for the iPF tools
+ */
+
+#include "image_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+
+#define MAX_PATH 4096
+#define PNG_IDAT_CHUNK 65536
+
+struct image_writer {
+    image_format_t fmt;
+    FILE *fp;
+    int is_pipe;
+    int is_stdout;
+    int width;
+    int height;
+    int channels;
+    int rows_written;
+    int failed;
+    uint8_t *scratch;        // One converted row (TGA/PPM/QOI)
+
+    // PNG
+    z_stream zs;
+    int zs_ready;
+    int png_filter;
+    uint8_t *prev_row;       // Previous unfiltered row (zeroed for the first row)
+    uint8_t *filt_rows;      // 5 candidate filtered rows for adaptive filtering
+    uint8_t *zbuf;           // Pending IDAT payload
+
+    // QOI
+    uint8_t qoi_index[64 * 4];
+    uint8_t qoi_prev[4];
+    int qoi_run;
+};
+
+// =============================================================================
+// Format Selection
+// =============================================================================
+
+static const struct {
+    const char *name;
+    image_format_t fmt;
+} FORMAT_NAMES[] = {
+    {"raw", IMG_FMT_RAW},
+    {"png", IMG_FMT_PNG},
+    {"qoi", IMG_FMT_QOI},
+    {"ppm", IMG_FMT_PPM},
+    {"pnm", IMG_FMT_PPM},
+    {"pgm", IMG_FMT_PPM},
+    {"pam", IMG_FMT_PAM},
+    {"tga", IMG_FMT_TGA},
+    {"ffmpeg", IMG_FMT_FFMPEG},
+};
+
+image_format_t image_format_from_path(const char *path) {
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (!dot || (slash && dot < slash)) return IMG_FMT_FFMPEG;
+
+    int fmt = image_format_from_name(dot + 1);
+    return fmt < 0 ? IMG_FMT_FFMPEG : (image_format_t)fmt;
+}
+
+int image_format_from_name(const char *name) {
+    for (size_t i = 0; i < sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0]); i++) {
+        if (strcasecmp(name, FORMAT_NAMES[i].name) == 0) return FORMAT_NAMES[i].fmt;
+    }
+    return -1;
+}
+
+const char *image_format_name(image_format_t fmt) {
+    for (size_t i = 0; i < sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0]); i++) {
+        if (FORMAT_NAMES[i].fmt == fmt) return FORMAT_NAMES[i].name;
+    }
+    return "unknown";
+}
+
+int png_filter_from_name(const char *name) {
+    if (strcasecmp(name, "none") == 0) return PNG_FILTER_NONE;
+    if (strcasecmp(name, "sub") == 0) return PNG_FILTER_SUB;
+    if (strcasecmp(name, "up") == 0) return PNG_FILTER_UP;
+    if (strcasecmp(name, "avg") == 0 || strcasecmp(name, "average") == 0) return PNG_FILTER_AVERAGE;
+    if (strcasecmp(name, "paeth") == 0) return PNG_FILTER_PAETH;
+    if (strcasecmp(name, "adaptive") == 0) return PNG_FILTER_ADAPTIVE;
+    return -1;
+}
+
+// =============================================================================
+// Byte Helpers
+// =============================================================================
+
+static void put_u32_be(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static int write_all(image_writer_t *w, const void *data, size_t len) {
+    if (len && fwrite(data, 1, len, w->fp) != len) {
+        w->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// PNG
+// =============================================================================
+
+static int png_write_chunk(image_writer_t *w, const char *type, const uint8_t *data, uint32_t len) {
+    uint8_t head[8];
+    uint8_t tail[4];
+    put_u32_be(head, len);
+    memcpy(head + 4, type, 4);
+
+    uLong crc = crc32(0L, (const Bytef *)type, 4);
+    if (len) crc = crc32(crc, data, len);
+    put_u32_be(tail, (uint32_t)crc);
+
+    if (write_all(w, head, 8) < 0) return -1;
+    if (write_all(w, data, len) < 0) return -1;
+    return write_all(w, tail, 4);
+}
+
+static int png_begin(image_writer_t *w, const image_writer_opts_t *opts) {
+    static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    size_t row_bytes = (size_t)w->width * w->channels;
+
+    w->png_filter = opts->png_filter;
+    w->prev_row = calloc(1, row_bytes);
+    w->filt_rows = malloc((row_bytes + 1) * 5);
+    w->zbuf = malloc(PNG_IDAT_CHUNK);
+    if (!w->prev_row || !w->filt_rows || !w->zbuf) return -1;
+
+    memset(&w->zs, 0, sizeof(w->zs));
+    int level = opts->png_level < 0 ? 0 : (opts->png_level > 9 ? 9 : opts->png_level);
+    if (deflateInit(&w->zs, level) != Z_OK) return -1;
+    w->zs_ready = 1;
+    w->zs.next_out = w->zbuf;
+    w->zs.avail_out = PNG_IDAT_CHUNK;
+
+    uint8_t ihdr[13];
+    put_u32_be(ihdr + 0, (uint32_t)w->width);
+    put_u32_be(ihdr + 4, (uint32_t)w->height);
+    ihdr[8] = 8;                             // Bit depth
+    ihdr[9] = w->channels == 4 ? 6 : (w->channels == 1 ? 0 : 2);  // Colour type: RGBA, grey or RGB
+    ihdr[10] = 0;                            // Deflate
+    ihdr[11] = 0;                            // Adaptive filtering
+    ihdr[12] = 0;                            // No interlace
+
+    if (write_all(w, PNG_SIGNATURE, 8) < 0) return -1;
+    return png_write_chunk(w, "IHDR", ihdr, 13);
+}
+
+static int png_deflate(image_writer_t *w, const uint8_t *data, size_t len, int flush) {
+    w->zs.next_in = (Bytef *)data;
+    w->zs.avail_in = (uInt)len;
+
+    for (;;) {
+        int ret = deflate(&w->zs, flush);
+        if (ret == Z_STREAM_ERROR) return -1;
+
+        if (w->zs.avail_out == 0) {
+            if (png_write_chunk(w, "IDAT", w->zbuf, PNG_IDAT_CHUNK) < 0) return -1;
+            w->zs.next_out = w->zbuf;
+            w->zs.avail_out = PNG_IDAT_CHUNK;
+            continue;
+        }
+        if (flush == Z_FINISH ? ret == Z_STREAM_END : w->zs.avail_in == 0) break;
+    }
+    return 0;
+}
+
+static uint8_t paeth_predictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    if (pb <= pc) return (uint8_t)b;
+    return (uint8_t)c;
+}
+
+/**
+ * Filter one row with the given filter type into out (filter byte + row).
+ * Returns the sum of absolute signed residuals, the usual adaptive heuristic.
+ */
+static unsigned long png_filter_row(int filter, const uint8_t *row, const uint8_t *prev,
+                                    size_t row_bytes, int bpp, uint8_t *out) {
+    unsigned long cost = 0;
+    out[0] = (uint8_t)filter;
+
+    for (size_t i = 0; i < row_bytes; i++) {
+        int a = (i >= (size_t)bpp) ? row[i - bpp] : 0;
+        int b = prev[i];
+        int c = (i >= (size_t)bpp) ? prev[i - bpp] : 0;
+        uint8_t v;
+
+        switch (filter) {
+            case PNG_FILTER_SUB:     v = (uint8_t)(row[i] - a); break;
+            case PNG_FILTER_UP:      v = (uint8_t)(row[i] - b); break;
+            case PNG_FILTER_AVERAGE: v = (uint8_t)(row[i] - ((a + b) >> 1)); break;
+            case PNG_FILTER_PAETH:   v = (uint8_t)(row[i] - paeth_predictor(a, b, c)); break;
+            default:                 v = row[i]; break;
+        }
+
+        out[i + 1] = v;
+        cost += (v < 128) ? v : 256 - v;
+    }
+    return cost;
+}
+
+static int png_write_row(image_writer_t *w, const uint8_t *row) {
+    size_t row_bytes = (size_t)w->width * w->channels;
+    uint8_t *best = w->filt_rows;
+
+    if (w->png_filter == PNG_FILTER_ADAPTIVE) {
+        unsigned long best_cost = (unsigned long)-1;
+        for (int f = PNG_FILTER_NONE; f <= PNG_FILTER_PAETH; f++) {
+            uint8_t *cand = w->filt_rows + f * (row_bytes + 1);
+            unsigned long cost = png_filter_row(f, row, w->prev_row, row_bytes, w->channels, cand);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = cand;
+            }
+        }
+    } else {
+        png_filter_row(w->png_filter, row, w->prev_row, row_bytes, w->channels, best);
+    }
+
+    memcpy(w->prev_row, row, row_bytes);
+    return png_deflate(w, best, row_bytes + 1, Z_NO_FLUSH);
+}
+
+static int png_finish(image_writer_t *w) {
+    if (png_deflate(w, NULL, 0, Z_FINISH) < 0) return -1;
+
+    uint32_t pending = PNG_IDAT_CHUNK - w->zs.avail_out;
+    if (pending && png_write_chunk(w, "IDAT", w->zbuf, pending) < 0) return -1;
+    return png_write_chunk(w, "IEND", NULL, 0);
+}
+
+// =============================================================================
+// QOI
+// =============================================================================
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+
+static int qoi_begin(image_writer_t *w) {
+    uint8_t header[14];
+    memcpy(header, "qoif", 4);
+    put_u32_be(header + 4, (uint32_t)w->width);
+    put_u32_be(header + 8, (uint32_t)w->height);
+    header[12] = (uint8_t)(w->channels == 4 ? 4 : 3);  // QOI has no grey; it goes out as RGB
+    header[13] = 0;  // sRGB with linear alpha
+
+    memset(w->qoi_index, 0, sizeof(w->qoi_index));
+    w->qoi_prev[0] = w->qoi_prev[1] = w->qoi_prev[2] = 0;
+    w->qoi_prev[3] = 255;
+    w->qoi_run = 0;
+
+    // Worst case is 5 bytes per pixel (QOI_OP_RGBA)
+    w->scratch = malloc((size_t)w->width * 5);
+    if (!w->scratch) return -1;
+    return write_all(w, header, sizeof(header));
+}
+
+static int qoi_write_row(image_writer_t *w, const uint8_t *row) {
+    uint8_t *out = w->scratch;
+    size_t n = 0;
+
+    for (int x = 0; x < w->width; x++) {
+        const uint8_t *p = row + (size_t)x * w->channels;
+        uint8_t px[4] = {p[0], p[0], p[0], 255};
+        if (w->channels >= 3) {
+            px[1] = p[1];
+            px[2] = p[2];
+            if (w->channels == 4) px[3] = p[3];
+        }
+
+        if (memcmp(px, w->qoi_prev, 4) == 0) {
+            if (++w->qoi_run == 62) {
+                out[n++] = QOI_OP_RUN | 61;
+                w->qoi_run = 0;
+            }
+            continue;
+        }
+
+        if (w->qoi_run > 0) {
+            out[n++] = (uint8_t)(QOI_OP_RUN | (w->qoi_run - 1));
+            w->qoi_run = 0;
+        }
+
+        int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+        uint8_t *slot = w->qoi_index + hash * 4;
+
+        if (memcmp(slot, px, 4) == 0) {
+            out[n++] = (uint8_t)(QOI_OP_INDEX | hash);
+        } else {
+            memcpy(slot, px, 4);
+
+            if (px[3] == w->qoi_prev[3]) {
+                int vr = (int8_t)(px[0] - w->qoi_prev[0]);
+                int vg = (int8_t)(px[1] - w->qoi_prev[1]);
+                int vb = (int8_t)(px[2] - w->qoi_prev[2]);
+                int vg_r = vr - vg;
+                int vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out[n++] = (uint8_t)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                    out[n++] = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+                    out[n++] = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    out[n++] = QOI_OP_RGB;
+                    out[n++] = px[0];
+                    out[n++] = px[1];
+                    out[n++] = px[2];
+                }
+            } else {
+                out[n++] = QOI_OP_RGBA;
+                out[n++] = px[0];
+                out[n++] = px[1];
+                out[n++] = px[2];
+                out[n++] = px[3];
+            }
+        }
+
+        memcpy(w->qoi_prev, px, 4);
+    }
+
+    return write_all(w, out, n);
+}
+
+static int qoi_finish(image_writer_t *w) {
+    static const uint8_t QOI_END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    if (w->qoi_run > 0) {
+        uint8_t op = (uint8_t)(QOI_OP_RUN | (w->qoi_run - 1));
+        if (write_all(w, &op, 1) < 0) return -1;
+    }
+    return write_all(w, QOI_END, sizeof(QOI_END));
+}
+
+// =============================================================================
+// PPM / PAM / TGA
+// =============================================================================
+
+static int netpbm_begin(image_writer_t *w) {
+    if (w->fmt == IMG_FMT_PPM) {
+        if (w->channels == 4) {
+            w->scratch = malloc((size_t)w->width * 3);
+            if (!w->scratch) return -1;
+        }
+        if (fprintf(w->fp, "%s\n%d %d\n255\n", w->channels == 1 ? "P5" : "P6", w->width, w->height) < 0) return -1;
+    } else {
+        if (fprintf(w->fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                    w->width, w->height, w->channels,
+                    w->channels == 4 ? "RGB_ALPHA" : (w->channels == 1 ? "GRAYSCALE" : "RGB")) < 0) return -1;
+    }
+    return 0;
+}
+
+static int tga_begin(image_writer_t *w) {
+    uint8_t header[18] = {0};
+    header[2] = w->channels == 1 ? 3 : 2;            // Uncompressed grey or true-colour
+    header[12] = (uint8_t)(w->width & 0xFF);
+    header[13] = (uint8_t)(w->width >> 8);
+    header[14] = (uint8_t)(w->height & 0xFF);
+    header[15] = (uint8_t)(w->height >> 8);
+    header[16] = (uint8_t)(w->channels * 8);         // Bits per pixel
+    header[17] = (uint8_t)(0x20 | (w->channels == 4 ? 8 : 0));  // Top-left origin, alpha bits
+
+    w->scratch = malloc((size_t)w->width * w->channels);
+    if (!w->scratch) return -1;
+    return write_all(w, header, sizeof(header));
+}
+
+static int tga_write_row(image_writer_t *w, const uint8_t *row) {
+    int ch = w->channels;
+    if (ch == 1) return write_all(w, row, (size_t)w->width);
+    for (int x = 0; x < w->width; x++) {
+        const uint8_t *s = row + (size_t)x * ch;
+        uint8_t *d = w->scratch + (size_t)x * ch;
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = s[0];
+        if (ch == 4) d[3] = s[3];
+    }
+    return write_all(w, w->scratch, (size_t)w->width * ch);
+}
+
+static int ppm_write_row(image_writer_t *w, const uint8_t *row) {
+    if (w->channels != 4) return write_all(w, row, (size_t)w->width * w->channels);
+
+    for (int x = 0; x < w->width; x++) {
+        memcpy(w->scratch + (size_t)x * 3, row + (size_t)x * 4, 3);
+    }
+    return write_all(w, w->scratch, (size_t)w->width * 3);
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+image_writer_t *image_writer_open(const char *path, image_format_t fmt,
+                                  int width, int height, int channels,
+                                  const image_writer_opts_t *opts) {
+    image_writer_opts_t defaults = IMAGE_WRITER_OPTS_DEFAULT;
+    if (!opts) opts = &defaults;
+
+    image_writer_t *w = calloc(1, sizeof(image_writer_t));
+    if (!w) return NULL;
+
+    w->fmt = fmt;
+    w->width = width;
+    w->height = height;
+    w->channels = channels;
+
+    if (fmt == IMG_FMT_FFMPEG) {
+        char cmd[MAX_PATH * 2];
+        snprintf(cmd, sizeof(cmd),
+                 "ffmpeg -hide_banner -v quiet -y -f rawvideo -pix_fmt %s -s %dx%d "
+                 "-i - \"%s\"",
+                 channels == 4 ? "rgba" : (channels == 1 ? "gray" : "rgb24"), width, height, path);
+
+        if (opts->verbose) {
+            fprintf(stderr, "FFmpeg command: %s\n", cmd);
+        }
+
+        w->fp = popen(cmd, "w");
+        w->is_pipe = 1;
+        if (!w->fp) {
+            fprintf(stderr, "Error: Failed to start FFmpeg\n");
+            free(w);
+            return NULL;
+        }
+        return w;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        w->fp = stdout;
+        w->is_stdout = 1;
+    } else {
+        w->fp = fopen(path, "wb");
+    }
+    if (!w->fp) {
+        fprintf(stderr, "Error: Failed to open output file: %s\n", path);
+        free(w);
+        return NULL;
+    }
+
+    int result = 0;
+    switch (fmt) {
+        case IMG_FMT_PNG: result = png_begin(w, opts); break;
+        case IMG_FMT_QOI: result = qoi_begin(w); break;
+        case IMG_FMT_PPM:
+        case IMG_FMT_PAM: result = netpbm_begin(w); break;
+        case IMG_FMT_TGA: result = tga_begin(w); break;
+        default: break;
+    }
+
+    if (result < 0) {
+        fprintf(stderr, "Error: Failed to start %s output\n", image_format_name(fmt));
+        w->failed = 1;
+        image_writer_close(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+int image_writer_write_rows(image_writer_t *w, const uint8_t *rows, size_t stride, int count) {
+    size_t row_bytes = (size_t)w->width * w->channels;
+
+    if (w->failed) return -1;
+    if (w->rows_written + count > w->height) count = w->height - w->rows_written;
+
+    // Raw-like formats take contiguous bands in one write
+    if ((w->fmt == IMG_FMT_RAW || w->fmt == IMG_FMT_FFMPEG || w->fmt == IMG_FMT_PAM ||
+         (w->fmt == IMG_FMT_PPM && w->channels != 4)) && stride == row_bytes) {
+        w->rows_written += count;
+        return write_all(w, rows, row_bytes * count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *row = rows + i * stride;
+        int result;
+
+        switch (w->fmt) {
+            case IMG_FMT_PNG: result = png_write_row(w, row); break;
+            case IMG_FMT_QOI: result = qoi_write_row(w, row); break;
+            case IMG_FMT_PPM: result = ppm_write_row(w, row); break;
+            case IMG_FMT_TGA: result = tga_write_row(w, row); break;
+            default: result = write_all(w, row, row_bytes); break;
+        }
+
+        if (result < 0) {
+            w->failed = 1;
+            return -1;
+        }
+        w->rows_written++;
+    }
+    return 0;
+}
+
+int image_writer_close(image_writer_t *w) {
+    if (!w) return 0;
+
+    int result = w->failed ? -1 : 0;
+
+    if (result == 0 && w->rows_written != w->height) {
+        fprintf(stderr, "Error: Image writer got %d of %d rows\n", w->rows_written, w->height);
+        result = -1;
+    }
+
+    if (result == 0) {
+        if (w->fmt == IMG_FMT_PNG) result = png_finish(w);
+        else if (w->fmt == IMG_FMT_QOI) result = qoi_finish(w);
+    }
+
+    if (w->zs_ready) deflateEnd(&w->zs);
+
+    if (w->fp) {
+        if (w->is_pipe) {
+            int status = pclose(w->fp);
+            if (status != 0) {
+                fprintf(stderr, "Error: FFmpeg failed with status %d\n", status);
+                result = -1;
+            }
+        } else if (w->is_stdout) {
+            if (fflush(w->fp) != 0) result = -1;
+        } else if (fclose(w->fp) != 0) {
+            result = -1;
+        }
+    }
+
+    free(w->scratch);
+    free(w->prev_row);
+    free(w->filt_rows);
+    free(w->zbuf);
+    free(w);
+
+    return result;
+}
@@ -0,0 +1,82 @@
+/**
+ * Image Writers - in-process PNG/QOI/PPM/PAM/TGA output for the iPF tools
+ *
+ * All writers accept scanlines incrementally, so a decoder can push bands
+ * as they are produced. Formats without a native writer fall back to an
+ * FFmpeg pipe.
+ */
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    IMG_FMT_RAW = 0,     // Bare RGB24/RGBA/grey scanlines
+    IMG_FMT_PNG,
+    IMG_FMT_QOI,
+    IMG_FMT_PPM,         // P6 (P5 for grey); alpha is dropped
+    IMG_FMT_PAM,         // P7 RGB, RGB_ALPHA or GRAYSCALE
+    IMG_FMT_TGA,         // Uncompressed true-colour or grey, top-left origin
+    IMG_FMT_FFMPEG       // Anything else, through an FFmpeg process
+} image_format_t;
+
+#define PNG_FILTER_NONE     0
+#define PNG_FILTER_SUB      1
+#define PNG_FILTER_UP       2
+#define PNG_FILTER_AVERAGE  3
+#define PNG_FILTER_PAETH    4
+#define PNG_FILTER_ADAPTIVE 5  // Pick the cheapest filter per row
+
+typedef struct {
+    int png_level;       // Deflate level 0..9
+    int png_filter;      // One of PNG_FILTER_*
+    int verbose;         // Print the FFmpeg command when falling back
+} image_writer_opts_t;
+
+#define IMAGE_WRITER_OPTS_DEFAULT { 1, PNG_FILTER_UP, 0 }
+
+typedef struct image_writer image_writer_t;
+
+/**
+ * Pick a format from a file extension. Unknown extensions map to IMG_FMT_FFMPEG.
+ */
+image_format_t image_format_from_path(const char *path);
+
+/**
+ * Parse a format name ("png", "qoi", "ppm", "pam", "tga", "raw", "ffmpeg").
+ * Returns -1 if the name is unknown.
+ */
+int image_format_from_name(const char *name);
+
+const char *image_format_name(image_format_t fmt);
+
+/**
+ * Parse a PNG filter name ("none", "sub", "up", "avg", "paeth", "adaptive").
+ * Returns -1 if the name is unknown.
+ */
+int png_filter_from_name(const char *name);
+
+/**
+ * Open a writer. path "-" writes to stdout (not available for IMG_FMT_FFMPEG).
+ * channels is 1 (grey), 3 (RGB24) or 4 (RGBA); QOI has no grey, so grey
+ * goes out as RGB there. Returns NULL on error.
+ */
+image_writer_t *image_writer_open(const char *path, image_format_t fmt,
+                                  int width, int height, int channels,
+                                  const image_writer_opts_t *opts);
+
+/**
+ * Append count scanlines of width*channels bytes each, taken stride bytes apart.
+ * Returns 0 on success, -1 on error.
+ */
+int image_writer_write_rows(image_writer_t *w, const uint8_t *rows, size_t stride, int count);
+
+/**
+ * Finish the file and free the writer. Returns 0 on success, -1 on error
+ * (including when fewer rows than the image height were written).
+ */
+int image_writer_close(image_writer_t *w);
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,1024 @@
+/**
+ * iPF Inspector - where the bytes of iPF files go
+ *
+ * Reads the block stream of one file or a whole tree and reports, for the
+ * lot of them:
+ *   - Shannon entropy of each plane (Y, Co, Cg, A nibbles) against the bits
+ *     the format spends on it
+ *   - the share of solid, duplicate, fully opaque and fully transparent blocks
+ *   - horizontal against vertical chroma variation inside blocks, and how
+ *     much vertical detail iPF2 keeps that iPF1 would average away
+ *   - the Zstd ratio of each plane compressed on its own
+ * and, for a single file, a heatmap of the estimated cost of every block.
+ *
+ * Files are mapped and walked in place across worker threads; only the
+ * per-plane Zstd pass does real work, and --no-zstd skips it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <zlib.h>
+
+#include "image_writer.h"
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MAX_PATH 4096
+#define PLANES_ZSTD_LEVEL 7  // encoder_ipf's level
+
+enum { PLANE_Y = 0, PLANE_CO, PLANE_CG, PLANE_A, PLANE_COUNT };
+static const char *PLANE_NAMES[PLANE_COUNT] = { "Y", "Co", "Cg", "A" };
+
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+static const uint8_t GZIP_MAGIC[3] = { 0x1F, 0x8B, 0x08 };
+
+// Chroma sample positions inside a block: iPF1 keeps a 2x2 grid, iPF2 a
+// 2-wide, 4-tall one; sample c sits at column c % 2, row c / 2
+#define CHROMA_COLS 2
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    char **inputs;
+    int input_count;
+    char *heatmap_file;
+    int zstd_level;      // 0 skips the per-plane Zstd pass
+    int json;
+    int jobs;
+    int verbose;
+} inspect_config_t;
+
+/**
+ * Totals over every file inspected; each worker keeps its own and they are
+ * added up at the end.
+ */
+typedef struct {
+    uint64_t files;
+    uint64_t failed;
+    uint64_t file_bytes;          // As stored
+    uint64_t block_bytes;         // Unpacked
+    uint64_t type_files[3];
+
+    uint64_t blocks;
+    uint64_t solid;               // One colour and alpha throughout
+    uint64_t duplicate;           // Byte-identical to an earlier block of the same file
+    uint64_t alpha_blocks;        // Blocks of files with an alpha plane
+    uint64_t opaque;
+    uint64_t transparent;
+
+    uint64_t hist[PLANE_COUNT][16];
+    uint64_t index_hist[256];     // Indexed files
+
+    double chroma_h_sq;           // Squared nibble steps between chroma neighbours
+    double chroma_v_sq;
+    uint64_t chroma_h_pairs;
+    uint64_t chroma_v_pairs;
+    uint64_t ipf2_pairs;          // iPF2 vertical pairs iPF1 would merge
+    uint64_t ipf2_detail;         // ... of which differ by more than one step
+
+    uint64_t plane_raw[PLANE_COUNT];
+    uint64_t plane_packed[PLANE_COUNT];
+    uint64_t stream_raw;          // Whole block stream, for comparison
+    uint64_t stream_packed;
+} inspect_stats_t;
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+typedef struct inspect_run inspect_run_t;
+
+typedef struct {
+    inspect_run_t *run;
+    pthread_t thread;
+    inspect_stats_t stats;
+    ZSTD_DCtx *dctx;
+    ZSTD_CCtx *cctx;
+    z_stream zs;
+    int zs_ready;
+    uint8_t *blocks;
+    size_t blocks_cap;
+    uint8_t *planes;              // Plane bytes, one plane after another
+    size_t planes_cap;
+    uint8_t *packed;
+    size_t packed_cap;
+    uint32_t *seen;               // Hash table of block offsets + 1
+    size_t seen_cap;
+} inspect_worker_t;
+
+struct inspect_run {
+    const inspect_config_t *cfg;
+    path_list_t *files;
+    size_t next;
+};
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Inspector - entropy and block statistics of iPF files\n");
+    printf("\nUsage: %s [options] FILE|DIR...\n\n", program);
+    printf("Options:\n");
+    printf("  --heatmap FILE           Write a map of estimated bytes per block (one input file;\n");
+    printf("                           PNG, QOI, PPM or TGA by extension)\n");
+    printf("  -z, --zstd LEVEL         Level for the per-plane Zstd ratios (default: %d)\n", PLANES_ZSTD_LEVEL);
+    printf("  --no-zstd                Skip the per-plane Zstd pass (scan at memory speed)\n");
+    printf("  --json                   Print the report as one JSON object\n");
+    printf("  -j, --jobs N             Worker threads (default: number of CPUs)\n");
+    printf("  -v, --verbose            One line per file as well\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nDirectories are searched recursively for .ipf, .ipf1, .ipf2 files.\n");
+    printf("\nExamples:\n");
+    printf("  %s photo.ipf --heatmap cost.png\n", program);
+    printf("  %s assets/disk0 --no-zstd -v\n", program);
+}
+
+static int ensure_capacity(uint8_t **buf, size_t *cap, size_t need) {
+    if (*cap >= need) return 0;
+    uint8_t *grown = realloc(*buf, need);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = need;
+    return 0;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int has_ipf_extension(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot || strncasecmp(dot + 1, "ipf", 3) != 0) return 0;
+    for (const char *c = dot + 4; *c; c++) {
+        if (*c < '0' || *c > '9') return 0;
+    }
+    return 1;
+}
+
+static int path_list_add(path_list_t *list, const char *path) {
+    if (list->count == list->capacity) {
+        size_t cap = list->capacity ? list->capacity * 2 : 64;
+        char **paths = realloc(list->paths, cap * sizeof(*paths));
+        if (!paths) return -1;
+        list->paths = paths;
+        list->capacity = cap;
+    }
+    list->paths[list->count] = strdup(path);
+    return list->paths[list->count++] ? 0 : -1;
+}
+
+static void path_list_free(path_list_t *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->paths[i]);
+    free(list->paths);
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int scan_directory(path_list_t *list, const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: Cannot open directory %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent *ent;
+    char path[MAX_PATH];
+
+    while (result == 0 && (ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path)) continue;
+
+        struct stat st;
+        if (stat(path, &st) < 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            result = scan_directory(list, path);
+        } else if (S_ISREG(st.st_mode) && has_ipf_extension(ent->d_name)) {
+            result = path_list_add(list, path);
+        }
+    }
+
+    closedir(d);
+    return result;
+}
+
+/**
+ * Bits per symbol of a histogram.
+ */
+static double entropy(const uint64_t *hist, int symbols) {
+    uint64_t total = 0;
+    for (int i = 0; i < symbols; i++) total += hist[i];
+    if (!total) return 0;
+    double h = 0;
+    for (int i = 0; i < symbols; i++) {
+        if (!hist[i]) continue;
+        double p = (double)hist[i] / total;
+        h -= p * log2(p);
+    }
+    return h;
+}
+
+static void stats_add(inspect_stats_t *dst, const inspect_stats_t *src) {
+    dst->files += src->files;
+    dst->failed += src->failed;
+    dst->file_bytes += src->file_bytes;
+    dst->block_bytes += src->block_bytes;
+    for (int t = 0; t < 3; t++) dst->type_files[t] += src->type_files[t];
+    dst->blocks += src->blocks;
+    dst->solid += src->solid;
+    dst->duplicate += src->duplicate;
+    dst->alpha_blocks += src->alpha_blocks;
+    dst->opaque += src->opaque;
+    dst->transparent += src->transparent;
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        for (int v = 0; v < 16; v++) dst->hist[p][v] += src->hist[p][v];
+        dst->plane_raw[p] += src->plane_raw[p];
+        dst->plane_packed[p] += src->plane_packed[p];
+    }
+    for (int v = 0; v < 256; v++) dst->index_hist[v] += src->index_hist[v];
+    dst->chroma_h_sq += src->chroma_h_sq;
+    dst->chroma_v_sq += src->chroma_v_sq;
+    dst->chroma_h_pairs += src->chroma_h_pairs;
+    dst->chroma_v_pairs += src->chroma_v_pairs;
+    dst->ipf2_pairs += src->ipf2_pairs;
+    dst->ipf2_detail += src->ipf2_detail;
+    dst->stream_raw += src->stream_raw;
+    dst->stream_packed += src->stream_packed;
+}
+
+static double share(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+// =============================================================================
+// Block Analysis
+// =============================================================================
+
+/**
+ * The block data of a file, in place when stored raw. Unflagged legacy
+ * payloads may be gzip, as decoder_ipf handles them.
+ */
+static const uint8_t *unpack_blocks(inspect_worker_t *w, const char *path, const ipf_header_t *header,
+                                    const uint8_t *payload, size_t payload_size) {
+    size_t raw_size = ipf_blocks_size(header);
+    int is_zstd = payload_size >= 4 && memcmp(payload, ZSTD_MAGIC, 4) == 0;
+    int is_gzip = payload_size >= 3 && memcmp(payload, GZIP_MAGIC, 3) == 0;
+    int flagged = (header->flags & IPF_FLAG_ZSTD) != 0;
+    int zstd = flagged ? !is_gzip : (payload_size < raw_size && is_zstd && !is_gzip);
+    int gzip = flagged ? is_gzip : (payload_size < raw_size && is_gzip);
+
+    if (!zstd && !gzip) {
+        if (payload_size < raw_size) {
+            fprintf(stderr, "Error: %s: Block data is truncated\n", path);
+            return NULL;
+        }
+        return payload;
+    }
+    if (ensure_capacity(&w->blocks, &w->blocks_cap, raw_size ? raw_size : 1) < 0) {
+        fprintf(stderr, "Error: %s: Out of memory\n", path);
+        return NULL;
+    }
+
+    if (zstd) {
+        size_t got = ZSTD_decompressDCtx(w->dctx, w->blocks, raw_size, payload, payload_size);
+        if (ZSTD_isError(got) || got != raw_size) {
+            fprintf(stderr, "Error: %s: Zstd decompression failed\n", path);
+            return NULL;
+        }
+        return w->blocks;
+    }
+
+    if (!w->zs_ready) {
+        if (inflateInit2(&w->zs, 16 + MAX_WBITS) != Z_OK) return NULL;
+        w->zs_ready = 1;
+    } else {
+        inflateReset(&w->zs);
+    }
+    w->zs.next_in = (Bytef *)payload;
+    w->zs.avail_in = (uInt)payload_size;
+    w->zs.next_out = w->blocks;
+    w->zs.avail_out = (uInt)raw_size;
+    int ret = inflate(&w->zs, Z_FINISH);
+    if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) || w->zs.avail_out != 0) {
+        fprintf(stderr, "Error: %s: Gzip decompression failed\n", path);
+        return NULL;
+    }
+    return w->blocks;
+}
+
+static uint32_t hash_block(const uint8_t *block, int size) {
+    // Blocks are 12 to 24 bytes; mix them a word at a time
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, block + i, 8);
+        h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    if (i < size) {
+        uint64_t v = 0;
+        memcpy(&v, block + i, size - i);
+        h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return (uint32_t)h;
+}
+
+/**
+ * Mark blocks identical to an earlier one (in stored order) in dup[].
+ * Open addressing on a table of block offsets, sized to twice the count.
+ */
+static int find_duplicates(inspect_worker_t *w, const uint8_t *blocks, size_t count, int block_size,
+                           uint8_t *dup) {
+    size_t cap = 1;
+    while (cap < count * 2) cap <<= 1;
+    if (w->seen_cap < cap) {
+        uint32_t *grown = realloc(w->seen, cap * sizeof(*grown));
+        if (!grown) return -1;
+        w->seen = grown;
+        w->seen_cap = cap;
+    }
+    memset(w->seen, 0, cap * sizeof(*w->seen));
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *block = blocks + i * block_size;
+        size_t slot = hash_block(block, block_size) & (cap - 1);
+        dup[i] = 0;
+        while (w->seen[slot]) {
+            if (memcmp(blocks + (size_t)(w->seen[slot] - 1) * block_size, block, block_size) == 0) {
+                dup[i] = 1;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+        if (!dup[i]) w->seen[slot] = (uint32_t)(i + 1);
+    }
+    return 0;
+}
+
+/**
+ * Whether n bytes all hold one nibble value twice over.
+ */
+static int solid_bytes(const uint8_t *v, int n) {
+    if ((v[0] >> 4) != (v[0] & 15)) return 0;
+    for (int i = 1; i < n; i++) {
+        if (v[i] != v[0]) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Squared nibble step between chroma samples a and b of both planes.
+ */
+static int chroma_step(const uint8_t *co, const uint8_t *cg, int a, int b, int *max_step) {
+    int dco = co[a] - co[b];
+    int dcg = cg[a] - cg[b];
+    int m = abs(dco) > abs(dcg) ? abs(dco) : abs(dcg);
+    if (max_step) *max_step = m;
+    return dco * dco + dcg * dcg;
+}
+
+/**
+ * Collect the statistics of one file's blocks. Plane bytes are appended to
+ * w->planes in their stored nibble packing, a plane at a time, so each can
+ * be compressed on its own.
+ */
+static int inspect_blocks(inspect_worker_t *w, const inspect_config_t *cfg, const ipf_header_t *header,
+                          const uint8_t *blocks, inspect_stats_t *s) {
+    int type = header->type == IPF_TYPE_1 ? 0 : 1;
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int chroma_bytes = type == 0 ? 2 : 4;
+    int chroma_samples = chroma_bytes * 2;
+    int block_size = ipf_block_size(header);
+    size_t count = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+
+    size_t plane_size[PLANE_COUNT];
+    plane_size[PLANE_Y] = count * 8;
+    plane_size[PLANE_CO] = count * chroma_bytes;
+    plane_size[PLANE_CG] = count * chroma_bytes;
+    plane_size[PLANE_A] = has_alpha ? count * 8 : 0;
+    // Y first in the buffer, then Co, Cg and A, as the enum orders them
+    size_t plane_off[PLANE_COUNT];
+    plane_off[PLANE_Y] = 0;
+    plane_off[PLANE_CO] = plane_size[PLANE_Y];
+    plane_off[PLANE_CG] = plane_off[PLANE_CO] + plane_size[PLANE_CO];
+    plane_off[PLANE_A] = plane_off[PLANE_CG] + plane_size[PLANE_CG];
+    size_t planes_total = plane_off[PLANE_A] + plane_size[PLANE_A];
+
+    // The duplicate flags ride at the end of the plane buffer
+    if (ensure_capacity(&w->planes, &w->planes_cap, planes_total + count) < 0) return -1;
+    uint8_t *dup = w->planes + planes_total;
+    if (find_duplicates(w, blocks, count, block_size, dup) < 0) return -1;
+
+    uint8_t *py = w->planes + plane_off[PLANE_Y];
+    uint8_t *pco = w->planes + plane_off[PLANE_CO];
+    uint8_t *pcg = w->planes + plane_off[PLANE_CG];
+    uint8_t *pa = w->planes + plane_off[PLANE_A];
+
+    // Count bytes here and split them into nibbles once at the end
+    uint64_t byte_hist[PLANE_COUNT][256];
+    memset(byte_hist, 0, sizeof(byte_hist));
+    int keep_planes = cfg->zstd_level > 0;
+    int rows = chroma_samples / CHROMA_COLS;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *b = blocks + i * block_size;
+        const uint8_t *yb = b + chroma_bytes * 2;
+        uint8_t co[8], cg[8];
+        for (int n = 0; n < chroma_bytes; n++) {
+            co[n * 2] = b[n] & 15;
+            co[n * 2 + 1] = b[n] >> 4;
+            cg[n * 2] = b[chroma_bytes + n] & 15;
+            cg[n * 2 + 1] = b[chroma_bytes + n] >> 4;
+            byte_hist[PLANE_CO][b[n]]++;
+            byte_hist[PLANE_CG][b[chroma_bytes + n]]++;
+        }
+        for (int n = 0; n < 8; n++) byte_hist[PLANE_Y][yb[n]]++;
+        if (keep_planes) {
+            memcpy(pco + i * chroma_bytes, b, chroma_bytes);
+            memcpy(pcg + i * chroma_bytes, b + chroma_bytes, chroma_bytes);
+            memcpy(py + i * 8, yb, 8);
+        }
+
+        int solid = solid_bytes(b, chroma_bytes) && solid_bytes(b + chroma_bytes, chroma_bytes) &&
+                    solid_bytes(yb, 8);
+        if (has_alpha) {
+            const uint8_t *ab = yb + 8;
+            for (int n = 0; n < 8; n++) byte_hist[PLANE_A][ab[n]]++;
+            if (keep_planes) memcpy(pa + i * 8, ab, 8);
+            int flat = solid_bytes(ab, 8);
+            solid = solid && flat;
+            s->opaque += flat && ab[0] == 0xFF;
+            s->transparent += flat && ab[0] == 0x00;
+        }
+        s->solid += solid;
+        s->duplicate += dup[i];
+
+        // Neighbouring chroma samples across and down the block
+        for (int r = 0; r < rows; r++) {
+            s->chroma_h_sq += chroma_step(co, cg, r * CHROMA_COLS, r * CHROMA_COLS + 1, NULL);
+            s->chroma_h_pairs++;
+            for (int c = 0; c < CHROMA_COLS && r + 1 < rows; c++) {
+                int step;
+                s->chroma_v_sq += chroma_step(co, cg, r * CHROMA_COLS + c, (r + 1) * CHROMA_COLS + c, &step);
+                s->chroma_v_pairs++;
+                // iPF1 averages chroma rows 0/1 and 2/3 together
+                if (type == 1 && r % 2 == 0) {
+                    s->ipf2_pairs++;
+                    s->ipf2_detail += step > 1;
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        for (int v = 0; v < 256; v++) {
+            s->hist[p][v & 15] += byte_hist[p][v];
+            s->hist[p][v >> 4] += byte_hist[p][v];
+        }
+    }
+
+    s->blocks += count;
+    if (has_alpha) s->alpha_blocks += count;
+
+    if (cfg->zstd_level > 0) {
+        size_t stream_size = count * block_size;
+        size_t bound = ZSTD_compressBound(stream_size);
+        if (ensure_capacity(&w->packed, &w->packed_cap, bound) < 0) return -1;
+        for (int p = 0; p < PLANE_COUNT; p++) {
+            if (!plane_size[p]) continue;
+            size_t n = ZSTD_compressCCtx(w->cctx, w->packed, bound, w->planes + plane_off[p], plane_size[p],
+                                         cfg->zstd_level);
+            if (ZSTD_isError(n)) return -1;
+            s->plane_raw[p] += plane_size[p];
+            s->plane_packed[p] += n;
+        }
+        size_t n = ZSTD_compressCCtx(w->cctx, w->packed, bound, blocks, stream_size, cfg->zstd_level);
+        if (ZSTD_isError(n)) return -1;
+        s->stream_raw += stream_size;
+        s->stream_packed += n;
+    }
+    return 0;
+}
+
+/**
+ * Estimated bits of each block: the order-0 cost of its nibbles under this
+ * file's own plane histograms, with duplicates free. Zstd does better than
+ * order-0 on repetition, so the map shows where the entropy sits, not exact
+ * compressed bytes.
+ */
+static int block_costs(inspect_worker_t *w, const ipf_header_t *header, const uint8_t *blocks,
+                       const inspect_stats_t *s, float **cost_out) {
+    int type = header->type == IPF_TYPE_1 ? 0 : 1;
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int chroma_bytes = type == 0 ? 2 : 4;
+    int block_size = ipf_block_size(header);
+    size_t count = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+
+    double bits[PLANE_COUNT][16];
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        uint64_t total = 0;
+        for (int v = 0; v < 16; v++) total += s->hist[p][v];
+        for (int v = 0; v < 16; v++) bits[p][v] = s->hist[p][v] ? -log2((double)s->hist[p][v] / total) : 0;
+    }
+
+    float *cost = malloc(count * sizeof(*cost));
+    if (!cost) return -1;
+    uint8_t *flags = malloc(count ? count : 1);
+    if (!flags || find_duplicates(w, blocks, count, block_size, flags) < 0) {
+        free(flags);
+        free(cost);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *b = blocks + i * block_size;
+        double c = 0;
+        if (!flags[i]) {
+            for (int n = 0; n < chroma_bytes; n++) {
+                c += bits[PLANE_CO][b[n] & 15] + bits[PLANE_CO][b[n] >> 4];
+                c += bits[PLANE_CG][b[chroma_bytes + n] & 15] + bits[PLANE_CG][b[chroma_bytes + n] >> 4];
+            }
+            for (int n = 0; n < 8; n++) {
+                uint8_t y = b[chroma_bytes * 2 + n];
+                c += bits[PLANE_Y][y & 15] + bits[PLANE_Y][y >> 4];
+                if (has_alpha) {
+                    uint8_t a = b[chroma_bytes * 2 + 8 + n];
+                    c += bits[PLANE_A][a & 15] + bits[PLANE_A][a >> 4];
+                }
+            }
+        }
+        cost[i] = (float)(c / 8.0);
+    }
+    free(flags);
+    *cost_out = cost;
+    return 0;
+}
+
+// =============================================================================
+// Heatmap
+// =============================================================================
+
+/**
+ * Black through blue, red and yellow to white for 0..1.
+ */
+static void heat_colour(double t, uint8_t *rgb) {
+    static const uint8_t stops[5][3] = {
+        { 0, 0, 0 }, { 32, 32, 200 }, { 220, 40, 40 }, { 250, 220, 40 }, { 255, 255, 255 }
+    };
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    double x = t * 4;
+    int i = x >= 4 ? 3 : (int)x;
+    double f = x - i;
+    for (int c = 0; c < 3; c++) rgb[c] = (uint8_t)(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f + 0.5);
+}
+
+/**
+ * Write the image size map: each 4x4 block painted by its estimated bytes,
+ * scaled to the costliest block of the file. Progressive files are put
+ * back in raster order.
+ */
+static int write_heatmap(const char *path, const ipf_header_t *header, const float *cost) {
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    size_t count = (size_t)blocks_x * blocks_y;
+
+    float *raster = malloc(count * sizeof(*raster));
+    uint32_t *order = malloc(count * sizeof(*order));
+    size_t stride = (size_t)header->width * 3;
+    uint8_t *band = malloc(stride * 4);
+    if (!raster || !order || !band) {
+        free(raster);
+        free(order);
+        free(band);
+        fprintf(stderr, "Error: Out of memory for the heatmap\n");
+        return -1;
+    }
+
+    float max_cost = 0;
+    if (header->flags & IPF_FLAG_PROGRESSIVE) ipf_adam7_order(blocks_x, blocks_y, order);
+    for (size_t i = 0; i < count; i++) {
+        size_t at = (header->flags & IPF_FLAG_PROGRESSIVE) ? order[i] : i;
+        raster[at] = cost[i];
+        if (cost[i] > max_cost) max_cost = cost[i];
+    }
+
+    image_writer_opts_t opts = IMAGE_WRITER_OPTS_DEFAULT;
+    image_writer_t *writer = image_writer_open(path, image_format_from_path(path), header->width, header->height,
+                                               3, &opts);
+    int result = writer ? 0 : -1;
+    for (int by = 0; by < blocks_y && result == 0; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            uint8_t rgb[3];
+            heat_colour(max_cost > 0 ? raster[(size_t)by * blocks_x + bx] / max_cost : 0, rgb);
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4 && bx * 4 + x < header->width; x++) {
+                    memcpy(band + y * stride + (size_t)(bx * 4 + x) * 3, rgb, 3);
+                }
+            }
+        }
+        int rows = header->height - by * 4;
+        if (rows > 4) rows = 4;
+        if (image_writer_write_rows(writer, band, stride, rows) < 0) result = -1;
+    }
+    if (writer && image_writer_close(writer) < 0) result = -1;
+    if (result < 0) fprintf(stderr, "Error: Failed to write heatmap: %s\n", path);
+    else printf("Heatmap written: %s (white = %.1f bytes per block)\n", path, max_cost);
+
+    free(raster);
+    free(order);
+    free(band);
+    return result;
+}
+
+// =============================================================================
+// File Inspection
+// =============================================================================
+
+static int inspect_file(inspect_worker_t *w, const char *path) {
+    const inspect_config_t *cfg = w->run->cfg;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < IPF_HEADER_SIZE) {
+        fprintf(stderr, "Error: %s: File too short for an iPF header\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t file_size = (size_t)st.st_size;
+#ifdef MAP_POPULATE
+    int map_flags = MAP_PRIVATE | MAP_POPULATE;  // Fault the pages in up front
+#else
+    int map_flags = MAP_PRIVATE;
+#endif
+    uint8_t *map = mmap(NULL, file_size, PROT_READ, map_flags, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: %s: mmap failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+    madvise(map, file_size, MADV_SEQUENTIAL);
+
+    int result = -1;
+    ipf_header_t header;
+    int err = ipf_parse_header(map, file_size, &header);
+    if (err != IPF_OK) {
+        fprintf(stderr, "Error: %s: %s\n", path, ipf_strerror(err));
+        goto done;
+    }
+    const uint8_t *blocks = unpack_blocks(w, path, &header, map + IPF_HEADER_SIZE, file_size - IPF_HEADER_SIZE);
+    if (!blocks) goto done;
+
+    // Per-file figures first, so the heatmap and -v see this file alone
+    inspect_stats_t one;
+    memset(&one, 0, sizeof(one));
+    one.files = 1;
+    one.file_bytes = file_size;
+    one.block_bytes = ipf_blocks_size(&header);
+    one.type_files[header.type]++;
+
+    if (header.type == IPF_TYPE_INDEXED) {
+        size_t pixels = (size_t)header.width * header.height;
+        for (size_t i = 0; i < pixels; i++) one.index_hist[blocks[i]]++;
+    } else if (inspect_blocks(w, cfg, &header, blocks, &one) < 0) {
+        fprintf(stderr, "Error: %s: Out of memory\n", path);
+        goto done;
+    }
+
+    if (cfg->heatmap_file) {
+        float *cost = NULL;
+        if (header.type == IPF_TYPE_INDEXED) {
+            fprintf(stderr, "Error: %s: Indexed images have no blocks to map\n", path);
+            goto done;
+        }
+        if (block_costs(w, &header, blocks, &one, &cost) < 0 || write_heatmap(cfg->heatmap_file, &header, cost) < 0) {
+            free(cost);
+            goto done;
+        }
+        free(cost);
+    }
+
+    if (cfg->verbose) {
+        if (header.type == IPF_TYPE_INDEXED) {
+            printf("%s: %dx%d indexed, %zu bytes, %.2f bits per index\n", path, header.width, header.height,
+                   file_size, entropy(one.index_hist, 256));
+        } else {
+            char alpha[32] = "";
+            if (header.flags & IPF_FLAG_ALPHA) snprintf(alpha, sizeof(alpha), " A %.2f", entropy(one.hist[PLANE_A], 16));
+            printf("%s: %dx%d iPF%d, %zu bytes, Y %.2f Co %.2f Cg %.2f%s bits, %.1f%% solid, %.1f%% duplicate\n",
+                   path, header.width, header.height, header.type + 1, file_size, entropy(one.hist[PLANE_Y], 16),
+                   entropy(one.hist[PLANE_CO], 16), entropy(one.hist[PLANE_CG], 16), alpha,
+                   share(one.solid, one.blocks), share(one.duplicate, one.blocks));
+        }
+    }
+
+    stats_add(&w->stats, &one);
+    result = 0;
+
+done:
+    munmap(map, file_size);
+    return result;
+}
+
+static void *inspect_worker_main(void *arg) {
+    inspect_worker_t *w = arg;
+    inspect_run_t *run = w->run;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED);
+        if (i >= run->files->count) break;
+        if (inspect_file(w, run->files->paths[i]) < 0) w->stats.failed++;
+    }
+    return NULL;
+}
+
+// =============================================================================
+// Report
+// =============================================================================
+
+static void print_text_report(const inspect_config_t *cfg, const inspect_stats_t *s, double seconds) {
+    printf("Inspected %llu files (%llu iPF1, %llu iPF2, %llu indexed)", (unsigned long long)s->files,
+           (unsigned long long)s->type_files[IPF_TYPE_1], (unsigned long long)s->type_files[IPF_TYPE_2],
+           (unsigned long long)s->type_files[IPF_TYPE_INDEXED]);
+    if (s->failed) printf(", %llu unreadable", (unsigned long long)s->failed);
+    printf(" in %.3f s (%.1f MB/s of block data)\n", seconds, seconds > 0 ? s->block_bytes / 1e6 / seconds : 0);
+    printf("  Stored %.2f MB, %.2f MB unpacked (%.2fx)\n", s->file_bytes / 1e6, s->block_bytes / 1e6,
+           s->file_bytes ? (double)s->block_bytes / s->file_bytes : 0);
+
+    if (s->blocks) {
+        printf("\nPlanes (entropy of 4-bit samples):\n");
+        printf("  %-5s %12s %10s %8s", "plane", "samples", "bits", "needed");
+        if (cfg->zstd_level > 0) printf(" %12s %8s", "zstd bytes", "ratio");
+        printf("\n");
+        for (int p = 0; p < PLANE_COUNT; p++) {
+            uint64_t samples = 0;
+            for (int v = 0; v < 16; v++) samples += s->hist[p][v];
+            if (!samples) continue;
+            double h = entropy(s->hist[p], 16);
+            printf("  %-5s %12llu %6.2f / 4 %7.1f%%", PLANE_NAMES[p], (unsigned long long)samples, h, h / 4 * 100);
+            if (cfg->zstd_level > 0 && s->plane_raw[p]) {
+                printf(" %12llu %7.2fx", (unsigned long long)s->plane_packed[p],
+                       (double)s->plane_raw[p] / s->plane_packed[p]);
+            }
+            printf("\n");
+        }
+        if (cfg->zstd_level > 0 && s->stream_packed) {
+            uint64_t split = 0;
+            for (int p = 0; p < PLANE_COUNT; p++) split += s->plane_packed[p];
+            printf("  Zstd %d on the block stream: %llu bytes (%.2fx); planes apart: %llu bytes (%.2fx)\n",
+                   cfg->zstd_level, (unsigned long long)s->stream_packed, (double)s->stream_raw / s->stream_packed,
+                   (unsigned long long)split, split ? (double)s->stream_raw / split : 0);
+        }
+
+        printf("\nBlocks: %llu\n", (unsigned long long)s->blocks);
+        printf("  Solid:          %6.1f%%\n", share(s->solid, s->blocks));
+        printf("  Duplicate:      %6.1f%%\n", share(s->duplicate, s->blocks));
+        if (s->alpha_blocks) {
+            printf("  Fully opaque:   %6.1f%% of blocks with alpha\n", share(s->opaque, s->alpha_blocks));
+            printf("  Fully clear:    %6.1f%% of blocks with alpha\n", share(s->transparent, s->alpha_blocks));
+        }
+
+        printf("\nChroma inside blocks (mean squared step, Co and Cg):\n");
+        printf("  Horizontal:     %6.3f\n", s->chroma_h_pairs ? s->chroma_h_sq / s->chroma_h_pairs : 0);
+        printf("  Vertical:       %6.3f\n", s->chroma_v_pairs ? s->chroma_v_sq / s->chroma_v_pairs : 0);
+        if (s->ipf2_pairs) {
+            printf("  iPF2 rows iPF1 would merge that differ by more than one step: %.1f%%\n",
+                   share(s->ipf2_detail, s->ipf2_pairs));
+        }
+    }
+
+    if (s->type_files[IPF_TYPE_INDEXED]) {
+        uint64_t pixels = 0, used = 0;
+        for (int v = 0; v < 256; v++) {
+            pixels += s->index_hist[v];
+            used += s->index_hist[v] != 0;
+        }
+        printf("\nIndexed: %llu pixels, %llu colours used, %.2f bits per index, %.1f%% transparent\n",
+               (unsigned long long)pixels, (unsigned long long)used, entropy(s->index_hist, 256),
+               share(s->index_hist[IPF_INDEX_TRANSPARENT], pixels));
+    }
+}
+
+static void print_json_report(const inspect_config_t *cfg, const inspect_stats_t *s, double seconds) {
+    printf("{\"files\":%llu,\"failed\":%llu,\"ipf1\":%llu,\"ipf2\":%llu,\"indexed\":%llu,\"seconds\":%.6f,"
+           "\"stored_bytes\":%llu,\"block_bytes\":%llu,\"blocks\":%llu,\"solid\":%llu,\"duplicate\":%llu,"
+           "\"alpha_blocks\":%llu,\"opaque\":%llu,\"transparent\":%llu",
+           (unsigned long long)s->files, (unsigned long long)s->failed,
+           (unsigned long long)s->type_files[IPF_TYPE_1], (unsigned long long)s->type_files[IPF_TYPE_2],
+           (unsigned long long)s->type_files[IPF_TYPE_INDEXED], seconds, (unsigned long long)s->file_bytes,
+           (unsigned long long)s->block_bytes, (unsigned long long)s->blocks, (unsigned long long)s->solid,
+           (unsigned long long)s->duplicate, (unsigned long long)s->alpha_blocks, (unsigned long long)s->opaque,
+           (unsigned long long)s->transparent);
+
+    printf(",\"planes\":{");
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        printf("%s\"%s\":{\"entropy\":%.4f", p ? "," : "", PLANE_NAMES[p], entropy(s->hist[p], 16));
+        if (cfg->zstd_level > 0) {
+            printf(",\"raw\":%llu,\"zstd\":%llu", (unsigned long long)s->plane_raw[p],
+                   (unsigned long long)s->plane_packed[p]);
+        }
+        printf(",\"histogram\":[");
+        for (int v = 0; v < 16; v++) printf("%s%llu", v ? "," : "", (unsigned long long)s->hist[p][v]);
+        printf("]}");
+    }
+    printf("}");
+    if (cfg->zstd_level > 0) {
+        printf(",\"zstd_level\":%d,\"stream_raw\":%llu,\"stream_zstd\":%llu", cfg->zstd_level,
+               (unsigned long long)s->stream_raw, (unsigned long long)s->stream_packed);
+    }
+    printf(",\"chroma_h\":%.6f,\"chroma_v\":%.6f,\"ipf2_pairs\":%llu,\"ipf2_detail\":%llu",
+           s->chroma_h_pairs ? s->chroma_h_sq / s->chroma_h_pairs : 0,
+           s->chroma_v_pairs ? s->chroma_v_sq / s->chroma_v_pairs : 0, (unsigned long long)s->ipf2_pairs,
+           (unsigned long long)s->ipf2_detail);
+    printf(",\"index_entropy\":%.4f}\n", entropy(s->index_hist, 256));
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    inspect_config_t cfg = {
+        .inputs = NULL,
+        .input_count = 0,
+        .heatmap_file = NULL,
+        .zstd_level = PLANES_ZSTD_LEVEL,
+        .json = 0,
+        .jobs = 0,
+        .verbose = 0
+    };
+
+    static struct option long_options[] = {
+        {"heatmap", required_argument, 0, 'H'},
+        {"zstd",    required_argument, 0, 'z'},
+        {"no-zstd", no_argument,       0, 'N'},
+        {"json",    no_argument,       0, 'J'},
+        {"jobs",    required_argument, 0, 'j'},
+        {"verbose", no_argument,       0, 'v'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "z:j:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'H':
+                cfg.heatmap_file = optarg;
+                break;
+            case 'z':
+                cfg.zstd_level = atoi(optarg);
+                if (cfg.zstd_level < 1 || cfg.zstd_level > ZSTD_maxCLevel()) {
+                    fprintf(stderr, "Error: Zstd level must be 1-%d\n", ZSTD_maxCLevel());
+                    return 1;
+                }
+                break;
+            case 'N':
+                cfg.zstd_level = 0;
+                break;
+            case 'J':
+                cfg.json = 1;
+                break;
+            case 'j':
+                cfg.jobs = atoi(optarg);
+                if (cfg.jobs < 1) {
+                    fprintf(stderr, "Error: Jobs must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "Error: Give at least one file or directory\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    path_list_t files;
+    memset(&files, 0, sizeof(files));
+    for (int i = optind; i < argc; i++) {
+        struct stat st;
+        if (stat(argv[i], &st) < 0) {
+            fprintf(stderr, "Error: %s: %s\n", argv[i], strerror(errno));
+            path_list_free(&files);
+            return 1;
+        }
+        int added = S_ISDIR(st.st_mode) ? scan_directory(&files, argv[i]) : path_list_add(&files, argv[i]);
+        if (added < 0) {
+            path_list_free(&files);
+            return 1;
+        }
+    }
+    if (files.count == 0) {
+        fprintf(stderr, "Error: No iPF files found\n");
+        path_list_free(&files);
+        return 1;
+    }
+    if (cfg.heatmap_file && files.count != 1) {
+        fprintf(stderr, "Error: --heatmap takes exactly one input file\n");
+        path_list_free(&files);
+        return 1;
+    }
+    qsort(files.paths, files.count, sizeof(char *), compare_paths);
+
+    if (cfg.jobs == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.jobs = n > 0 ? (int)n : 1;
+    }
+    if ((size_t)cfg.jobs > files.count) cfg.jobs = (int)files.count;
+    // Per-file lines come out in order only from a single worker
+    if (cfg.verbose) cfg.jobs = 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    inspect_run_t run = { &cfg, &files, 0 };
+    inspect_worker_t *workers = calloc(cfg.jobs, sizeof(*workers));
+    int result = workers ? 0 : -1;
+    int started = 0;
+    for (int i = 0; i < cfg.jobs && result == 0; i++) {
+        workers[i].run = &run;
+        workers[i].dctx = ZSTD_createDCtx();
+        workers[i].cctx = ZSTD_createCCtx();
+        if (!workers[i].dctx || !workers[i].cctx) {
+            result = -1;
+            break;
+        }
+        if (cfg.jobs == 1) {
+            inspect_worker_main(&workers[i]);
+        } else if (pthread_create(&workers[i].thread, NULL, inspect_worker_main, &workers[i]) != 0) {
+            result = -1;
+            break;
+        }
+        started++;
+    }
+
+    inspect_stats_t total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; workers && i < cfg.jobs; i++) {
+        if (i < started && cfg.jobs > 1) pthread_join(workers[i].thread, NULL);
+        stats_add(&total, &workers[i].stats);
+        ZSTD_freeDCtx(workers[i].dctx);
+        ZSTD_freeCCtx(workers[i].cctx);
+        if (workers[i].zs_ready) inflateEnd(&workers[i].zs);
+        free(workers[i].blocks);
+        free(workers[i].planes);
+        free(workers[i].packed);
+        free(workers[i].seen);
+    }
+    free(workers);
+    double seconds = elapsed_seconds(&start);
+
+    if (result < 0) {
+        fprintf(stderr, "Error: Failed to start workers\n");
+    } else if (total.files) {
+        if (cfg.verbose) printf("\n");
+        if (cfg.json) print_json_report(&cfg, &total, seconds);
+        else print_text_report(&cfg, &total, seconds);
+    }
+
+    path_list_free(&files);
+    return result == 0 && total.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+/**
+ * JNI bridge from net.torvald.tsvm.IpfNative to libipf
+ *
+ * The VM passes raw native addresses (usermem or peripheral memory, already
+ * resolved and bounds-checked on the Kotlin side), so no Java arrays are
+ * pinned or copied here.
+ */
+
+#include <jni.h>
+#include <stdint.h>
+
+#include "libipf.h"
+
+static void make_header(ipf_header_t *header, jint width, jint height, jint type, jint flags) {
+    header->width = (uint16_t)width;
+    header->height = (uint16_t)height;
+    header->type = (uint8_t)type;
+    header->flags = (uint8_t)flags;
+    header->uncompressed_size = 0;
+}
+
+static int valid_geometry(jint width, jint height, jint type) {
+    return width > 0 && width <= 65535 && height > 0 && height <= 65535 &&
+           (type == IPF_TYPE_1 || type == IPF_TYPE_2);
+}
+
+JNIEXPORT jint JNICALL Java_net_torvald_tsvm_IpfNative_decodePlanes(
+        JNIEnv *env, jclass cls, jlong src, jlong rg, jlong ba, jint stride,
+        jint width, jint height, jint type, jint flags) {
+    (void)env; (void)cls;
+    if (!valid_geometry(width, height, type) || stride < ((width + 3) & ~3)) return IPF_ERR_ARG;
+
+    ipf_header_t header;
+    make_header(&header, width, height, type, flags);
+    ipf_decode_planes(&header, (const uint8_t *)(intptr_t)src,
+                      (uint8_t *)(intptr_t)rg, (uint8_t *)(intptr_t)ba, (size_t)stride);
+    return IPF_OK;
+}
+
+JNIEXPORT jint JNICALL Java_net_torvald_tsvm_IpfNative_encode(
+        JNIEnv *env, jclass cls, jlong src, jint stride, jint channels, jlong dest,
+        jint width, jint height, jint type, jint flags, jint pattern) {
+    (void)env; (void)cls;
+    if (!valid_geometry(width, height, type)) return IPF_ERR_ARG;
+
+    ipf_header_t header;
+    make_header(&header, width, height, type, flags);
+    return ipf_encode_image(&header, (const uint8_t *)(intptr_t)src, (size_t)stride, channels,
+                            pattern, (uint8_t *)(intptr_t)dest);
+}
+
+JNIEXPORT jint JNICALL Java_net_torvald_tsvm_IpfNative_deltaEncode(
+        JNIEnv *env, jclass cls, jlong previous, jlong current, jlong out,
+        jint width, jint height, jint type, jint flags) {
+    (void)env; (void)cls;
+    if (!valid_geometry(width, height, type)) return IPF_ERR_ARG;
+
+    ipf_header_t header;
+    make_header(&header, width, height, type, flags);
+    return (jint)ipf_delta_encode(&header, (const uint8_t *)(intptr_t)previous,
+                                  (const uint8_t *)(intptr_t)current, (uint8_t *)(intptr_t)out);
+}
+
+JNIEXPORT jint JNICALL Java_net_torvald_tsvm_IpfNative_deltaApplyPlanes(
+        JNIEnv *env, jclass cls, jlong delta, jlong len, jlong rg, jlong ba, jint stride,
+        jint width, jint height, jint type, jint flags) {
+    (void)env; (void)cls;
+    if (!valid_geometry(width, height, type) || stride < width || len < 0) return IPF_ERR_ARG;
+
+    ipf_header_t header;
+    make_header(&header, width, height, type, flags);
+    return ipf_delta_apply_planes(&header, (const uint8_t *)(intptr_t)delta, (size_t)len,
+                                  (uint8_t *)(intptr_t)rg, (uint8_t *)(intptr_t)ba, (size_t)stride);
+}
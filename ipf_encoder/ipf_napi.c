@@ -0,0 +1,175 @@
+/**
+ * Node-API addon exposing libipf to the headless harness (harness/lib/ipf.mjs)
+ *
+ * Works on Uint8Array views straight into the harness's user space and GPU
+ * block, so nothing is copied. Every span is checked against the view
+ * length before libipf runs.
+ *
+ *   decodePlanes(src, rg, ba, stride, width, height, type, flags)
+ *   encode(src, stride, channels, dest, width, height, type, flags, pattern)
+ *   deltaEncode(previous, current, out, width, height, type, flags) -> length
+ *   deltaApplyPlanes(delta, rg, ba, stride, width, height, type, flags)
+ */
+
+#include <node_api.h>
+#include <stdint.h>
+
+#include "libipf.h"
+
+static napi_value throw_error(napi_env env, const char *msg) {
+    napi_throw_error(env, NULL, msg);
+    return NULL;
+}
+
+static int get_bytes(napi_env env, napi_value value, uint8_t **data, size_t *len) {
+    napi_typedarray_type type;
+    void *ptr;
+    if (napi_get_typedarray_info(env, value, &type, len, &ptr, NULL, NULL) != napi_ok) return -1;
+    if (type != napi_uint8_array && type != napi_uint8_clamped_array) return -1;
+    *data = ptr;
+    return 0;
+}
+
+static int get_ints(napi_env env, napi_value *args, int count, int32_t *out) {
+    for (int i = 0; i < count; i++) {
+        if (napi_get_value_int32(env, args[i], &out[i]) != napi_ok) return -1;
+    }
+    return 0;
+}
+
+static int make_header(ipf_header_t *header, int32_t width, int32_t height, int32_t type, int32_t flags) {
+    if (width <= 0 || width > 65535 || height <= 0 || height > 65535) return -1;
+    if (type != IPF_TYPE_1 && type != IPF_TYPE_2) return -1;
+    header->width = (uint16_t)width;
+    header->height = (uint16_t)height;
+    header->type = (uint8_t)type;
+    header->flags = (uint8_t)flags;
+    header->uncompressed_size = 0;
+    return 0;
+}
+
+static napi_value decode_planes(napi_env env, napi_callback_info info) {
+    size_t argc = 8;
+    napi_value args[8];
+    napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    if (argc < 8) return throw_error(env, "decodePlanes: expected 8 arguments");
+
+    uint8_t *src, *rg, *ba;
+    size_t src_len, rg_len, ba_len;
+    int32_t v[5];  // stride, width, height, type, flags
+    if (get_bytes(env, args[0], &src, &src_len) < 0 || get_bytes(env, args[1], &rg, &rg_len) < 0 ||
+        get_bytes(env, args[2], &ba, &ba_len) < 0) {
+        return throw_error(env, "decodePlanes: src, rg and ba must be Uint8Arrays");
+    }
+    if (get_ints(env, args + 3, 5, v) < 0) return throw_error(env, "decodePlanes: expected integer geometry");
+
+    ipf_header_t header;
+    if (make_header(&header, v[1], v[2], v[3], v[4]) < 0 || v[0] < ((v[1] + 3) & ~3)) {
+        return throw_error(env, "decodePlanes: invalid geometry");
+    }
+
+    size_t span = ipf_planes_span(&header, (size_t)v[0]);
+    if (src_len < ipf_blocks_size(&header)) return throw_error(env, "decodePlanes: block data is truncated");
+    if (rg_len < span || ba_len < span) return throw_error(env, "decodePlanes: destination plane is too small");
+
+    ipf_decode_planes(&header, src, rg, ba, (size_t)v[0]);
+    return NULL;
+}
+
+static napi_value encode(napi_env env, napi_callback_info info) {
+    size_t argc = 9;
+    napi_value args[9];
+    napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    if (argc < 9) return throw_error(env, "encode: expected 9 arguments");
+
+    uint8_t *src, *dest;
+    size_t src_len, dest_len;
+    int32_t stride_channels[2], v[5];  // width, height, type, flags, pattern
+    if (get_bytes(env, args[0], &src, &src_len) < 0 || get_bytes(env, args[3], &dest, &dest_len) < 0) {
+        return throw_error(env, "encode: src and dest must be Uint8Arrays");
+    }
+    if (get_ints(env, args + 1, 2, stride_channels) < 0 || get_ints(env, args + 4, 5, v) < 0) {
+        return throw_error(env, "encode: expected integer geometry");
+    }
+
+    int32_t stride = stride_channels[0], channels = stride_channels[1];
+    ipf_header_t header;
+    if (make_header(&header, v[0], v[1], v[2], v[3]) < 0 || stride < 0 ||
+        (channels != 1 && channels != 3 && channels != 4)) {
+        return throw_error(env, "encode: invalid geometry");
+    }
+    if (src_len < ipf_encode_src_span(&header, (size_t)stride, channels)) {
+        return throw_error(env, "encode: source does not cover the padded image");
+    }
+    if (dest_len < ipf_blocks_size(&header)) return throw_error(env, "encode: destination is too small");
+
+    ipf_encode_image(&header, src, (size_t)stride, channels, v[4], dest);
+    return NULL;
+}
+
+static napi_value delta_encode(napi_env env, napi_callback_info info) {
+    size_t argc = 7;
+    napi_value args[7];
+    napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    if (argc < 7) return throw_error(env, "deltaEncode: expected 7 arguments");
+
+    uint8_t *previous, *current, *out;
+    size_t previous_len, current_len, out_len;
+    int32_t v[4];  // width, height, type, flags
+    if (get_bytes(env, args[0], &previous, &previous_len) < 0 || get_bytes(env, args[1], &current, &current_len) < 0 ||
+        get_bytes(env, args[2], &out, &out_len) < 0) {
+        return throw_error(env, "deltaEncode: previous, current and out must be Uint8Arrays");
+    }
+    if (get_ints(env, args + 3, 4, v) < 0) return throw_error(env, "deltaEncode: expected integer geometry");
+
+    ipf_header_t header;
+    if (make_header(&header, v[0], v[1], v[2], v[3]) < 0) return throw_error(env, "deltaEncode: invalid geometry");
+    size_t blocks_size = ipf_blocks_size(&header);
+    if (previous_len < blocks_size || current_len < blocks_size) return throw_error(env, "deltaEncode: block data is truncated");
+    if (out_len < ipf_delta_bound(&header)) return throw_error(env, "deltaEncode: destination is too small");
+
+    napi_value result;
+    napi_create_uint32(env, (uint32_t)ipf_delta_encode(&header, previous, current, out), &result);
+    return result;
+}
+
+static napi_value delta_apply_planes(napi_env env, napi_callback_info info) {
+    size_t argc = 8;
+    napi_value args[8];
+    napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    if (argc < 8) return throw_error(env, "deltaApplyPlanes: expected 8 arguments");
+
+    uint8_t *delta, *rg, *ba;
+    size_t delta_len, rg_len, ba_len;
+    int32_t v[5];  // stride, width, height, type, flags
+    if (get_bytes(env, args[0], &delta, &delta_len) < 0 || get_bytes(env, args[1], &rg, &rg_len) < 0 ||
+        get_bytes(env, args[2], &ba, &ba_len) < 0) {
+        return throw_error(env, "deltaApplyPlanes: delta, rg and ba must be Uint8Arrays");
+    }
+    if (get_ints(env, args + 3, 5, v) < 0) return throw_error(env, "deltaApplyPlanes: expected integer geometry");
+
+    ipf_header_t header;
+    if (make_header(&header, v[1], v[2], v[3], v[4]) < 0 || v[0] < v[1]) {
+        return throw_error(env, "deltaApplyPlanes: invalid geometry");
+    }
+
+    size_t span = (size_t)(v[2] - 1) * (size_t)v[0] + (size_t)v[1];
+    if (rg_len < span || ba_len < span) return throw_error(env, "deltaApplyPlanes: destination plane is too small");
+
+    int err = ipf_delta_apply_planes(&header, delta, delta_len, rg, ba, (size_t)v[0]);
+    if (err < 0) return throw_error(env, ipf_strerror(err));
+    return NULL;
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+    napi_property_descriptor props[] = {
+        { "decodePlanes", NULL, decode_planes, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "encode", NULL, encode, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "deltaEncode", NULL, delta_encode, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "deltaApplyPlanes", NULL, delta_apply_planes, NULL, NULL, NULL, napi_enumerable, NULL },
+    };
+    napi_define_properties(env, exports, sizeof(props) / sizeof(props[0]), props);
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,309 @@
+/**
+ * TSVM default palette and 12-bit colour mapping, for indexed iPF images
+ *
+ * IPF_DEFAULT_PALETTE is GraphicsAdapter.DEFAULT_PALETTE (0xRRGGBBAA); index
+ * 255 is the transparent colour. IPF_COLOUR_TO_INDEX is
+ * assets/4096_colours_to_tsvm_palette.data, indexed by R<<8 | G<<4 | B with
+ * 4-bit channels. Regenerate both if either source changes.
+ */
+
+#ifndef IPF_PALETTE_H
+#define IPF_PALETTE_H
+
+#include <stdint.h>
+
+static const uint32_t IPF_DEFAULT_PALETTE[256] = {
+    0x00000077, 0x000044FF, 0x000088FF, 0x0000BBFF, 0x0000FFFF, 0x002200FF, 0x002244FF, 0x002288FF,
+    0x0022BBFF, 0x0022FFFF, 0x004400FF, 0x004444FF, 0x004488FF, 0x0044BBFF, 0x0044FFFF, 0x006600FF,
+    0x006644FF, 0x006688FF, 0x0066BBFF, 0x0066FFFF, 0x009900FF, 0x009944FF, 0x009988FF, 0x0099BBFF,
+    0x0099FFFF, 0x00BB00FF, 0x00BB44FF, 0x00BB88FF, 0x00BBBBFF, 0x00BBFFFF, 0x00DD00FF, 0x00DD44FF,
+    0x00DD88FF, 0x00DDBBFF, 0x00DDFFFF, 0x00FF00FF, 0x00FF44FF, 0x00FF88FF, 0x00FFBBFF, 0x00FFFFFF,
+    0x330000FF, 0x330044FF, 0x330088FF, 0x3300BBFF, 0x3300FFFF, 0x332200FF, 0x332244FF, 0x332288FF,
+    0x3322BBFF, 0x3322FFFF, 0x334400FF, 0x334444FF, 0x334488FF, 0x3344BBFF, 0x3344FFFF, 0x336600FF,
+    0x336644FF, 0x336688FF, 0x3366BBFF, 0x3366FFFF, 0x339900FF, 0x339944FF, 0x339988FF, 0x3399BBFF,
+    0x3399FFFF, 0x33BB00FF, 0x33BB44FF, 0x33BB88FF, 0x33BBBBFF, 0x33BBFFFF, 0x33DD00FF, 0x33DD44FF,
+    0x33DD88FF, 0x33DDBBFF, 0x33DDFFFF, 0x33FF00FF, 0x33FF44FF, 0x33FF88FF, 0x33FFBBFF, 0x33FFFFFF,
+    0x660000FF, 0x660044FF, 0x660088FF, 0x6600BBFF, 0x6600FFFF, 0x662200FF, 0x662244FF, 0x662288FF,
+    0x6622BBFF, 0x6622FFFF, 0x664400FF, 0x664444FF, 0x664488FF, 0x6644BBFF, 0x6644FFFF, 0x666600FF,
+    0x666644FF, 0x666688FF, 0x6666BBFF, 0x6666FFFF, 0x669900FF, 0x669944FF, 0x669988FF, 0x6699BBFF,
+    0x6699FFFF, 0x66BB00FF, 0x66BB44FF, 0x66BB88FF, 0x66BBBBFF, 0x66BBFFFF, 0x66DD00FF, 0x66DD44FF,
+    0x66DD88FF, 0x66DDBBFF, 0x66DDFFFF, 0x66FF00FF, 0x66FF44FF, 0x66FF88FF, 0x66FFBBFF, 0x66FFFFFF,
+    0x990000FF, 0x990044FF, 0x990088FF, 0x9900BBFF, 0x9900FFFF, 0x992200FF, 0x992244FF, 0x992288FF,
+    0x9922BBFF, 0x9922FFFF, 0x994400FF, 0x994444FF, 0x994488FF, 0x9944BBFF, 0x9944FFFF, 0x996600FF,
+    0x996644FF, 0x996688FF, 0x9966BBFF, 0x9966FFFF, 0x999900FF, 0x999944FF, 0x999988FF, 0x9999BBFF,
+    0x9999FFFF, 0x99BB00FF, 0x99BB44FF, 0x99BB88FF, 0x99BBBBFF, 0x99BBFFFF, 0x99DD00FF, 0x99DD44FF,
+    0x99DD88FF, 0x99DDBBFF, 0x99DDFFFF, 0x99FF00FF, 0x99FF44FF, 0x99FF88FF, 0x99FFBBFF, 0x99FFFFFF,
+    0xCC0000FF, 0xCC0044FF, 0xCC0088FF, 0xCC00BBFF, 0xCC00FFFF, 0xCC2200FF, 0xCC2244FF, 0xCC2288FF,
+    0xCC22BBFF, 0xCC22FFFF, 0xCC4400FF, 0xCC4444FF, 0xCC4488FF, 0xCC44BBFF, 0xCC44FFFF, 0xCC6600FF,
+    0xCC6644FF, 0xCC6688FF, 0xCC66BBFF, 0xCC66FFFF, 0xCC9900FF, 0xCC9944FF, 0xCC9988FF, 0xCC99BBFF,
+    0xCC99FFFF, 0xCCBB00FF, 0xCCBB44FF, 0xCCBB88FF, 0xCCBBBBFF, 0xCCBBFFFF, 0xCCDD00FF, 0xCCDD44FF,
+    0xCCDD88FF, 0xCCDDBBFF, 0xCCDDFFFF, 0xCCFF00FF, 0xCCFF44FF, 0xCCFF88FF, 0xCCFFBBFF, 0xCCFFFFFF,
+    0xFF0000FF, 0xFF0044FF, 0xFF0088FF, 0xFF00BBFF, 0xFF00FFFF, 0xFF2200FF, 0xFF2244FF, 0xFF2288FF,
+    0xFF22BBFF, 0xFF22FFFF, 0xFF4400FF, 0xFF4444FF, 0xFF4488FF, 0xFF44BBFF, 0xFF44FFFF, 0xFF6600FF,
+    0xFF6644FF, 0xFF6688FF, 0xFF66BBFF, 0xFF66FFFF, 0xFF9900FF, 0xFF9944FF, 0xFF9988FF, 0xFF99BBFF,
+    0xFF99FFFF, 0xFFBB00FF, 0xFFBB44FF, 0xFFBB88FF, 0xFFBBBBFF, 0xFFBBFFFF, 0xFFDD00FF, 0xFFDD44FF,
+    0xFFDD88FF, 0xFFDDBBFF, 0xFFDDFFFF, 0xFFFF00FF, 0xFFFF44FF, 0xFFFF88FF, 0xFFFFBBFF, 0xFFFFFFFF,
+    0x000000FF, 0x111111FF, 0x222222FF, 0x333333FF, 0x444444FF, 0x555555FF, 0x666666FF, 0x777777FF,
+    0x888888FF, 0x999999FF, 0xAAAAAAFF, 0xBBBBBBFF, 0xCCCCCCFF, 0xDDDDDDFF, 0xEEEEEEFF, 0x00000000
+};
+
+static const uint8_t IPF_COLOUR_TO_INDEX[4096] = {
+    0x00, 0x00, 0x06, 0x06, 0x01, 0x01, 0x07, 0x02, 0x02, 0x02, 0x02, 0x03, 0x03, 0x03, 0x31, 0x04,
+    0xF1, 0xF1, 0xF1, 0x06, 0x01, 0x01, 0x01, 0x07, 0x07, 0x02, 0x02, 0x08, 0x03, 0x03, 0x31, 0x09,
+    0x05, 0x05, 0xF2, 0x06, 0x06, 0x06, 0x01, 0x07, 0x07, 0x07, 0x02, 0x08, 0x08, 0x03, 0x03, 0x09,
+    0x05, 0x05, 0x05, 0x0B, 0x0B, 0x06, 0x06, 0x0C, 0x34, 0x07, 0x07, 0x35, 0x08, 0x08, 0x36, 0x36,
+    0x0A, 0x0A, 0x05, 0x0B, 0x0B, 0x0B, 0x39, 0x0C, 0x0C, 0x34, 0x0D, 0x0D, 0x0D, 0x08, 0x08, 0x0E,
+    0x0A, 0x0A, 0x0A, 0x10, 0x10, 0x0B, 0x0B, 0x11, 0x39, 0x0C, 0x0C, 0x3A, 0x0D, 0x0D, 0x3B, 0x3B,
+    0x0F, 0x0F, 0x0A, 0x10, 0x10, 0x10, 0x0B, 0x11, 0x11, 0x39, 0x12, 0x12, 0x3A, 0x3A, 0x0D, 0x13,
+    0x0F, 0x0F, 0x0F, 0x0F, 0x10, 0x10, 0x10, 0x3E, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x3A, 0x13,
+    0x3C, 0x0F, 0x15, 0x3D, 0x3D, 0x10, 0x10, 0x3E, 0x3E, 0x17, 0x3F, 0x11, 0x12, 0x12, 0x40, 0x40,
+    0x3C, 0x14, 0x14, 0x15, 0x15, 0x3D, 0x43, 0x16, 0x16, 0x3E, 0x17, 0x17, 0x3F, 0x45, 0x18, 0x40,
+    0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x43, 0x16, 0x16, 0x44, 0x44, 0x17, 0x17, 0x45, 0x45,
+    0x41, 0x41, 0x14, 0x1A, 0x42, 0x15, 0x15, 0x1B, 0x43, 0x43, 0x16, 0x1C, 0x44, 0x17, 0x1D, 0x1D,
+    0x19, 0x19, 0x19, 0x1A, 0x1A, 0x1A, 0x1A, 0x48, 0x1B, 0x1B, 0x49, 0x1C, 0x1C, 0x44, 0x4A, 0x1D,
+    0x46, 0x46, 0x1F, 0x1F, 0x47, 0x1A, 0x1A, 0x20, 0x48, 0x48, 0x1B, 0x49, 0x49, 0x1C, 0x22, 0x4A,
+    0x1E, 0x1E, 0x1E, 0x1F, 0x1F, 0x1F, 0x1F, 0x4D, 0x20, 0x20, 0x4E, 0x21, 0x21, 0x21, 0x4F, 0x22,
+    0x23, 0x23, 0x4C, 0x4C, 0x4C, 0x1F, 0x1F, 0x25, 0x4D, 0x20, 0x4E, 0x4E, 0x21, 0x21, 0x21, 0x4F,
+    0x00, 0x00, 0x2E, 0x01, 0x01, 0x01, 0x2F, 0x2A, 0x2A, 0x02, 0x30, 0x03, 0x03, 0x03, 0x31, 0x04,
+    0xF1, 0xF1, 0xF1, 0x06, 0x01, 0x01, 0x01, 0x2F, 0x07, 0x02, 0x02, 0x08, 0x03, 0x03, 0x31, 0x31,
+    0x05, 0x05, 0xF2, 0xF2, 0x06, 0x06, 0x01, 0x07, 0x07, 0x07, 0x02, 0x08, 0x08, 0x03, 0x03, 0x09,
+    0x05, 0x05, 0x05, 0x0B, 0x06, 0x06, 0x06, 0x34, 0x34, 0x07, 0x07, 0x35, 0x08, 0x08, 0x36, 0x36,
+    0x0A, 0x0A, 0x05, 0x0B, 0x0B, 0x0B, 0x06, 0x0C, 0x0C, 0x34, 0x0D, 0x0D, 0x35, 0x0D, 0x0E, 0x0E,
+    0x0A, 0x0A, 0x0A, 0x38, 0x0B, 0x0B, 0x0B, 0x39, 0x39, 0x0C, 0x0C, 0x3A, 0x0D, 0x0D, 0x3B, 0x3B,
+    0x0F, 0x0F, 0x0F, 0x10, 0x10, 0x10, 0x0B, 0x11, 0x11, 0x39, 0x12, 0x12, 0x3A, 0x0D, 0x0D, 0x13,
+    0x0F, 0x0F, 0x0F, 0x0F, 0x10, 0x10, 0x10, 0x3E, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x3A, 0x13,
+    0x3C, 0x0F, 0x3D, 0x3D, 0x3D, 0x10, 0x10, 0x3E, 0x3E, 0x3F, 0x3F, 0x3F, 0x12, 0x12, 0x40, 0x40,
+    0x3C, 0x3C, 0x14, 0x3D, 0x15, 0x3D, 0x43, 0x16, 0x16, 0x3E, 0x17, 0x17, 0x3F, 0x45, 0x18, 0x40,
+    0x14, 0x14, 0x14, 0x42, 0x15, 0x15, 0x15, 0x43, 0x16, 0x16, 0x44, 0x17, 0x17, 0x3F, 0x45, 0x45,
+    0x41, 0x41, 0x14, 0x1A, 0x42, 0x15, 0x15, 0x1B, 0x43, 0x43, 0x16, 0x1C, 0x44, 0x17, 0x1D, 0x45,
+    0x19, 0x19, 0x19, 0x1A, 0x1A, 0x1A, 0x1A, 0x48, 0x1B, 0x1B, 0x49, 0x1C, 0x1C, 0x44, 0x4A, 0x1D,
+    0x46, 0x46, 0x1F, 0x47, 0x47, 0x1A, 0x1A, 0x20, 0x48, 0x48, 0x1B, 0x49, 0x49, 0x1C, 0x22, 0x4A,
+    0x1E, 0x1E, 0x1E, 0x1F, 0x1F, 0x1F, 0x1F, 0x4D, 0x20, 0x20, 0x4E, 0x21, 0x21, 0x21, 0x4F, 0x22,
+    0x23, 0x23, 0x4C, 0x4C, 0x4C, 0x1F, 0x1F, 0x25, 0x4D, 0x20, 0x4E, 0x4E, 0x21, 0x21, 0x4F, 0x4F,
+    0x28, 0x28, 0x2E, 0x29, 0x29, 0x01, 0x2F, 0x2A, 0x2A, 0x02, 0x30, 0x2B, 0x2B, 0x03, 0x31, 0x04,
+    0x2D, 0xF1, 0xF1, 0x2E, 0x2E, 0x01, 0x2F, 0x2F, 0x2F, 0x02, 0x30, 0x30, 0x03, 0x03, 0x31, 0x31,
+    0x2D, 0xF2, 0xF2, 0xF2, 0x2E, 0x2E, 0x01, 0x2F, 0x2F, 0x2F, 0x2A, 0x30, 0x30, 0x2B, 0x03, 0x31,
+    0x32, 0x05, 0xF3, 0xF3, 0xF3, 0x06, 0x06, 0x34, 0x34, 0x07, 0x07, 0x35, 0x08, 0x08, 0x36, 0x36,
+    0x32, 0x32, 0x05, 0x33, 0x33, 0x33, 0x06, 0x0C, 0x34, 0x34, 0x0D, 0x0D, 0x35, 0x35, 0x08, 0x36,
+    0x0A, 0x0A, 0x0A, 0x38, 0x38, 0x0B, 0x0B, 0x39, 0x39, 0x0C, 0x3A, 0x3A, 0x0D, 0x0D, 0x3B, 0x3B,
+    0x37, 0x37, 0x0A, 0x38, 0x38, 0x38, 0x0B, 0x11, 0x39, 0x39, 0x12, 0x12, 0x3A, 0x0D, 0x0D, 0x3B,
+    0x0F, 0x0F, 0x0F, 0x10, 0x10, 0x10, 0x38, 0x3E, 0x11, 0x11, 0x39, 0x12, 0x12, 0x3A, 0x3A, 0x13,
+    0x3C, 0x0F, 0x0F, 0x3D, 0x3D, 0x10, 0x10, 0x3E, 0x3E, 0x3F, 0x3F, 0x3F, 0x12, 0x12, 0x40, 0x40,
+    0x3C, 0x3C, 0x3C, 0x3D, 0x3D, 0x3D, 0x43, 0x16, 0x16, 0x3E, 0x17, 0x3F, 0x3F, 0x6D, 0x18, 0x40,
+    0x14, 0x14, 0x14, 0x42, 0x15, 0x3D, 0x15, 0x43, 0x16, 0x16, 0x44, 0x17, 0x17, 0x3F, 0x45, 0x45,
+    0x41, 0x41, 0x42, 0x42, 0x42, 0x15, 0x15, 0x1B, 0x43, 0x43, 0x16, 0x44, 0x44, 0x17, 0x17, 0x45,
+    0x19, 0x19, 0x19, 0x1A, 0x1A, 0x1A, 0x42, 0x48, 0x1B, 0x1B, 0x49, 0x1C, 0x1C, 0x44, 0x4A, 0x1D,
+    0x46, 0x46, 0x47, 0x47, 0x47, 0x1A, 0x1A, 0x48, 0x48, 0x48, 0x49, 0x49, 0x49, 0x1C, 0x22, 0x4A,
+    0x1E, 0x1E, 0x1E, 0x1F, 0x1F, 0x1F, 0x47, 0x4D, 0x20, 0x48, 0x76, 0x21, 0x49, 0x49, 0x4F, 0x22,
+    0x4B, 0x4B, 0x4C, 0x4C, 0x4C, 0x1F, 0x1F, 0x4D, 0x4D, 0x20, 0x4E, 0x4E, 0x4E, 0x21, 0x4F, 0x4F,
+    0x28, 0x28, 0x56, 0x29, 0x29, 0x29, 0x2F, 0x2F, 0x2A, 0x2A, 0x30, 0x2B, 0x2B, 0x03, 0x31, 0x04,
+    0x28, 0x28, 0x28, 0x2E, 0x29, 0x29, 0x2F, 0x2F, 0x2F, 0x2A, 0x30, 0x30, 0x2B, 0x2B, 0x31, 0x31,
+    0x2D, 0x2D, 0xF2, 0x2E, 0x2E, 0x2E, 0x29, 0x2F, 0x2F, 0x2F, 0x2A, 0x30, 0x30, 0x2B, 0x36, 0x31,
+    0x2D, 0x2D, 0xF3, 0xF3, 0xF3, 0x2E, 0x2E, 0x34, 0x34, 0x2F, 0x35, 0x35, 0x30, 0x08, 0x36, 0x36,
+    0x32, 0x32, 0x32, 0x33, 0x33, 0x33, 0x06, 0x34, 0x34, 0x34, 0x35, 0x35, 0x35, 0x35, 0x36, 0x36,
+    0x32, 0x32, 0x32, 0x38, 0x33, 0x33, 0x39, 0x39, 0x39, 0x34, 0x34, 0x3A, 0x35, 0x35, 0x3B, 0x3B,
+    0x37, 0x37, 0x37, 0x38, 0x38, 0x38, 0x33, 0x39, 0x39, 0x39, 0x12, 0x3A, 0x3A, 0x0D, 0x0D, 0x3B,
+    0x37, 0x37, 0x37, 0x37, 0x38, 0x38, 0x38, 0x66, 0x11, 0x39, 0x39, 0x12, 0x3A, 0x3A, 0x3A, 0x13,
+    0x3C, 0x0F, 0x0F, 0x3D, 0x3D, 0x10, 0x10, 0x3E, 0x3E, 0x3F, 0x3F, 0x3F, 0x12, 0x12, 0x40, 0x68,
+    0x3C, 0x3C, 0x3C, 0x3D, 0x3D, 0x3D, 0x6B, 0x3E, 0x3E, 0x3E, 0x3F, 0x3F, 0x3F, 0x6D, 0x18, 0x40,
+    0x3C, 0x3C, 0x3C, 0x42, 0x3D, 0x3D, 0x3D, 0x43, 0x3E, 0x3E, 0x3E, 0x17, 0x3F, 0x3F, 0x45, 0x6D,
+    0x41, 0x41, 0x42, 0x42, 0x42, 0x42, 0x15, 0x43, 0x43, 0x16, 0x16, 0x44, 0x44, 0x17, 0x17, 0x45,
+    0x41, 0x41, 0x41, 0x42, 0x1A, 0x42, 0x42, 0x48, 0x1B, 0x43, 0x49, 0x1C, 0x44, 0x44, 0x72, 0x72,
+    0x46, 0x46, 0x47, 0x47, 0x47, 0x1A, 0x1A, 0x48, 0x48, 0x48, 0x49, 0x49, 0x49, 0x1C, 0x4A, 0x4A,
+    0x46, 0x46, 0x46, 0x46, 0x1F, 0x47, 0x47, 0x75, 0x20, 0x48, 0x76, 0x49, 0x49, 0x49, 0x4F, 0x4A,
+    0x4B, 0x4B, 0x4C, 0x4C, 0x4C, 0x1F, 0x47, 0x4D, 0x4D, 0x20, 0x20, 0x4E, 0x4E, 0x21, 0x4F, 0x4F,
+    0x28, 0x28, 0x56, 0x51, 0x29, 0x29, 0x57, 0x57, 0x2A, 0x2A, 0x30, 0x2B, 0x2B, 0x2B, 0x59, 0x2C,
+    0x28, 0x28, 0x28, 0x56, 0x2E, 0x29, 0x29, 0x2F, 0x2F, 0x2A, 0x2A, 0x30, 0x2B, 0x2B, 0x59, 0x59,
+    0x2D, 0x2D, 0x5B, 0x2E, 0x2E, 0x2E, 0x29, 0x57, 0x2F, 0x2F, 0x2A, 0x30, 0x30, 0x2B, 0x5E, 0x59,
+    0x2D, 0x2D, 0x2D, 0xF3, 0x2E, 0x2E, 0x2E, 0x5C, 0x5C, 0x2F, 0x2F, 0x5D, 0x30, 0x30, 0x36, 0x5E,
+    0x32, 0x32, 0x60, 0xF4, 0xF4, 0xF4, 0x2E, 0x34, 0x34, 0x34, 0x35, 0x35, 0x35, 0x35, 0x30, 0x36,
+    0x32, 0x32, 0x32, 0x60, 0x33, 0xF5, 0xF5, 0x61, 0x34, 0x34, 0x34, 0x62, 0x35, 0x35, 0x3B, 0x63,
+    0x37, 0x37, 0x37, 0x38, 0x38, 0x38, 0xF6, 0x39, 0x39, 0x39, 0x3A, 0x3A, 0x3A, 0x35, 0x35, 0x3B,
+    0x37, 0x37, 0x37, 0x37, 0x38, 0x38, 0x38, 0xF6, 0x39, 0x39, 0x39, 0x3A, 0x3A, 0x3A, 0x3A, 0x13,
+    0x64, 0x64, 0x65, 0x65, 0x65, 0x38, 0x38, 0x66, 0x66, 0x3F, 0x67, 0x67, 0x12, 0x12, 0x68, 0x68,
+    0x3C, 0x3C, 0x3C, 0x3D, 0x3D, 0x3D, 0x6B, 0x3E, 0x3E, 0x66, 0x3F, 0x3F, 0x67, 0x6D, 0x40, 0x40,
+    0x3C, 0x3C, 0x3C, 0x6A, 0x3D, 0x3D, 0x3D, 0x6B, 0x3E, 0x3E, 0x6C, 0x3F, 0x3F, 0x3F, 0x6D, 0x6D,
+    0x41, 0x41, 0x69, 0x42, 0x42, 0x3D, 0x3D, 0x43, 0x43, 0x6B, 0x44, 0x44, 0x44, 0x3F, 0x45, 0x45,
+    0x41, 0x41, 0x41, 0x41, 0x42, 0x42, 0x70, 0x70, 0x43, 0x43, 0x71, 0x44, 0x44, 0x44, 0x72, 0x72,
+    0x6E, 0x46, 0x46, 0x47, 0x47, 0x1A, 0x42, 0x48, 0x48, 0x43, 0x49, 0x71, 0x1C, 0x44, 0x4A, 0x4A,
+    0x46, 0x46, 0x46, 0x46, 0x47, 0x47, 0x47, 0x75, 0x48, 0x48, 0x76, 0x49, 0x49, 0x49, 0x77, 0x4A,
+    0x73, 0x73, 0x4C, 0x4C, 0x4C, 0x47, 0x47, 0x75, 0x4D, 0x20, 0x48, 0x76, 0x76, 0x49, 0x4F, 0x77,
+    0x50, 0x28, 0x56, 0x56, 0x51, 0x29, 0x57, 0x57, 0x52, 0x52, 0x58, 0x53, 0x2B, 0x2B, 0x59, 0x54,
+    0x55, 0x28, 0x28, 0x56, 0x56, 0x29, 0x57, 0x57, 0x52, 0x2A, 0x58, 0x58, 0x53, 0x2B, 0x59, 0x59,
+    0x55, 0x55, 0x5B, 0x56, 0x56, 0x56, 0x5C, 0x57, 0x57, 0x57, 0x58, 0x58, 0x58, 0x2B, 0x5E, 0x59,
+    0x5A, 0x2D, 0x5B, 0x5B, 0x5B, 0x2E, 0x5C, 0x5C, 0x5C, 0x2F, 0x5D, 0x5D, 0x30, 0x30, 0x5E, 0x5E,
+    0x5A, 0x5A, 0x60, 0x5B, 0xF4, 0xF4, 0x61, 0x5C, 0x5C, 0x5C, 0x5D, 0x5D, 0x5D, 0x63, 0x63, 0x5E,
+    0x5F, 0x32, 0x60, 0x60, 0x60, 0xF5, 0xF5, 0x61, 0x61, 0x34, 0x62, 0x62, 0x35, 0x35, 0x63, 0x63,
+    0x5F, 0x5F, 0x32, 0x60, 0x60, 0x60, 0xF6, 0xF6, 0x61, 0x61, 0x62, 0x62, 0x62, 0x35, 0x35, 0x63,
+    0x37, 0x37, 0x37, 0x65, 0x38, 0x38, 0x66, 0xF6, 0x39, 0x39, 0x39, 0x3A, 0x3A, 0x3A, 0x62, 0x3B,
+    0x64, 0x64, 0x65, 0x65, 0x65, 0x38, 0x66, 0x66, 0x66, 0x67, 0x67, 0x67, 0x3A, 0x3A, 0x68, 0x68,
+    0x64, 0x64, 0x64, 0x65, 0x65, 0x65, 0x6B, 0x66, 0x66, 0x66, 0x67, 0x67, 0x67, 0x6D, 0x68, 0x68,
+    0x3C, 0x3C, 0x6A, 0x6A, 0x65, 0x3D, 0x6B, 0x6B, 0x3E, 0x3E, 0x6C, 0x3F, 0x3F, 0x3F, 0x6D, 0x6D,
+    0x69, 0x69, 0x69, 0x6A, 0x6A, 0x6A, 0x3D, 0x6B, 0x6B, 0x6B, 0x6C, 0x6C, 0x6C, 0x3F, 0x45, 0x6D,
+    0x41, 0x41, 0x41, 0x6F, 0x42, 0x42, 0x6A, 0x70, 0x43, 0x43, 0x71, 0x44, 0x44, 0x6C, 0x72, 0x45,
+    0x6E, 0x6E, 0x6E, 0x6F, 0x6F, 0x6F, 0x42, 0x70, 0x70, 0x43, 0x71, 0x71, 0x71, 0x44, 0x72, 0x72,
+    0x46, 0x46, 0x6E, 0x6E, 0x47, 0x47, 0x75, 0x75, 0x48, 0x70, 0x76, 0x71, 0x71, 0x71, 0x77, 0x4A,
+    0x73, 0x73, 0x74, 0x74, 0x74, 0x47, 0x47, 0x75, 0x75, 0x48, 0x76, 0x76, 0x76, 0x49, 0x77, 0x77,
+    0x50, 0x50, 0x7E, 0x51, 0x51, 0x51, 0x57, 0x57, 0x52, 0x52, 0x58, 0x53, 0x53, 0x53, 0x59, 0x54,
+    0x50, 0x50, 0x56, 0x56, 0x51, 0x51, 0x57, 0x57, 0x52, 0x52, 0x58, 0x58, 0x53, 0x53, 0x59, 0x59,
+    0x55, 0x55, 0x83, 0x56, 0x56, 0x56, 0x5C, 0x57, 0x57, 0x57, 0x58, 0x58, 0x58, 0x53, 0x5E, 0x59,
+    0x5A, 0x55, 0x5B, 0x5B, 0x56, 0x56, 0x56, 0x5C, 0x5C, 0x57, 0x5D, 0x5D, 0x58, 0x58, 0x5E, 0x5E,
+    0x5A, 0x5A, 0x5A, 0x5B, 0x5B, 0x5B, 0x89, 0x5C, 0x5C, 0x5C, 0x5D, 0x5D, 0x5D, 0x58, 0x63, 0x5E,
+    0x5A, 0x5A, 0x60, 0x60, 0x5B, 0xF5, 0x61, 0x61, 0x61, 0x5C, 0x62, 0x62, 0x5D, 0x5D, 0x63, 0x63,
+    0x5F, 0x5F, 0x5F, 0x60, 0x60, 0xF6, 0xF6, 0xF6, 0x61, 0x61, 0x62, 0x62, 0x62, 0x62, 0x63, 0x63,
+    0x5F, 0x5F, 0x5F, 0x5F, 0x60, 0x60, 0xF7, 0xF7, 0xF7, 0x61, 0x61, 0x62, 0x62, 0x62, 0x62, 0x63,
+    0x64, 0x65, 0x65, 0x65, 0x65, 0x60, 0x66, 0x66, 0x66, 0x67, 0x67, 0x67, 0x67, 0x68, 0x68, 0x68,
+    0x64, 0x64, 0x64, 0x65, 0x65, 0x65, 0x93, 0x66, 0x66, 0x66, 0x67, 0x67, 0x67, 0x67, 0x68, 0x68,
+    0x64, 0x64, 0x64, 0x6A, 0x65, 0x65, 0x65, 0x6B, 0x66, 0x66, 0x6C, 0x6C, 0x67, 0x67, 0x6D, 0x6D,
+    0x69, 0x69, 0x6A, 0x6A, 0x6A, 0x6A, 0x3D, 0x6B, 0x6B, 0x6B, 0x6C, 0x6C, 0x6C, 0x67, 0x6D, 0x6D,
+    0x69, 0x69, 0x69, 0x69, 0x6A, 0x6A, 0x6A, 0x70, 0x6B, 0x6B, 0x71, 0x6C, 0x6C, 0x6C, 0x72, 0x6D,
+    0x6E, 0x6E, 0x6F, 0x6F, 0x6F, 0x6F, 0x42, 0x70, 0x70, 0x70, 0x71, 0x71, 0x71, 0x6C, 0x72, 0x72,
+    0x6E, 0x6E, 0x6E, 0x6E, 0x6F, 0x6F, 0x75, 0x75, 0x70, 0x70, 0x76, 0x71, 0x71, 0x71, 0x77, 0x72,
+    0x73, 0x73, 0x73, 0x74, 0x74, 0x6F, 0x47, 0x75, 0x75, 0x48, 0x76, 0x76, 0x76, 0x71, 0x77, 0x77,
+    0x50, 0x50, 0x7E, 0x7E, 0x51, 0x51, 0x7F, 0x7F, 0x52, 0x52, 0x80, 0x53, 0x53, 0x53, 0x81, 0x59,
+    0x50, 0x50, 0x7E, 0x7E, 0x51, 0x51, 0x7F, 0x7F, 0x57, 0x52, 0x80, 0x58, 0x53, 0x53, 0x81, 0x59,
+    0x55, 0x55, 0x83, 0x83, 0x56, 0x51, 0x84, 0x84, 0x57, 0x57, 0x52, 0x58, 0x58, 0x53, 0x86, 0x59,
+    0x55, 0x55, 0x83, 0x83, 0x56, 0x56, 0x56, 0x84, 0x57, 0x57, 0x57, 0x58, 0x58, 0x58, 0x86, 0x5E,
+    0x5A, 0x5A, 0x88, 0x88, 0x5B, 0x5B, 0x89, 0x89, 0x5C, 0x5C, 0x57, 0x5D, 0x5D, 0x58, 0x8B, 0x5E,
+    0x5A, 0x5A, 0x5A, 0x88, 0x5B, 0x5B, 0x5B, 0x89, 0x89, 0x5C, 0x8A, 0x8A, 0x5D, 0x5D, 0x8B, 0x8B,
+    0x5F, 0x5F, 0x5F, 0x60, 0x60, 0xF6, 0xF6, 0xF6, 0x61, 0x61, 0x62, 0x62, 0x62, 0x5D, 0x63, 0x63,
+    0x5F, 0x5F, 0x5F, 0x5F, 0x60, 0x60, 0xF7, 0xF7, 0xF7, 0x61, 0x61, 0x62, 0x62, 0x62, 0x90, 0x63,
+    0x8C, 0x8D, 0x8D, 0x8D, 0x8D, 0x60, 0x8E, 0x8E, 0xF8, 0xF8, 0x8F, 0x8F, 0x62, 0x62, 0x90, 0x90,
+    0x64, 0x64, 0x64, 0x65, 0x65, 0x65, 0x93, 0x66, 0x66, 0x66, 0x67, 0x67, 0x67, 0x95, 0x95, 0x68,
+    0x64, 0x64, 0x64, 0x92, 0x65, 0x65, 0x65, 0x93, 0x66, 0x66, 0x94, 0x67, 0x67, 0x67, 0x95, 0x95,
+    0x69, 0x69, 0x69, 0x6A, 0x6A, 0x65, 0x65, 0x6B, 0x6B, 0x6B, 0x6C, 0x6C, 0x6C, 0x67, 0x6D, 0x6D,
+    0x69, 0x69, 0x69, 0x6A, 0x6A, 0x6A, 0x98, 0x98, 0x6B, 0x6B, 0x99, 0x6C, 0x6C, 0x6C, 0x9A, 0x9A,
+    0x6E, 0x6E, 0x6F, 0x97, 0x6F, 0x6A, 0x6A, 0x70, 0x70, 0x70, 0x71, 0x71, 0x71, 0x6C, 0x72, 0x72,
+    0x6E, 0x6E, 0x6E, 0x6F, 0x6F, 0x6F, 0x9D, 0x9D, 0x70, 0x70, 0x9E, 0x71, 0x71, 0x71, 0x9F, 0x72,
+    0x73, 0x73, 0x9C, 0x9C, 0x74, 0x6F, 0x6F, 0x75, 0x9D, 0x75, 0x76, 0x9E, 0x71, 0x71, 0x77, 0x9F,
+    0x78, 0x50, 0x7E, 0x7E, 0x79, 0x51, 0x7F, 0x7F, 0x7A, 0x52, 0x80, 0x7B, 0x7B, 0x53, 0x81, 0x7C,
+    0x7D, 0x50, 0x7E, 0x7E, 0x7E, 0x51, 0x7F, 0x7F, 0x7F, 0x7A, 0x80, 0x80, 0x53, 0x53, 0x81, 0x81,
+    0x7D, 0x50, 0x83, 0x7E, 0x7E, 0x51, 0x84, 0x7F, 0x7F, 0x57, 0x85, 0x80, 0x80, 0x53, 0x86, 0x81,
+    0x82, 0x55, 0x83, 0x83, 0x83, 0x56, 0x84, 0x84, 0x84, 0x57, 0x85, 0x85, 0x80, 0x58, 0x86, 0x86,
+    0x82, 0x82, 0x88, 0x83, 0x83, 0x83, 0x89, 0x84, 0x84, 0x8A, 0x8A, 0x85, 0x85, 0x8B, 0x8B, 0x86,
+    0x87, 0x5A, 0x88, 0x88, 0x88, 0x5B, 0x89, 0x89, 0x89, 0x5C, 0x8A, 0x8A, 0x5D, 0x5D, 0x8B, 0x8B,
+    0x87, 0x87, 0x5A, 0x88, 0x88, 0x88, 0x5B, 0x89, 0x89, 0x89, 0x8A, 0x8A, 0x8A, 0x8A, 0x8B, 0x8B,
+    0x5F, 0x5F, 0x5F, 0x8D, 0x60, 0x60, 0xF7, 0xF7, 0xF7, 0x61, 0x61, 0x62, 0x62, 0x62, 0x90, 0x63,
+    0x8C, 0x8C, 0x8D, 0x8D, 0x8D, 0x60, 0x8E, 0x8E, 0xF8, 0xF8, 0x8F, 0x8F, 0x8F, 0x90, 0x90, 0x90,
+    0x8C, 0x8C, 0x8D, 0x8D, 0x8D, 0x8D, 0x93, 0x8E, 0x8E, 0xF9, 0x8F, 0x8F, 0x8F, 0x95, 0x90, 0x90,
+    0x91, 0x92, 0x92, 0x92, 0x92, 0x65, 0x93, 0x93, 0x93, 0x66, 0x94, 0x94, 0x67, 0x8F, 0x95, 0x95,
+    0x91, 0x91, 0x91, 0x92, 0x92, 0x92, 0x65, 0x93, 0x93, 0x93, 0x94, 0x94, 0x94, 0x67, 0x95, 0x95,
+    0x96, 0x97, 0x97, 0x97, 0x6A, 0x6A, 0x98, 0x98, 0x98, 0x6B, 0x99, 0x99, 0x6C, 0x6C, 0x9A, 0x9A,
+    0x96, 0x96, 0x96, 0x97, 0x97, 0x6A, 0x6A, 0x98, 0x98, 0x98, 0x99, 0x99, 0x99, 0x6C, 0x9A, 0x9A,
+    0x9C, 0x9C, 0x9C, 0x9C, 0x6F, 0x6F, 0x9D, 0x9D, 0x70, 0x98, 0x9E, 0x71, 0x71, 0x9F, 0x9F, 0x72,
+    0x9B, 0x9B, 0x9C, 0x9C, 0x9C, 0x9C, 0x6F, 0x9D, 0x9D, 0x9D, 0x9E, 0x9E, 0x9E, 0x71, 0x9F, 0x9F,
+    0x78, 0x78, 0x7E, 0x79, 0x79, 0x79, 0x7F, 0x7F, 0x7A, 0x7A, 0x80, 0x7B, 0x7B, 0x7B, 0x81, 0x7C,
+    0x78, 0x78, 0x7E, 0x7E, 0x79, 0x79, 0xAC, 0x7F, 0x7A, 0x7A, 0x80, 0x80, 0x7B, 0x7B, 0x81, 0x81,
+    0x7D, 0x7D, 0xAB, 0x7E, 0x7E, 0x7E, 0x84, 0x84, 0x7F, 0x7A, 0x85, 0x80, 0x80, 0x7B, 0x86, 0x81,
+    0x82, 0x82, 0x83, 0x83, 0x83, 0x7E, 0x7E, 0x84, 0x84, 0x7F, 0x85, 0x85, 0x80, 0x80, 0x86, 0x86,
+    0x82, 0x82, 0x82, 0x83, 0x83, 0x83, 0xB1, 0x84, 0x84, 0x84, 0x85, 0x85, 0x85, 0x80, 0x86, 0x86,
+    0x87, 0x82, 0x88, 0x88, 0x88, 0x83, 0x89, 0x89, 0x89, 0x84, 0x8A, 0x8A, 0x85, 0x85, 0x8B, 0x8B,
+    0x87, 0x87, 0x87, 0x88, 0x88, 0x88, 0x5B, 0x89, 0x89, 0x89, 0x8A, 0x8A, 0x8A, 0x8A, 0x8B, 0x8B,
+    0x87, 0x87, 0x87, 0x88, 0x88, 0x88, 0xB6, 0xF8, 0x89, 0x89, 0x89, 0x8A, 0x8A, 0x8A, 0x90, 0x8B,
+    0x8C, 0x8C, 0x8D, 0x8D, 0x8D, 0x60, 0x8E, 0x8E, 0xF8, 0xF8, 0x8F, 0x8F, 0x8F, 0x90, 0x90, 0x90,
+    0x8C, 0x8C, 0x8C, 0x8D, 0x8D, 0x8D, 0xBB, 0x8E, 0x8E, 0xF9, 0xF9, 0x8F, 0x8F, 0x95, 0x90, 0x90,
+    0x8C, 0x8C, 0x92, 0x92, 0x8D, 0x8D, 0x93, 0x93, 0x8E, 0x8E, 0xFA, 0xFA, 0x8F, 0x8F, 0x95, 0x95,
+    0x91, 0x91, 0x92, 0x92, 0x92, 0x92, 0x93, 0x93, 0x93, 0x93, 0x94, 0x94, 0x94, 0x67, 0x95, 0x95,
+    0x91, 0x91, 0x91, 0x91, 0x92, 0x92, 0x92, 0x98, 0x93, 0x93, 0x99, 0x94, 0x94, 0x94, 0x9A, 0x95,
+    0x96, 0x96, 0x96, 0x97, 0x97, 0x97, 0x6A, 0x98, 0x98, 0x98, 0x99, 0x99, 0x99, 0x6C, 0x9A, 0x9A,
+    0x96, 0x96, 0x96, 0x96, 0x97, 0x97, 0x9D, 0x9D, 0x98, 0x98, 0x9E, 0x99, 0x99, 0x99, 0x9F, 0x9A,
+    0x9B, 0x9B, 0x9C, 0x9C, 0x9C, 0x9C, 0x9D, 0x9D, 0x9D, 0x9D, 0x9E, 0x9E, 0x9E, 0x99, 0x9F, 0x9F,
+    0x78, 0x78, 0xA6, 0xA6, 0x79, 0x79, 0xA7, 0xA7, 0x7A, 0x7A, 0xA8, 0x7B, 0x7B, 0xAE, 0xA9, 0x81,
+    0x78, 0x78, 0xAB, 0x7E, 0x79, 0x79, 0xAC, 0x7F, 0x7F, 0x7A, 0xA8, 0x80, 0x7B, 0x7B, 0xA9, 0x81,
+    0x7D, 0x7D, 0xAB, 0xAB, 0x7E, 0x79, 0xAC, 0xAC, 0x7F, 0x7A, 0x7A, 0x80, 0x80, 0x7B, 0xAE, 0x81,
+    0x7D, 0x7D, 0xAB, 0xAB, 0x7E, 0x7E, 0xAC, 0xAC, 0x7F, 0x7F, 0xAD, 0x85, 0x80, 0x80, 0xAE, 0x86,
+    0x82, 0x82, 0xB0, 0x83, 0x83, 0x83, 0xB1, 0x84, 0x84, 0x84, 0x7F, 0x85, 0x85, 0xB3, 0xB3, 0x86,
+    0x82, 0x82, 0x82, 0xB0, 0x83, 0x83, 0x83, 0xB1, 0x84, 0x84, 0x84, 0x8A, 0x85, 0x85, 0x8B, 0x8B,
+    0x87, 0x87, 0x87, 0x88, 0x88, 0x88, 0x83, 0x89, 0x89, 0x89, 0x8A, 0x8A, 0x8A, 0x85, 0x85, 0x8B,
+    0x87, 0x87, 0x87, 0x87, 0x88, 0x88, 0xB6, 0xB6, 0x89, 0x89, 0x89, 0x8A, 0x8A, 0x8A, 0xB8, 0x8B,
+    0xB4, 0xB5, 0xB5, 0xB5, 0xB5, 0x88, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0xB7, 0xB8, 0xB8, 0xB8,
+    0x8C, 0x8C, 0x8C, 0x8D, 0x8D, 0x8D, 0xBB, 0x8E, 0x8E, 0xF9, 0xF9, 0x8F, 0x8F, 0xBD, 0x90, 0x90,
+    0x8C, 0x8C, 0x8C, 0x8C, 0x8D, 0x8D, 0xBB, 0xBB, 0x8E, 0x8E, 0xFA, 0xFA, 0x8F, 0x8F, 0xBD, 0xBD,
+    0x91, 0x91, 0x91, 0x92, 0x92, 0x92, 0xC0, 0x93, 0x93, 0x93, 0xFB, 0x94, 0x94, 0xC2, 0x95, 0x95,
+    0x91, 0x91, 0x91, 0x91, 0x92, 0x92, 0xC0, 0xC0, 0x93, 0x93, 0xC1, 0x94, 0x94, 0x94, 0xC2, 0xC2,
+    0x96, 0x96, 0x97, 0x97, 0x97, 0x92, 0x92, 0x98, 0x98, 0x93, 0x99, 0x99, 0x99, 0x94, 0x9A, 0x9A,
+    0x96, 0x96, 0x96, 0x96, 0x97, 0x97, 0x97, 0xC5, 0x98, 0x98, 0xC6, 0x99, 0x99, 0x99, 0xC7, 0x9A,
+    0x9B, 0x9B, 0x9B, 0x9C, 0x9C, 0x97, 0x97, 0x9D, 0x9D, 0x98, 0x9E, 0x9E, 0x99, 0x99, 0x9F, 0x9F,
+    0xA5, 0x78, 0xA6, 0xA6, 0xA1, 0x79, 0xA7, 0xA7, 0xA2, 0xA8, 0xA8, 0xA3, 0x7B, 0xAE, 0xA9, 0xA4,
+    0xA5, 0x78, 0xA6, 0xA6, 0xA1, 0x79, 0xAC, 0xA7, 0xA7, 0xAD, 0xA8, 0xA8, 0xA3, 0xAE, 0xA9, 0xA9,
+    0xA5, 0x78, 0xAB, 0xAB, 0xA6, 0x79, 0xAC, 0xAC, 0xA7, 0xAD, 0xAD, 0xA8, 0x80, 0x7B, 0xAE, 0xA9,
+    0xAA, 0x7D, 0xAB, 0xAB, 0xAB, 0x7E, 0xAC, 0xAC, 0xAC, 0x7F, 0xAD, 0xAD, 0xA8, 0x80, 0xAE, 0xAE,
+    0xAA, 0x7D, 0xB0, 0xAB, 0xAB, 0x7E, 0xB1, 0xB1, 0xAC, 0xB2, 0xB2, 0xAD, 0xAD, 0xB3, 0xB3, 0xAE,
+    0xAF, 0x82, 0xB0, 0xB0, 0xB0, 0x83, 0xB1, 0xB1, 0xB1, 0xB2, 0xB2, 0xB2, 0x85, 0x85, 0xB3, 0xB3,
+    0xAF, 0xAF, 0x87, 0xB0, 0xB0, 0x88, 0x83, 0xB1, 0xB1, 0x89, 0xB2, 0xB2, 0xB2, 0x85, 0xB3, 0xB3,
+    0x87, 0x87, 0x87, 0xB5, 0x88, 0x88, 0xB6, 0xB6, 0x89, 0x89, 0x89, 0xB2, 0x8A, 0x8A, 0xB8, 0xB8,
+    0xB4, 0xB4, 0xB5, 0xB5, 0xB5, 0x88, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0x8A, 0xB8, 0xB8, 0xB8,
+    0xB4, 0xB4, 0xB5, 0xB5, 0xB5, 0xB5, 0xBB, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0xBD, 0xB8, 0xB8,
+    0xB9, 0xB9, 0xBA, 0xBA, 0x8D, 0x8D, 0xBB, 0xBB, 0xBB, 0xBC, 0xFA, 0xBC, 0x8F, 0x8F, 0xBD, 0xBD,
+    0xB9, 0xB9, 0xB9, 0xBA, 0xBA, 0xBA, 0xC0, 0xBB, 0xBB, 0xBB, 0xFB, 0xFB, 0xFB, 0x8F, 0xBD, 0xBD,
+    0xBE, 0xBF, 0xBF, 0xBF, 0x92, 0x92, 0xC0, 0xC0, 0xC0, 0x93, 0xC1, 0xC1, 0xFC, 0xC2, 0xC2, 0xC2,
+    0xBE, 0xBE, 0xBE, 0xBF, 0xBF, 0xBF, 0x92, 0xC0, 0xC0, 0x93, 0xC1, 0xC1, 0xC1, 0xFC, 0xC2, 0xC2,
+    0xC3, 0xC4, 0xC4, 0xC4, 0x97, 0x97, 0xC5, 0xC5, 0xC5, 0xC6, 0xC6, 0xC1, 0x99, 0xC7, 0xC7, 0xC7,
+    0xC3, 0xC3, 0xC4, 0xC4, 0xC4, 0xC4, 0x97, 0xC5, 0xC5, 0xC5, 0xC6, 0xC6, 0xC6, 0x99, 0xC7, 0xC7,
+    0xA0, 0xA0, 0xA6, 0xA6, 0xA1, 0xA1, 0xA7, 0xA7, 0xA2, 0xA2, 0xA8, 0xA3, 0xA3, 0xAE, 0xA9, 0xA4,
+    0xA0, 0xA0, 0xA6, 0xA6, 0xA1, 0xA1, 0xAC, 0xA7, 0xA2, 0xA2, 0xA8, 0xA8, 0xA3, 0xA3, 0xA9, 0xA9,
+    0xA5, 0xA5, 0xAB, 0xA6, 0xA6, 0xA1, 0xAC, 0xAC, 0xA7, 0xA2, 0xAD, 0xA8, 0xA3, 0xAE, 0xAE, 0xA9,
+    0xAA, 0xAA, 0xAB, 0xAB, 0xAB, 0xA6, 0xAC, 0xAC, 0xAC, 0xA7, 0xAD, 0xAD, 0xA8, 0xA3, 0xAE, 0xAE,
+    0xAA, 0xAA, 0xAA, 0xAB, 0xAB, 0xAB, 0xD9, 0xAC, 0xAC, 0xAC, 0xAD, 0xAD, 0xAD, 0xA8, 0xAE, 0xAE,
+    0xAF, 0xAF, 0xB0, 0xB0, 0xB0, 0xAB, 0xB1, 0xB1, 0xB1, 0xAC, 0xB2, 0xB2, 0xAD, 0xAD, 0xB3, 0xB3,
+    0xAF, 0xAF, 0xAF, 0xB0, 0xB0, 0xB0, 0xB1, 0xB1, 0xB1, 0xB1, 0xB2, 0xB2, 0xB2, 0xB2, 0xB3, 0xB3,
+    0xAF, 0xAF, 0xAF, 0xB5, 0xB0, 0xB0, 0xDE, 0xB6, 0xB1, 0xB1, 0xB7, 0xB2, 0xB2, 0xB2, 0xB8, 0xB3,
+    0xB4, 0xB4, 0xB5, 0xB5, 0xB5, 0xB5, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0xB7, 0xB8, 0xB8, 0xB8,
+    0xB4, 0xB4, 0xB4, 0xB5, 0xB5, 0xB5, 0xE3, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0xB7, 0xB8, 0xB8,
+    0xB9, 0xBA, 0xBA, 0xBA, 0xB5, 0xB5, 0xBB, 0xBB, 0xBB, 0xB6, 0xBC, 0xBC, 0xB7, 0xBD, 0xBD, 0xBD,
+    0xB9, 0xB9, 0xB9, 0xBA, 0xBA, 0xBA, 0xE8, 0xBB, 0xBB, 0xBB, 0xBC, 0xBC, 0xBC, 0xEA, 0xBD, 0xBD,
+    0xB9, 0xB9, 0xBF, 0xBF, 0xBA, 0xBA, 0xC0, 0xC0, 0xBB, 0xBB, 0xC1, 0xFC, 0xFC, 0xFC, 0xC2, 0xC2,
+    0xBE, 0xBE, 0xBF, 0xBF, 0xBF, 0xBF, 0xC0, 0xC0, 0xC0, 0xC0, 0xC1, 0xC1, 0xFD, 0xFD, 0xFD, 0xC2,
+    0xBE, 0xBE, 0xBE, 0xC4, 0xBF, 0xBF, 0xBF, 0xC5, 0xC0, 0xC0, 0xC6, 0xC1, 0xC1, 0xC1, 0xC7, 0xC2,
+    0xC3, 0xC3, 0xC3, 0xC4, 0xC4, 0xC4, 0xC5, 0xC5, 0xC5, 0xC5, 0xC6, 0xC6, 0xC6, 0x99, 0xC7, 0xC7,
+    0xA0, 0xA0, 0xD3, 0xA6, 0xA1, 0xA1, 0xD4, 0xCF, 0xA2, 0xA2, 0xD0, 0xA3, 0xA3, 0xD6, 0xD1, 0xA9,
+    0xA0, 0xA0, 0xD3, 0xCE, 0xA1, 0xA1, 0xD4, 0xCF, 0xA2, 0xA2, 0xD0, 0xA8, 0xA3, 0xD6, 0xD6, 0xA9,
+    0xA5, 0xA5, 0xD3, 0xA6, 0xA6, 0xA1, 0xD4, 0xD4, 0xA7, 0xA2, 0xD5, 0xA8, 0xA3, 0xA3, 0xD6, 0xA9,
+    0xA5, 0xA5, 0xD3, 0xAB, 0xA6, 0xA6, 0xD4, 0xAC, 0xAC, 0xA7, 0xD5, 0xAD, 0xA8, 0xA3, 0xD6, 0xAE,
+    0xAA, 0xAA, 0xD8, 0xAB, 0xAB, 0xAB, 0xD9, 0xAC, 0xAC, 0xAC, 0xDA, 0xAD, 0xAD, 0xDB, 0xDB, 0xAE,
+    0xAA, 0xAA, 0xAA, 0xD8, 0xAB, 0xAB, 0xD9, 0xD9, 0xB1, 0xAC, 0xDA, 0xB2, 0xAD, 0xAD, 0xDB, 0xB3,
+    0xAF, 0xAF, 0xAF, 0xB0, 0xB0, 0xB0, 0xDE, 0xB1, 0xB1, 0xB1, 0xB2, 0xB2, 0xB2, 0xAD, 0xB3, 0xB3,
+    0xAF, 0xAF, 0xAF, 0xDD, 0xB0, 0xB0, 0xDE, 0xDE, 0xB1, 0xB1, 0xB1, 0xB2, 0xB2, 0xB2, 0xE0, 0xB3,
+    0xB4, 0xDD, 0xDD, 0xDD, 0xB5, 0xB0, 0xDE, 0xDE, 0xB6, 0xDF, 0xDF, 0xB7, 0xB2, 0xB2, 0xE0, 0xE0,
+    0xB4, 0xB4, 0xB4, 0xB5, 0xB5, 0xB5, 0xE3, 0xB6, 0xB6, 0xB6, 0xB7, 0xB7, 0xB7, 0xE5, 0xE5, 0xB8,
+    0xB4, 0xB4, 0xB4, 0xB4, 0xB5, 0xB5, 0xE3, 0xE3, 0xB6, 0xB6, 0xE4, 0xB7, 0xB7, 0xB7, 0xE5, 0xBD,
+    0xB9, 0xB9, 0xB9, 0xBA, 0xBA, 0xBA, 0xE8, 0xBB, 0xBB, 0xBB, 0xBC, 0xBC, 0xBC, 0xEA, 0xBD, 0xBD,
+    0xB9, 0xB9, 0xB9, 0xB9, 0xBA, 0xBA, 0xE8, 0xE8, 0xBB, 0xBB, 0xE9, 0xBC, 0xFC, 0xFC, 0xEA, 0xEA,
+    0xBE, 0xBE, 0xBE, 0xBF, 0xBF, 0xBF, 0xED, 0xC0, 0xC0, 0xC0, 0xC1, 0xC1, 0xFD, 0xFD, 0xFD, 0xC2,
+    0xBE, 0xBE, 0xBE, 0xBE, 0xBF, 0xBF, 0xED, 0xED, 0xC0, 0xC0, 0xEE, 0xC1, 0xC1, 0xFE, 0xFE, 0xFE,
+    0xC3, 0xC3, 0xC3, 0xC4, 0xC4, 0xC4, 0xBF, 0xC5, 0xC5, 0xC0, 0xC6, 0xC6, 0xC1, 0xC1, 0xC7, 0xC7,
+    0xCD, 0xA0, 0xCE, 0xCE, 0xC9, 0xA1, 0xD4, 0xCF, 0xCA, 0xD5, 0xD0, 0xCB, 0xA3, 0xD6, 0xD1, 0xCC,
+    0xCD, 0xA0, 0xD3, 0xCE, 0xA1, 0xA1, 0xD4, 0xCF, 0xCF, 0xD5, 0xD0, 0xCB, 0xA3, 0xD6, 0xD6, 0xD1,
+    0xCD, 0xA0, 0xD3, 0xD3, 0xCE, 0xA1, 0xD4, 0xD4, 0xCF, 0xD5, 0xD5, 0xD0, 0xA3, 0xD6, 0xD6, 0xD1,
+    0xD2, 0xA5, 0xD3, 0xD3, 0xA6, 0xA6, 0xD9, 0xD4, 0xD4, 0xA7, 0xD5, 0xD5, 0xA8, 0xA8, 0xD6, 0xD6,
+    0xD7, 0xD2, 0xD8, 0xD3, 0xAB, 0xA6, 0xD9, 0xD9, 0xD4, 0xDA, 0xDA, 0xD5, 0xAD, 0xDB, 0xDB, 0xD6,
+    0xD7, 0xAA, 0xD8, 0xD8, 0xD8, 0xAB, 0xD9, 0xD9, 0xD9, 0xAC, 0xDA, 0xDA, 0xAD, 0xAD, 0xDB, 0xDB,
+    0xD7, 0xD7, 0xD8, 0xD8, 0xD8, 0xAB, 0xAB, 0xD9, 0xD9, 0xB1, 0xDA, 0xDA, 0xB2, 0xAD, 0xDB, 0xDB,
+    0xDC, 0xAF, 0xDD, 0xDD, 0xB0, 0xB0, 0xDE, 0xDE, 0xB1, 0xDF, 0xDF, 0xDA, 0xB2, 0xE0, 0xE0, 0xE0,
+    0xDC, 0xDD, 0xDD, 0xDD, 0xDD, 0xB0, 0xDE, 0xDE, 0xDE, 0xDF, 0xDF, 0xDF, 0xB2, 0xE0, 0xE0, 0xE0,
+    0xDC, 0xDC, 0xDD, 0xDD, 0xDD, 0xB5, 0xE3, 0xDE, 0xDE, 0xE4, 0xDF, 0xDF, 0xDF, 0xE5, 0xE5, 0xE0,
+    0xE1, 0xE1, 0xE2, 0xE2, 0xE2, 0xB5, 0xE3, 0xE3, 0xE3, 0xE4, 0xE4, 0xE4, 0xB7, 0xE5, 0xE5, 0xE5,
+    0xE1, 0xE1, 0xE2, 0xE2, 0xE2, 0xE2, 0xE8, 0xE3, 0xE3, 0xE9, 0xE4, 0xE4, 0xE4, 0xEA, 0xE5, 0xE5,
+    0xE6, 0xE7, 0xE7, 0xE7, 0xE7, 0xBA, 0xE8, 0xE8, 0xE8, 0xE9, 0xE9, 0xE9, 0xBC, 0xEA, 0xEA, 0xEA,
+    0xE6, 0xE6, 0xE6, 0xE7, 0xE7, 0xBA, 0xE8, 0xE8, 0xE8, 0xEE, 0xE9, 0xE9, 0xE9, 0xFD, 0xFD, 0xEA,
+    0xEC, 0xEC, 0xEC, 0xEC, 0xEC, 0xBF, 0xED, 0xED, 0xC0, 0xC0, 0xEE, 0xEE, 0xC1, 0xFE, 0xFE, 0xFE,
+    0xEB, 0xEB, 0xEC, 0xEC, 0xEC, 0xBF, 0xED, 0xED, 0xED, 0xC0, 0xEE, 0xEE, 0xC1, 0xC1, 0xEF, 0xEF,
+    0xC8, 0xC8, 0xCE, 0xCE, 0xC9, 0xC9, 0xCF, 0xCF, 0xCA, 0xCA, 0xD0, 0xCB, 0xCB, 0xD6, 0xD1, 0xD1,
+    0xCD, 0xCD, 0xCE, 0xCE, 0xC9, 0xC9, 0xD4, 0xCF, 0xCA, 0xD5, 0xD0, 0xCB, 0xCB, 0xD6, 0xD6, 0xD1,
+    0xCD, 0xCD, 0xD3, 0xCE, 0xCE, 0xC9, 0xD4, 0xD4, 0xCF, 0xCA, 0xD5, 0xD0, 0xCB, 0xD6, 0xD6, 0xD1,
+    0xD2, 0xD2, 0xD3, 0xD3, 0xD3, 0xCE, 0xD4, 0xD4, 0xD4, 0xCF, 0xD5, 0xD5, 0xD0, 0xCB, 0xD6, 0xD6,
+    0xD2, 0xD2, 0xD8, 0xD3, 0xD3, 0xD3, 0xD9, 0xD9, 0xD4, 0xDA, 0xDA, 0xD5, 0xD5, 0xDB, 0xDB, 0xD6,
+    0xD7, 0xD7, 0xD8, 0xD8, 0xD8, 0xD3, 0xD9, 0xD9, 0xD9, 0xD4, 0xDA, 0xDA, 0xD5, 0xD5, 0xDB, 0xDB,
+    0xD7, 0xD7, 0xD7, 0xD8, 0xD8, 0xD8, 0xAB, 0xD9, 0xD9, 0xD9, 0xDA, 0xDA, 0xDA, 0xDA, 0xDB, 0xDB,
+    0xD7, 0xD7, 0xDD, 0xD8, 0xD8, 0xD8, 0xDE, 0xDE, 0xD9, 0xD9, 0xDF, 0xDA, 0xDA, 0xE0, 0xE0, 0xDB,
+    0xDC, 0xDC, 0xDD, 0xDD, 0xDD, 0xDD, 0xDE, 0xDE, 0xDE, 0xDF, 0xDF, 0xDF, 0xDF, 0xE0, 0xE0, 0xE0,
+    0xDC, 0xDC, 0xDD, 0xDD, 0xDD, 0xDD, 0xDE, 0xDE, 0xDE, 0xDE, 0xDF, 0xDF, 0xDF, 0xE5, 0xE0, 0xE0,
+    0xE1, 0xE1, 0xE2, 0xE2, 0xDD, 0xDD, 0xE3, 0xE3, 0xE3, 0xE4, 0xE4, 0xE4, 0xDF, 0xDF, 0xE5, 0xE5,
+    0xE1, 0xE1, 0xE1, 0xE2, 0xE2, 0xE2, 0xE3, 0xE3, 0xE3, 0xE3, 0xE4, 0xE4, 0xE4, 0xE4, 0xE5, 0xE5,
+    0xE6, 0xE7, 0xE7, 0xE7, 0xE7, 0xE2, 0xE8, 0xE8, 0xE8, 0xE3, 0xE9, 0xE4, 0xE4, 0xEA, 0xEA, 0xEA,
+    0xE6, 0xE6, 0xE6, 0xE7, 0xE7, 0xE7, 0xE8, 0xE8, 0xE8, 0xE8, 0xE9, 0xE9, 0xE9, 0xFE, 0xEA, 0xEA,
+    0xE6, 0xE6, 0xE6, 0xEC, 0xE7, 0xE7, 0xED, 0xED, 0xE8, 0xE8, 0xEE, 0xE9, 0xE9, 0xE9, 0xFE, 0xFE,
+    0xEB, 0xEB, 0xEC, 0xEC, 0xEC, 0xEC, 0xED, 0xED, 0xED, 0xED, 0xEE, 0xEE, 0xEE, 0xC1, 0xEF, 0xEF
+};
+
+#endif // IPF_PALETTE_H
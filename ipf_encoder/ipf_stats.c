@@ -0,0 +1,313 @@
+/**
+ * iPF Tool Stats - per-stage timings and counters for the iPF tools
+ */
+
+#include "ipf_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+int ipf_stats_parse(const char *spec, ipf_stats_output_t *out) {
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+    if (len == 4 && strncmp(spec, "json", 4) == 0) out->format = IPF_STATS_JSON;
+    else if (len == 4 && strncmp(spec, "text", 4) == 0) out->format = IPF_STATS_TEXT;
+    else return -1;
+
+    out->path = colon && colon[1] ? colon + 1 : NULL;
+    return 0;
+}
+
+void ipf_stats_from_env(ipf_stats_output_t *out) {
+    const char *spec = getenv("IPF_STATS");
+    if (out->format == IPF_STATS_OFF && spec && *spec && ipf_stats_parse(spec, out) < 0) {
+        fprintf(stderr, "Warning: Ignoring IPF_STATS=%s (use json or text, optionally :FILE)\n", spec);
+    }
+
+    const char *trace = getenv("IPF_TRACE");
+    if (!out->trace_path && trace && *trace) out->trace_path = trace;
+}
+
+// =============================================================================
+// Timing
+// =============================================================================
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t ipf_stats_now(void) {
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+void ipf_stats_init(ipf_stats_t *s, int tid, int tracing) {
+    memset(s, 0, sizeof(*s));
+    s->zstd_level = -1;
+    s->tid = tid;
+    s->tracing = tracing;
+    s->origin_ns = ipf_stats_now();
+    s->origin_cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void ipf_stats_free(ipf_stats_t *s) {
+    free(s->events);
+    s->events = NULL;
+    s->event_count = s->event_capacity = 0;
+}
+
+static ipf_stage_t *find_stage(ipf_stats_t *s, const char *name) {
+    for (int i = 0; i < s->stage_count; i++) {
+        if (s->stages[i].name == name || strcmp(s->stages[i].name, name) == 0) return &s->stages[i];
+    }
+    if (s->stage_count == IPF_STATS_MAX_STAGES) return NULL;
+
+    ipf_stage_t *stage = &s->stages[s->stage_count++];
+    stage->name = name;
+    stage->ns = 0;
+    stage->calls = 0;
+    return stage;
+}
+
+static void add_event(ipf_stats_t *s, const char *name, const char *detail, uint64_t start, uint64_t dur) {
+    if (s->event_count == s->event_capacity) {
+        size_t capacity = s->event_capacity ? s->event_capacity * 2 : 256;
+        ipf_trace_event_t *events = realloc(s->events, capacity * sizeof(*events));
+        if (!events) {
+            s->tracing = 0;  // Keep the run going without a trace
+            return;
+        }
+        s->events = events;
+        s->event_capacity = capacity;
+    }
+    s->events[s->event_count++] = (ipf_trace_event_t){ name, detail, s->tid, start, dur };
+}
+
+uint64_t ipf_stats_start(const ipf_stats_t *s) {
+    return s ? ipf_stats_now() : 0;
+}
+
+uint64_t ipf_stats_lap(ipf_stats_t *s, const char *stage, uint64_t since) {
+    if (!s) return 0;
+    uint64_t now = ipf_stats_now();
+
+    ipf_stage_t *st = find_stage(s, stage);
+    if (st) {
+        st->ns += now - since;
+        st->calls++;
+    }
+    if (s->tracing) add_event(s, stage, NULL, since, now - since);
+    return now;
+}
+
+void ipf_stats_event(ipf_stats_t *s, const char *name, const char *detail, uint64_t start_ns) {
+    if (s && s->tracing) add_event(s, name, detail, start_ns, ipf_stats_now() - start_ns);
+}
+
+void ipf_stats_add_thread_cpu(ipf_stats_t *s) {
+    s->cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    s->threads++;
+}
+
+int ipf_stats_merge(ipf_stats_t *total, const ipf_stats_t *worker) {
+    for (int i = 0; i < worker->stage_count; i++) {
+        ipf_stage_t *st = find_stage(total, worker->stages[i].name);
+        if (!st) continue;
+        st->ns += worker->stages[i].ns;
+        st->calls += worker->stages[i].calls;
+    }
+
+    total->files += worker->files;
+    total->bytes_in += worker->bytes_in;
+    total->bytes_out += worker->bytes_out;
+    total->blocks += worker->blocks;
+    total->pixels += worker->pixels;
+    total->zstd_raw += worker->zstd_raw;
+    total->zstd_packed += worker->zstd_packed;
+    if (worker->zstd_level >= 0) total->zstd_level = worker->zstd_level;
+    total->threads += worker->threads;
+    total->cpu_ns += worker->cpu_ns;
+
+    if (!total->tracing) return 0;
+    for (size_t i = 0; i < worker->event_count; i++) {
+        const ipf_trace_event_t *e = &worker->events[i];
+        if (total->event_count == total->event_capacity) {
+            size_t capacity = total->event_capacity ? total->event_capacity * 2 : 256;
+            while (capacity < total->event_count + worker->event_count - i) capacity *= 2;
+            ipf_trace_event_t *events = realloc(total->events, capacity * sizeof(*events));
+            if (!events) return -1;
+            total->events = events;
+            total->event_capacity = capacity;
+        }
+        total->events[total->event_count++] = *e;
+    }
+    return 0;
+}
+
+void ipf_stats_finish(ipf_stats_t *s) {
+    s->wall_ns = ipf_stats_now() - s->origin_ns;
+    if (s->threads == 0) {
+        s->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - s->origin_cpu_ns;
+        s->threads = 1;
+    }
+}
+
+uint64_t ipf_stats_file_size(const char *path) {
+    struct stat st;
+    if (!path || strcmp(path, "-") == 0 || stat(path, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+    return (uint64_t)st.st_size;
+}
+
+// =============================================================================
+// Reports
+// =============================================================================
+
+static void json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') fprintf(fp, "\\%c", *c);
+        else if (*c < 0x20) fprintf(fp, "\\u%04x", *c);
+        else fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+static long peak_rss_kb(int who) {
+    struct rusage ru;
+    return getrusage(who, &ru) == 0 ? ru.ru_maxrss : 0;  // Kilobytes on Linux
+}
+
+static void write_json(const ipf_stats_t *s, FILE *fp, const char *tool, const char *input) {
+    double wall = s->wall_ns / 1e9;
+    double secs = wall > 0 ? wall : 1e-9;
+
+    fprintf(fp, "{\"tool\":");
+    json_string(fp, tool);
+    fprintf(fp, ",\"input\":");
+    json_string(fp, input ? input : "");
+    fprintf(fp, ",\"wall_ms\":%.3f,\"stages\":{", s->wall_ns / 1e6);
+    for (int i = 0; i < s->stage_count; i++) {
+        fprintf(fp, "%s", i ? "," : "");
+        json_string(fp, s->stages[i].name);
+        fprintf(fp, ":{\"ms\":%.3f,\"calls\":%llu}", s->stages[i].ns / 1e6,
+                (unsigned long long)s->stages[i].calls);
+    }
+    fprintf(fp, "},\"files\":%llu,\"bytes_in\":%llu,\"bytes_out\":%llu,\"blocks\":%llu,\"pixels\":%llu,"
+            "\"blocks_per_s\":%.0f,\"mb_per_s_in\":%.3f,",
+            (unsigned long long)s->files, (unsigned long long)s->bytes_in, (unsigned long long)s->bytes_out,
+            (unsigned long long)s->blocks, (unsigned long long)s->pixels,
+            s->blocks / secs, s->bytes_in / 1e6 / secs);
+
+    fprintf(fp, "\"zstd\":{\"level\":");
+    if (s->zstd_level >= 0) fprintf(fp, "%d", s->zstd_level);
+    else fprintf(fp, "null");
+    fprintf(fp, ",\"raw\":%llu,\"packed\":%llu,\"ratio\":", (unsigned long long)s->zstd_raw,
+            (unsigned long long)s->zstd_packed);
+    if (s->zstd_packed) fprintf(fp, "%.4f", (double)s->zstd_raw / s->zstd_packed);
+    else fprintf(fp, "null");
+
+    fprintf(fp, "},\"threads\":%d,\"cpu_ms\":%.3f,\"thread_utilisation\":%.4f,"
+            "\"peak_rss_kb\":%ld,\"children_peak_rss_kb\":%ld}\n",
+            s->threads, s->cpu_ns / 1e6, s->wall_ns ? (double)s->cpu_ns / s->wall_ns / s->threads : 0.0,
+            peak_rss_kb(RUSAGE_SELF), peak_rss_kb(RUSAGE_CHILDREN));
+}
+
+static void write_text(const ipf_stats_t *s, FILE *fp, const char *tool, const char *input) {
+    double secs = s->wall_ns > 0 ? s->wall_ns / 1e9 : 1e-9;
+    uint64_t staged = 0;
+    for (int i = 0; i < s->stage_count; i++) staged += s->stages[i].ns;
+
+    fprintf(fp, "%s stats for %s: %.3f ms wall\n", tool, input ? input : "-", s->wall_ns / 1e6);
+    for (int i = 0; i < s->stage_count; i++) {
+        const ipf_stage_t *st = &s->stages[i];
+        fprintf(fp, "  %-10s %10.3f ms %5.1f%% %8llu calls\n", st->name, st->ns / 1e6,
+                staged ? 100.0 * st->ns / staged : 0.0, (unsigned long long)st->calls);
+    }
+    fprintf(fp, "  Bytes:    %llu in, %llu out, %llu files\n", (unsigned long long)s->bytes_in,
+            (unsigned long long)s->bytes_out, (unsigned long long)s->files);
+    fprintf(fp, "  Blocks:   %llu (%.0f blocks/s, %.2f Mpx/s)\n", (unsigned long long)s->blocks,
+            s->blocks / secs, s->pixels / 1e6 / secs);
+    if (s->zstd_packed) {
+        fprintf(fp, "  Zstd:     ");
+        if (s->zstd_level >= 0) fprintf(fp, "level %d, ", s->zstd_level);
+        fprintf(fp, "%llu <-> %llu bytes, ratio %.3f\n", (unsigned long long)s->zstd_raw,
+                (unsigned long long)s->zstd_packed, (double)s->zstd_raw / s->zstd_packed);
+    }
+    fprintf(fp, "  Threads:  %d, %.1f%% utilised\n", s->threads,
+            s->wall_ns ? 100.0 * s->cpu_ns / s->wall_ns / s->threads : 0.0);
+    fprintf(fp, "  Peak RSS: %ld KB (children %ld KB)\n", peak_rss_kb(RUSAGE_SELF), peak_rss_kb(RUSAGE_CHILDREN));
+}
+
+/**
+ * Chrome trace-event format: one complete ("X") event per stage or file,
+ * timestamps in microseconds from the start of the run.
+ */
+static int write_trace(const ipf_stats_t *s, const char *path, const char *tool) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open trace file: %s\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":");
+    json_string(fp, tool);
+    fprintf(fp, "}}");
+    for (size_t i = 0; i < s->event_count; i++) {
+        const ipf_trace_event_t *e = &s->events[i];
+        fprintf(fp, ",\n{\"name\":");
+        json_string(fp, e->name);
+        fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", e->tid,
+                (e->start_ns - s->origin_ns) / 1e3, e->dur_ns / 1e3);
+        if (e->detail) {
+            fprintf(fp, ",\"args\":{\"file\":");
+            json_string(fp, e->detail);
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Error: Failed to write trace file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int ipf_stats_report(const ipf_stats_t *s, const ipf_stats_output_t *out, const char *tool, const char *input) {
+    int result = 0;
+
+    if (out->format != IPF_STATS_OFF) {
+        // Build the report first so that runs appending to one file don't interleave
+        char *buf = NULL;
+        size_t len = 0;
+        FILE *mem = open_memstream(&buf, &len);
+        if (!mem) return -1;
+        if (out->format == IPF_STATS_JSON) write_json(s, mem, tool, input);
+        else write_text(s, mem, tool, input);
+        fclose(mem);
+
+        int fd = out->path ? open(out->path, O_WRONLY | O_CREAT | O_APPEND, 0644) : STDERR_FILENO;
+        if (fd < 0 || write(fd, buf, len) != (ssize_t)len) {
+            fprintf(stderr, "Error: Failed to write stats to %s\n", out->path ? out->path : "stderr");
+            result = -1;
+        }
+        if (out->path && fd >= 0) close(fd);
+        free(buf);
+    }
+
+    if (out->trace_path && write_trace(s, out->trace_path, tool) < 0) result = -1;
+    return result;
+}
@@ -0,0 +1,140 @@
+/**
+ * iPF Tool Stats - per-stage timings and counters for the iPF tools
+ *
+ * A tool keeps one ipf_stats_t per thread, times its stages with
+ * ipf_stats_start/ipf_stats_lap on the monotonic clock, and merges the
+ * per-thread records at the end. The report is a text table or one line of
+ * JSON; a Chrome trace (chrome://tracing, Perfetto) can be written as well.
+ *
+ * Besides --stats/--trace, the tools read two environment variables, so a
+ * build script can collect stats without changing any command line:
+ *   IPF_STATS=json[:FILE] or text[:FILE]   (a FILE is appended to)
+ *   IPF_TRACE=FILE
+ */
+
+#ifndef IPF_STATS_H
+#define IPF_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define IPF_STATS_MAX_STAGES 12
+
+typedef enum {
+    IPF_STATS_OFF = 0,
+    IPF_STATS_TEXT,
+    IPF_STATS_JSON
+} ipf_stats_format_t;
+
+/**
+ * Where the report goes. path NULL means stderr.
+ */
+typedef struct {
+    ipf_stats_format_t format;
+    const char *path;
+    const char *trace_path;  // Chrome trace-event JSON, NULL for none
+} ipf_stats_output_t;
+
+typedef struct {
+    const char *name;    // Must outlive the stats (string literals)
+    uint64_t ns;
+    uint64_t calls;
+} ipf_stage_t;
+
+typedef struct {
+    const char *name;
+    const char *detail;  // File path for per-file events, or NULL
+    int tid;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+} ipf_trace_event_t;
+
+typedef struct {
+    ipf_stage_t stages[IPF_STATS_MAX_STAGES];
+    int stage_count;
+
+    uint64_t files;
+    uint64_t bytes_in;     // Read from input files
+    uint64_t bytes_out;    // Written to output files
+    uint64_t blocks;       // 4x4 blocks encoded or decoded
+    uint64_t pixels;
+    int zstd_level;        // -1 when unknown or not compressing
+    uint64_t zstd_raw;     // Bytes before compression / after decompression
+    uint64_t zstd_packed;  // Bytes after compression / before decompression
+
+    int threads;           // Threads that did the work
+    uint64_t cpu_ns;       // CPU time of those threads
+    uint64_t origin_ns;      // When the run started
+    uint64_t origin_cpu_ns;  // Process CPU time by then
+    uint64_t wall_ns;        // Set by ipf_stats_finish
+
+    int tid;               // Thread number in trace events
+    int tracing;           // Record trace events
+    ipf_trace_event_t *events;
+    size_t event_count;
+    size_t event_capacity;
+} ipf_stats_t;
+
+/**
+ * Parse "json", "text", or either followed by ":FILE". Returns -1 if unknown.
+ */
+int ipf_stats_parse(const char *spec, ipf_stats_output_t *out);
+
+/**
+ * Fill in IPF_STATS and IPF_TRACE for whatever the command line left unset.
+ */
+void ipf_stats_from_env(ipf_stats_output_t *out);
+
+/**
+ * Start a run (or one worker's share of it). tid numbers the thread in traces.
+ */
+void ipf_stats_init(ipf_stats_t *s, int tid, int tracing);
+
+void ipf_stats_free(ipf_stats_t *s);
+
+uint64_t ipf_stats_now(void);
+
+/**
+ * Timestamp to time a stage from, or 0 when s is NULL so callers can pass
+ * NULL to turn the instrumentation off.
+ */
+uint64_t ipf_stats_start(const ipf_stats_t *s);
+
+/**
+ * Charge the time since since to stage and return the current time, which
+ * starts the next stage.
+ */
+uint64_t ipf_stats_lap(ipf_stats_t *s, const char *stage, uint64_t since);
+
+/**
+ * Record a trace event spanning start_ns until now, such as one whole file.
+ */
+void ipf_stats_event(ipf_stats_t *s, const char *name, const char *detail, uint64_t start_ns);
+
+/**
+ * Add the CPU time the calling thread has used so far.
+ */
+void ipf_stats_add_thread_cpu(ipf_stats_t *s);
+
+/**
+ * Fold a worker's stages, counters and events into the run's total.
+ */
+int ipf_stats_merge(ipf_stats_t *total, const ipf_stats_t *worker);
+
+/**
+ * Stop the wall clock. Single-threaded tools count the process's CPU time.
+ */
+void ipf_stats_finish(ipf_stats_t *s);
+
+/**
+ * Write the report, and the trace when one was asked for. input names the
+ * file or batch source. Returns 0 on success.
+ */
+int ipf_stats_report(const ipf_stats_t *s, const ipf_stats_output_t *out, const char *tool, const char *input);
+
+/**
+ * Size of the file at path, or 0 for "-" and anything that can't be stat'ed.
+ */
+uint64_t ipf_stats_file_size(const char *path);
+
+#endif // IPF_STATS_H
@@ -0,0 +1,1576 @@
+/**
+ * libipf - TSVM Interchangeable Picture Format block codec
+ *
+ * See libipf.h. The float arithmetic here mirrors the Kotlin codec in
+ * GraphicsJSR223Delegate operation for operation; build without
+ * -ffast-math or FMA contraction or the nibbles stop matching.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "libipf.h"
+#include "ipf_palette.h"
+
+// Adam7 interlace pattern - pass number (1-7) for each pixel in 8x8 block
+static const int ADAM7_PASS[8][8] = {
+    {1, 6, 4, 6, 2, 6, 4, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {5, 6, 5, 6, 5, 6, 5, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {3, 6, 4, 6, 3, 6, 4, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {5, 6, 5, 6, 5, 6, 5, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7}
+};
+
+// GraphicsJSR223Delegate.bayerKernelsInt; thresholds are (k + 0.5) / 16
+static const int BAYER_KERNELS[4][16] = {
+    { 0,  8,  2, 10,
+     12,  4, 14,  6,
+      3, 11,  1,  9,
+     15,  7, 13,  5},
+    { 8,  2, 10,  0,
+      4, 14,  6, 12,
+     11,  1,  9,  3,
+      7, 13,  5, 15},
+    { 7, 13,  5, 15,
+      8,  2, 10,  0,
+      4, 14,  6, 12,
+     11,  1,  9,  3},
+    {15,  7, 13,  5,
+      0,  8,  2, 10,
+     12,  4, 14,  6,
+      3, 11,  1,  9}
+};
+
+// =============================================================================
+// Header
+// =============================================================================
+
+const char *ipf_strerror(int err) {
+    switch (err) {
+        case IPF_OK:        return "Success";
+        case IPF_ERR_SHORT: return "File too short for an iPF header";
+        case IPF_ERR_MAGIC: return "Invalid iPF magic";
+        case IPF_ERR_TYPE:  return "Unknown iPF type";
+        case IPF_ERR_ARG:   return "Invalid argument";
+        case IPF_ERR_DELTA: return "Corrupt delta stream";
+        case IPF_ERR_NOMEM: return "Out of memory";
+        default:            return "Unknown error";
+    }
+}
+
+int ipf_parse_header(const uint8_t *buf, size_t len, ipf_header_t *header) {
+    if (len < IPF_HEADER_SIZE) return IPF_ERR_SHORT;
+    if (memcmp(buf, IPF_MAGIC, 8) != 0) return IPF_ERR_MAGIC;
+
+    header->width = buf[8] | (buf[9] << 8);
+    header->height = buf[10] | (buf[11] << 8);
+    header->flags = buf[12];
+    header->type = buf[13];
+    // 10 reserved bytes at 14..23
+    header->uncompressed_size = (uint32_t)buf[24] | ((uint32_t)buf[25] << 8) |
+                                ((uint32_t)buf[26] << 16) | ((uint32_t)buf[27] << 24);
+
+    if (header->type != IPF_TYPE_1 && header->type != IPF_TYPE_2 && header->type != IPF_TYPE_INDEXED) {
+        return IPF_ERR_TYPE;
+    }
+    return IPF_OK;
+}
+
+void ipf_write_header(const ipf_header_t *header, uint8_t *buf) {
+    memcpy(buf, IPF_MAGIC, 8);
+    buf[8] = header->width & 0xFF;
+    buf[9] = header->width >> 8;
+    buf[10] = header->height & 0xFF;
+    buf[11] = header->height >> 8;
+    buf[12] = header->flags;
+    buf[13] = header->type;
+    memset(buf + 14, 0, 10);
+    buf[24] = header->uncompressed_size & 0xFF;
+    buf[25] = (header->uncompressed_size >> 8) & 0xFF;
+    buf[26] = (header->uncompressed_size >> 16) & 0xFF;
+    buf[27] = (header->uncompressed_size >> 24) & 0xFF;
+}
+
+int ipf_blocks_x(const ipf_header_t *header) {
+    return (header->width + 3) / 4;
+}
+
+int ipf_blocks_y(const ipf_header_t *header) {
+    return (header->height + 3) / 4;
+}
+
+int ipf_block_size(const ipf_header_t *header) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    return (header->type == IPF_TYPE_1) ? (has_alpha ? 20 : 12) : (has_alpha ? 24 : 16);
+}
+
+size_t ipf_blocks_size(const ipf_header_t *header) {
+    if (header->type == IPF_TYPE_INDEXED) return (size_t)header->width * header->height;
+    return (size_t)ipf_blocks_x(header) * ipf_blocks_y(header) * ipf_block_size(header);
+}
+
+int ipf_pixel_bytes(int has_alpha, ipf_layout_t layout) {
+    if (layout == IPF_PIXELS_TSVM) return 2;
+    return has_alpha ? 4 : 3;
+}
+
+int ipf_adam7_pass(int bx, int by) {
+    return ADAM7_PASS[(by * 4) % 8][(bx * 4) % 8];
+}
+
+void ipf_adam7_order(int blocks_x, int blocks_y, uint32_t *order) {
+    size_t n = 0;
+    for (int pass = 1; pass <= 7; pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (ipf_adam7_pass(bx, by) == pass) order[n++] = (uint32_t)by * blocks_x + bx;
+            }
+        }
+    }
+}
+
+// =============================================================================
+// libGDX MathUtils
+// =============================================================================
+
+// MathUtils.floor/round bias the float through a double, so there is no
+// float rounding on the way
+
+static int gdx_floor(float v) {
+    return (int)((double)v + 16384.0) - 16384;
+}
+
+static int gdx_round(float v) {
+    return (int)((double)v + 16384.5) - 16384;
+}
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// =============================================================================
+// Decoding
+// =============================================================================
+
+/**
+ * Quantise a [0..1] channel to 4 bits exactly as MathUtils.round(v * 15)
+ * does in the VM.
+ */
+static int round_nibble(float v) {
+    return gdx_round(v * 15.0f);
+}
+
+// Nibble position (byte * 2 + high) of each pixel's Y/alpha within the
+// 8-byte field: [Y1|Y0],[Y5|Y4],[Y3|Y2],[Y7|Y6],[Y9|Y8],[YD|YC],[YB|YA],[YF|YE]
+static const uint8_t PIXEL_NIBBLE[16] = {
+    0, 1, 4, 5,
+    2, 3, 6, 7,
+    8, 9, 12, 13,
+    10, 11, 14, 15
+};
+
+// Every pixel's colour depends only on its (Co, Cg, Y) nibbles, so the
+// conversion is tabulated once: 4096 entries per output layout
+static uint16_t lut_tsvm[4096];     // RG in the low byte, B<<4 in the high byte
+static uint8_t lut_rgb[4096][3];
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+
+/**
+ * YCoCg to RGB as ipf1YcocgToRGB/ipf2YcocgToRGB compute it, from nibble
+ * values that may lie between the integers; note that r is derived from
+ * the already clamped b.
+ */
+static void ycocg_to_rgbf(float yi, float co, float cg, float *r, float *g, float *b) {
+    // Convert chroma from [0..15] to [-1..1]
+    float co_f = (co - 7) / 8.0f;
+    float cg_f = (cg - 7) / 8.0f;
+    float y = yi / 15.0f;
+    float tmp = y - cg_f / 2.0f;
+    *g = clampf(cg_f + tmp, 0.0f, 1.0f);
+    *b = clampf(tmp - co_f / 2.0f, 0.0f, 1.0f);
+    *r = clampf(*b + co_f, 0.0f, 1.0f);
+}
+
+void ipf_ycocg_to_rgb(float y, float co, float cg, uint8_t *rgb) {
+    float r, g, b;
+    ycocg_to_rgbf(y, co, cg, &r, &g, &b);
+    rgb[0] = (uint8_t)(r * 255.0f + 0.5f);
+    rgb[1] = (uint8_t)(g * 255.0f + 0.5f);
+    rgb[2] = (uint8_t)(b * 255.0f + 0.5f);
+}
+
+static void build_luts(void) {
+    for (int co = 0; co < 16; co++) {
+        for (int cg = 0; cg < 16; cg++) {
+            for (int yi = 0; yi < 16; yi++) {
+                float r, g, b;
+                ycocg_to_rgbf((float)yi, (float)co, (float)cg, &r, &g, &b);
+
+                int i = (co << 8) | (cg << 4) | yi;
+                lut_tsvm[i] = (uint16_t)(((round_nibble(r) << 4) | round_nibble(g)) | (round_nibble(b) << 12));
+                lut_rgb[i][0] = (uint8_t)(r * 255.0f + 0.5f);
+                lut_rgb[i][1] = (uint8_t)(g * 255.0f + 0.5f);
+                lut_rgb[i][2] = (uint8_t)(b * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+static void ensure_luts(void) {
+    pthread_once(&lut_once, build_luts);
+}
+
+// Chroma pair used by each pixel: iPF1 has one per 2x2 quad, iPF2 one per
+// horizontal pair
+static const uint8_t PIXEL_CHROMA[2][16] = {
+    {0, 0, 1, 1,  0, 0, 1, 1,  2, 2, 3, 3,  2, 2, 3, 3},
+    {0, 0, 1, 1,  2, 2, 3, 3,  4, 4, 5, 5,  6, 6, 7, 7}
+};
+
+static void split_nibbles(const uint8_t *field, int bytes, uint8_t *out) {
+    for (int n = 0; n < bytes; n++) {
+        out[n * 2] = field[n] & 0x0F;
+        out[n * 2 + 1] = field[n] >> 4;
+    }
+}
+
+/**
+ * Unpack a block into per-pixel LUT indices and alpha nibbles.
+ */
+static void unpack_block(const ipf_header_t *header, const uint8_t *block, uint16_t idx[16], uint8_t alpha[16]) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int type = header->type == IPF_TYPE_1 ? 0 : 1;
+    int chroma_bytes = type == 0 ? 2 : 4;
+    uint8_t co[8], cg[8], ys[16], as[16];
+    uint16_t base[8];
+
+    split_nibbles(block, chroma_bytes, co);
+    split_nibbles(block + chroma_bytes, chroma_bytes, cg);
+    split_nibbles(block + chroma_bytes * 2, 8, ys);
+    for (int c = 0; c < chroma_bytes * 2; c++) base[c] = (uint16_t)((co[c] << 8) | (cg[c] << 4));
+
+    for (int i = 0; i < 16; i++) idx[i] = base[PIXEL_CHROMA[type][i]] | ys[PIXEL_NIBBLE[i]];
+
+    if (has_alpha) {
+        split_nibbles(block + chroma_bytes * 2 + 8, 8, as);
+        for (int i = 0; i < 16; i++) alpha[i] = as[PIXEL_NIBBLE[i]];
+    } else {
+        memset(alpha, 15, 16);
+    }
+}
+
+void ipf_decode_block(const ipf_header_t *header, const uint8_t *block, ipf_layout_t layout,
+                      uint8_t *pixels, size_t stride) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    uint16_t idx[16];
+    uint8_t alpha[16];
+
+    ensure_luts();
+    unpack_block(header, block, idx, alpha);
+
+    for (int py = 0; py < 4; py++) {
+        uint8_t *row = pixels + py * stride;
+        for (int px = 0; px < 4; px++) {
+            int i = py * 4 + px;
+            if (layout == IPF_PIXELS_TSVM) {
+                uint16_t v = lut_tsvm[idx[i]];
+                row[px * 2] = (uint8_t)v;
+                row[px * 2 + 1] = (uint8_t)((v >> 8) | alpha[i]);
+            } else if (has_alpha) {
+                memcpy(row + px * 4, lut_rgb[idx[i]], 3);
+                row[px * 4 + 3] = (uint8_t)(alpha[i] * 17);  // Scale 0-15 to 0-255
+            } else {
+                memcpy(row + px * 3, lut_rgb[idx[i]], 3);
+            }
+        }
+    }
+}
+
+void ipf_decode_block_row(const ipf_header_t *header, ipf_layout_t layout, const uint8_t *blocks,
+                          uint8_t *band, size_t band_stride) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int channels = ipf_pixel_bytes(has_alpha, layout);
+    int blocks_x = ipf_blocks_x(header);
+    int block_size = ipf_block_size(header);
+
+    for (int bx = 0; bx < blocks_x; bx++) {
+        ipf_decode_block(header, blocks + (size_t)bx * block_size, layout,
+                         band + (size_t)bx * 4 * channels, band_stride);
+    }
+}
+
+void ipf_decode_block_row_upscaled(const ipf_header_t *header, const uint8_t *blocks, int scale,
+                                   uint8_t *band, size_t band_stride) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int channels = has_alpha ? 4 : 3;
+    int blocks_x = ipf_blocks_x(header);
+    int block_size = ipf_block_size(header);
+    size_t run = (size_t)4 * scale * channels;  // One block's pixels across
+    uint16_t idx[16];
+    uint8_t alpha[16];
+
+    ensure_luts();
+    for (int bx = 0; bx < blocks_x; bx++) {
+        unpack_block(header, blocks + (size_t)bx * block_size, idx, alpha);
+        for (int py = 0; py < 4; py++) {
+            uint8_t *row = band + (size_t)py * scale * band_stride + bx * run;
+            for (int px = 0; px < 4; px++) {
+                uint8_t pixel[4];
+                memcpy(pixel, lut_rgb[idx[py * 4 + px]], 3);
+                pixel[3] = (uint8_t)(alpha[py * 4 + px] * 17);
+                for (int k = 0; k < scale; k++) memcpy(row + (size_t)(px * scale + k) * channels, pixel, channels);
+            }
+            for (int k = 1; k < scale; k++) memcpy(row + k * band_stride, row, run);
+        }
+    }
+}
+
+void ipf_unpack_block_row(const ipf_header_t *header, const uint8_t *blocks, uint8_t *const planes[4],
+                          size_t stride) {
+    int blocks_x = ipf_blocks_x(header);
+    int block_size = ipf_block_size(header);
+    uint16_t idx[16];
+    uint8_t alpha[16];
+
+    for (int bx = 0; bx < blocks_x; bx++) {
+        unpack_block(header, blocks + (size_t)bx * block_size, idx, alpha);
+        for (int i = 0; i < 16; i++) {
+            size_t at = (size_t)(i >> 2) * stride + bx * 4 + (i & 3);
+            planes[0][at] = (uint8_t)(idx[i] & 15);
+            planes[1][at] = (uint8_t)(idx[i] >> 8);
+            planes[2][at] = (uint8_t)((idx[i] >> 4) & 15);
+            planes[3][at] = alpha[i];
+        }
+    }
+}
+
+/**
+ * Look indices up in the default palette, as the adapter shows them.
+ */
+static void decode_indexed(const ipf_header_t *header, const uint8_t *indices, ipf_layout_t layout,
+                           uint8_t *pixels, size_t stride) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+
+    for (int y = 0; y < header->height; y++) {
+        const uint8_t *in = indices + (size_t)y * header->width;
+        uint8_t *row = pixels + (size_t)y * stride;
+        for (int x = 0; x < header->width; x++) {
+            uint32_t c = IPF_DEFAULT_PALETTE[in[x]];
+            uint8_t r = (uint8_t)(c >> 24), g = (uint8_t)(c >> 16), b = (uint8_t)(c >> 8), a = (uint8_t)c;
+            if (layout == IPF_PIXELS_TSVM) {
+                row[x * 2] = (uint8_t)((r & 0xF0) | (g >> 4));
+                row[x * 2 + 1] = (uint8_t)((b & 0xF0) | (a >> 4));
+            } else if (has_alpha) {
+                uint8_t *p = row + (size_t)x * 4;
+                p[0] = r;
+                p[1] = g;
+                p[2] = b;
+                p[3] = a;
+            } else {
+                uint8_t *p = row + (size_t)x * 3;
+                p[0] = r;
+                p[1] = g;
+                p[2] = b;
+            }
+        }
+    }
+}
+
+void ipf_decode_image(const ipf_header_t *header, const uint8_t *blocks, ipf_layout_t layout,
+                      uint8_t *pixels, size_t stride) {
+    if (header->type == IPF_TYPE_INDEXED) {
+        decode_indexed(header, blocks, layout, pixels, stride);
+        return;
+    }
+
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int channels = ipf_pixel_bytes(has_alpha, layout);
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    int block_size = ipf_block_size(header);
+
+    if (!(header->flags & IPF_FLAG_PROGRESSIVE)) {
+        for (int by = 0; by < blocks_y; by++) {
+            ipf_decode_block_row(header, layout, blocks + (size_t)by * blocks_x * block_size,
+                                 pixels + (size_t)by * 4 * stride, stride);
+        }
+        return;
+    }
+
+    // Walk the passes in stored order; no index table needed
+    for (int pass = 1; pass <= 7; pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (ipf_adam7_pass(bx, by) != pass) continue;
+                ipf_decode_block(header, blocks, layout,
+                                 pixels + (size_t)by * 4 * stride + (size_t)bx * 4 * channels, stride);
+                blocks += block_size;
+            }
+        }
+    }
+}
+
+size_t ipf_planes_span(const ipf_header_t *header, size_t stride) {
+    return ((size_t)ipf_blocks_y(header) * 4 - 1) * stride + (size_t)ipf_blocks_x(header) * 4;
+}
+
+void ipf_decode_planes(const ipf_header_t *header, const uint8_t *blocks,
+                       uint8_t *rg, uint8_t *ba, size_t stride) {
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    int block_size = ipf_block_size(header);
+    int progressive = (header->flags & IPF_FLAG_PROGRESSIVE) != 0;
+    uint16_t idx[16];
+    uint8_t alpha[16];
+
+    ensure_luts();
+
+    for (int pass = progressive ? 1 : 0; pass <= (progressive ? 7 : 0); pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (progressive && ipf_adam7_pass(bx, by) != pass) continue;
+                unpack_block(header, blocks, idx, alpha);
+                blocks += block_size;
+
+                for (int py = 0; py < 4; py++) {
+                    size_t offset = (size_t)(by * 4 + py) * stride + bx * 4;
+                    for (int px = 0; px < 4; px++) {
+                        uint16_t v = lut_tsvm[idx[py * 4 + px]];
+                        rg[offset + px] = (uint8_t)v;
+                        ba[offset + px] = (uint8_t)((v >> 8) | alpha[py * 4 + px]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// =============================================================================
+// Greyscale Decoding
+// =============================================================================
+
+// Y is the brightness the VM shows, so greyscale needs neither chroma nor
+// the LUT: each Y nibble widens to a byte as v * 17. Going by PIXEL_NIBBLE,
+// the four rows of a block are Y field bytes {0,2}, {1,3}, {4,6} and {5,7}.
+
+#if defined(__SSE2__)
+
+static void gray_block(const uint8_t *y, uint8_t *pixels, size_t stride) {
+    const __m128i low = _mm_set1_epi8(0x0F);
+    __m128i v = _mm_loadl_epi64((const __m128i *)y);
+    __m128i lo = _mm_and_si128(v, low);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+    // n * 17 == n << 4 | n; nibbles are below 16 so the 16-bit shift keeps to its byte
+    lo = _mm_or_si128(lo, _mm_slli_epi16(lo, 4));
+    hi = _mm_or_si128(hi, _mm_slli_epi16(hi, 4));
+    // Nibble order, then gather byte pairs (0,2)(1,3)(4,6)(5,7) into rows
+    __m128i n = _mm_unpacklo_epi8(lo, hi);
+    n = _mm_shufflelo_epi16(n, _MM_SHUFFLE(3, 1, 2, 0));
+    n = _mm_shufflehi_epi16(n, _MM_SHUFFLE(3, 1, 2, 0));
+    for (int py = 0; py < 4; py++) {
+        uint32_t row = (uint32_t)_mm_cvtsi128_si32(n);
+        memcpy(pixels + py * stride, &row, 4);
+        n = _mm_srli_si128(n, 4);
+    }
+}
+
+#else
+
+static void gray_block(const uint8_t *y, uint8_t *pixels, size_t stride) {
+    static const uint8_t ROW_BYTES[4][2] = {{0, 2}, {1, 3}, {4, 6}, {5, 7}};
+    for (int py = 0; py < 4; py++) {
+        uint8_t *row = pixels + py * stride;
+        for (int h = 0; h < 2; h++) {
+            uint8_t b = y[ROW_BYTES[py][h]];
+            row[h * 2] = (uint8_t)((b & 0x0F) * 17);
+            row[h * 2 + 1] = (uint8_t)((b >> 4) * 17);
+        }
+    }
+}
+
+#endif
+
+void ipf_decode_gray_row(const ipf_header_t *header, const uint8_t *blocks, uint8_t *band, size_t band_stride) {
+    int blocks_x = ipf_blocks_x(header);
+    int block_size = ipf_block_size(header);
+    const uint8_t *y = blocks + (header->type == IPF_TYPE_1 ? 4 : 8);
+
+    for (int bx = 0; bx < blocks_x; bx++) {
+        gray_block(y + (size_t)bx * block_size, band + (size_t)bx * 4, band_stride);
+    }
+}
+
+void ipf_decode_gray(const ipf_header_t *header, const uint8_t *blocks, uint8_t *pixels, size_t stride) {
+    if (header->type == IPF_TYPE_INDEXED) {
+        // The palette has no Y of its own; take the one encodeIpf would
+        for (int y = 0; y < header->height; y++) {
+            const uint8_t *in = blocks + (size_t)y * header->width;
+            uint8_t *row = pixels + (size_t)y * stride;
+            for (int x = 0; x < header->width; x++) {
+                uint32_t c = IPF_DEFAULT_PALETTE[in[x]];
+                row[x] = (uint8_t)(((c >> 24) + ((c >> 16) & 0xFF) * 2 + ((c >> 8) & 0xFF) + 2) >> 2);
+            }
+        }
+        return;
+    }
+
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    int block_size = ipf_block_size(header);
+
+    if (!(header->flags & IPF_FLAG_PROGRESSIVE)) {
+        for (int by = 0; by < blocks_y; by++) {
+            ipf_decode_gray_row(header, blocks + (size_t)by * blocks_x * block_size,
+                                pixels + (size_t)by * 4 * stride, stride);
+        }
+        return;
+    }
+
+    const uint8_t *y = blocks + (header->type == IPF_TYPE_1 ? 4 : 8);
+    for (int pass = 1; pass <= 7; pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (ipf_adam7_pass(bx, by) != pass) continue;
+                gray_block(y, pixels + (size_t)by * 4 * stride + (size_t)bx * 4, stride);
+                y += block_size;
+            }
+        }
+    }
+}
+
+// =============================================================================
+// Compositing
+// =============================================================================
+
+// Layers are drawn a 4x4 tile at a time: each tile row is built in the
+// canvas's own pixel format next to its alpha (layer opacity folded in),
+// then skipped, copied or blended onto the canvas by what that alpha says
+
+#define TILE_EMPTY  0
+#define TILE_OPAQUE 1
+#define TILE_MIXED  2
+
+typedef struct {
+    uint8_t px[4][16];    // Rows of canvas-format pixels; an RGBA canvas gets alpha 255
+    uint8_t a[4][17];     // Alpha repeated for every byte of its pixel, and a spare byte
+    uint8_t alpha[4][4];  // Alpha per pixel
+} tile_t;
+
+typedef struct {
+    const ipf_canvas_t *canvas;
+    int x;                // Canvas position of the layer's top-left pixel
+    int y;
+    int width;            // Layer size, padding excluded
+    int height;
+    int opacity;
+    uint8_t nibble_alpha[16];  // Alpha nibble to 8-bit alpha with opacity applied
+} composite_ctx_t;
+
+/**
+ * x / 255 rounded to nearest, exact for x up to 255 * 255.
+ */
+static inline int div255(int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/**
+ * Source-over of one straight-alpha pixel onto an RGBA canvas pixel that
+ * is not itself opaque.
+ */
+static void blend_straight(uint8_t *d, const uint8_t *s, int a) {
+    int da = d[3];
+    int keep = div255(da * (255 - a));  // What is left of the canvas alpha
+    int oa = a + keep;
+    if (oa == 0) {
+        memset(d, 0, 4);
+        return;
+    }
+    for (int c = 0; c < 3; c++) d[c] = (uint8_t)((s[c] * a + d[c] * keep + oa / 2) / oa);
+    d[3] = (uint8_t)oa;
+}
+
+/**
+ * d = (s * a + d * (255 - a)) / 255 for the first bytes of a tile row.
+ */
+static void blend_bytes(uint8_t *dst, const uint8_t *src, const uint8_t *a, int bytes) {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    uint8_t d[16] = {0}, sb[16] = {0}, ab[16] = {0};
+    memcpy(d, dst, (size_t)bytes);
+    memcpy(sb, src, (size_t)bytes);
+    memcpy(ab, a, (size_t)bytes);
+    __m128i dv = _mm_loadu_si128((const __m128i *)d);
+    __m128i sv = _mm_loadu_si128((const __m128i *)sb);
+    __m128i av = _mm_loadu_si128((const __m128i *)ab);
+    __m128i out[2];
+    for (int h = 0; h < 2; h++) {
+        __m128i dw = h ? _mm_unpackhi_epi8(dv, zero) : _mm_unpacklo_epi8(dv, zero);
+        __m128i sw = h ? _mm_unpackhi_epi8(sv, zero) : _mm_unpacklo_epi8(sv, zero);
+        __m128i aw = h ? _mm_unpackhi_epi8(av, zero) : _mm_unpacklo_epi8(av, zero);
+        __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sw, aw),
+                                                _mm_mullo_epi16(dw, _mm_sub_epi16(full, aw))), half);
+        out[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+    _mm_storeu_si128((__m128i *)d, _mm_packus_epi16(out[0], out[1]));
+    memcpy(dst, d, (size_t)bytes);
+#else
+    for (int i = 0; i < bytes; i++) dst[i] = (uint8_t)div255(src[i] * a[i] + dst[i] * (255 - a[i]));
+#endif
+}
+
+/**
+ * Put one tile on the canvas with its top-left at layer pixel (tx, ty).
+ */
+static void composite_tile(const composite_ctx_t *ctx, int tx, int ty, const tile_t *tile, int coverage) {
+    const ipf_canvas_t *canvas = ctx->canvas;
+    int cx = ctx->x + tx, cy = ctx->y + ty;
+
+    // Clip to the layer's own size, then to the canvas
+    int x0 = cx < 0 ? -cx : 0;
+    int y0 = cy < 0 ? -cy : 0;
+    int x1 = ctx->width - tx < 4 ? ctx->width - tx : 4;
+    int y1 = ctx->height - ty < 4 ? ctx->height - ty : 4;
+    if (cx + x1 > canvas->width) x1 = canvas->width - cx;
+    if (cy + y1 > canvas->height) y1 = canvas->height - cy;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    int ch = canvas->channels;
+    int n = x1 - x0;
+    for (int py = y0; py < y1; py++) {
+        uint8_t *dst = canvas->pixels + (size_t)(cy + py) * canvas->stride + (size_t)(cx + x0) * ch;
+        const uint8_t *src = tile->px[py] + x0 * ch;
+        if (coverage == TILE_OPAQUE) {
+            memcpy(dst, src, (size_t)n * ch);
+            continue;
+        }
+        // An opaque canvas stays opaque; below that, blend pixel by pixel
+        int dst_opaque = 1;
+        for (int i = 0; ch == 4 && i < n; i++) dst_opaque &= dst[i * 4 + 3] == 255;
+        if (dst_opaque) {
+            blend_bytes(dst, src, tile->a[py] + x0 * ch, n * ch);
+        } else {
+            for (int i = 0; i < n; i++) {
+                int a = tile->alpha[py][x0 + i];
+                if (a) blend_straight(dst + i * 4, src + i * 4, a);
+            }
+        }
+    }
+}
+
+/**
+ * Classify a tile by its per-pixel alpha, filling the byte-wise alpha rows
+ * only when it will be blended.
+ */
+static int tile_coverage(tile_t *tile, int ch) {
+    int opaque = 1, empty = 1;
+    for (int i = 0; i < 16; i++) {
+        int a = tile->alpha[i >> 2][i & 3];
+        opaque &= a == 255;
+        empty &= a == 0;
+    }
+    if (empty) return TILE_EMPTY;
+    if (opaque) return TILE_OPAQUE;
+
+    for (int py = 0; py < 4; py++) {
+        for (int px = 0; px < 4; px++) {
+            uint32_t a = tile->alpha[py][px] * 0x01010101u;
+            memcpy(tile->a[py] + px * ch, &a, 4);  // Rows have room for the spare byte
+        }
+    }
+    return TILE_MIXED;
+}
+
+/**
+ * Decode and draw the block for layer tile (bx, by). Blocks whose alpha
+ * field is all zero are dropped before any colour is decoded.
+ */
+static void composite_block(const composite_ctx_t *ctx, const ipf_header_t *header, const uint8_t *block,
+                            int bx, int by) {
+    int solid = ctx->opacity == 255;
+    if (header->flags & IPF_FLAG_ALPHA) {
+        uint64_t a;
+        memcpy(&a, block + (header->type == IPF_TYPE_1 ? 12 : 16), 8);
+        if (a == 0) return;
+        solid = solid && a == UINT64_MAX;
+    }
+
+    int ch = ctx->canvas->channels;
+    uint16_t idx[16];
+    uint8_t alpha[16];
+    tile_t tile;
+    unpack_block(header, block, idx, alpha);
+    for (int i = 0; i < 16; i++) {
+        uint8_t *p = tile.px[i >> 2] + (i & 3) * ch;
+        memcpy(p, lut_rgb[idx[i]], 3);
+        if (ch == 4) p[3] = 255;
+    }
+
+    int coverage = TILE_OPAQUE;
+    if (!solid) {
+        for (int i = 0; i < 16; i++) tile.alpha[i >> 2][i & 3] = ctx->nibble_alpha[alpha[i]];
+        coverage = tile_coverage(&tile, ch);
+        if (coverage == TILE_EMPTY) return;
+    }
+    composite_tile(ctx, bx * 4, by * 4, &tile, coverage);
+}
+
+static int composite_init(composite_ctx_t *ctx, const ipf_header_t *header, const ipf_canvas_t *canvas,
+                          int x, int y, int opacity) {
+    if (!canvas->pixels || (canvas->channels != 3 && canvas->channels != 4) ||
+        canvas->width < 0 || canvas->height < 0 || opacity < 0 || opacity > 255) {
+        return IPF_ERR_ARG;
+    }
+    ctx->canvas = canvas;
+    ctx->x = x;
+    ctx->y = y;
+    ctx->width = header->width;
+    ctx->height = header->height;
+    ctx->opacity = opacity;
+    for (int n = 0; n < 16; n++) ctx->nibble_alpha[n] = (uint8_t)div255(n * 17 * opacity);
+    ensure_luts();
+    return IPF_OK;
+}
+
+/**
+ * Whether any of block row by can land on the canvas.
+ */
+static int row_visible(const composite_ctx_t *ctx, int by) {
+    int top = ctx->y + by * 4;
+    return ctx->opacity > 0 && top + 4 > 0 && top < ctx->canvas->height &&
+           ctx->x < ctx->canvas->width && ctx->x + ctx->width > 0;
+}
+
+/**
+ * Draw the blocks of one raster row that reach the canvas.
+ */
+static void composite_row(const composite_ctx_t *ctx, const ipf_header_t *header, const uint8_t *blocks, int by) {
+    if (!row_visible(ctx, by)) return;
+
+    int blocks_x = ipf_blocks_x(header);
+    int block_size = ipf_block_size(header);
+    int first = ctx->x < 0 ? -ctx->x / 4 : 0;
+    int last = (ctx->canvas->width - ctx->x + 3) / 4;
+    if (last > blocks_x) last = blocks_x;
+    for (int bx = first; bx < last; bx++) {
+        composite_block(ctx, header, blocks + (size_t)bx * block_size, bx, by);
+    }
+}
+
+/**
+ * Indexed images have no blocks; cut their palette colours into tiles so
+ * they take the same skip and copy paths.
+ */
+static void composite_indexed(const composite_ctx_t *ctx, const ipf_header_t *header, const uint8_t *indices) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int ch = ctx->canvas->channels;
+    tile_t tile;
+
+    for (int by = 0; by < ipf_blocks_y(header); by++) {
+        if (!row_visible(ctx, by)) continue;
+        for (int bx = 0; bx < ipf_blocks_x(header); bx++) {
+            memset(&tile, 0, sizeof(tile));
+            for (int py = 0; py < 4 && by * 4 + py < header->height; py++) {
+                const uint8_t *in = indices + (size_t)(by * 4 + py) * header->width + bx * 4;
+                for (int px = 0; px < 4 && bx * 4 + px < header->width; px++) {
+                    uint32_t c = IPF_DEFAULT_PALETTE[in[px]];
+                    uint8_t *p = tile.px[py] + px * ch;
+                    p[0] = (uint8_t)(c >> 24);
+                    p[1] = (uint8_t)(c >> 16);
+                    p[2] = (uint8_t)(c >> 8);
+                    if (ch == 4) p[3] = 255;
+                    tile.alpha[py][px] = (uint8_t)div255((has_alpha ? (int)(c & 0xFF) : 255) * ctx->opacity);
+                }
+            }
+            int coverage = tile_coverage(&tile, ch);
+            if (coverage != TILE_EMPTY) composite_tile(ctx, bx * 4, by * 4, &tile, coverage);
+        }
+    }
+}
+
+int ipf_composite_block_row(const ipf_header_t *header, const uint8_t *blocks, int by,
+                            const ipf_canvas_t *canvas, int x, int y, int opacity) {
+    if (header->type == IPF_TYPE_INDEXED || (header->flags & IPF_FLAG_PROGRESSIVE)) return IPF_ERR_ARG;
+    composite_ctx_t ctx;
+    int result = composite_init(&ctx, header, canvas, x, y, opacity);
+    if (result == IPF_OK) composite_row(&ctx, header, blocks, by);
+    return result;
+}
+
+int ipf_composite(const ipf_header_t *header, const uint8_t *blocks, const ipf_canvas_t *canvas,
+                  int x, int y, int opacity) {
+    composite_ctx_t ctx;
+    int result = composite_init(&ctx, header, canvas, x, y, opacity);
+    if (result != IPF_OK || opacity == 0) return result;
+
+    if (header->type == IPF_TYPE_INDEXED) {
+        composite_indexed(&ctx, header, blocks);
+        return IPF_OK;
+    }
+
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    int block_size = ipf_block_size(header);
+
+    if (!(header->flags & IPF_FLAG_PROGRESSIVE)) {
+        for (int by = 0; by < blocks_y; by++) {
+            composite_row(&ctx, header, blocks + (size_t)by * blocks_x * block_size, by);
+        }
+        return IPF_OK;
+    }
+
+    for (int pass = 1; pass <= 7; pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (ipf_adam7_pass(bx, by) != pass) continue;
+                if (row_visible(&ctx, by)) composite_block(&ctx, header, blocks, bx, by);
+                blocks += block_size;
+            }
+        }
+    }
+    return IPF_OK;
+}
+
+// =============================================================================
+// Encoding
+// =============================================================================
+
+/**
+ * Port of blockEncodeToYCoCgFourBits. Pixels right of the image are read
+ * from the start of the next row, as the VM does.
+ */
+static void encode_block_to_ycocg(const uint8_t *src, size_t stride, int channels, int has_alpha,
+                                  int pattern, int Ys[16], int As[16], float COs[16], float CGs[16]) {
+    const int *kernel = pattern < 0 ? NULL : BAYER_KERNELS[pattern % 4];
+
+    for (int py = 0; py < 4; py++) {
+        for (int px = 0; px < 4; px++) {
+            float t = kernel ? ((float)kernel[4 * py + px] + 0.5f) / 16.0f : 0.0f;
+            const uint8_t *p = src + py * stride + (size_t)px * channels;
+
+            float r0 = p[0] / 255.0f;
+            float g0 = (channels == 1) ? r0 : p[1] / 255.0f;
+            float b0 = (channels == 1) ? r0 : p[2] / 255.0f;
+            float a0 = has_alpha ? p[channels - 1] / 255.0f : 1.0f;
+
+            float r = gdx_floor((t / 15.0f + r0) * 15.0f) / 15.0f;
+            float g = gdx_floor((t / 15.0f + g0) * 15.0f) / 15.0f;
+            float b = gdx_floor((t / 15.0f + b0) * 15.0f) / 15.0f;
+            float a = gdx_floor((t / 15.0f + a0) * 15.0f) / 15.0f;
+
+            float co = r - b;
+            float tmp = b + co / 2.0f;
+            float cg = g - tmp;
+            float y = tmp + cg / 2.0f;
+
+            int index = py * 4 + px;
+            Ys[index] = gdx_round(y * 15.0f);
+            As[index] = gdx_round(a * 15.0f);
+            COs[index] = co;
+            CGs[index] = cg;
+        }
+    }
+}
+
+static int chroma_to_four_bits(float f) {
+    int v = gdx_round(f * 8.0f) + 7;
+    return v < 0 ? 0 : (v > 15 ? 15 : v);
+}
+
+static void pack_nibbles16(const int *v, uint8_t *out) {
+    out[0] = (uint8_t)((v[1] << 4) | v[0]);
+    out[1] = (uint8_t)((v[5] << 4) | v[4]);
+    out[2] = (uint8_t)((v[3] << 4) | v[2]);
+    out[3] = (uint8_t)((v[7] << 4) | v[6]);
+    out[4] = (uint8_t)((v[9] << 4) | v[8]);
+    out[5] = (uint8_t)((v[13] << 4) | v[12]);
+    out[6] = (uint8_t)((v[11] << 4) | v[10]);
+    out[7] = (uint8_t)((v[15] << 4) | v[14]);
+}
+
+static void encode_block(const ipf_header_t *header, const uint8_t *src, size_t stride, int channels,
+                         int pattern, uint8_t *out) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int Ys[16], As[16];
+    float COs[16], CGs[16];
+
+    encode_block_to_ycocg(src, stride, channels, has_alpha, pattern, Ys, As, COs, CGs);
+
+    if (header->type == IPF_TYPE_1) {
+        // 2x2 averages, summed in the same order as encodeIpf1
+        int co[4], cg[4];
+        static const int quad[4] = {0, 2, 8, 10};
+        for (int q = 0; q < 4; q++) {
+            int i = quad[q];
+            co[q] = chroma_to_four_bits((COs[i] + COs[i + 1] + COs[i + 4] + COs[i + 5]) / 4.0f);
+            cg[q] = chroma_to_four_bits((CGs[i] + CGs[i + 1] + CGs[i + 4] + CGs[i + 5]) / 4.0f);
+        }
+        out[0] = (uint8_t)((co[1] << 4) | co[0]);
+        out[1] = (uint8_t)((co[3] << 4) | co[2]);
+        out[2] = (uint8_t)((cg[1] << 4) | cg[0]);
+        out[3] = (uint8_t)((cg[3] << 4) | cg[2]);
+        out += 4;
+    } else {
+        // Horizontal pair averages
+        int co[8], cg[8];
+        for (int ci = 0; ci < 8; ci++) {
+            co[ci] = chroma_to_four_bits((COs[ci * 2] + COs[ci * 2 + 1]) / 2.0f);
+            cg[ci] = chroma_to_four_bits((CGs[ci * 2] + CGs[ci * 2 + 1]) / 2.0f);
+        }
+        for (int i = 0; i < 4; i++) {
+            out[i] = (uint8_t)((co[i * 2 + 1] << 4) | co[i * 2]);
+            out[4 + i] = (uint8_t)((cg[i * 2 + 1] << 4) | cg[i * 2]);
+        }
+        out += 8;
+    }
+
+    pack_nibbles16(Ys, out);
+    if (has_alpha) pack_nibbles16(As, out + 8);
+}
+
+size_t ipf_encode_src_span(const ipf_header_t *header, size_t stride, int channels) {
+    return ((size_t)ipf_blocks_y(header) * 4 - 1) * stride + (size_t)ipf_blocks_x(header) * 4 * channels;
+}
+
+int ipf_encode_image(const ipf_header_t *header, const uint8_t *src, size_t stride, int channels,
+                     int pattern, uint8_t *blocks) {
+    if (channels != 1 && channels != 3 && channels != 4) return IPF_ERR_ARG;
+    if (header->type != IPF_TYPE_1 && header->type != IPF_TYPE_2) return IPF_ERR_TYPE;
+
+    int blocks_x = ipf_blocks_x(header);
+    int blocks_y = ipf_blocks_y(header);
+    int block_size = ipf_block_size(header);
+    int progressive = (header->flags & IPF_FLAG_PROGRESSIVE) != 0;
+
+    for (int pass = progressive ? 1 : 0; pass <= (progressive ? 7 : 0); pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (progressive && ipf_adam7_pass(bx, by) != pass) continue;
+                encode_block(header, src + (size_t)by * 4 * stride + (size_t)bx * 4 * channels,
+                             stride, channels, pattern, blocks);
+                blocks += block_size;
+            }
+        }
+    }
+    return IPF_OK;
+}
+
+// Nibble each 8-bit value quantises to under each Bayer threshold, plus the
+// undithered case in the last row, with the float steps of
+// encode_block_to_ycocg, so indexed images dither exactly like blocks
+static uint8_t lut_quant[17][256];
+static pthread_once_t quant_once = PTHREAD_ONCE_INIT;
+
+static void build_quant_lut(void) {
+    for (int k = 0; k <= 16; k++) {
+        float t = k < 16 ? ((float)k + 0.5f) / 16.0f : 0.0f;
+        for (int v = 0; v < 256; v++) {
+            int q = gdx_floor((t / 15.0f + v / 255.0f) * 15.0f);
+            lut_quant[k][v] = (uint8_t)(q > 15 ? 15 : q);
+        }
+    }
+}
+
+int ipf_encode_indexed(const ipf_header_t *header, const uint8_t *src, size_t stride, int channels,
+                       int pattern, uint8_t *indices) {
+    if (channels != 1 && channels != 3 && channels != 4) return IPF_ERR_ARG;
+    if (header->type != IPF_TYPE_INDEXED) return IPF_ERR_TYPE;
+
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    const int *kernel = pattern < 0 ? NULL : BAYER_KERNELS[pattern % 4];
+    pthread_once(&quant_once, build_quant_lut);
+
+    // Table lookups all the way: three nibbles, then the palette index
+    for (int y = 0; y < header->height; y++) {
+        const uint8_t *row = src + (size_t)y * stride;
+        uint8_t *out = indices + (size_t)y * header->width;
+        const uint8_t *quant[4];
+        int key[4];  // Alpha at or above this (times 32) is opaque
+        for (int px = 0; px < 4; px++) {
+            int k = kernel ? kernel[4 * (y % 4) + px] : 16;
+            quant[px] = lut_quant[k];
+            key[px] = kernel ? (2 * k + 1) * 255 : 16 * 255;
+        }
+
+        for (int x = 0; x < header->width; x++) {
+            const uint8_t *p = row + (size_t)x * channels;
+            const uint8_t *q = quant[x & 3];
+            if (has_alpha && p[channels - 1] * 32 < key[x & 3]) {
+                out[x] = IPF_INDEX_TRANSPARENT;
+                continue;
+            }
+            int colour = channels == 1 ? q[p[0]] * 0x111 : (q[p[0]] << 8) | (q[p[1]] << 4) | q[p[2]];
+            out[x] = IPF_COLOUR_TO_INDEX[colour];
+        }
+    }
+    return IPF_OK;
+}
+
+// =============================================================================
+// Delta Frames
+// =============================================================================
+
+typedef struct {
+    int block_size;
+    uint8_t weight[32];  // Per block byte: 3 chroma, 2 luma/alpha, 0 not scored
+#if defined(__SSE2__)
+    __m128i scored[2];   // 0xFF where the weight is 2 or 3
+    __m128i triple[2];   // 0xFF where the weight is 3
+#endif
+} score_ctx_t;
+
+static void score_ctx_init(score_ctx_t *ctx, const ipf_header_t *header) {
+    int has_alpha = (header->flags & IPF_FLAG_ALPHA) != 0;
+    int chroma_bytes = header->type == IPF_TYPE_1 ? 4 : 8;
+    int luma_bytes = (header->type == IPF_TYPE_1 && !has_alpha) ? 6 : 8;
+
+    ctx->block_size = ipf_block_size(header);
+    memset(ctx->weight, 0, sizeof(ctx->weight));
+    memset(ctx->weight, 3, chroma_bytes);
+    memset(ctx->weight + chroma_bytes, 2, luma_bytes);
+    if (has_alpha) memset(ctx->weight + chroma_bytes + 8, 2, 8);
+
+#if defined(__SSE2__)
+    for (int c = 0; c < 2; c++) {
+        uint8_t scored[16], triple[16];
+        for (int i = 0; i < 16; i++) {
+            scored[i] = ctx->weight[c * 16 + i] ? 0xFF : 0;
+            triple[i] = ctx->weight[c * 16 + i] == 3 ? 0xFF : 0;
+        }
+        ctx->scored[c] = _mm_loadu_si128((const __m128i *)scored);
+        ctx->triple[c] = _mm_loadu_si128((const __m128i *)triple);
+    }
+#endif
+}
+
+#if defined(__SSE2__)
+
+static __m128i load_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128((int)v);
+}
+
+// Blocks are 12, 16, 20 or 24 bytes; load them as 16 + 8 without reading past the end
+static void load_block(const uint8_t *p, int size, __m128i v[2]) {
+    if (size >= 16) {
+        v[0] = _mm_loadu_si128((const __m128i *)p);
+    } else {
+        v[0] = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p), load_u32(p + 8));
+    }
+    v[1] = size == 24 ? _mm_loadl_epi64((const __m128i *)(p + 16))
+         : size == 20 ? load_u32(p + 16)
+         : _mm_setzero_si128();
+}
+
+// |a - b| * (3 near black or white, else 2) * byte weight, for 16 nibbles
+static __m128i nibble_cost(__m128i a, __m128i b, __m128i scored, __m128i triple) {
+    __m128i d = _mm_sub_epi8(_mm_max_epu8(a, b), _mm_min_epu8(a, b));
+    __m128i sum = _mm_add_epi8(a, b);
+    __m128i contrast = _mm_or_si128(_mm_cmplt_epi8(sum, _mm_set1_epi8(8)),
+                                    _mm_cmpgt_epi8(sum, _mm_set1_epi8(22)));
+    __m128i t = _mm_add_epi8(_mm_add_epi8(d, d), _mm_and_si128(d, contrast));
+    return _mm_add_epi8(_mm_and_si128(_mm_add_epi8(t, t), scored), _mm_and_si128(t, triple));
+}
+
+static int block_score(const score_ctx_t *ctx, const uint8_t *a, const uint8_t *b) {
+    const __m128i low = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i va[2], vb[2];
+    __m128i total = zero;
+
+    load_block(a, ctx->block_size, va);
+    load_block(b, ctx->block_size, vb);
+
+    for (int c = 0; c < 2; c++) {
+        __m128i lo = nibble_cost(_mm_and_si128(va[c], low), _mm_and_si128(vb[c], low),
+                                 ctx->scored[c], ctx->triple[c]);
+        __m128i hi = nibble_cost(_mm_and_si128(_mm_srli_epi16(va[c], 4), low),
+                                 _mm_and_si128(_mm_srli_epi16(vb[c], 4), low),
+                                 ctx->scored[c], ctx->triple[c]);
+        // Byte sums go through SAD so the per-nibble costs (up to 135) never overflow
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_sad_epu8(lo, zero), _mm_sad_epu8(hi, zero)));
+    }
+    return _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+}
+
+#else
+
+static int nibble_cost(int a, int b) {
+    int d = a > b ? a - b : b - a;
+    int sum = a + b;
+    return d * ((sum < 8 || sum > 22) ? 3 : 2);
+}
+
+static int block_score(const score_ctx_t *ctx, const uint8_t *a, const uint8_t *b) {
+    int score = 0;
+    for (int i = 0; i < ctx->block_size; i++) {
+        if (!ctx->weight[i] || a[i] == b[i]) continue;
+        score += ctx->weight[i] * (nibble_cost(a[i] & 15, b[i] & 15) + nibble_cost(a[i] >> 4, b[i] >> 4));
+    }
+    return score;
+}
+
+#endif
+
+int ipf_block_score(const ipf_header_t *header, const uint8_t *a, const uint8_t *b) {
+    score_ctx_t ctx;
+    score_ctx_init(&ctx, header);
+    return block_score(&ctx, a, b);
+}
+
+size_t ipf_delta_diff(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                      uint8_t *changed) {
+    score_ctx_t ctx;
+    score_ctx_init(&ctx, header);
+    size_t blocks = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+    size_t count = 0;
+
+    for (size_t i = 0; i < blocks; i++) {
+        size_t offset = i * ctx.block_size;
+        changed[i] = block_score(&ctx, previous + offset, current + offset) > IPF_DELTA_THRESHOLD
+                   ? IPF_BLOCK_PATCH : IPF_BLOCK_SKIP;
+        count += changed[i];
+    }
+    return count;
+}
+
+size_t ipf_delta_scores(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                        int *scores) {
+    score_ctx_t ctx;
+    score_ctx_init(&ctx, header);
+    size_t blocks = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+    size_t count = 0;
+
+    for (size_t i = 0; i < blocks; i++) {
+        size_t offset = i * ctx.block_size;
+        scores[i] = block_score(&ctx, previous + offset, current + offset);
+        count += scores[i] > IPF_DELTA_THRESHOLD;
+    }
+    return count;
+}
+
+// =============================================================================
+// Motion Search
+// =============================================================================
+
+typedef struct {
+    score_ctx_t score;
+    const uint8_t *previous;
+    const uint8_t *current;
+    int blocks_x, blocks_y;
+    int full_x, full_y;  // Blocks that lie wholly inside the picture
+    int range;
+} motion_ctx_t;
+
+// Score of block (bx, by) when copied from v away, or INT_MAX if that source can't be used
+static int move_score(const motion_ctx_t *m, int bx, int by, ipf_vector_t v) {
+    int sx = bx + v.dx, sy = by + v.dy;
+    if ((v.dx == 0 && v.dy == 0) || v.dx < -m->range || v.dx > m->range || v.dy < -m->range || v.dy > m->range ||
+        sx < 0 || sy < 0 || sx >= m->full_x || sy >= m->full_y) {
+        return INT_MAX;
+    }
+    size_t bs = m->score.block_size;
+    return block_score(&m->score, m->previous + ((size_t)sy * m->blocks_x + sx) * bs,
+                       m->current + ((size_t)by * m->blocks_x + bx) * bs);
+}
+
+/**
+ * One vector for the whole frame: the one that explains a sample of the
+ * changed blocks best, searched exhaustively within the range.
+ */
+static ipf_vector_t estimate_global(const motion_ctx_t *m, const uint8_t *changed, size_t count, ipf_vector_t hint) {
+    enum { SAMPLES = 64 };
+    int sample[SAMPLES], n = 0;
+    size_t blocks = (size_t)m->blocks_x * m->blocks_y;
+    size_t step = count > SAMPLES ? count / SAMPLES : 1;
+    size_t seen = 0;
+
+    for (size_t i = 0; i < blocks && n < SAMPLES; i++) {
+        if (changed[i] && seen++ % step == 0) sample[n++] = (int)i;
+    }
+
+    ipf_vector_t best = hint;
+    long best_cost = LONG_MAX;
+    if (n < 4) return best;
+
+    for (int dy = -m->range; dy <= m->range; dy++) {
+        for (int dx = -m->range; dx <= m->range; dx++) {
+            ipf_vector_t v = { (int8_t)dx, (int8_t)dy };
+            long cost = 0;
+            for (int k = 0; k < n && cost < best_cost; k++) {
+                int score = move_score(m, sample[k] % m->blocks_x, sample[k] / m->blocks_x, v);
+                cost += score < 4 * IPF_DELTA_THRESHOLD ? score : 4 * IPF_DELTA_THRESHOLD;
+            }
+            if (cost < best_cost || (cost == best_cost && dx == hint.dx && dy == hint.dy)) {
+                best_cost = cost;
+                best = v;
+            }
+        }
+    }
+    return best;
+}
+
+static void try_vector(const motion_ctx_t *m, int bx, int by, ipf_vector_t v, ipf_vector_t *best, int *best_score) {
+    int score = move_score(m, bx, by, v);
+    if (score < *best_score) {
+        *best_score = score;
+        *best = v;
+    }
+}
+
+/**
+ * Best source for one block: the predictors first, then a large and a small
+ * diamond search around the best of them.
+ */
+static int search_block(const motion_ctx_t *m, int bx, int by, const ipf_vector_t *predictors, int predictor_count,
+                        ipf_vector_t *best) {
+    static const int8_t LARGE[8][2] = { {0,-2}, {1,-1}, {2,0}, {1,1}, {0,2}, {-1,1}, {-2,0}, {-1,-1} };
+    static const int8_t SMALL[4][2] = { {0,-1}, {1,0}, {0,1}, {-1,0} };
+    int best_score = INT_MAX;
+
+    for (int k = 0; k < predictor_count; k++) {
+        try_vector(m, bx, by, predictors[k], best, &best_score);
+        // Keeping a neighbour's vector lets the run continue
+        if (best_score <= IPF_DELTA_THRESHOLD) return best_score;
+    }
+    if (best_score == INT_MAX) {
+        best->dx = best->dy = 0;
+        try_vector(m, bx, by, (ipf_vector_t){ 1, 0 }, best, &best_score);
+        try_vector(m, bx, by, (ipf_vector_t){ -1, 0 }, best, &best_score);
+        try_vector(m, bx, by, (ipf_vector_t){ 0, 1 }, best, &best_score);
+        try_vector(m, bx, by, (ipf_vector_t){ 0, -1 }, best, &best_score);
+        if (best_score == INT_MAX) return best_score;
+    }
+
+    for (int iteration = 0; iteration < 2 * m->range; iteration++) {
+        ipf_vector_t centre = *best;
+        for (int k = 0; k < 8; k++) {
+            try_vector(m, bx, by, (ipf_vector_t){ (int8_t)(centre.dx + LARGE[k][0]), (int8_t)(centre.dy + LARGE[k][1]) },
+                       best, &best_score);
+        }
+        if (best->dx == centre.dx && best->dy == centre.dy) break;
+    }
+    ipf_vector_t centre = *best;
+    for (int k = 0; k < 4; k++) {
+        try_vector(m, bx, by, (ipf_vector_t){ (int8_t)(centre.dx + SMALL[k][0]), (int8_t)(centre.dy + SMALL[k][1]) },
+                   best, &best_score);
+    }
+    return best_score;
+}
+
+size_t ipf_motion_search(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                         uint8_t *changed, ipf_vector_t *vectors, int range, ipf_vector_t *global) {
+    motion_ctx_t m;
+    score_ctx_init(&m.score, header);
+    m.previous = previous;
+    m.current = current;
+    m.blocks_x = ipf_blocks_x(header);
+    m.blocks_y = ipf_blocks_y(header);
+    m.full_x = header->width / 4;
+    m.full_y = header->height / 4;
+    m.range = range < 1 ? 1 : range > IPF_MOTION_RANGE_MAX ? IPF_MOTION_RANGE_MAX : range;
+
+    size_t blocks = (size_t)m.blocks_x * m.blocks_y;
+    size_t count = 0;
+    for (size_t i = 0; i < blocks; i++) count += changed[i] != IPF_BLOCK_SKIP;
+
+    ipf_vector_t hint = global ? *global : (ipf_vector_t){ 0, 0 };
+    ipf_vector_t g = estimate_global(&m, changed, count, hint);
+    if (global) *global = g;
+
+    size_t moved = 0;
+    for (int by = 0; by < m.blocks_y; by++) {
+        for (int bx = 0; bx < m.blocks_x; bx++) {
+            size_t i = (size_t)by * m.blocks_x + bx;
+            if (changed[i] != IPF_BLOCK_PATCH) continue;
+
+            ipf_vector_t predictors[3];
+            int n = 0;
+            if (bx > 0 && changed[i - 1] == IPF_BLOCK_MOVE) predictors[n++] = vectors[i - 1];
+            predictors[n++] = g;
+            if (by > 0 && changed[i - m.blocks_x] == IPF_BLOCK_MOVE) predictors[n++] = vectors[i - m.blocks_x];
+
+            ipf_vector_t best;
+            if (search_block(&m, bx, by, predictors, n, &best) <= IPF_DELTA_THRESHOLD) {
+                changed[i] = IPF_BLOCK_MOVE;
+                vectors[i] = best;
+                moved++;
+            }
+        }
+    }
+    return moved;
+}
+
+// =============================================================================
+// Delta Streams
+// =============================================================================
+
+size_t ipf_delta_bound(const ipf_header_t *header) {
+    // Worst case alternates one skipped and one patched block; a MOVE is never longer than a PATCH
+    size_t blocks = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+    return blocks * (ipf_block_size(header) + 2) + 16;
+}
+
+static uint8_t *write_varint(uint8_t *out, uint32_t value) {
+    do {
+        uint8_t part = value & 0x7F;
+        value >>= 7;
+        *out++ = value ? (part | 0x80) : part;
+    } while (value);
+    return out;
+}
+
+/**
+ * Shared body of ipf_delta_write and ipf_delta_encode; blocks are scored on
+ * the fly when there is no change map. Runs always alternate, so every run
+ * gets its opcode, and trailing unchanged blocks get no SKIP, like
+ * encodeIpf1d.
+ */
+static size_t delta_write(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                          const uint8_t *changed, const ipf_vector_t *vectors, uint8_t *out) {
+    score_ctx_t ctx;
+    score_ctx_init(&ctx, header);
+    size_t blocks = (size_t)ipf_blocks_x(header) * ipf_blocks_y(header);
+    size_t bs = ctx.block_size;
+    uint8_t *start = out;
+
+#define BLOCK_CLASS(i) (changed ? changed[i] \
+                                : block_score(&ctx, previous + (i) * bs, current + (i) * bs) > IPF_DELTA_THRESHOLD)
+#define SAME_VECTOR(a, b) (vectors[a].dx == vectors[b].dx && vectors[a].dy == vectors[b].dy)
+
+    size_t i = 0;
+    int next = blocks > 0 ? BLOCK_CLASS(0) : IPF_BLOCK_SKIP;
+    while (i < blocks) {
+        int cls = next;
+        size_t first = i, count = 0;
+        do {
+            count++;
+            next = ++i < blocks ? BLOCK_CLASS(i) : -1;
+        } while (next == cls && (cls != IPF_BLOCK_MOVE || SAME_VECTOR(first, i)));
+
+        switch (cls) {
+            case IPF_BLOCK_SKIP:
+                if (i < blocks) {
+                    *out++ = IPF_DELTA_SKIP;
+                    out = write_varint(out, (uint32_t)count);
+                }
+                break;
+            case IPF_BLOCK_MOVE:
+                *out++ = IPF_DELTA_MOVE;
+                out = write_varint(out, (uint32_t)count);
+                *out++ = (uint8_t)vectors[first].dx;
+                *out++ = (uint8_t)vectors[first].dy;
+                break;
+            default:
+                *out++ = IPF_DELTA_PATCH;
+                out = write_varint(out, (uint32_t)count);
+                memcpy(out, current + first * bs, count * bs);
+                out += count * bs;
+                break;
+        }
+    }
+
+#undef SAME_VECTOR
+#undef BLOCK_CLASS
+
+    *out++ = IPF_DELTA_END;
+    return (size_t)(out - start);
+}
+
+size_t ipf_delta_write(const ipf_header_t *header, const uint8_t *current, const uint8_t *changed,
+                       const ipf_vector_t *vectors, uint8_t *out) {
+    return delta_write(header, NULL, current, changed, vectors, out);
+}
+
+size_t ipf_delta_encode(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                        uint8_t *out) {
+    return delta_write(header, previous, current, NULL, NULL, out);
+}
+
+static int read_varint(const uint8_t **p, const uint8_t *end, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*p >= end) return IPF_ERR_DELTA;
+        uint8_t byte = *(*p)++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return IPF_OK;
+    }
+    return IPF_ERR_DELTA;
+}
+
+typedef struct {
+    void (*patch)(const ipf_header_t *, const uint8_t *block, size_t index, void *user);
+    void (*move)(const ipf_header_t *, size_t index, size_t source, void *user);
+    void *user;
+} delta_target_t;
+
+/**
+ * Walk a delta stream, handing every patched or moved block to the target,
+ * or only check it when target is NULL. *moves counts the moved blocks.
+ */
+static int delta_walk(const ipf_header_t *header, const uint8_t *delta, size_t len,
+                      const delta_target_t *target, size_t *moves) {
+    const uint8_t *p = delta, *end = delta + len;
+    int blocks_x = ipf_blocks_x(header), blocks_y = ipf_blocks_y(header);
+    size_t blocks = (size_t)blocks_x * blocks_y;
+    size_t bs = ipf_block_size(header);
+    size_t index = 0;
+
+    // MOVE needs a block grid to find its source in
+    if (header->width == 0 || header->height == 0) return IPF_ERR_ARG;
+    if (moves) *moves = 0;
+    while (p < end) {
+        uint8_t opcode = *p++;
+        uint32_t count;
+
+        if (opcode == IPF_DELTA_END) return IPF_OK;
+        if (read_varint(&p, end, &count) < 0) return IPF_ERR_DELTA;
+
+        switch (opcode) {
+            case IPF_DELTA_SKIP:
+            case IPF_DELTA_REPEAT:
+                index += count;
+                break;
+            case IPF_DELTA_PATCH:
+                if (count > blocks - (index < blocks ? index : blocks) || (size_t)(end - p) / bs < count) {
+                    return IPF_ERR_DELTA;
+                }
+                for (uint32_t k = 0; k < count; k++, index++, p += bs) {
+                    if (target) target->patch(header, p, index, target->user);
+                }
+                break;
+            case IPF_DELTA_MOVE: {
+                if (count > blocks - (index < blocks ? index : blocks) || end - p < 2) return IPF_ERR_DELTA;
+                int dx = (int8_t)p[0], dy = (int8_t)p[1];
+                p += 2;
+                for (uint32_t k = 0; k < count; k++, index++) {
+                    int sx = (int)(index % blocks_x) + dx, sy = (int)(index / blocks_x) + dy;
+                    if (sx < 0 || sy < 0 || sx >= blocks_x || sy >= blocks_y) return IPF_ERR_DELTA;
+                    if (target) target->move(header, index, (size_t)sy * blocks_x + sx, target->user);
+                }
+                if (moves) *moves += count;
+                break;
+            }
+            default:
+                return IPF_ERR_DELTA;
+        }
+    }
+    return IPF_ERR_DELTA;  // No END
+}
+
+typedef struct {
+    uint8_t *blocks;
+    const uint8_t *previous;  // Copy of the blocks before the stream, for MOVE
+} blocks_target_t;
+
+static void patch_blocks(const ipf_header_t *header, const uint8_t *block, size_t index, void *user) {
+    size_t bs = ipf_block_size(header);
+    memcpy(((blocks_target_t *)user)->blocks + index * bs, block, bs);
+}
+
+static void move_blocks(const ipf_header_t *header, size_t index, size_t source, void *user) {
+    const blocks_target_t *t = user;
+    size_t bs = ipf_block_size(header);
+    memcpy(t->blocks + index * bs, t->previous + source * bs, bs);
+}
+
+int ipf_delta_apply(const ipf_header_t *header, const uint8_t *delta, size_t len, uint8_t *blocks) {
+    size_t moves;
+    int err = delta_walk(header, delta, len, NULL, &moves);
+    if (err < 0) return err;
+
+    // MOVE reads the previous frame, which the stream overwrites as it goes
+    uint8_t *previous = NULL;
+    if (moves > 0) {
+        previous = malloc(ipf_blocks_size(header));
+        if (!previous) return IPF_ERR_NOMEM;
+        memcpy(previous, blocks, ipf_blocks_size(header));
+    }
+
+    blocks_target_t t = { blocks, previous };
+    delta_target_t target = { patch_blocks, move_blocks, &t };
+    err = delta_walk(header, delta, len, &target, NULL);
+    free(previous);
+    return err;
+}
+
+typedef struct {
+    uint8_t *rg;
+    uint8_t *ba;
+    const uint8_t *prev_rg;
+    const uint8_t *prev_ba;
+    size_t stride;
+} planes_target_t;
+
+static void patch_planes(const ipf_header_t *header, const uint8_t *block, size_t index, void *user) {
+    const planes_target_t *t = user;
+    int blocks_x = ipf_blocks_x(header);
+    int bx = (int)(index % blocks_x), by = (int)(index / blocks_x);
+    int w = header->width - bx * 4, h = header->height - by * 4;
+    uint16_t idx[16];
+    uint8_t alpha[16];
+
+    unpack_block(header, block, idx, alpha);
+    for (int py = 0; py < 4 && py < h; py++) {
+        size_t offset = (size_t)(by * 4 + py) * t->stride + bx * 4;
+        for (int px = 0; px < 4 && px < w; px++) {
+            uint16_t v = lut_tsvm[idx[py * 4 + px]];
+            t->rg[offset + px] = (uint8_t)v;
+            t->ba[offset + px] = (uint8_t)((v >> 8) | alpha[py * 4 + px]);
+        }
+    }
+}
+
+static void move_planes(const ipf_header_t *header, size_t index, size_t source, void *user) {
+    const planes_target_t *t = user;
+    int blocks_x = ipf_blocks_x(header);
+    int bx = (int)(index % blocks_x), by = (int)(index / blocks_x);
+    int sx = (int)(source % blocks_x), sy = (int)(source / blocks_x);
+    // Only pixels that are inside the picture at both ends
+    int w = header->width - (bx > sx ? bx : sx) * 4, h = header->height - (by > sy ? by : sy) * 4;
+    if (w > 4) w = 4;
+    if (h > 4) h = 4;
+
+    for (int py = 0; py < h; py++) {
+        size_t to = (size_t)(by * 4 + py) * t->stride + bx * 4;
+        size_t from = (size_t)(sy * 4 + py) * t->stride + sx * 4;
+        memcpy(t->rg + to, t->prev_rg + from, w);
+        memcpy(t->ba + to, t->prev_ba + from, w);
+    }
+}
+
+int ipf_delta_apply_planes(const ipf_header_t *header, const uint8_t *delta, size_t len,
+                           uint8_t *rg, uint8_t *ba, size_t stride) {
+    if (header->width == 0 || header->height == 0) return IPF_ERR_ARG;
+
+    size_t moves;
+    int err = delta_walk(header, delta, len, NULL, &moves);
+    if (err < 0) return err;
+
+    uint8_t *previous = NULL;
+    size_t span = (size_t)(header->height - 1) * stride + header->width;
+    if (moves > 0) {
+        previous = malloc(span * 2);
+        if (!previous) return IPF_ERR_NOMEM;
+        memcpy(previous, rg, span);
+        memcpy(previous + span, ba, span);
+    }
+
+    planes_target_t t = { rg, ba, previous, previous ? previous + span : NULL, stride };
+    delta_target_t target = { patch_planes, move_planes, &t };
+    ensure_luts();
+    err = delta_walk(header, delta, len, &target, NULL);
+    free(previous);
+    return err;
+}
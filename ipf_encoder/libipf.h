@@ -0,0 +1,320 @@
+/**
+ * libipf - TSVM Interchangeable Picture Format block codec
+ *
+ * Buffer-in/buffer-out encoding and decoding of iPF1/iPF2 block data, shared
+ * by the command-line tools and the VM's native bridge (ipf_jni.c). Nothing
+ * here touches files or compression; callers hand over the uncompressed
+ * block stream that follows the 28-byte header.
+ *
+ * Decoding reproduces GraphicsJSR223Delegate.decodeIpf1/decodeIpf2 bit for
+ * bit, and ipf_encode_image reproduces encodeIpf1/encodeIpf2, so the VM
+ * gives the same pixels with or without the native library. The delta
+ * functions do the same for encodeIpf1d/applyIpf1d, and extend the stream
+ * to iPF2 and alpha blocks.
+ *
+ * Indexed images (IPF_TYPE_INDEXED) are not made of blocks: the payload is
+ * one default-palette index per pixel, row after row, which the VM copies
+ * straight into the framebuffer in 256-colour mode. Only the header,
+ * ipf_blocks_size, ipf_decode_image and ipf_encode_indexed take them.
+ */
+
+#ifndef LIBIPF_H
+#define LIBIPF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IPF_MAGIC "\x1F\x54\x53\x56\x4D\x69\x50\x46"  // "\x1FTSVMiPF"
+#define IPF_HEADER_SIZE 28  // 8 magic + 2 width + 2 height + 1 flags + 1 type + 10 reserved + 4 uncompressed
+
+#define IPF_TYPE_1 0  // 4:2:0 chroma subsampling (12 bytes per block, +8 with alpha)
+#define IPF_TYPE_2 1  // 4:2:2 chroma subsampling (16 bytes per block, +8 with alpha)
+#define IPF_TYPE_INDEXED 2  // Default-palette indices, one byte per pixel in rows
+
+#define IPF_INDEX_TRANSPARENT 255  // Palette entry the alpha key maps to
+
+#define IPF_FLAG_ALPHA       0x01
+#define IPF_FLAG_ZSTD        0x10
+#define IPF_FLAG_PROGRESSIVE 0x80  // Blocks stored in Adam7 pass order
+
+// Return codes
+#define IPF_OK          0
+#define IPF_ERR_SHORT  -1  // Buffer too short for a header
+#define IPF_ERR_MAGIC  -2  // Not an iPF file
+#define IPF_ERR_TYPE   -3  // Unknown iPF type
+#define IPF_ERR_ARG    -4  // Bad dimensions, channel count or layout
+#define IPF_ERR_DELTA  -5  // Truncated or corrupt delta stream
+#define IPF_ERR_NOMEM  -6
+
+// Delta frame opcodes (terranmon.txt, iPF-delta)
+#define IPF_DELTA_SKIP   0x00  // varint count: blocks unchanged
+#define IPF_DELTA_PATCH  0x01  // varint count, then count literal blocks
+#define IPF_DELTA_REPEAT 0x02  // varint count: blocks left as they are; never emitted
+#define IPF_DELTA_MOVE   0x03  // varint count, int8 dx, int8 dy: blocks copied from the previous frame
+#define IPF_DELTA_END    0xFF
+
+// A block is patched when ipf_block_score exceeds this: twice the 4.0 of
+// the VM's isSignificantlyDifferent, as scores are kept in integers
+#define IPF_DELTA_THRESHOLD 8
+
+// What happens to each block, in the change maps the delta functions share
+#define IPF_BLOCK_SKIP  0
+#define IPF_BLOCK_PATCH 1
+#define IPF_BLOCK_MOVE  2
+
+#define IPF_MOTION_RANGE_MAX 127
+
+// Motion vector in blocks, pointing at the source in the previous frame
+typedef struct {
+    int8_t dx;
+    int8_t dy;
+} ipf_vector_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t flags;
+    uint8_t type;
+    uint32_t uncompressed_size;
+} ipf_header_t;
+
+typedef enum {
+    IPF_PIXELS_RGB = 0,  // RGB24, or RGBA when the image has alpha
+    IPF_PIXELS_TSVM      // Adapter nibble pairs (R<<4|G, B<<4|A), as GraphicsJSR223Delegate writes them
+} ipf_layout_t;
+
+const char *ipf_strerror(int err);
+
+/**
+ * Parse a 28-byte header from memory. Fields are little-endian on disk.
+ */
+int ipf_parse_header(const uint8_t *buf, size_t len, ipf_header_t *header);
+
+/**
+ * Serialise a header into IPF_HEADER_SIZE bytes.
+ */
+void ipf_write_header(const ipf_header_t *header, uint8_t *buf);
+
+int ipf_blocks_x(const ipf_header_t *header);
+int ipf_blocks_y(const ipf_header_t *header);
+
+/**
+ * Bytes per 4x4 block for the header's type and alpha flag.
+ */
+int ipf_block_size(const ipf_header_t *header);
+
+/**
+ * Size of the uncompressed block stream, or of the indices of an indexed
+ * image.
+ */
+size_t ipf_blocks_size(const ipf_header_t *header);
+
+int ipf_pixel_bytes(int has_alpha, ipf_layout_t layout);
+
+/**
+ * Adam7 pass (1..7) of the block at (bx, by), from its top-left pixel.
+ */
+int ipf_adam7_pass(int bx, int by);
+
+/**
+ * Fill order[i] with the raster index of the i-th block stored in a
+ * progressive file. order must hold blocks_x * blocks_y entries.
+ */
+void ipf_adam7_order(int blocks_x, int blocks_y, uint32_t *order);
+
+/**
+ * Decode one block into 4 rows of pixels, stride bytes apart.
+ */
+void ipf_decode_block(const ipf_header_t *header, const uint8_t *block, ipf_layout_t layout,
+                      uint8_t *pixels, size_t stride);
+
+/**
+ * Decode one row of raster-ordered blocks into a 4-scanline band.
+ */
+void ipf_decode_block_row(const ipf_header_t *header, ipf_layout_t layout, const uint8_t *blocks,
+                          uint8_t *band, size_t band_stride);
+
+/**
+ * Decode one row of raster-ordered blocks to RGB24 or RGBA, every pixel
+ * repeated scale times across and down: a band of 4 * scale scanlines of
+ * ipf_blocks_x * 4 * scale pixels.
+ */
+void ipf_decode_block_row_upscaled(const ipf_header_t *header, const uint8_t *blocks, int scale,
+                                   uint8_t *band, size_t band_stride);
+
+/**
+ * Unpack one row of raster-ordered blocks into per-pixel Y, Co, Cg and
+ * alpha nibbles (planes[0..3], 4 rows each, stride bytes apart), chroma
+ * repeated over the pixels that share it. Alpha is 15 without
+ * IPF_FLAG_ALPHA.
+ */
+void ipf_unpack_block_row(const ipf_header_t *header, const uint8_t *blocks, uint8_t *const planes[4],
+                          size_t stride);
+
+/**
+ * The VM's YCoCg to RGB conversion for nibble values (0..15), which may
+ * lie between the integers, e.g. after interpolation; at integers it gives
+ * the same bytes as ipf_decode_block.
+ */
+void ipf_ycocg_to_rgb(float y, float co, float cg, uint8_t *rgb);
+
+/**
+ * Decode a whole block stream, in raster or progressive order as the header
+ * says. pixels must hold ipf_blocks_y * 4 rows of at least
+ * ipf_blocks_x * 4 pixels; padding right of and below the image is written.
+ * Indexed images come out in the default palette's colours (with its alpha
+ * when the header has IPF_FLAG_ALPHA), and only width x height is written.
+ */
+void ipf_decode_image(const ipf_header_t *header, const uint8_t *blocks, ipf_layout_t layout,
+                      uint8_t *pixels, size_t stride);
+
+/**
+ * Decode into separate RG and BA planes, exactly as decodeIpf1/decodeIpf2
+ * poke them into the framebuffers. Every pixel of every block is written,
+ * so each plane needs ipf_planes_span(header, stride) bytes.
+ */
+void ipf_decode_planes(const ipf_header_t *header, const uint8_t *blocks,
+                       uint8_t *rg, uint8_t *ba, size_t stride);
+
+size_t ipf_planes_span(const ipf_header_t *header, size_t stride);
+
+/**
+ * Decode brightness only: each pixel's Y nibble widened to an 8-bit grey,
+ * with chroma and alpha never read. Same buffer rules as ipf_decode_image
+ * at one byte per pixel; indexed images give the Y of their palette colour.
+ */
+void ipf_decode_gray(const ipf_header_t *header, const uint8_t *blocks, uint8_t *pixels, size_t stride);
+
+/**
+ * Greyscale counterpart of ipf_decode_block_row.
+ */
+void ipf_decode_gray_row(const ipf_header_t *header, const uint8_t *blocks, uint8_t *band, size_t band_stride);
+
+// A caller's pixel buffer that layers are composited onto
+typedef struct {
+    uint8_t *pixels;     // RGB24, or RGBA with straight (not premultiplied) alpha
+    int width;
+    int height;
+    int channels;        // 3 or 4
+    size_t stride;
+} ipf_canvas_t;
+
+/**
+ * Draw an image onto a canvas with source-over blending, its top-left
+ * pixel at (x, y) and its alpha scaled by opacity (0..255). Parts outside
+ * the canvas are clipped; blocks that end up fully transparent are not
+ * decoded, and fully opaque ones are copied. Takes any type and order.
+ */
+int ipf_composite(const ipf_header_t *header, const uint8_t *blocks, const ipf_canvas_t *canvas,
+                  int x, int y, int opacity);
+
+/**
+ * Composite block row by alone, for raster-ordered blocks read a row at a
+ * time; blocks points at that row's first block.
+ */
+int ipf_composite_block_row(const ipf_header_t *header, const uint8_t *blocks, int by,
+                            const ipf_canvas_t *canvas, int x, int y, int opacity);
+
+/**
+ * Encode pixels to a block stream the way encodeIpf1/encodeIpf2 do: a 4x4
+ * ordered dither picked by pattern (negative for none), libGDX rounding and
+ * the VM's chroma averaging. channels is 1 (grey), 3 or 4; the last channel
+ * is alpha when the header has IPF_FLAG_ALPHA. Blocks are written in
+ * progressive order if the header says so.
+ *
+ * Edge blocks read whole 4x4 areas just as the VM does, so src must hold
+ * ipf_encode_src_span(header, stride, channels) bytes.
+ */
+int ipf_encode_image(const ipf_header_t *header, const uint8_t *src, size_t stride, int channels,
+                     int pattern, uint8_t *blocks);
+
+size_t ipf_encode_src_span(const ipf_header_t *header, size_t stride, int channels);
+
+/**
+ * Quantise pixels to 4-4-4 with the same ordered dither as ipf_encode_image
+ * and map them through assets/4096_colours_to_tsvm_palette.data, writing
+ * width * height palette indices. With IPF_FLAG_ALPHA, pixels whose alpha
+ * falls under the dither threshold (half, undithered) become
+ * IPF_INDEX_TRANSPARENT. src holds height rows of width pixels.
+ */
+int ipf_encode_indexed(const ipf_header_t *header, const uint8_t *src, size_t stride, int channels,
+                       int pattern, uint8_t *indices);
+
+/**
+ * Perceptual difference between two blocks, twice the score of the VM's
+ * isSignificantlyDifferent: per nibble |a - b| weighted 3 for chroma and 2
+ * for luma and alpha, half as much again near black or white. iPF1 blocks
+ * without alpha leave out their last two luma bytes, as the VM does.
+ * Vectorised with SSE2 where available.
+ */
+int ipf_block_score(const ipf_header_t *header, const uint8_t *a, const uint8_t *b);
+
+/**
+ * Mark changed[i] IPF_BLOCK_PATCH for every block scoring above
+ * IPF_DELTA_THRESHOLD, IPF_BLOCK_SKIP otherwise. Returns the number of
+ * changed blocks.
+ */
+size_t ipf_delta_diff(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                      uint8_t *changed);
+
+/**
+ * ipf_block_score of every block against the previous frame, for encoders
+ * that pick their own patches. Returns how many exceed IPF_DELTA_THRESHOLD.
+ */
+size_t ipf_delta_scores(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                        int *scores);
+
+/**
+ * Look for the IPF_BLOCK_PATCH blocks of changed somewhere else in the
+ * previous frame, at most range blocks away, and turn the ones found within
+ * IPF_DELTA_THRESHOLD into IPF_BLOCK_MOVE with their vectors[i]. Each frame
+ * gets a global motion estimate first; pass the last one in *global (or
+ * NULL) and it is updated. Sources are only taken from blocks wholly
+ * inside the picture. Returns the number of moved blocks.
+ */
+size_t ipf_motion_search(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                         uint8_t *changed, ipf_vector_t *vectors, int range, ipf_vector_t *global);
+
+/**
+ * Largest delta stream a frame can produce.
+ */
+size_t ipf_delta_bound(const ipf_header_t *header);
+
+/**
+ * Write the delta stream for a change map, taking patches from current.
+ * vectors is only read for IPF_BLOCK_MOVE blocks and may be NULL without
+ * them. Returns the stream length.
+ */
+size_t ipf_delta_write(const ipf_header_t *header, const uint8_t *current, const uint8_t *changed,
+                       const ipf_vector_t *vectors, uint8_t *out);
+
+/**
+ * Diff two raster block streams and write the delta stream, byte for byte
+ * what encodeIpf1d writes for iPF1. out needs ipf_delta_bound bytes.
+ */
+size_t ipf_delta_encode(const ipf_header_t *header, const uint8_t *previous, const uint8_t *current,
+                        uint8_t *out);
+
+/**
+ * Patch a raster block stream in place. The stream is checked before
+ * anything is written, and MOVE sources are read from a copy of the
+ * blocks as they were.
+ */
+int ipf_delta_apply(const ipf_header_t *header, const uint8_t *delta, size_t len, uint8_t *blocks);
+
+/**
+ * Decode the patched blocks straight into the RG and BA planes, as
+ * applyIpf1d does; pixels past the image's width and height are left alone.
+ */
+int ipf_delta_apply_planes(const ipf_header_t *header, const uint8_t *delta, size_t len,
+                           uint8_t *rg, uint8_t *ba, size_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBIPF_H
@@ -0,0 +1,1115 @@
+/**
+ * iPF Server - long-lived iPF encode/decode service
+ *
+ * For tools that would otherwise start encoder_ipf or decoder_ipf for every
+ * image. Requests are served by a pool of workers, each keeping its Zstd
+ * contexts and buffers across requests, so a request costs about what the
+ * codec does. Decoded files are kept in an LRU cache keyed by path, mtime,
+ * size and pixel layout.
+ *
+ * The service listens on a Unix domain socket (--socket PATH, one worker per
+ * connected client) or speaks the same protocol over stdin/stdout (--stdio).
+ * All integers are little-endian:
+ *
+ *   Request:  u32 length, then length bytes: u8 op, then the op's fields
+ *   Response: u32 length, then length bytes: u8 status, then the result,
+ *             or an error message when the status is not 0
+ *
+ *   0x01 DECODE_FILE  u8 layout, path (the rest of the request)
+ *   0x02 DECODE       u8 layout, a whole iPF file (the rest of the request)
+ *        -> u16 width, u16 height, u8 bytes per pixel, rows of pixels
+ *   0x03 ENCODE       u16 width, u16 height, u8 channels (1, 3 or 4),
+ *                     u8 type (1 or 2), u8 iPF header flags (alpha, zstd,
+ *                     progressive), i8 dither pattern (-1 for none),
+ *                     u16 path length, path, rows of pixels
+ *        -> the iPF file, or its u32 size when a path was given, in which
+ *           case the file is written there
+ *   0x04 STATS        -> one line of JSON with request and cache counters
+ *   0x05 QUIT         -> empty; the server stops once it has replied
+ *
+ * Layout 0 is RGB24, or RGBA when the image has alpha; layout 1 is the
+ * graphics adapter's nibble pairs (R<<4|G, B<<4|A), 2 bytes per pixel.
+ * Encoding uses libipf, which matches the VM's encodeIpf1/encodeIpf2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <zstd.h>
+#include <zlib.h>
+
+#include "libipf.h"
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define MAX_PATH 4096
+#define MAX_REQUEST (512u << 20)
+
+#define IPF_ZSTD_LEVEL 7  // As encoder_ipf writes files
+
+#define DEFAULT_CACHE_MB 64
+#define CACHE_BUCKETS 4096
+
+#define OP_DECODE_FILE 0x01
+#define OP_DECODE      0x02
+#define OP_ENCODE      0x03
+#define OP_STATS       0x04
+#define OP_QUIT        0x05
+
+#define STATUS_OK      0
+#define STATUS_REQUEST 1  // Malformed request or unknown op
+#define STATUS_IO      2  // File could not be read or written
+#define STATUS_DATA    3  // Not an iPF file, or corrupt
+#define STATUS_NOMEM   4
+
+#define RESPONSE_HEAD 5   // u32 length, u8 status
+
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+static const uint8_t GZIP_MAGIC[3] = { 0x1F, 0x8B, 0x08 };
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    const char *socket_path;
+    int use_stdio;
+    int jobs;
+    size_t cache_capacity;  // Bytes of decoded pixels
+    int verbose;
+} server_config_t;
+
+typedef struct cache_entry {
+    char *path;
+    int64_t mtime_ns;
+    int64_t file_size;
+    int layout;
+    uint32_t hash;
+    uint16_t width;
+    uint16_t height;
+    uint8_t bpp;
+    uint8_t *pixels;         // Rows packed, width * bpp bytes each
+    size_t bytes;
+    struct cache_entry *prev;  // LRU list, most recent first
+    struct cache_entry *next;
+    struct cache_entry *chain; // Hash bucket
+} cache_entry_t;
+
+typedef struct {
+    cache_entry_t *buckets[CACHE_BUCKETS];
+    cache_entry_t *head;
+    cache_entry_t *tail;
+    size_t bytes;
+    size_t capacity;
+    size_t entries;
+} cache_t;
+
+typedef struct server server_t;
+
+typedef struct {
+    server_t *srv;
+    int id;
+    pthread_t thread;
+    int client_fd;           // Connection being served, -1 when idle
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+    z_stream zs;             // Legacy gzip files
+    int zs_ready;
+    uint8_t *req;            // Request body
+    size_t req_cap;
+    uint8_t *resp;           // Response, from its length field on
+    size_t resp_cap;
+    size_t resp_len;
+    uint8_t *file;           // File read for DECODE_FILE
+    size_t file_cap;
+    uint8_t *blocks;
+    size_t blocks_cap;
+    uint8_t *pixels;         // Padded decode target, or padded encode source
+    size_t pixels_cap;
+} worker_t;
+
+struct server {
+    const server_config_t *cfg;
+    pthread_mutex_t lock;    // Guards everything below
+    pthread_cond_t cond;
+    cache_t cache;
+    int *queue;              // Accepted connections waiting for a worker
+    size_t queue_head;
+    size_t queue_count;
+    size_t queue_cap;
+    int stop;
+    int listen_fd;
+    worker_t *workers;
+    int worker_count;
+
+    uint64_t requests;
+    uint64_t decodes;
+    uint64_t encodes;
+    uint64_t errors;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t busy_ns;        // Time spent handling requests
+};
+
+static volatile sig_atomic_t signalled = 0;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Server - long-lived iPF encode/decode service\n");
+    printf("\nUsage: %s --socket PATH [options]\n", program);
+    printf("       %s --stdio [options]\n\n", program);
+    printf("Transport:\n");
+    printf("  -s, --socket PATH        Listen on a Unix domain socket\n");
+    printf("  --stdio                  Serve one client over stdin/stdout\n");
+    printf("\nOptions:\n");
+    printf("  -j, --jobs N             Clients served at once (default: number of CPUs)\n");
+    printf("  -c, --cache MB           Decoded images kept for DECODE_FILE (default: %d, 0 = off)\n",
+           DEFAULT_CACHE_MB);
+    printf("  -v, --verbose            Log every request to stderr\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nRequests and responses are length-prefixed; the protocol is described at the\n");
+    printf("top of server_ipf.c. SIGINT, SIGTERM or a QUIT request stops the server.\n");
+    printf("\nExamples:\n");
+    printf("  %s --socket /tmp/ipf.sock &\n", program);
+    printf("  %s --stdio -c 256            # As a child process of an editor\n", program);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int ensure_capacity(uint8_t **buf, size_t *cap, size_t need) {
+    if (*cap >= need) return 0;
+    uint8_t *grown = realloc(*buf, need);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = need;
+    return 0;
+}
+
+/**
+ * Read exactly len bytes. Returns 1 when done, 0 on end of stream before the
+ * first byte, -1 on an error or a stream cut short.
+ */
+static int read_full(int fd, uint8_t *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, buf + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n == 0 && got == 0 ? 0 : -1;
+        got += (size_t)n;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static uint32_t hash_path(const char *path) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++) {
+        h ^= *c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// =============================================================================
+// Decoded Image Cache
+// =============================================================================
+
+static void cache_unlink(cache_t *cache, cache_entry_t *e) {
+    if (e->prev) e->prev->next = e->next;
+    else cache->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void cache_push_front(cache_t *cache, cache_entry_t *e) {
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail) cache->tail = e;
+}
+
+static void cache_remove(cache_t *cache, cache_entry_t *e) {
+    cache_entry_t **link = &cache->buckets[e->hash % CACHE_BUCKETS];
+    while (*link != e) link = &(*link)->chain;
+    *link = e->chain;
+    cache_unlink(cache, e);
+    cache->bytes -= e->bytes;
+    cache->entries--;
+    free(e->path);
+    free(e->pixels);
+    free(e);
+}
+
+/**
+ * Find a file's decoded pixels. An entry for the same path and layout whose
+ * mtime or size no longer match is dropped.
+ */
+static cache_entry_t *cache_lookup(cache_t *cache, const char *path, uint32_t hash, int layout,
+                                   int64_t mtime_ns, int64_t file_size) {
+    for (cache_entry_t *e = cache->buckets[hash % CACHE_BUCKETS]; e; e = e->chain) {
+        if (e->hash != hash || e->layout != layout || strcmp(e->path, path) != 0) continue;
+        if (e->mtime_ns != mtime_ns || e->file_size != file_size) {
+            cache_remove(cache, e);
+            return NULL;
+        }
+        cache_unlink(cache, e);
+        cache_push_front(cache, e);
+        return e;
+    }
+    return NULL;
+}
+
+/**
+ * Keep a copy of pixels, evicting the least recently used entries to make
+ * room. Images larger than the whole cache are not kept.
+ */
+static void cache_insert(cache_t *cache, const char *path, uint32_t hash, int layout, int64_t mtime_ns,
+                         int64_t file_size, int width, int height, int bpp, const uint8_t *pixels) {
+    size_t bytes = (size_t)width * height * bpp;
+    if (bytes > cache->capacity) return;
+
+    // Another worker may have decoded the same file meanwhile
+    if (cache_lookup(cache, path, hash, layout, mtime_ns, file_size)) return;
+
+    cache_entry_t *e = calloc(1, sizeof(*e));
+    if (!e) return;
+    e->path = strdup(path);
+    e->pixels = malloc(bytes ? bytes : 1);
+    if (!e->path || !e->pixels) {
+        free(e->path);
+        free(e->pixels);
+        free(e);
+        return;
+    }
+    memcpy(e->pixels, pixels, bytes);
+    e->mtime_ns = mtime_ns;
+    e->file_size = file_size;
+    e->layout = layout;
+    e->hash = hash;
+    e->width = (uint16_t)width;
+    e->height = (uint16_t)height;
+    e->bpp = (uint8_t)bpp;
+    e->bytes = bytes;
+
+    while (cache->tail && cache->bytes + bytes > cache->capacity) cache_remove(cache, cache->tail);
+
+    e->chain = cache->buckets[hash % CACHE_BUCKETS];
+    cache->buckets[hash % CACHE_BUCKETS] = e;
+    cache_push_front(cache, e);
+    cache->bytes += bytes;
+    cache->entries++;
+}
+
+static void cache_free(cache_t *cache) {
+    while (cache->head) cache_remove(cache, cache->head);
+}
+
+// =============================================================================
+// Responses
+// =============================================================================
+
+static void resp_begin(worker_t *w) {
+    w->resp_len = RESPONSE_HEAD;
+    w->resp[4] = STATUS_OK;
+}
+
+/**
+ * Make room for len more bytes of result and return where they go.
+ */
+static uint8_t *resp_reserve(worker_t *w, size_t len) {
+    if (ensure_capacity(&w->resp, &w->resp_cap, w->resp_len + len) < 0) return NULL;
+    uint8_t *p = w->resp + w->resp_len;
+    w->resp_len += len;
+    return p;
+}
+
+static int resp_error(worker_t *w, int status, const char *fmt, ...) {
+    char msg[MAX_PATH + 256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if ((size_t)n >= sizeof(msg)) n = (int)sizeof(msg) - 1;
+
+    resp_begin(w);
+    w->resp[4] = (uint8_t)status;
+    uint8_t *p = resp_reserve(w, (size_t)n);
+    if (p) memcpy(p, msg, (size_t)n);
+    else w->resp_len = RESPONSE_HEAD;  // resp always holds the head
+    return -1;
+}
+
+// =============================================================================
+// Decoding
+// =============================================================================
+
+/**
+ * Unpack an iPF file's block data: in place when stored raw, otherwise into
+ * the worker's block buffer. Unflagged legacy files may be gzip, which the
+ * VM sniffs for, as decoder_ipf does. Returns NULL after setting an error.
+ */
+static const uint8_t *unpack_blocks(worker_t *w, const ipf_header_t *header, const uint8_t *payload,
+                                    size_t payload_size, size_t raw_size) {
+    int is_zstd = payload_size >= 4 && memcmp(payload, ZSTD_MAGIC, 4) == 0;
+    int is_gzip = payload_size >= 3 && memcmp(payload, GZIP_MAGIC, 3) == 0;
+    int zstd = (header->flags & IPF_FLAG_ZSTD) ? !is_gzip : (payload_size < raw_size && is_zstd && !is_gzip);
+    int gzip = (header->flags & IPF_FLAG_ZSTD) ? is_gzip : (payload_size < raw_size && is_gzip);
+
+    if (!zstd && !gzip) {
+        if (payload_size < raw_size) {
+            resp_error(w, STATUS_DATA, "Block data is truncated");
+            return NULL;
+        }
+        return payload;
+    }
+
+    if (ensure_capacity(&w->blocks, &w->blocks_cap, raw_size) < 0) {
+        resp_error(w, STATUS_NOMEM, "Failed to allocate decompression buffer");
+        return NULL;
+    }
+
+    if (zstd) {
+        // Stream into a buffer of exactly raw_size, so trailing data is ignored
+        ZSTD_DCtx_reset(w->dctx, ZSTD_reset_session_only);
+        ZSTD_outBuffer output = { w->blocks, raw_size, 0 };
+        ZSTD_inBuffer input = { payload, payload_size, 0 };
+        while (output.pos < output.size) {
+            size_t pos_before = output.pos;
+            size_t ret = ZSTD_decompressStream(w->dctx, &output, &input);
+            if (ZSTD_isError(ret)) {
+                resp_error(w, STATUS_DATA, "Zstd decompression failed: %s", ZSTD_getErrorName(ret));
+                return NULL;
+            }
+            if (output.pos == pos_before && input.pos == input.size) {
+                resp_error(w, STATUS_DATA, "Unexpected end of compressed block data");
+                return NULL;
+            }
+        }
+        return w->blocks;
+    }
+
+    if (!w->zs_ready) {
+        if (inflateInit2(&w->zs, 16 + MAX_WBITS) != Z_OK) {
+            resp_error(w, STATUS_NOMEM, "Failed to allocate decompression stream");
+            return NULL;
+        }
+        w->zs_ready = 1;
+    } else {
+        inflateReset(&w->zs);
+    }
+    w->zs.next_in = (Bytef *)payload;
+    w->zs.avail_in = (uInt)payload_size;
+    w->zs.next_out = w->blocks;
+    w->zs.avail_out = (uInt)raw_size;
+    int ret = inflate(&w->zs, Z_FINISH);
+    if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) || w->zs.avail_out != 0) {
+        resp_error(w, STATUS_DATA, "Gzip decompression failed: %s", w->zs.msg ? w->zs.msg : "unexpected end of data");
+        return NULL;
+    }
+    return w->blocks;
+}
+
+/**
+ * Decode a whole iPF file into the response: u16 width, u16 height, u8 bytes
+ * per pixel, then the pixels. Returns where the pixels start in w->resp, or
+ * 0 after setting an error.
+ */
+static size_t decode_into_response(worker_t *w, const uint8_t *data, size_t size, int layout) {
+    ipf_header_t header;
+    int err = ipf_parse_header(data, size, &header);
+    if (err != IPF_OK) {
+        resp_error(w, STATUS_DATA, "%s", ipf_strerror(err));
+        return 0;
+    }
+
+    size_t raw_size = ipf_blocks_size(&header);
+    const uint8_t *blocks = unpack_blocks(w, &header, data + IPF_HEADER_SIZE, size - IPF_HEADER_SIZE, raw_size);
+    if (!blocks) return 0;
+
+    int has_alpha = (header.flags & IPF_FLAG_ALPHA) != 0;
+    int bpp = ipf_pixel_bytes(has_alpha, (ipf_layout_t)layout);
+    size_t row = (size_t)header.width * bpp;
+    size_t padded_stride = (size_t)ipf_blocks_x(&header) * 4 * bpp;
+    size_t padded_rows = (size_t)ipf_blocks_y(&header) * 4;
+
+    resp_begin(w);
+    uint8_t *info = resp_reserve(w, 5 + row * header.height);
+    if (!info) {
+        resp_error(w, STATUS_NOMEM, "Failed to allocate %ux%u pixels", header.width, header.height);
+        return 0;
+    }
+    put_u16(info, header.width);
+    put_u16(info + 2, header.height);
+    info[4] = (uint8_t)bpp;
+    size_t pixels_at = (size_t)(info + 5 - w->resp);
+
+    // Whole blocks decode straight into the response; others need padding
+    if (padded_stride == row && padded_rows == header.height) {
+        ipf_decode_image(&header, blocks, (ipf_layout_t)layout, w->resp + pixels_at, row);
+        return pixels_at;
+    }
+
+    if (ensure_capacity(&w->pixels, &w->pixels_cap, padded_stride * padded_rows) < 0) {
+        resp_error(w, STATUS_NOMEM, "Failed to allocate decode buffer");
+        return 0;
+    }
+    ipf_decode_image(&header, blocks, (ipf_layout_t)layout, w->pixels, padded_stride);
+    for (int y = 0; y < header.height; y++) {
+        memcpy(w->resp + pixels_at + (size_t)y * row, w->pixels + (size_t)y * padded_stride, row);
+    }
+    return pixels_at;
+}
+
+static int parse_layout(worker_t *w, uint8_t layout) {
+    if (layout > IPF_PIXELS_TSVM) return resp_error(w, STATUS_REQUEST, "Unknown pixel layout %u", layout);
+    return 0;
+}
+
+static int handle_decode(worker_t *w, const uint8_t *req, size_t len) {
+    if (len < 1) return resp_error(w, STATUS_REQUEST, "DECODE needs a layout");
+    if (parse_layout(w, req[0]) < 0) return -1;
+    return decode_into_response(w, req + 1, len - 1, req[0]) ? 0 : -1;
+}
+
+static int handle_decode_file(worker_t *w, const uint8_t *req, size_t len) {
+    server_t *srv = w->srv;
+    if (len < 2 || len - 1 >= MAX_PATH) return resp_error(w, STATUS_REQUEST, "DECODE_FILE needs a layout and a path");
+    if (parse_layout(w, req[0]) < 0) return -1;
+    int layout = req[0];
+
+    char path[MAX_PATH];
+    memcpy(path, req + 1, len - 1);
+    path[len - 1] = '\0';
+    if (strlen(path) != len - 1) return resp_error(w, STATUS_REQUEST, "Path contains a NUL byte");
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return resp_error(w, STATUS_IO, "Cannot open %s: %s", path, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return resp_error(w, STATUS_IO, "Not a regular file: %s", path);
+    }
+    int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    uint32_t hash = hash_path(path);
+
+    if (srv->cfg->cache_capacity > 0) {
+        pthread_mutex_lock(&srv->lock);
+        cache_entry_t *e = cache_lookup(&srv->cache, path, hash, layout, mtime_ns, (int64_t)st.st_size);
+        if (e) {
+            srv->cache_hits++;
+            resp_begin(w);
+            uint8_t *out = resp_reserve(w, 5 + e->bytes);
+            if (out) {
+                put_u16(out, e->width);
+                put_u16(out + 2, e->height);
+                out[4] = e->bpp;
+                memcpy(out + 5, e->pixels, e->bytes);
+            }
+            pthread_mutex_unlock(&srv->lock);
+            close(fd);
+            return out ? 0 : resp_error(w, STATUS_NOMEM, "Failed to allocate response");
+        }
+        srv->cache_misses++;
+        pthread_mutex_unlock(&srv->lock);
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (ensure_capacity(&w->file, &w->file_cap, size ? size : 1) < 0) {
+        close(fd);
+        return resp_error(w, STATUS_NOMEM, "Failed to allocate %zu bytes for %s", size, path);
+    }
+    int got = size ? read_full(fd, w->file, size) : 1;
+    close(fd);
+    if (got != 1) return resp_error(w, STATUS_IO, "Cannot read %s", path);
+
+    size_t pixels_at = decode_into_response(w, w->file, size, layout);
+    if (!pixels_at) {
+        // Name the file in the message
+        char msg[512];
+        size_t n = w->resp_len - RESPONSE_HEAD < sizeof(msg) - 1 ? w->resp_len - RESPONSE_HEAD : sizeof(msg) - 1;
+        memcpy(msg, w->resp + RESPONSE_HEAD, n);
+        msg[n] = '\0';
+        return resp_error(w, w->resp[4], "%s: %s", path, msg);
+    }
+
+    if (srv->cfg->cache_capacity > 0) {
+        const uint8_t *info = w->resp + RESPONSE_HEAD;
+        pthread_mutex_lock(&srv->lock);
+        cache_insert(&srv->cache, path, hash, layout, mtime_ns, (int64_t)st.st_size,
+                     get_u16(info), get_u16(info + 2), info[4], w->resp + pixels_at);
+        pthread_mutex_unlock(&srv->lock);
+    }
+    return 0;
+}
+
+// =============================================================================
+// Encoding
+// =============================================================================
+
+static int handle_encode(worker_t *w, const uint8_t *req, size_t len) {
+    if (len < 10) return resp_error(w, STATUS_REQUEST, "ENCODE request is too short");
+
+    int width = get_u16(req);
+    int height = get_u16(req + 2);
+    int channels = req[4];
+    int type = req[5];
+    int flags = req[6] & (IPF_FLAG_ALPHA | IPF_FLAG_ZSTD | IPF_FLAG_PROGRESSIVE);
+    int dither = (int8_t)req[7];
+    size_t path_len = get_u16(req + 8);
+
+    if (width < 1 || height < 1) return resp_error(w, STATUS_REQUEST, "Invalid size %dx%d", width, height);
+    if (channels != 1 && channels != 3 && channels != 4) {
+        return resp_error(w, STATUS_REQUEST, "Channels must be 1, 3 or 4");
+    }
+    if (type != 1 && type != 2) return resp_error(w, STATUS_REQUEST, "Invalid iPF type %d (use 1 or 2)", type);
+    if ((flags & IPF_FLAG_ALPHA) && channels != 4) {
+        return resp_error(w, STATUS_REQUEST, "Alpha needs 4 channels");
+    }
+    if (path_len >= MAX_PATH) return resp_error(w, STATUS_REQUEST, "Path is too long");
+
+    size_t stride = (size_t)width * channels;
+    size_t pixels_size = stride * height;
+    if (len != 10 + path_len + pixels_size) {
+        return resp_error(w, STATUS_REQUEST, "Expected %zu bytes of pixels, got %zu", pixels_size,
+                          len < 10 + path_len ? 0 : len - 10 - path_len);
+    }
+
+    char path[MAX_PATH];
+    memcpy(path, req + 10, path_len);
+    path[path_len] = '\0';
+    if (strlen(path) != path_len) return resp_error(w, STATUS_REQUEST, "Path contains a NUL byte");
+    const uint8_t *src = req + 10 + path_len;
+
+    // Progressive files are always flagged as compressed, as encoder_ipf writes them
+    if (flags & IPF_FLAG_PROGRESSIVE) flags |= IPF_FLAG_ZSTD;
+    ipf_header_t header = { (uint16_t)width, (uint16_t)height, (uint8_t)flags, (uint8_t)(type - 1), 0 };
+    size_t blocks_size = ipf_blocks_size(&header);
+    header.uncompressed_size = (uint32_t)blocks_size;
+
+    // The encoder reads whole 4x4 areas at the edges
+    size_t span = ipf_encode_src_span(&header, stride, channels);
+    if (span > pixels_size) {
+        if (ensure_capacity(&w->pixels, &w->pixels_cap, span) < 0) {
+            return resp_error(w, STATUS_NOMEM, "Failed to allocate encode buffer");
+        }
+        memcpy(w->pixels, src, pixels_size);
+        memset(w->pixels + pixels_size, 0, span - pixels_size);
+        src = w->pixels;
+    }
+
+    if (ensure_capacity(&w->blocks, &w->blocks_cap, blocks_size) < 0) {
+        return resp_error(w, STATUS_NOMEM, "Failed to allocate block buffer");
+    }
+    int err = ipf_encode_image(&header, src, stride, channels, dither, w->blocks);
+    if (err != IPF_OK) return resp_error(w, STATUS_REQUEST, "%s", ipf_strerror(err));
+
+    resp_begin(w);
+    size_t bound = (flags & IPF_FLAG_ZSTD) ? ZSTD_compressBound(blocks_size) : blocks_size;
+    uint8_t *file = resp_reserve(w, IPF_HEADER_SIZE + bound);
+    if (!file) return resp_error(w, STATUS_NOMEM, "Failed to allocate response");
+    ipf_write_header(&header, file);
+
+    size_t payload = blocks_size;
+    if (flags & IPF_FLAG_ZSTD) {
+        payload = ZSTD_compressCCtx(w->cctx, file + IPF_HEADER_SIZE, bound, w->blocks, blocks_size, IPF_ZSTD_LEVEL);
+        if (ZSTD_isError(payload)) {
+            return resp_error(w, STATUS_DATA, "Zstd compression failed: %s", ZSTD_getErrorName(payload));
+        }
+    } else {
+        memcpy(file + IPF_HEADER_SIZE, w->blocks, blocks_size);
+    }
+    size_t file_size = IPF_HEADER_SIZE + payload;
+    w->resp_len = RESPONSE_HEAD + file_size;
+
+    if (path_len == 0) return 0;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return resp_error(w, STATUS_IO, "Cannot write %s: %s", path, strerror(errno));
+    size_t written = fwrite(file, 1, file_size, fp);
+    if (fclose(fp) != 0 || written != file_size) return resp_error(w, STATUS_IO, "Cannot write %s", path);
+
+    resp_begin(w);
+    put_u32(resp_reserve(w, 4), (uint32_t)file_size);  // Room for the whole file is already there
+    return 0;
+}
+
+// =============================================================================
+// Requests
+// =============================================================================
+
+static int handle_stats(worker_t *w) {
+    server_t *srv = w->srv;
+    char json[1024];
+
+    pthread_mutex_lock(&srv->lock);
+    uint64_t handled = srv->decodes + srv->encodes;
+    int n = snprintf(json, sizeof(json),
+                     "{\"requests\":%llu,\"decodes\":%llu,\"encodes\":%llu,\"errors\":%llu,"
+                     "\"mean_us\":%.1f,\"workers\":%d,\"cache\":{\"hits\":%llu,\"misses\":%llu,"
+                     "\"entries\":%zu,\"bytes\":%zu,\"capacity\":%zu}}\n",
+                     (unsigned long long)srv->requests, (unsigned long long)srv->decodes,
+                     (unsigned long long)srv->encodes, (unsigned long long)srv->errors,
+                     handled ? srv->busy_ns / 1e3 / handled : 0.0, srv->worker_count,
+                     (unsigned long long)srv->cache_hits, (unsigned long long)srv->cache_misses,
+                     srv->cache.entries, srv->cache.bytes, srv->cache.capacity);
+    pthread_mutex_unlock(&srv->lock);
+
+    resp_begin(w);
+    uint8_t *out = resp_reserve(w, (size_t)n);
+    if (!out) return resp_error(w, STATUS_NOMEM, "Failed to allocate response");
+    memcpy(out, json, (size_t)n);
+    return 0;
+}
+
+static void request_stop(server_t *srv) {
+    pthread_mutex_lock(&srv->lock);
+    srv->stop = 1;
+    if (srv->listen_fd >= 0) shutdown(srv->listen_fd, SHUT_RDWR);  // Wakes accept()
+    pthread_cond_broadcast(&srv->cond);
+    pthread_mutex_unlock(&srv->lock);
+}
+
+static const char *op_name(int op) {
+    switch (op) {
+        case OP_DECODE_FILE: return "decode_file";
+        case OP_DECODE: return "decode";
+        case OP_ENCODE: return "encode";
+        case OP_STATS: return "stats";
+        case OP_QUIT: return "quit";
+        default: return "unknown";
+    }
+}
+
+/**
+ * Answer requests from one client until it hangs up, sends something
+ * unreadable or asks the server to quit.
+ */
+static void serve_client(worker_t *w, int in_fd, int out_fd) {
+    server_t *srv = w->srv;
+    uint8_t head[4];
+
+    for (;;) {
+        int got = read_full(in_fd, head, 4);
+        if (got <= 0) break;
+
+        uint32_t len = get_u32(head);
+        if (len == 0 || len > MAX_REQUEST) {
+            resp_error(w, STATUS_REQUEST, "Request length %u is out of range", len);
+            put_u32(w->resp, (uint32_t)(w->resp_len - 4));
+            write_full(out_fd, w->resp, w->resp_len);
+            break;  // Can't find the next request
+        }
+        if (ensure_capacity(&w->req, &w->req_cap, len) < 0) {
+            fprintf(stderr, "Error: Out of memory for a %u-byte request\n", len);
+            break;
+        }
+        if (read_full(in_fd, w->req, len) != 1) break;
+
+        int op = w->req[0];
+        uint64_t start = now_ns();
+        int result;
+        switch (op) {
+            case OP_DECODE_FILE: result = handle_decode_file(w, w->req + 1, len - 1); break;
+            case OP_DECODE: result = handle_decode(w, w->req + 1, len - 1); break;
+            case OP_ENCODE: result = handle_encode(w, w->req + 1, len - 1); break;
+            case OP_STATS: result = handle_stats(w); break;
+            case OP_QUIT:
+                resp_begin(w);
+                result = 0;
+                break;
+            default: result = resp_error(w, STATUS_REQUEST, "Unknown op 0x%02X", op); break;
+        }
+        uint64_t took = now_ns() - start;
+
+        pthread_mutex_lock(&srv->lock);
+        srv->requests++;
+        if (result < 0) srv->errors++;
+        else if (op == OP_ENCODE) srv->encodes++;
+        else if (op == OP_DECODE || op == OP_DECODE_FILE) srv->decodes++;
+        if (op == OP_ENCODE || op == OP_DECODE || op == OP_DECODE_FILE) srv->busy_ns += took;
+        pthread_mutex_unlock(&srv->lock);
+
+        if (srv->cfg->verbose) {
+            fprintf(stderr, "[%d] %s: %s, %zu bytes, %.3f ms\n", w->id, op_name(op),
+                    result < 0 ? "error" : "ok", w->resp_len - RESPONSE_HEAD, took / 1e6);
+        }
+
+        put_u32(w->resp, (uint32_t)(w->resp_len - 4));
+        if (write_full(out_fd, w->resp, w->resp_len) < 0) break;
+
+        if (op == OP_QUIT) {
+            request_stop(srv);
+            break;
+        }
+    }
+}
+
+// =============================================================================
+// Workers
+// =============================================================================
+
+static int worker_init(worker_t *w, server_t *srv, int id) {
+    memset(w, 0, sizeof(*w));
+    w->srv = srv;
+    w->id = id;
+    w->client_fd = -1;
+    w->cctx = ZSTD_createCCtx();
+    w->dctx = ZSTD_createDCtx();
+    w->resp_cap = 4096;
+    w->resp = malloc(w->resp_cap);
+    return w->cctx && w->dctx && w->resp ? 0 : -1;
+}
+
+static void worker_free(worker_t *w) {
+    ZSTD_freeCCtx(w->cctx);
+    ZSTD_freeDCtx(w->dctx);
+    if (w->zs_ready) inflateEnd(&w->zs);
+    free(w->req);
+    free(w->resp);
+    free(w->file);
+    free(w->blocks);
+    free(w->pixels);
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    server_t *srv = w->srv;
+
+    for (;;) {
+        pthread_mutex_lock(&srv->lock);
+        while (!srv->stop && srv->queue_count == 0) pthread_cond_wait(&srv->cond, &srv->lock);
+        if (srv->stop) {
+            pthread_mutex_unlock(&srv->lock);
+            break;
+        }
+        int fd = srv->queue[srv->queue_head];
+        srv->queue_head = (srv->queue_head + 1) % srv->queue_cap;
+        srv->queue_count--;
+        w->client_fd = fd;
+        pthread_mutex_unlock(&srv->lock);
+
+        serve_client(w, fd, fd);
+
+        pthread_mutex_lock(&srv->lock);
+        w->client_fd = -1;
+        pthread_mutex_unlock(&srv->lock);
+        close(fd);
+    }
+    return NULL;
+}
+
+static int queue_push(server_t *srv, int fd) {
+    pthread_mutex_lock(&srv->lock);
+    if (srv->queue_count == srv->queue_cap) {
+        size_t cap = srv->queue_cap ? srv->queue_cap * 2 : 16;
+        int *grown = malloc(cap * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&srv->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < srv->queue_count; i++) {
+            grown[i] = srv->queue[(srv->queue_head + i) % srv->queue_cap];
+        }
+        free(srv->queue);
+        srv->queue = grown;
+        srv->queue_cap = cap;
+        srv->queue_head = 0;
+    }
+    srv->queue[(srv->queue_head + srv->queue_count) % srv->queue_cap] = fd;
+    srv->queue_count++;
+    pthread_cond_signal(&srv->cond);
+    pthread_mutex_unlock(&srv->lock);
+    return 0;
+}
+
+// =============================================================================
+// Transports
+// =============================================================================
+
+static void on_signal(int sig) {
+    (void)sig;
+    signalled = 1;
+}
+
+/**
+ * Bind the socket, replacing a stale one left by a server that died, but
+ * not one another server is still listening on.
+ */
+static int open_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path is too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error: %s exists and is not a socket\n", path);
+            close(fd);
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            fprintf(stderr, "Error: A server is already listening on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int serve_socket(server_t *srv) {
+    const server_config_t *cfg = srv->cfg;
+    int fd = open_socket(cfg->socket_path);
+    if (fd < 0) return -1;
+    srv->listen_fd = fd;
+
+    // Only the accepting thread takes SIGINT/SIGTERM, so accept() sees EINTR
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+
+    int started = 0;
+    for (int i = 0; i < srv->worker_count; i++) {
+        if (pthread_create(&srv->workers[i].thread, NULL, worker_main, &srv->workers[i]) != 0) break;
+        started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    int result = 0;
+    if (started == 0) {
+        fprintf(stderr, "Error: Failed to start worker threads\n");
+        result = -1;
+    } else {
+        fprintf(stderr, "Listening on %s with %d workers\n", cfg->socket_path, started);
+    }
+
+    while (started > 0) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (signalled) break;
+            pthread_mutex_lock(&srv->lock);
+            int stop = srv->stop;
+            pthread_mutex_unlock(&srv->lock);
+            if (stop) break;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Error: accept failed: %s\n", strerror(errno));
+            result = -1;
+            break;
+        }
+        if (queue_push(srv, client) < 0) {
+            fprintf(stderr, "Error: Out of memory queueing a client\n");
+            close(client);
+        }
+    }
+
+    // Hang up on clients mid-conversation so their workers can be joined
+    request_stop(srv);
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < started; i++) {
+        if (srv->workers[i].client_fd >= 0) shutdown(srv->workers[i].client_fd, SHUT_RDWR);
+    }
+    while (srv->queue_count > 0) {
+        close(srv->queue[srv->queue_head]);
+        srv->queue_head = (srv->queue_head + 1) % srv->queue_cap;
+        srv->queue_count--;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    for (int i = 0; i < started; i++) pthread_join(srv->workers[i].thread, NULL);
+
+    close(fd);
+    unlink(cfg->socket_path);
+    return result;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char *argv[]) {
+    server_config_t cfg = {
+        .socket_path = NULL,
+        .use_stdio = 0,
+        .jobs = 0,
+        .cache_capacity = (size_t)DEFAULT_CACHE_MB << 20,
+        .verbose = 0
+    };
+
+    static struct option long_options[] = {
+        {"socket",  required_argument, 0, 's'},
+        {"stdio",   no_argument,       0, 'I'},
+        {"jobs",    required_argument, 0, 'j'},
+        {"cache",   required_argument, 0, 'c'},
+        {"verbose", no_argument,       0, 'v'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:j:c:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                cfg.socket_path = optarg;
+                break;
+            case 'I':
+                cfg.use_stdio = 1;
+                break;
+            case 'j':
+                cfg.jobs = atoi(optarg);
+                if (cfg.jobs < 1) {
+                    fprintf(stderr, "Error: Jobs must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case 'c': {
+                long mb = atol(optarg);
+                if (mb < 0) {
+                    fprintf(stderr, "Error: Cache size must not be negative\n");
+                    return 1;
+                }
+                cfg.cache_capacity = (size_t)mb << 20;
+                break;
+            }
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!cfg.socket_path == !cfg.use_stdio) {
+        fprintf(stderr, "Error: Give either --socket PATH or --stdio\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (cfg.use_stdio) {
+        cfg.jobs = 1;
+    } else if (cfg.jobs == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.jobs = n > 0 ? (int)n : 1;
+    }
+
+    server_t srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.cfg = &cfg;
+    srv.listen_fd = -1;
+    srv.cache.capacity = cfg.cache_capacity;
+    pthread_mutex_init(&srv.lock, NULL);
+    pthread_cond_init(&srv.cond, NULL);
+
+    srv.workers = calloc((size_t)cfg.jobs, sizeof(*srv.workers));
+    if (!srv.workers) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    int result = 0;
+    for (int i = 0; i < cfg.jobs; i++) {
+        if (worker_init(&srv.workers[i], &srv, i) < 0) {
+            fprintf(stderr, "Error: Failed to allocate worker contexts\n");
+            result = -1;
+        }
+        srv.worker_count++;
+        if (result < 0) break;
+    }
+
+    // A client going away must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);   // No SA_RESTART: a blocked read or accept returns
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (result == 0) {
+        if (cfg.use_stdio) serve_client(&srv.workers[0], STDIN_FILENO, STDOUT_FILENO);
+        else result = serve_socket(&srv);
+    }
+
+    for (int i = 0; i < srv.worker_count; i++) worker_free(&srv.workers[i]);
+    free(srv.workers);
+    free(srv.queue);
+    cache_free(&srv.cache);
+    pthread_mutex_destroy(&srv.lock);
+    pthread_cond_destroy(&srv.cond);
+
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,669 @@
+/**
+ * iPF Transcoder - rewrite iPF files in the block domain
+ *
+ * Converts between iPF1 and iPF2, raster and progressive block order,
+ * crops on the 4-pixel block grid, adds or strips alpha and recompresses,
+ * all by moving nibbles around. Luma and alpha are copied untouched; the
+ * only lossy step is merging vertical chroma pairs for iPF2 -> iPF1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <zstd.h>
+#include <zlib.h>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+#define IPF_MAGIC "\x1F\x54\x53\x56\x4D\x69\x50\x46"  // "\x1FTSVMiPF"
+#define IPF_HEADER_SIZE 28  // 8 magic + 2 width + 2 height + 1 flags + 1 type + 10 reserved + 4 uncompressed size
+
+#define IPF_TYPE_1 0  // 4:2:0 chroma subsampling (12 bytes per block, +8 with alpha)
+#define IPF_TYPE_2 1  // 4:2:2 chroma subsampling (16 bytes per block, +8 with alpha)
+
+#define IPF_FLAG_ALPHA       0x01  // Has alpha channel
+#define IPF_FLAG_ZSTD        0x10  // Zstd compressed
+#define IPF_FLAG_PROGRESSIVE 0x80  // Adam7 progressive ordering
+
+#define DEFAULT_ZSTD_LEVEL 7  // Same as encoder_ipf
+
+#define KEEP -1  // Option left at "same as input"
+
+// Adam7 interlace pattern - pass number (1-7) for each pixel in 8x8 block
+static const int ADAM7_PASS[8][8] = {
+    {1, 6, 4, 6, 2, 6, 4, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {5, 6, 5, 6, 5, 6, 5, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {3, 6, 4, 6, 3, 6, 4, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7},
+    {5, 6, 5, 6, 5, 6, 5, 6},
+    {7, 7, 7, 7, 7, 7, 7, 7}
+};
+
+// =============================================================================
+// Structures
+// =============================================================================
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t flags;
+    uint8_t type;
+    uint32_t uncompressed_size;
+} ipf_header_t;
+
+typedef struct {
+    char *input_file;
+    char *output_file;
+    int ipf_type;        // IPF_TYPE_1/2 or KEEP
+    int progressive;     // 0/1 or KEEP
+    int alpha;           // 0 = strip, 1 = add opaque, KEEP
+    int use_zstd;        // 0/1 or KEEP
+    int zstd_level;
+    int crop;            // 1 if a crop rectangle was given
+    int crop_x, crop_y, crop_w, crop_h;
+    int verbose;
+} transcoder_config_t;
+
+/**
+ * A decoded image in the block domain: blocks in raster order.
+ */
+typedef struct {
+    ipf_header_t header;
+    int blocks_x;
+    int blocks_y;
+    int block_size;
+    uint8_t *blocks;
+} block_image_t;
+
+// =============================================================================
+// Utility Functions
+// =============================================================================
+
+static void print_usage(const char *program) {
+    printf("iPF Transcoder - rewrite iPF files without decoding to RGB\n");
+    printf("\nUsage: %s -i input.ipf -o output.ipf [options]\n\n", program);
+    printf("Required:\n");
+    printf("  -i, --input FILE         Input iPF file\n");
+    printf("  -o, --output FILE        Output iPF file\n");
+    printf("\nOptions (anything not given is kept as in the input):\n");
+    printf("  -t, --type N             iPF type: 1 (4:2:0) or 2 (4:2:2)\n");
+    printf("                           (2 -> 1 averages vertical chroma pairs; 1 -> 2 is lossless)\n");
+    printf("  -p, --progressive        Store blocks in Adam7 progressive order\n");
+    printf("  --raster                 Store blocks in raster order\n");
+    printf("  -c, --crop WxH+X+Y       Crop; X and Y must be multiples of 4\n");
+    printf("  --alpha                  Add an opaque alpha channel\n");
+    printf("  --no-alpha               Strip the alpha channel\n");
+    printf("  -z, --zstd-level N       Zstd level for the output (default: %d)\n", DEFAULT_ZSTD_LEVEL);
+    printf("  --no-zstd                Store blocks uncompressed (not allowed with progressive)\n");
+    printf("  -v, --verbose            Verbose output\n");
+    printf("  -h, --help               Show this help\n");
+    printf("\nExamples:\n");
+    printf("  %s -i photo.ipf -o photo1.ipf -t 1\n", program);
+    printf("  %s -i wall.ipf -o wall_p.ipf -p -z 19\n", program);
+    printf("  %s -i shot.ipf -o part.ipf -c 280x224+140+112 --no-alpha\n", program);
+}
+
+static int clampi(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Convert chroma value [-1..1] to 4-bit [0..15], as encoder_ipf does
+static int chroma_to_four_bits(float f) {
+    return clampi((int)roundf(f * 8.0f) + 7, 0, 15);
+}
+
+/**
+ * Average two 4-bit chroma values the way the encoder would have quantised
+ * the average of the underlying pixels.
+ */
+static int merge_chroma(int a, int b) {
+    float fa = (a - 7) / 8.0f;
+    float fb = (b - 7) / 8.0f;
+    return chroma_to_four_bits((fa + fb) / 2.0f);
+}
+
+static int ipf_block_size(int type, int has_alpha) {
+    return (type == IPF_TYPE_1) ? (has_alpha ? 20 : 12) : (has_alpha ? 24 : 16);
+}
+
+static int get_adam7_pass(int block_x, int block_y) {
+    int px = (block_x * 4) % 8;
+    int py = (block_y * 4) % 8;
+    return ADAM7_PASS[py][px];
+}
+
+/**
+ * Fill order[] with raster block indices in the sequence a progressive
+ * file stores them: pass 1..7, raster order within each pass.
+ */
+static void build_adam7_order(int blocks_x, int blocks_y, size_t *order) {
+    size_t n = 0;
+    for (int pass = 1; pass <= 7; pass++) {
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                if (get_adam7_pass(bx, by) == pass) {
+                    order[n++] = (size_t)by * blocks_x + bx;
+                }
+            }
+        }
+    }
+}
+
+// =============================================================================
+// iPF File Reading
+// =============================================================================
+
+/**
+ * Decompress the payload into exactly dst_size bytes. The z-flag marks Zstd,
+ * but older files carry gzip without it, so the stream magic is checked too.
+ */
+static int unpack_payload(const ipf_header_t *header, const uint8_t *src, size_t src_size,
+                          uint8_t *dst, size_t dst_size) {
+    int is_zstd = src_size >= 4 && src[0] == 0x28 && src[1] == 0xB5 && src[2] == 0x2F && src[3] == 0xFD;
+    int is_gzip = src_size >= 3 && src[0] == 0x1F && src[1] == 0x8B && src[2] == 0x08;
+
+    if (!(header->flags & IPF_FLAG_ZSTD) && (src_size >= dst_size || (!is_zstd && !is_gzip))) {
+        if (src_size < dst_size) {
+            fprintf(stderr, "Error: Block data is truncated\n");
+            return -1;
+        }
+        memcpy(dst, src, dst_size);
+        return 0;
+    }
+
+    if (is_gzip) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+            fprintf(stderr, "Error: Failed to allocate decompression stream\n");
+            return -1;
+        }
+        zs.next_in = (Bytef *)src;
+        zs.avail_in = (uInt)src_size;
+        zs.next_out = dst;
+        zs.avail_out = (uInt)dst_size;
+        int ret = inflate(&zs, Z_FINISH);
+        int ok = (ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR) && zs.avail_out == 0;
+        inflateEnd(&zs);
+        if (!ok) {
+            fprintf(stderr, "Error: Gzip decompression failed\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx) {
+        fprintf(stderr, "Error: Failed to allocate decompression context\n");
+        return -1;
+    }
+    ZSTD_outBuffer output = { dst, dst_size, 0 };
+    ZSTD_inBuffer input = { src, src_size, 0 };
+    int result = 0;
+    while (output.pos < output.size) {
+        size_t pos_before = output.pos;
+        size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "Error: Zstd decompression failed: %s\n", ZSTD_getErrorName(ret));
+            result = -1;
+            break;
+        }
+        if (output.pos == pos_before && input.pos == input.size) {
+            fprintf(stderr, "Error: Unexpected end of compressed block data\n");
+            result = -1;
+            break;
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    return result;
+}
+
+/**
+ * Load an iPF file into raster-ordered blocks, undoing progressive ordering.
+ */
+static int read_block_image(const char *path, block_image_t *img) {
+    memset(img, 0, sizeof(*img));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open input file: %s\n", path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (file_size < IPF_HEADER_SIZE) {
+        fclose(fp);
+        fprintf(stderr, "Error: File too short for an iPF header\n");
+        return -1;
+    }
+
+    uint8_t *file_data = malloc(file_size);
+    if (!file_data) {
+        fclose(fp);
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        return -1;
+    }
+    size_t got = fread(file_data, 1, file_size, fp);
+    fclose(fp);
+    if (got != (size_t)file_size) {
+        free(file_data);
+        fprintf(stderr, "Error: Failed to read input file\n");
+        return -1;
+    }
+
+    if (memcmp(file_data, IPF_MAGIC, 8) != 0) {
+        free(file_data);
+        fprintf(stderr, "Error: Invalid iPF magic\n");
+        return -1;
+    }
+
+    ipf_header_t *h = &img->header;
+    h->width = file_data[8] | (file_data[9] << 8);
+    h->height = file_data[10] | (file_data[11] << 8);
+    h->flags = file_data[12];
+    h->type = file_data[13];
+    h->uncompressed_size = (uint32_t)file_data[24] | ((uint32_t)file_data[25] << 8) |
+                           ((uint32_t)file_data[26] << 16) | ((uint32_t)file_data[27] << 24);
+
+    if (h->type != IPF_TYPE_1 && h->type != IPF_TYPE_2) {
+        free(file_data);
+        fprintf(stderr, "Error: Unknown iPF type %d\n", h->type);
+        return -1;
+    }
+
+    img->blocks_x = (h->width + 3) / 4;
+    img->blocks_y = (h->height + 3) / 4;
+    img->block_size = ipf_block_size(h->type, h->flags & IPF_FLAG_ALPHA);
+    size_t total = (size_t)img->blocks_x * img->blocks_y;
+    size_t data_size = total * img->block_size;
+
+    uint8_t *stored = malloc(data_size);
+    if (!stored) {
+        free(file_data);
+        fprintf(stderr, "Error: Failed to allocate block buffer\n");
+        return -1;
+    }
+
+    int result = unpack_payload(h, file_data + IPF_HEADER_SIZE, file_size - IPF_HEADER_SIZE, stored, data_size);
+    free(file_data);
+    if (result < 0) {
+        free(stored);
+        return -1;
+    }
+
+    if (!(h->flags & IPF_FLAG_PROGRESSIVE)) {
+        img->blocks = stored;
+        return 0;
+    }
+
+    // Put progressive blocks back at their raster positions
+    size_t *order = malloc(total * sizeof(size_t));
+    img->blocks = malloc(data_size);
+    if (!order || !img->blocks) {
+        free(order);
+        free(stored);
+        free(img->blocks);
+        img->blocks = NULL;
+        fprintf(stderr, "Error: Failed to allocate block buffer\n");
+        return -1;
+    }
+    build_adam7_order(img->blocks_x, img->blocks_y, order);
+    for (size_t i = 0; i < total; i++) {
+        memcpy(img->blocks + order[i] * img->block_size, stored + i * img->block_size, img->block_size);
+    }
+    free(order);
+    free(stored);
+    return 0;
+}
+
+// =============================================================================
+// Block Transforms
+// =============================================================================
+
+/**
+ * Rewrite one block to the output type and alpha setting.
+ *
+ * iPF1 holds one Co/Cg nibble per 2x2 quad; iPF2 holds one per horizontal
+ * pair, two pairs per quad (ci and ci+2). Going up duplicates the quad value
+ * into both pairs, which is lossless; going down averages the two pairs.
+ * Y and alpha use the same 8-byte packing in both types and are copied.
+ */
+static void transcode_block(const uint8_t *src, int src_type, int src_alpha,
+                            uint8_t *dst, int dst_type, int dst_alpha) {
+    int chroma_in = (src_type == IPF_TYPE_1) ? 4 : 8;
+    int chroma_out = (dst_type == IPF_TYPE_1) ? 4 : 8;
+
+    if (src_type == dst_type) {
+        memcpy(dst, src, chroma_in);
+    } else if (dst_type == IPF_TYPE_1) {
+        // Quad q gets pairs (row 2*(q/2), row 2*(q/2)+1) in column half q%2
+        for (int plane = 0; plane < 2; plane++) {
+            const uint8_t *c = src + plane * 4;
+            int ci[8];
+            for (int i = 0; i < 4; i++) {
+                ci[i * 2] = c[i] & 0x0F;
+                ci[i * 2 + 1] = (c[i] >> 4) & 0x0F;
+            }
+            int q0 = merge_chroma(ci[0], ci[2]);
+            int q1 = merge_chroma(ci[1], ci[3]);
+            int q2 = merge_chroma(ci[4], ci[6]);
+            int q3 = merge_chroma(ci[5], ci[7]);
+            dst[plane * 2] = (uint8_t)((q1 << 4) | q0);
+            dst[plane * 2 + 1] = (uint8_t)((q3 << 4) | q2);
+        }
+    } else {
+        for (int plane = 0; plane < 2; plane++) {
+            const uint8_t *c = src + plane * 2;
+            // Pairs 0,2 <- quad 0; 1,3 <- quad 1; 4,6 <- quad 2; 5,7 <- quad 3
+            int q0 = c[0] & 0x0F, q1 = (c[0] >> 4) & 0x0F;
+            int q2 = c[1] & 0x0F, q3 = (c[1] >> 4) & 0x0F;
+            uint8_t top = (uint8_t)((q1 << 4) | q0);
+            uint8_t bottom = (uint8_t)((q3 << 4) | q2);
+            dst[plane * 4 + 0] = top;
+            dst[plane * 4 + 1] = top;
+            dst[plane * 4 + 2] = bottom;
+            dst[plane * 4 + 3] = bottom;
+        }
+    }
+
+    memcpy(dst + chroma_out, src + chroma_in, 8);
+
+    if (dst_alpha) {
+        if (src_alpha) {
+            memcpy(dst + chroma_out + 8, src + chroma_in + 8, 8);
+        } else {
+            memset(dst + chroma_out + 8, 0xFF, 8);  // Fully opaque
+        }
+    }
+}
+
+// =============================================================================
+// Transcoding
+// =============================================================================
+
+static int write_ipf(const char *path, const ipf_header_t *header, const uint8_t *blocks,
+                     size_t data_size, int zstd_level, int verbose) {
+    const uint8_t *payload = blocks;
+    size_t payload_size = data_size;
+    uint8_t *compressed = NULL;
+
+    if (header->flags & IPF_FLAG_ZSTD) {
+        size_t bound = ZSTD_compressBound(data_size);
+        compressed = malloc(bound);
+        if (!compressed) {
+            fprintf(stderr, "Error: Failed to allocate compression buffer\n");
+            return -1;
+        }
+        payload_size = ZSTD_compress(compressed, bound, blocks, data_size, zstd_level);
+        if (ZSTD_isError(payload_size)) {
+            fprintf(stderr, "Error: Zstd compression failed: %s\n", ZSTD_getErrorName(payload_size));
+            free(compressed);
+            return -1;
+        }
+        payload = compressed;
+    }
+
+    uint8_t head[IPF_HEADER_SIZE] = {0};
+    memcpy(head, IPF_MAGIC, 8);
+    head[8] = header->width & 0xFF;
+    head[9] = header->width >> 8;
+    head[10] = header->height & 0xFF;
+    head[11] = header->height >> 8;
+    head[12] = header->flags;
+    head[13] = header->type;
+    head[24] = data_size & 0xFF;
+    head[25] = (data_size >> 8) & 0xFF;
+    head[26] = (data_size >> 16) & 0xFF;
+    head[27] = (data_size >> 24) & 0xFF;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Failed to open output file: %s\n", path);
+        free(compressed);
+        return -1;
+    }
+
+    int result = 0;
+    if (fwrite(head, 1, IPF_HEADER_SIZE, fp) != IPF_HEADER_SIZE ||
+        fwrite(payload, 1, payload_size, fp) != payload_size) {
+        result = -1;
+    }
+    if (fclose(fp) != 0) result = -1;
+    if (result < 0) fprintf(stderr, "Error: Failed to write output file: %s\n", path);
+
+    if (result == 0 && verbose) {
+        printf("Wrote %zu bytes to %s\n", IPF_HEADER_SIZE + payload_size, path);
+        printf("  Format: iPF%d, %dx%d\n", header->type + 1, header->width, header->height);
+        printf("  Flags: %s%s%s\n",
+               (header->flags & IPF_FLAG_ALPHA) ? "alpha " : "",
+               (header->flags & IPF_FLAG_ZSTD) ? "zstd " : "",
+               (header->flags & IPF_FLAG_PROGRESSIVE) ? "progressive " : "");
+    }
+
+    free(compressed);
+    return result;
+}
+
+static int transcode(const transcoder_config_t *cfg) {
+    block_image_t in;
+    if (read_block_image(cfg->input_file, &in) < 0) return -1;
+
+    const ipf_header_t *ih = &in.header;
+    int src_alpha = (ih->flags & IPF_FLAG_ALPHA) != 0;
+
+    if (cfg->verbose) {
+        printf("Input: iPF%d, %dx%d, %s%s%s\n", ih->type + 1, ih->width, ih->height,
+               src_alpha ? "alpha " : "",
+               (ih->flags & IPF_FLAG_ZSTD) ? "zstd " : "",
+               (ih->flags & IPF_FLAG_PROGRESSIVE) ? "progressive" : "raster");
+    }
+
+    // Crop rectangle in blocks
+    int x0 = 0, y0 = 0, out_w = ih->width, out_h = ih->height;
+    if (cfg->crop) {
+        if (cfg->crop_x % 4 != 0 || cfg->crop_y % 4 != 0) {
+            fprintf(stderr, "Error: Crop offset must be on the 4-pixel block grid\n");
+            free(in.blocks);
+            return -1;
+        }
+        if (cfg->crop_w <= 0 || cfg->crop_h <= 0 ||
+            cfg->crop_x + cfg->crop_w > ih->width || cfg->crop_y + cfg->crop_h > ih->height) {
+            fprintf(stderr, "Error: Crop %dx%d+%d+%d is outside the %dx%d image\n",
+                    cfg->crop_w, cfg->crop_h, cfg->crop_x, cfg->crop_y, ih->width, ih->height);
+            free(in.blocks);
+            return -1;
+        }
+        x0 = cfg->crop_x / 4;
+        y0 = cfg->crop_y / 4;
+        out_w = cfg->crop_w;
+        out_h = cfg->crop_h;
+    }
+
+    ipf_header_t oh = { 0 };
+    oh.width = (uint16_t)out_w;
+    oh.height = (uint16_t)out_h;
+    oh.type = (uint8_t)(cfg->ipf_type == KEEP ? ih->type : cfg->ipf_type);
+
+    int dst_alpha = cfg->alpha == KEEP ? src_alpha : cfg->alpha;
+    int progressive = cfg->progressive == KEEP ? (ih->flags & IPF_FLAG_PROGRESSIVE) != 0 : cfg->progressive;
+    int use_zstd = cfg->use_zstd == KEEP ? (ih->flags & IPF_FLAG_ZSTD) != 0 : cfg->use_zstd;
+
+    if (progressive && !use_zstd) {
+        if (cfg->use_zstd == 0) {
+            fprintf(stderr, "Error: Progressive iPF is always Zstd-compressed\n");
+            free(in.blocks);
+            return -1;
+        }
+        use_zstd = 1;
+    }
+
+    if (dst_alpha) oh.flags |= IPF_FLAG_ALPHA;
+    if (use_zstd) oh.flags |= IPF_FLAG_ZSTD;
+    if (progressive) oh.flags |= IPF_FLAG_PROGRESSIVE;
+
+    int out_bx = (out_w + 3) / 4;
+    int out_by = (out_h + 3) / 4;
+    int out_block_size = ipf_block_size(oh.type, dst_alpha);
+    size_t total = (size_t)out_bx * out_by;
+    size_t data_size = total * out_block_size;
+
+    uint8_t *raster = malloc(data_size);
+    if (!raster) {
+        free(in.blocks);
+        fprintf(stderr, "Error: Failed to allocate output buffer\n");
+        return -1;
+    }
+
+    for (int by = 0; by < out_by; by++) {
+        for (int bx = 0; bx < out_bx; bx++) {
+            const uint8_t *src = in.blocks + ((size_t)(y0 + by) * in.blocks_x + (x0 + bx)) * in.block_size;
+            uint8_t *dst = raster + ((size_t)by * out_bx + bx) * out_block_size;
+            transcode_block(src, ih->type, src_alpha, dst, oh.type, dst_alpha);
+        }
+    }
+    free(in.blocks);
+
+    uint8_t *stored = raster;
+    if (progressive) {
+        size_t *order = malloc(total * sizeof(size_t));
+        stored = malloc(data_size);
+        if (!order || !stored) {
+            free(order);
+            free(stored);
+            free(raster);
+            fprintf(stderr, "Error: Failed to allocate output buffer\n");
+            return -1;
+        }
+        build_adam7_order(out_bx, out_by, order);
+        for (size_t i = 0; i < total; i++) {
+            memcpy(stored + i * out_block_size, raster + order[i] * out_block_size, out_block_size);
+        }
+        free(order);
+        free(raster);
+    }
+
+    int result = write_ipf(cfg->output_file, &oh, stored, data_size, cfg->zstd_level, cfg->verbose);
+    free(stored);
+    return result;
+}
+
+// =============================================================================
+// Main Entry Point
+// =============================================================================
+
+static int parse_crop(const char *arg, transcoder_config_t *cfg) {
+    return sscanf(arg, "%dx%d+%d+%d", &cfg->crop_w, &cfg->crop_h, &cfg->crop_x, &cfg->crop_y) == 4 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    transcoder_config_t cfg = {
+        .input_file = NULL,
+        .output_file = NULL,
+        .ipf_type = KEEP,
+        .progressive = KEEP,
+        .alpha = KEEP,
+        .use_zstd = KEEP,
+        .zstd_level = DEFAULT_ZSTD_LEVEL,
+        .crop = 0,
+        .verbose = 0
+    };
+
+    static struct option long_options[] = {
+        {"input",       required_argument, 0, 'i'},
+        {"output",      required_argument, 0, 'o'},
+        {"type",        required_argument, 0, 't'},
+        {"progressive", no_argument,       0, 'p'},
+        {"raster",      no_argument,       0, 'R'},
+        {"crop",        required_argument, 0, 'c'},
+        {"alpha",       no_argument,       0, 'A'},
+        {"no-alpha",    no_argument,       0, 'N'},
+        {"zstd-level",  required_argument, 0, 'z'},
+        {"no-zstd",     no_argument,       0, 'Z'},
+        {"verbose",     no_argument,       0, 'v'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:o:t:pc:z:vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                cfg.input_file = optarg;
+                break;
+            case 'o':
+                cfg.output_file = optarg;
+                break;
+            case 't':
+                cfg.ipf_type = atoi(optarg) - 1;  // User specifies 1 or 2
+                if (cfg.ipf_type < 0 || cfg.ipf_type > 1) {
+                    fprintf(stderr, "Error: Invalid iPF type (use 1 or 2)\n");
+                    return 1;
+                }
+                break;
+            case 'p':
+                cfg.progressive = 1;
+                break;
+            case 'R':
+                cfg.progressive = 0;
+                break;
+            case 'c':
+                if (parse_crop(optarg, &cfg) != 0) {
+                    fprintf(stderr, "Error: Invalid crop (use WxH+X+Y)\n");
+                    return 1;
+                }
+                cfg.crop = 1;
+                break;
+            case 'A':
+                cfg.alpha = 1;
+                break;
+            case 'N':
+                cfg.alpha = 0;
+                break;
+            case 'z':
+                cfg.zstd_level = atoi(optarg);
+                if (cfg.zstd_level < 1 || cfg.zstd_level > ZSTD_maxCLevel()) {
+                    fprintf(stderr, "Error: Zstd level must be 1-%d\n", ZSTD_maxCLevel());
+                    return 1;
+                }
+                cfg.use_zstd = 1;
+                break;
+            case 'Z':
+                cfg.use_zstd = 0;
+                break;
+            case 'v':
+                cfg.verbose = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    // Validate required arguments
+    if (!cfg.input_file || !cfg.output_file) {
+        fprintf(stderr, "Error: Input and output files are required\n\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int result = transcode(&cfg);
+
+    if (result == 0) {
+        printf("Successfully transcoded: %s\n", cfg.output_file);
+    }
+
+    return result == 0 ? 0 : 1;
+}
@@ -7,6 +7,8 @@ import net.torvald.UnsafeHelper
 import net.torvald.terrarum.modulecomputers.virtualcomputer.tvd.toUint
 import java.io.ByteArrayInputStream
 import java.io.ByteArrayOutputStream
+import java.io.IOException
+import java.io.InputStream
 import java.util.zip.GZIPInputStream
 import java.util.zip.GZIPOutputStream
 
@@ -95,6 +97,89 @@ class CompressorDelegate(private val vm: VM) {
         return bytes.size
     }
 
+    /**
+     * Input for a [ZstdInputStream] that is handed one packet at a time. Running dry reads as the
+     * end of input, which ZstdInputStream only accepts between frames; anywhere else it throws
+     * "Not enough input bytes". Streamed packets never close their frame, so see
+     * [decompStreamFromTo] for why the feed is never read past its last packet.
+     */
+    private class PacketFeed : InputStream() {
+        private val packets = ArrayDeque<ByteArray>()
+        private var head = 0
+
+        fun append(ba: ByteArray) { if (ba.isNotEmpty()) packets.addLast(ba) }
+
+        override fun read(): Int {
+            val b = ByteArray(1)
+            return if (read(b, 0, 1) < 0) -1 else b[0].toUint()
+        }
+
+        override fun read(b: ByteArray, off: Int, len: Int): Int {
+            if (len == 0) return 0
+            var n = 0
+            while (n < len && packets.isNotEmpty()) {
+                val packet = packets.first()
+                val k = minOf(len - n, packet.size - head)
+                System.arraycopy(packet, head, b, off + n, k)
+                n += k; head += k
+                if (head == packet.size) { packets.removeFirst(); head = 0 }
+            }
+            return if (n == 0) -1 else n
+        }
+    }
+
+    private class DecompStream {
+        val feed = PacketFeed()
+        val zis = ZstdInputStream(feed)
+    }
+
+    private val decompStreams = HashMap<Int, DecompStream>()
+    private var nextDecompStream = 1
+
+    /**
+     * Opens a stream for zstd data that arrives in packets, each ending on a flush (e.g. streamed
+     * MOV video packets).
+     * @return handle for [decompStreamFromTo]
+     */
+    fun openDecompStream(): Int {
+        val handle = nextDecompStream++
+        decompStreams[handle] = DecompStream()
+        return handle
+    }
+
+    /**
+     * Makes the next packet start a new zstd frame, dropping what the stream has seen so far.
+     */
+    fun resetDecompStream(handle: Int) {
+        if (!decompStreams.containsKey(handle)) throw IllegalArgumentException("No such decompression stream: $handle")
+        decompStreams[handle] = DecompStream()
+    }
+
+    fun closeDecompStream(handle: Int) {
+        decompStreams.remove(handle)
+    }
+
+    /**
+     * Decompresses the next packet of a stream: `len` bytes at `input` that hold exactly `outLen`
+     * bytes of output.
+     *
+     * This relies on each packet ending on a flush: its last block completes the `outLen` bytes, so
+     * `readNBytes(outLen)` returns before ZstdInputStream asks the feed for the next block header.
+     * A packet holding less than `outLen` would run the feed dry mid-frame and throw.
+     * @return length of the bytes decompressed
+     */
+    fun decompStreamFromTo(handle: Int, input: Int, len: Int, output: Int, outLen: Int): Int {
+        val stream = decompStreams[handle] ?: throw IllegalArgumentException("No such decompression stream: $handle")
+        stream.feed.append(ByteArray(len) { vm.peek(input.toLong() + it)!! })
+        val bytes = stream.zis.readNBytes(outLen)
+        if (bytes.size != outLen) throw IOException("Zstd stream ended after ${bytes.size} of $outLen bytes")
+        // See compFromTo: always use the address-translating vm.poke loop.
+        bytes.forEachIndexed { index, byte ->
+            vm.poke(output.toLong() + index, byte)
+        }
+        return bytes.size
+    }
+
     companion object {
         val GZIP_HEADER = byteArrayOf(31, -117, 8) // .gz in DEFLATE
         val ZSTD_HEADER = byteArrayOf(40, -75, 47, -3)
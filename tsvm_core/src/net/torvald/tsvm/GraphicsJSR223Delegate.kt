@@ -871,7 +871,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
             val r0 = vm.peek(srcPtr + offset+0L)!!.toUint() / 255f
             val g0 = if (channels == 1) r0 else vm.peek(srcPtr + offset+1L)!!.toUint() / 255f
             val b0 = if (channels == 1) r0 else vm.peek(srcPtr + offset+2L)!!.toUint() / 255f
-            val a0 = if (hasAlpha) vm.peek(srcPtr + offset+(channels - 1L))!! / 255f else 1f
+            val a0 = if (hasAlpha) vm.peek(srcPtr + offset+(channels - 1L))!!.toUint() / 255f else 1f
 
             val r = floor((t / 15f + r0) * 15f) / 15f
             val g = floor((t / 15f + g0) * 15f) / 15f
@@ -893,7 +893,65 @@ class GraphicsJSR223Delegate(private val vm: VM) {
         return listOf(Ys, As, COs, CGs)
     }
 
+    /**
+     * Native address of `span` bytes starting at `ptr`, so a whole range can be handed to [IpfNative].
+     * Usermem is addressed forwards; peripheral memory is resolved through [VM.getDev]. Returns null
+     * when the range does not resolve, and the caller falls back to peek/poke.
+     */
+    private fun ipfNativeRange(ptr: Int, span: Long, isDest: Boolean): Long? {
+        if (span <= 0) return null
+        return if (ptr >= 0) {
+            if (ptr + span <= vm.memsize) vm.usermem.ptr + ptr else null
+        }
+        // getDev wants the offset of the last byte, not the length
+        else vm.getDev(ptr.toLong(), span - 1, isDest)
+    }
+
+    private fun ipfBlockSize(type: Int, hasAlpha: Boolean) = (if (type == 0) 12 else 16) + (if (hasAlpha) 8 else 0)
+
+    /**
+     * encodeIpf1/encodeIpf2 through [IpfNative]. Edge blocks read whole 4x4 areas like the Kotlin path,
+     * so the source span includes the pixels past the right and bottom edges.
+     *
+     * @return false if the caller has to encode with peek/poke
+     */
+    private fun encodeIpfNative(type: Int, srcPtr: Int, destPtr: Int, width: Int, height: Int, channels: Int, hasAlpha: Boolean, pattern: Int): Boolean {
+        // the Kotlin path reads backwards from negative addresses; leave those to it
+        if (!IpfNative.available || width <= 0 || height <= 0 || srcPtr < 0 || destPtr < 0) return false
+        if (channels != 1 && channels != 3 && channels != 4) return false
+
+        val blocksX = (width + 3) / 4
+        val blocksY = (height + 3) / 4
+        val srcSpan = channels * ((blocksY * 4 - 1L) * width + blocksX * 4)
+        val src = ipfNativeRange(srcPtr, srcSpan, false) ?: return false
+        val dest = ipfNativeRange(destPtr, blocksX.toLong() * blocksY * ipfBlockSize(type, hasAlpha), true) ?: return false
+
+        return IpfNative.encode(src, width * channels, channels, dest, width, height, type, if (hasAlpha) 1 else 0, pattern) == 0
+    }
+
+    /**
+     * decodeIpf1/decodeIpf2 and their progressive variants through [IpfNative]; every pixel of every
+     * block is written at a 560-byte stride, same as the Kotlin path.
+     *
+     * @return false if the caller has to decode with peek/poke
+     */
+    private fun decodeIpfNative(type: Int, srcPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, hasAlpha: Boolean, progressive: Boolean): Boolean {
+        if (!IpfNative.available || width <= 0 || height <= 0 || srcPtr < 0) return false
+
+        val blocksX = (width + 3) / 4
+        val blocksY = (height + 3) / 4
+        val planeSpan = (blocksY * 4 - 1L) * 560 + blocksX * 4
+        val src = ipfNativeRange(srcPtr, blocksX.toLong() * blocksY * ipfBlockSize(type, hasAlpha), false) ?: return false
+        val rg = ipfNativeRange(destRG, planeSpan, true) ?: return false
+        val ba = ipfNativeRange(destBA, planeSpan, true) ?: return false
+
+        val flags = (if (hasAlpha) 0x01 else 0) or (if (progressive) 0x80 else 0)
+        return IpfNative.decodePlanes(src, rg, ba, 560, width, height, type, flags) == 0
+    }
+
     fun encodeIpf1(srcPtr: Int, destPtr: Int, width: Int, height: Int, channels: Int, hasAlpha: Boolean, pattern: Int) {
+        if (encodeIpfNative(0, srcPtr, destPtr, width, height, channels, hasAlpha, pattern)) return
+
         var writeCount = 0L
         
         for (blockY in 0 until ceil(height / 4f)) {
@@ -951,12 +1009,33 @@ class GraphicsJSR223Delegate(private val vm: VM) {
         currentPtr: Int, // full iPF picture frame for t equals zero
         outPtr: Int, // where to write delta-encoded payloads to. Not touched if delta-encoding is worthless
         width: Int, height: Int,
-    ): Int {
-        var skipCount = 0
-        var outOffset = outPtr.toLong()
-        val blockSize = 12
+    ): Int = encodeIpfDelta(previousPtr, currentPtr, outPtr, width, height, 0, false)
+
+    /**
+     * encodeIpf1d for any iPF block stream: iPF1 or iPF2, with or without alpha. PATCH payloads are
+     * literal blocks of the frame's own type. `outPtr` needs blocks * (blockSize + 2) + 16 bytes.
+     *
+     * @return length of the delta stream
+     */
+    fun encodeIpfDelta(previousPtr: Int, currentPtr: Int, outPtr: Int, width: Int, height: Int, type: Int, hasAlpha: Boolean): Int {
+        val blockSize = ipfBlockSize(type, hasAlpha)
         val blocksPerRow = ceil(width / 4f).toInt()
         val blocksPerCol = ceil(height / 4f).toInt()
+
+        if (IpfNative.available && width > 0 && height > 0) {
+            val span = blocksPerRow.toLong() * blocksPerCol * blockSize
+            val previous = ipfNativeRange(previousPtr, span, false)
+            val current = ipfNativeRange(currentPtr, span, false)
+            val out = ipfNativeRange(outPtr, blocksPerRow.toLong() * blocksPerCol * (blockSize + 2) + 16, true)
+            if (previous != null && current != null && out != null) {
+                val len = IpfNative.deltaEncode(previous, current, out, width, height, type, if (hasAlpha) 1 else 0)
+                if (len > 0) return len
+            }
+        }
+
+        var skipCount = 0
+        var outOffset = outPtr.toLong()
+        val weights = ipfDeltaWeights(type, hasAlpha)
         val tempBlockA = ByteArray(blockSize)
         val tempBlockB = ByteArray(blockSize)
 
@@ -1004,7 +1083,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
                 tempBlockB[i] = vm.peek(offsetB + i)!!
             }
 
-            if (isSignificantlyDifferent(tempBlockA, tempBlockB)) {
+            if (isSignificantlyDifferent(tempBlockA, tempBlockB, weights)) {
                 // [skip payload]
                 if (skipCount > 0) {
                     emitState(SKIP)
@@ -1027,56 +1106,45 @@ class GraphicsJSR223Delegate(private val vm: VM) {
         return (outOffset - outPtr).toInt()
     }
 
-    private fun isSignificantlyDifferent(a: ByteArray, b: ByteArray): Boolean {
-        var score = 0.0
-
-        fun contrastWeight(v1: Int, v2: Int, delta: Int, weight: Int): Double {
-            val avg = (v1 + v2) / 2.0
-            val contrast = if (avg < 4 || avg > 11) 1.5 else 1.0
-            return delta * weight * contrast
-        }
+    /**
+     * Per-byte weights for [isSignificantlyDifferent]: 3 for chroma, 2 for luma and alpha. The last two
+     * luma bytes of a plain iPF1 block have never been scored, and stay unscored so old streams
+     * re-encode to the same bytes.
+     */
+    private fun ipfDeltaWeights(type: Int, hasAlpha: Boolean): IntArray {
+        val chromaBytes = if (type == 0) 4 else 8
+        val lumaBytes = if (type == 0 && !hasAlpha) 6 else 8
+        return IntArray(ipfBlockSize(type, hasAlpha)) { i -> when {
+            i < chromaBytes -> 3
+            i < chromaBytes + lumaBytes -> 2
+            i >= chromaBytes + 8 -> 2 // alpha
+            else -> 0
+        } }
+    }
 
-        // Co (bytes 0–1): 4 nybbles
-        val coA = (a[0].toUint()) or ((a[1].toUint()) shl 8)
-        val coB = (b[0].toUint()) or ((b[1].toUint()) shl 8)
-        for (i in 0 until 4) {
-            val va = (coA shr (i * 4)) and 0xF
-            val vb = (coB shr (i * 4)) and 0xF
-            val delta = abs(va - vb)
-            score += contrastWeight(va, vb, delta, 3)
-        }
+    private fun isSignificantlyDifferent(a: ByteArray, b: ByteArray, weights: IntArray): Boolean {
+        // twice the actual score, so the 1.5x contrast weight stays an integer
+        var score = 0
 
-        // Cg (bytes 2–3): 4 nybbles
-        val cgA = (a[2].toUint()) or ((a[3].toUint()) shl 8)
-        val cgB = (b[2].toUint()) or ((b[3].toUint()) shl 8)
-        for (i in 0 until 4) {
-            val va = (cgA shr (i * 4)) and 0xF
-            val vb = (cgB shr (i * 4)) and 0xF
-            val delta = abs(va - vb)
-            score += contrastWeight(va, vb, delta, 3)
+        fun contrastWeight(v1: Int, v2: Int, weight: Int): Int {
+            val contrast = if (v1 + v2 < 8 || v1 + v2 > 22) 3 else 2 // average below 4 or above 11
+            return abs(v1 - v2) * weight * contrast
         }
 
-        // Y (bytes 4–9): 16 nybbles
-        for (i in 4 until 10) {
+        for (i in weights.indices) {
+            if (weights[i] == 0) continue
             val byteA = a[i].toUint()
             val byteB = b[i].toUint()
-
-            val yAHigh = (byteA shr 4) and 0xF
-            val yALow = byteA and 0xF
-            val yBHigh = (byteB shr 4) and 0xF
-            val yBLow = byteB and 0xF
-
-            val deltaHigh = abs(yAHigh - yBHigh)
-            val deltaLow = abs(yALow - yBLow)
-
-            score += contrastWeight(yAHigh, yBHigh, deltaHigh, 2)
-            score += contrastWeight(yALow, yBLow, deltaLow, 2)
+            score += contrastWeight(byteA and 0xF, byteB and 0xF, weights[i])
+            score += contrastWeight(byteA shr 4, byteB shr 4, weights[i])
         }
 
-        return score > 4.0
+        return score > 8
     }
 
     fun encodeIpf2(srcPtr: Int, destPtr: Int, width: Int, height: Int, channels: Int, hasAlpha: Boolean, pattern: Int) {
+        if (encodeIpfNative(1, srcPtr, destPtr, width, height, channels, hasAlpha, pattern)) return
+
         var writeCount = 0L
 
         for (blockY in 0 until ceil(height / 4f)) {
@@ -1242,6 +1310,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
     fun decodeIpf1(srcPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, hasAlpha: Boolean) {
         val sign = if (destRG >= 0) 1 else -1
         if (destRG * destBA < 0) throw IllegalArgumentException("Both destination memories must be on the same domain (both being Usermem or HWmem)")
+        if (decodeIpfNative(0, srcPtr, destRG, destBA, width, height, hasAlpha, false)) return
         val sptr = srcPtr.toLong()
         val dptr1 = destRG.toLong()
         val dptr2 = destBA.toLong()
@@ -1307,18 +1376,37 @@ class GraphicsJSR223Delegate(private val vm: VM) {
         }}
     }
 
-    fun applyIpf1d(ipf1DeltaPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int) {
-        val BLOCK_SIZE = 12
+    fun applyIpf1d(ipf1DeltaPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int) =
+        applyIpfDelta(ipf1DeltaPtr, destRG, destBA, width, height, 0, false)
+
+    /**
+     * applyIpf1d for any iPF block stream. Only pixels inside `width` x `height` are written.
+     */
+    fun applyIpfDelta(deltaPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, type: Int, hasAlpha: Boolean) {
         val blocksPerRow = (width + 3) / 4
         val totalBlocks = ((width + 3) / 4) * ((height + 3) / 4)
 
-        val gpu = getFirstGPU()
         val sign = if (destRG >= 0) 1 else -1
         if (destRG * destBA < 0) throw IllegalArgumentException("Both destination memories must be on the same domain")
 
-        var ptr = ipf1DeltaPtr.toLong()
+        // the stream length is unknown until END, so only usermem deltas go native
+        if (IpfNative.available && width > 0 && height > 0 && deltaPtr >= 0 && deltaPtr < vm.memsize) {
+            val planeSpan = (height - 1L) * 560 + width
+            val rg = ipfNativeRange(destRG, planeSpan, true)
+            val ba = ipfNativeRange(destBA, planeSpan, true)
+            if (rg != null && ba != null &&
+                IpfNative.deltaApplyPlanes(vm.usermem.ptr + deltaPtr, vm.memsize - deltaPtr, rg, ba, 560, width, height, type, if (hasAlpha) 1 else 0) == 0) return
+        }
+
+        val blockSize = ipfBlockSize(type, hasAlpha)
+        var ptr = deltaPtr.toLong()
         var blockIndex = 0
 
+        // MOVE copies from the previous frame, which the stream overwrites as it goes
+        val planeSpan = (height - 1) * 560 + width
+        val previousRG = if (ipfDeltaHasMove(deltaPtr, blockSize)) ByteArray(planeSpan) { vm.peek(destRG.toLong() + it * sign)!! } else null
+        val previousBA = if (previousRG != null) ByteArray(planeSpan) { vm.peek(destBA.toLong() + it * sign)!! } else null
+
         fun readByte(): Int = vm.peek(ptr++)!!.toUint()
         fun readShort(): Int {
             val low = readByte()
@@ -1326,6 +1414,8 @@ class GraphicsJSR223Delegate(private val vm: VM) {
             return low or (high shl 8)
         }
 
+        fun readInt(): Int = readShort() or (readShort() shl 16)
+
         fun readVarInt(): Int {
             var value = 0
             var shift = 0
@@ -1352,43 +1442,58 @@ class GraphicsJSR223Delegate(private val vm: VM) {
                     for (i in 0 until count) {
                         if (blockIndex >= totalBlocks) break
 
-                        val co = readShort()
-                        val cg = readShort()
+                        val blockX = blockIndex % blocksPerRow
+                        val blockY = blockIndex / blocksPerRow
+
+                        // iPF2 packs both chroma rows of a corner into 32-bit words
+                        val co = if (type != 0) readInt() else readShort()
+                        val cg = if (type != 0) readInt() else readShort()
                         val y1 = readShort()
                         val y2 = readShort()
                         val y3 = readShort()
                         val y4 = readShort()
 
+                        var a1 = 65535; var a2 = 65535; var a3 = 65535; var a4 = 65535
+
+                        if (hasAlpha) {
+                            a1 = readShort()
+                            a2 = readShort()
+                            a3 = readShort()
+                            a4 = readShort()
+                        }
+
                         val rg = IntArray(16)
                         val ba = IntArray(16)
 
-                        var px = ipf1YcocgToRGB(co and 15, cg and 15, y1, 65535)
+                        fun corner(i: Int, y: Int, a: Int) =
+                            if (type != 0) ipf2YcocgToRGB((co shr (4 * i)) and 15, (co shr (4 * i + 8)) and 15,
+                                (cg shr (4 * i)) and 15, (cg shr (4 * i + 8)) and 15, y, a)
+                            else ipf1YcocgToRGB((co shr (4 * i)) and 15, (cg shr (4 * i)) and 15, y, a)
+
+                        var px = corner(0, y1, a1)
                         rg[0] = px[0]; ba[0] = px[1]
                         rg[1] = px[2]; ba[1] = px[3]
                         rg[4] = px[4]; ba[4] = px[5]
                         rg[5] = px[6]; ba[5] = px[7]
 
-                        px = ipf1YcocgToRGB((co shr 4) and 15, (cg shr 4) and 15, y2, 65535)
+                        px = corner(1, y2, a2)
                         rg[2] = px[0]; ba[2] = px[1]
                         rg[3] = px[2]; ba[3] = px[3]
                         rg[6] = px[4]; ba[6] = px[5]
                         rg[7] = px[6]; ba[7] = px[7]
 
-                        px = ipf1YcocgToRGB((co shr 8) and 15, (cg shr 8) and 15, y3, 65535)
+                        px = corner(if (type != 0) 4 else 2, y3, a3)
                         rg[8] = px[0]; ba[8] = px[1]
                         rg[9] = px[2]; ba[9] = px[3]
                         rg[12] = px[4]; ba[12] = px[5]
                         rg[13] = px[6]; ba[13] = px[7]
 
-                        px = ipf1YcocgToRGB((co shr 12) and 15, (cg shr 12) and 15, y4, 65535)
+                        px = corner(if (type != 0) 5 else 3, y4, a4)
                         rg[10] = px[0]; ba[10] = px[1]
                         rg[11] = px[2]; ba[11] = px[3]
                         rg[14] = px[4]; ba[14] = px[5]
                         rg[15] = px[6]; ba[15] = px[7]
 
-                        val blockX = blockIndex % blocksPerRow
-                        val blockY = blockIndex / blocksPerRow
-
                         for (py in 0..3) {
                             for (pxi in 0..3) {
                                 val ox = blockX * 4 + pxi
@@ -1414,6 +1519,33 @@ class GraphicsJSR223Delegate(private val vm: VM) {
                     }
                 }
 
+                MOVE -> { // Copy blocks from elsewhere in the previous frame
+                    val count = readVarInt()
+                    val dx = readByte().toByte() * 4
+                    val dy = readByte().toByte() * 4
+
+                    for (i in 0 until count) {
+                        val blockX = blockIndex % blocksPerRow
+                        val blockY = blockIndex / blocksPerRow
+
+                        for (py in 0..3) {
+                            for (pxi in 0..3) {
+                                val ox = blockX * 4 + pxi
+                                val oy = blockY * 4 + py
+                                val sx = ox + dx
+                                val sy = oy + dy
+                                if (ox < width && oy < height && sx in 0 until width && sy in 0 until height) {
+                                    val offset = oy * 560 + ox
+                                    vm.poke((destRG + offset * sign).toLong(), previousRG!![sy * 560 + sx])
+                                    vm.poke((destBA + offset * sign).toLong(), previousBA!![sy * 560 + sx])
+                                }
+                            }
+                        }
+
+                        blockIndex++
+                    }
+                }
+
                 END -> return // End of stream
                 else -> error("Unknown delta opcode: ${opcode.toString(16)}")
             }
@@ -1421,9 +1553,35 @@ class GraphicsJSR223Delegate(private val vm: VM) {
     }
 
 
+    private fun ipfDeltaHasMove(deltaPtr: Int, blockSize: Int): Boolean {
+        var ptr = deltaPtr.toLong()
+
+        fun readVarInt(): Int {
+            var value = 0
+            var shift = 0
+            while (true) {
+                val byte = vm.peek(ptr++)!!.toUint()
+                value = value or ((byte and 0x7F) shl shift)
+                if ((byte and 0x80) == 0) break
+                shift += 7
+            }
+            return value
+        }
+
+        while (true) {
+            when (vm.peek(ptr++)!!) {
+                SKIP, REPEAT -> readVarInt()
+                PATCH -> ptr += readVarInt().toLong() * blockSize
+                MOVE -> return true
+                else -> return false // END, or an opcode applyIpfDelta will complain about
+            }
+        }
+    }
+
     fun decodeIpf2(srcPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, hasAlpha: Boolean) {
         val sign = if (destRG >= 0) 1 else -1
         if (destRG * destBA < 0) throw IllegalArgumentException("Both destination memories must be on the same domain (both being Usermem or HWmem)")
+        if (decodeIpfNative(1, srcPtr, destRG, destBA, width, height, hasAlpha, false)) return
         val sptr = srcPtr.toLong()
         val dptr1 = destRG.toLong()
         val dptr2 = destBA.toLong()
@@ -1539,6 +1697,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
     fun decodeIpf1Progressive(srcPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, hasAlpha: Boolean) {
         val sign = if (destRG >= 0) 1 else -1
         if (destRG * destBA < 0) throw IllegalArgumentException("Both destination memories must be on the same domain (both being Usermem or HWmem)")
+        if (decodeIpfNative(0, srcPtr, destRG, destBA, width, height, hasAlpha, true)) return
         val sptr = srcPtr.toLong()
         val dptr1 = destRG.toLong()
         val dptr2 = destBA.toLong()
@@ -1612,6 +1771,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
     fun decodeIpf2Progressive(srcPtr: Int, destRG: Int, destBA: Int, width: Int, height: Int, hasAlpha: Boolean) {
         val sign = if (destRG >= 0) 1 else -1
         if (destRG * destBA < 0) throw IllegalArgumentException("Both destination memories must be on the same domain (both being Usermem or HWmem)")
+        if (decodeIpfNative(1, srcPtr, destRG, destBA, width, height, hasAlpha, true)) return
         val sptr = srcPtr.toLong()
         val dptr1 = destRG.toLong()
         val dptr2 = destBA.toLong()
@@ -1683,6 +1843,7 @@ class GraphicsJSR223Delegate(private val vm: VM) {
     private val SKIP = 0x00.toByte()
     private val PATCH = 0x01.toByte()
     private val REPEAT = 0x02.toByte()
+    private val MOVE = 0x03.toByte()
     private val END = 0xFF.toByte()
 
     // TEV (TSVM Enhanced Video) format support
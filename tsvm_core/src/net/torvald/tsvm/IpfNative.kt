@@ -0,0 +1,53 @@
+package net.torvald.tsvm
+
+/**
+ * Native iPF codec (ipf_encoder/libipf, bridged by ipf_encoder/ipf_jni.c).
+ *
+ * Build it with `make jni` in ipf_encoder and put libipf_jni on java.library.path, or point
+ * `-Dtsvm.libipf=/path/to/libipf_jni.so` at it. When the library is missing, [available] is false
+ * and GraphicsJSR223Delegate keeps using its Kotlin codec, which gives the same bytes.
+ * `-Dtsvm.libipf=off` forces the Kotlin codec.
+ *
+ * All pointers are raw native addresses that the caller has already resolved and bounds-checked.
+ */
+object IpfNative {
+
+    val available: Boolean = try {
+        when (val path = System.getProperty("tsvm.libipf")) {
+            "off" -> false
+            null -> { System.loadLibrary("ipf_jni"); true }
+            else -> { System.load(path); true }
+        }
+    }
+    catch (e: Throwable) {
+        false
+    }
+
+    /**
+     * Decodes a raw (uncompressed) block stream into the RG and BA planes, `stride` bytes per row.
+     * @param flags iPF header flags; only alpha (0x01) and progressive (0x80) matter here
+     * @return 0 on success
+     */
+    @JvmStatic external fun decodePlanes(src: Long, rg: Long, ba: Long, stride: Int, width: Int, height: Int, type: Int, flags: Int): Int
+
+    /**
+     * Encodes `channels`-byte pixels, `stride` bytes per row, into a raw block stream.
+     * @param pattern Bayer dither kernel, or negative for none
+     * @return 0 on success
+     */
+    @JvmStatic external fun encode(src: Long, stride: Int, channels: Int, dest: Long, width: Int, height: Int, type: Int, flags: Int, pattern: Int): Int
+
+    /**
+     * Delta-encodes the block stream at `current` against the one at `previous` (SKIP/PATCH/END, see
+     * terranmon.txt). `out` must hold blocks * (blockSize + 2) + 16 bytes.
+     * @return bytes written, or negative on bad geometry
+     */
+    @JvmStatic external fun deltaEncode(previous: Long, current: Long, out: Long, width: Int, height: Int, type: Int, flags: Int): Int
+
+    /**
+     * Applies a delta stream of at most `len` bytes onto the RG and BA planes. Only pixels inside
+     * `width` x `height` are written.
+     * @return 0 on success, negative if the stream is corrupt or runs past `len`
+     */
+    @JvmStatic external fun deltaApplyPlanes(delta: Long, len: Long, rg: Long, ba: Long, stride: Int, width: Int, height: Int, type: Int, flags: Int): Int
+}